@@ -50,6 +50,8 @@ extern void spawn(hclib_task_t * task);
 extern void spawn_await_at(hclib_task_t *task, hclib_future_t **futures,
         const int nfutures, hclib_locale_t *locale);
 extern void spawn_at(hclib_task_t *task, hclib_locale_t *locale);
+extern void spawn_escaping_at(hclib_locale_t *locale, hclib_task_t *task,
+        hclib_future_t *future);
 extern void spawn_await(hclib_task_t *task, hclib_future_t **futures,
         const int nfutures);
 
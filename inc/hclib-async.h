@@ -190,6 +190,18 @@ inline void async_nb_at(T&& lambda, hclib_locale_t *locale) {
 	spawn_at(task, locale);
 }
 
+/*
+ * Spawn a task that does not belong to the current finish, so that no
+ * enclosing finish waits for it, e.g. for a runtime-owned service task.
+ */
+template <typename T>
+inline void async_escaping_at(T&& lambda, hclib_locale_t *locale) {
+    MARK_OVH(current_ws()->id);
+    typedef typename std::remove_reference<T>::type U;
+    spawn_escaping_at(locale, initialize_task(call_lambda<U>, new U(lambda)),
+            NULL);
+}
+
 template <typename T>
 inline void async_nb_await(T&& lambda, hclib_future_t *future) {
 	MARK_OVH(current_ws()->id);
@@ -40,6 +40,8 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #ifndef HCLIB_FORASYNC_H_
 #define HCLIB_FORASYNC_H_
 
+#include <vector>
+
 #include "hclib.h"
 #include "hclib-task.h"
 
@@ -58,6 +60,23 @@ inline int default_tile_size(const int n, const int nchunks) {
     return (n + nchunks - 1) / nchunks;
 }
 
+/*
+ * Number of iterations FORASYNC_MODE_ADAPTIVE executes between checks of the
+ * local deque, rounded up to a multiple of stride.
+ */
+inline int adaptive_chunk_size(const int n, const int stride) {
+    int chunk = n / (hclib_get_num_workers() *
+            FORASYNC_ADAPTIVE_CHUNKS_PER_WORKER);
+    if (chunk < 1) chunk = 1;
+    return ((chunk + stride - 1) / stride) * stride;
+}
+
+inline int adaptive_split_point(const int low, const int high,
+        const int stride) {
+    const int half = (((high - low) / 2) / stride) * stride;
+    return half > 0 ? low + half : high;
+}
+
 class loop_domain_1d {
     private:
         hclib_loop_domain_t loop;
@@ -105,6 +124,14 @@ class loop_domain_2d {
             loop[1].stride = 1; loop[1].tile = default_tile_size(high2 - low2, hclib_get_num_workers());
         }
 
+        loop_domain_2d(int low1, int high1, int tile1,
+                int low2, int high2, int tile2) {
+            loop[0].low = low1; loop[0].high = high1;
+            loop[0].stride = 1; loop[0].tile = tile1;
+            loop[1].low = low2; loop[1].high = high2;
+            loop[1].stride = 1; loop[1].tile = tile2;
+        }
+
         hclib_loop_domain_t *get_internal() { return loop; }
 };
 
@@ -180,6 +207,38 @@ inline void forasync3D_runner(const hclib_loop_domain_t loop[3], T lambda) {
 	}
 }
 
+/*
+ * Wraps a user lambda that should be invoked once per tile with the bounds of
+ * that tile, rather than once per iteration. The runner overloads below are
+ * more specialized than the per-iteration runners, so every chunking strategy
+ * picks them up without modification.
+ */
+template <typename T>
+struct range_body {
+    T lambda;
+
+    range_body(T l) : lambda(l) { }
+};
+
+template <typename T>
+inline void forasync1D_runner(const hclib_loop_domain_t* loop,
+        range_body<T> body) {
+    body.lambda(loop[0].low, loop[0].high);
+}
+
+template <typename T>
+inline void forasync2D_runner(const hclib_loop_domain_t loop[2],
+        range_body<T> body) {
+    body.lambda(loop[0].low, loop[0].high, loop[1].low, loop[1].high);
+}
+
+template <typename T>
+inline void forasync3D_runner(const hclib_loop_domain_t loop[3],
+        range_body<T> body) {
+    body.lambda(loop[0].low, loop[0].high, loop[1].low, loop[1].high,
+            loop[2].low, loop[2].high);
+}
+
 template <typename T>
 inline void forasync1D_recursive(hclib_loop_domain_t * loop, T lambda,
         hclib_future_t *future, const bool nb) {
@@ -203,7 +262,7 @@ inline void forasync1D_recursive(hclib_loop_domain_t * loop, T lambda,
 	} else {
 		//compute the tile
 		hclib_loop_domain_t ld = {low, high, stride, tile};
-		forasync1D_runner<T>(&ld, lambda);
+		forasync1D_runner(&ld, lambda);
 	}
 }
 
@@ -262,7 +321,7 @@ inline void forasync2D_recursive(const hclib_loop_domain_t loop[2], T lambda,
 		};
 		forasync2D_recursive<T>(new_loop_lower_half, lambda, future, nb);
 	} else { //compute the tile
-		forasync2D_runner<T>(loop, lambda);
+		forasync2D_runner(loop, lambda);
 	}
 }
 
@@ -338,7 +397,7 @@ inline void forasync3D_recursive(const hclib_loop_domain_t loop[3], T lambda,
 		};
 		forasync3D_recursive<T>(new_loop_lower_half, lambda, future, nb);
 	} else { //compute the tile
-		forasync3D_runner<T>(loop, lambda);
+		forasync3D_runner(loop, lambda);
 	}
 }
 
@@ -348,6 +407,7 @@ inline void forasync1D_flat(hclib_loop_domain_t* loop, T lambda,
     const int low = loop->low, high = loop->high, stride = loop->stride,
             tile = loop->tile;
     const loop_dist_func func = hclib_lookup_dist_func(dist_func_id);
+    const hclib_loop_domain_t whole = *loop;
 
 	int nb_chunks = (int) (high/tile);
 	int size = tile * nb_chunks;
@@ -355,7 +415,9 @@ inline void forasync1D_flat(hclib_loop_domain_t* loop, T lambda,
 	for (low0 = low; low0 < size; low0 += tile) {
         hclib_loop_domain_t ld = {low0, low0 + tile, stride, tile};
         auto lambda_wrapper = [=]() {
-			forasync1D_runner<T>(&ld, lambda);
+            hclib_record_dist(dist_func_id, 1, &ld, &whole,
+                    FORASYNC_MODE_FLAT);
+			forasync1D_runner(&ld, lambda);
 		};
 
         hclib_locale_t *locale = func(1, &ld, loop, FORASYNC_MODE_FLAT);
@@ -369,7 +431,9 @@ inline void forasync1D_flat(hclib_loop_domain_t* loop, T lambda,
 	if (size < high) {
         hclib_loop_domain_t ld = {low0, high, stride, tile};
         auto lambda_wrapper = [=]() {
-			forasync1D_runner<T>(&ld, lambda);
+            hclib_record_dist(dist_func_id, 1, &ld, &whole,
+                    FORASYNC_MODE_FLAT);
+			forasync1D_runner(&ld, lambda);
 		};
         hclib_locale_t *locale = func(1, &ld, loop, FORASYNC_MODE_FLAT);
         if (nb) {
@@ -404,7 +468,7 @@ inline void forasync2D_flat(const hclib_loop_domain_t loop[2], T lambda,
 			hclib_loop_domain_t new_loop[2] = {new_loop0, new_loop1};
 
             auto lambda_wrapper = [=]() {
-				forasync2D_runner<T>(new_loop, lambda);
+				forasync2D_runner(new_loop, lambda);
 			};
 
             if (nb) {
@@ -449,7 +513,7 @@ inline void forasync3D_flat(const hclib_loop_domain_t loop[3], T lambda,
 				hclib_loop_domain_t new_loop[3] = {new_loop0, new_loop1, new_loop2};
 
                 auto lambda_wrapper = [=]() {
-					forasync3D_runner<T>(new_loop, lambda);
+					forasync3D_runner(new_loop, lambda);
 				};
 
                 if (nb) {
@@ -462,6 +526,155 @@ inline void forasync3D_flat(const hclib_loop_domain_t loop[3], T lambda,
 	}
 }
 
+template <int DIM>
+struct tile_runner;
+
+template <>
+struct tile_runner<1> {
+    template <typename T>
+    static void run(const hclib_loop_domain_t *loop, T lambda) {
+        forasync1D_runner(loop, lambda);
+    }
+};
+
+template <>
+struct tile_runner<2> {
+    template <typename T>
+    static void run(const hclib_loop_domain_t *loop, T lambda) {
+        forasync2D_runner(loop, lambda);
+    }
+};
+
+template <>
+struct tile_runner<3> {
+    template <typename T>
+    static void run(const hclib_loop_domain_t *loop, T lambda) {
+        forasync3D_runner(loop, lambda);
+    }
+};
+
+/*
+ * Lazy binary splitting over the outermost dimension: run the loop in chunks of
+ * loop[0].tile iterations and only spawn the upper half of the remaining range
+ * when the current worker has nothing else queued.
+ */
+template <int DIM, typename T>
+inline void forasync_adaptive(const hclib_loop_domain_t *loop, T lambda,
+        hclib_future_t *future) {
+    hclib_loop_domain_t ld[DIM];
+    for (int d = 0; d < DIM; d++) ld[d] = loop[d];
+    const int stride0 = ld[0].stride, chunk0 = ld[0].tile;
+    int low0 = ld[0].low, high0 = ld[0].high;
+
+    while (low0 < high0) {
+        if (high0 - low0 > chunk0 && hclib_current_worker_backlog() == 0) {
+            const int mid = adaptive_split_point(low0, high0, stride0);
+            auto lambda_wrapper = [=]() {
+                hclib_loop_domain_t upper[DIM];
+                for (int d = 0; d < DIM; d++) upper[d] = ld[d];
+                upper[0].low = mid;
+                upper[0].high = high0;
+                forasync_adaptive<DIM, T>(upper, lambda, future);
+            };
+
+            hclib::async_await(lambda_wrapper, future);
+            high0 = mid;
+            continue;
+        }
+
+        ld[0].low = low0;
+        ld[0].high = (high0 - low0 > chunk0) ? low0 + chunk0 : high0;
+        tile_runner<DIM>::run(ld, lambda);
+        low0 = ld[0].high;
+    }
+}
+
+template <int DIM, typename T>
+inline void forasync_adaptive_internal(const hclib_loop_domain_t *loop,
+        T lambda, hclib_future_t *future, const bool nb) {
+    HASSERT(nb == false);
+    hclib_loop_domain_t ld[DIM];
+    for (int d = 0; d < DIM; d++) ld[d] = loop[d];
+    ld[0].tile = adaptive_chunk_size(ld[0].high - ld[0].low, ld[0].stride);
+    forasync_adaptive<DIM, T>(ld, lambda, future);
+}
+
+/*
+ * Cache-oblivious recursive splitting: always halve the longest dimension that
+ * is still larger than its tile. Like forasync1D_recursive, nb is not supported.
+ */
+template <int DIM, typename T>
+inline void forasync_oblivious(const hclib_loop_domain_t *loop, T lambda,
+        hclib_future_t *future, const bool nb) {
+    HASSERT(nb == false);
+    int longest = -1;
+    for (int d = 0; d < DIM; d++) {
+        const int extent = loop[d].high - loop[d].low;
+        if (extent > loop[d].tile && (longest < 0 ||
+                    extent > loop[longest].high - loop[longest].low)) {
+            longest = d;
+        }
+    }
+
+    if (longest < 0) {
+        tile_runner<DIM>::run(loop, lambda);
+        return;
+    }
+
+    hclib_loop_domain_t lower[DIM], upper[DIM];
+    for (int d = 0; d < DIM; d++) lower[d] = upper[d] = loop[d];
+    const int mid = (loop[longest].low + loop[longest].high) / 2;
+    lower[longest].high = mid;
+    upper[longest].low = mid;
+
+    auto lambda_wrapper = [=]() {
+        forasync_oblivious<DIM, T>(upper, lambda, future, nb);
+    };
+    hclib::async_await(lambda_wrapper, future);
+    forasync_oblivious<DIM, T>(lower, lambda, future, nb);
+}
+
+/*
+ * Flat chunking that spawns tiles along the space-filling curve selected by
+ * mode (see hclib_forasync_tile_order).
+ */
+template <int DIM, typename T>
+inline void forasync_ordered(const hclib_loop_domain_t *loop, T lambda,
+        int mode, hclib_future_t *future, const bool nb) {
+    int ntiles[DIM];
+    int total = 1;
+    for (int d = 0; d < DIM; d++) {
+        ntiles[d] = (loop[d].high - loop[d].low + loop[d].tile - 1) /
+            loop[d].tile;
+        total *= ntiles[d];
+    }
+    int *order = (int *)malloc(total * sizeof(int));
+    HASSERT(order);
+    hclib_forasync_tile_order(DIM, ntiles, mode, order);
+
+    for (int i = 0; i < total; i++) {
+        hclib_loop_domain_t ld[DIM];
+        int rem = order[i];
+        for (int d = DIM - 1; d >= 0; d--) {
+            const int low = loop[d].low + (rem % ntiles[d]) * loop[d].tile;
+            const int high = low + loop[d].tile;
+            ld[d] = {low, high > loop[d].high ? loop[d].high : high,
+                loop[d].stride, loop[d].tile};
+            rem /= ntiles[d];
+        }
+
+        auto lambda_wrapper = [=]() {
+            tile_runner<DIM>::run(ld, lambda);
+        };
+        if (nb) {
+            hclib::async_nb_await(lambda_wrapper, future);
+        } else {
+            hclib::async_await(lambda_wrapper, future);
+        }
+    }
+    free(order);
+}
+
 template <typename T>
 inline void forasync1D_internal(hclib_loop_domain_t* loop, T lambda, int mode,
         hclib_future_t *future, const int dist_func_id, const bool nb) {
@@ -470,6 +683,18 @@ inline void forasync1D_internal(hclib_loop_domain_t* loop, T lambda, int mode,
 		forasync1D_flat<T>(loop, lambda, future, dist_func_id, nb);
 		break;
 	case FORASYNC_MODE_RECURSIVE:
+        HASSERT(dist_func_id == HCLIB_DEFAULT_LOOP_DIST);
+		forasync1D_recursive<T>(loop, lambda, future, nb);
+		break;
+	case FORASYNC_MODE_ADAPTIVE:
+        HASSERT(dist_func_id == HCLIB_DEFAULT_LOOP_DIST);
+		forasync_adaptive_internal<1, T>(loop, lambda, future, nb);
+		break;
+	case FORASYNC_MODE_MORTON:
+	case FORASYNC_MODE_HILBERT:
+		forasync1D_flat<T>(loop, lambda, future, dist_func_id, nb);
+		break;
+	case FORASYNC_MODE_OBLIVIOUS:
         HASSERT(dist_func_id == HCLIB_DEFAULT_LOOP_DIST);
 		forasync1D_recursive<T>(loop, lambda, future, nb);
 		break;
@@ -488,6 +713,16 @@ inline void forasync2D_internal(const hclib_loop_domain_t loop[2], T lambda,
 	case FORASYNC_MODE_RECURSIVE:
 		forasync2D_recursive<T>(loop, lambda, future, nb);
 		break;
+	case FORASYNC_MODE_ADAPTIVE:
+		forasync_adaptive_internal<2, T>(loop, lambda, future, nb);
+		break;
+	case FORASYNC_MODE_MORTON:
+	case FORASYNC_MODE_HILBERT:
+		forasync_ordered<2, T>(loop, lambda, mode, future, nb);
+		break;
+	case FORASYNC_MODE_OBLIVIOUS:
+		forasync_oblivious<2, T>(loop, lambda, future, nb);
+		break;
 	default:
 		HASSERT("Check forasync mode" && false);
 	}
@@ -503,6 +738,16 @@ inline void forasync3D_internal(const hclib_loop_domain_t loop[3], T lambda,
 	case FORASYNC_MODE_RECURSIVE:
 		forasync3D_recursive<T>(loop, lambda, future, nb);
 		break;
+	case FORASYNC_MODE_ADAPTIVE:
+		forasync_adaptive_internal<3, T>(loop, lambda, future, nb);
+		break;
+	case FORASYNC_MODE_MORTON:
+	case FORASYNC_MODE_HILBERT:
+		forasync_ordered<3, T>(loop, lambda, mode, future, nb);
+		break;
+	case FORASYNC_MODE_OBLIVIOUS:
+		forasync_oblivious<3, T>(loop, lambda, future, nb);
+		break;
 	default:
 		HASSERT("Check forasync mode" && false);
 	}
@@ -594,6 +839,225 @@ inline void forasync3D_nb(loop_domain_3d* loop, T lambda,
     forasync3D_internal<T>(loop->get_internal(), lambda, mode, future, true);
 }
 
+/*
+ * Range variants of forasync1D/2D/3D. The provided lambda accepts the bounds
+ * of a tile, e.g. (int low, int high) in 1D, and is responsible for iterating
+ * over it using the stride of the loop domain. Because the inner loop is
+ * visible to the compiler as a single function body, it can be vectorized.
+ */
+template <typename T>
+inline void forasync1D_range(loop_domain_1d* loop, T lambda,
+        bool force_seq = false, int mode = FORASYNC_MODE_RECURSIVE,
+        hclib_future_t *future = NULL,
+        int dist_func_id = HCLIB_DEFAULT_LOOP_DIST) {
+    if (force_seq) {
+        hclib_loop_domain_t *internal = loop->get_internal();
+        lambda(internal->low, internal->high);
+    } else {
+        forasync1D_internal<range_body<T> >(loop->get_internal(),
+                range_body<T>(lambda), mode, future, dist_func_id, false);
+    }
+}
+
+template <typename T>
+inline void forasync1D_range_nb(loop_domain_1d* loop, T lambda,
+        bool force_seq = false, int mode = FORASYNC_MODE_RECURSIVE,
+        hclib_future_t *future = NULL,
+        int dist_func_id = HCLIB_DEFAULT_LOOP_DIST) {
+    if (force_seq) {
+        hclib_loop_domain_t *internal = loop->get_internal();
+        lambda(internal->low, internal->high);
+    } else {
+        forasync1D_internal<range_body<T> >(loop->get_internal(),
+                range_body<T>(lambda), mode, future, dist_func_id, true);
+    }
+}
+
+template <typename T>
+inline void forasync2D_range(loop_domain_2d* loop, T lambda,
+        bool force_seq = false, int mode = FORASYNC_MODE_RECURSIVE,
+        hclib_future_t *future = NULL) {
+    if (force_seq) {
+        hclib_loop_domain_t *internal = loop->get_internal();
+        lambda(internal[0].low, internal[0].high, internal[1].low,
+                internal[1].high);
+    } else {
+        forasync2D_internal<range_body<T> >(loop->get_internal(),
+                range_body<T>(lambda), mode, future, false);
+    }
+}
+
+template <typename T>
+inline void forasync3D_range(loop_domain_3d* loop, T lambda,
+        bool force_seq = false, int mode = FORASYNC_MODE_RECURSIVE,
+        hclib_future_t *future = NULL) {
+    if (force_seq) {
+        hclib_loop_domain_t *internal = loop->get_internal();
+        lambda(internal[0].low, internal[0].high, internal[1].low,
+                internal[1].high, internal[2].low, internal[2].high);
+    } else {
+        forasync3D_internal<range_body<T> >(loop->get_internal(),
+                range_body<T>(lambda), mode, future, false);
+    }
+}
+
+template <typename T>
+inline hclib::future_t<void> *forasync1D_range_future(loop_domain_1d* loop,
+        T lambda, bool force_seq = false, int mode = FORASYNC_MODE_RECURSIVE,
+        hclib_future_t *future = NULL,
+        int dist_func_id = HCLIB_DEFAULT_LOOP_DIST) {
+    hclib::promise_t<void> *event = new hclib::promise_t<void>();
+
+    if (force_seq) {
+        hclib_loop_domain_t *internal = loop->get_internal();
+        lambda(internal->low, internal->high);
+        event->put();
+        return event->get_future();
+    } else {
+        hclib_start_finish();
+        forasync1D_internal<range_body<T> >(loop->get_internal(),
+                range_body<T>(lambda), mode, future, dist_func_id, false);
+        hclib_end_finish_nonblocking_helper(event);
+        return event->get_future();
+    }
+}
+
+/*
+ * Tile dependencies accepted by forasync2D_wavefront. Each flag makes a tile
+ * wait on the neighbouring tile in that direction, where north is the previous
+ * tile in the outer dimension and west the previous tile in the inner one.
+ */
+#define FORASYNC_WAVEFRONT_NORTH     0x1
+#define FORASYNC_WAVEFRONT_WEST      0x2
+#define FORASYNC_WAVEFRONT_NORTHWEST 0x4
+#define FORASYNC_WAVEFRONT_NORTHEAST 0x8
+
+template <typename T>
+struct wavefront_state {
+    hclib_loop_domain_t loop[2];
+    int ntiles[2];
+    int deps_pattern;
+    // Number of unfinished predecessors of each tile
+    volatile int *pending;
+    // Number of tiles that have not yet executed
+    volatile int remaining;
+    T lambda;
+
+    wavefront_state(const hclib_loop_domain_t *l, int deps, T lam) :
+            deps_pattern(deps), lambda(lam) {
+        for (int d = 0; d < 2; d++) {
+            loop[d] = l[d];
+            ntiles[d] = (l[d].high - l[d].low + l[d].tile - 1) / l[d].tile;
+        }
+        remaining = ntiles[0] * ntiles[1];
+        pending = new int[ntiles[0] * ntiles[1]];
+    }
+
+    ~wavefront_state() {
+        delete[] pending;
+    }
+
+    /*
+     * Visit every in-bounds neighbour of tile (i, j) selected by deps_pattern,
+     * in the direction given by dir (-1 for predecessors, 1 for successors).
+     */
+    template <typename F>
+    void for_each_neighbour(int i, int j, int dir, F f) {
+        const int di[4] = {1, 0, 1, 1};
+        const int dj[4] = {0, 1, 1, -1};
+        for (int k = 0; k < 4; k++) {
+            if ((deps_pattern & (1 << k)) == 0) continue;
+            const int ni = i + dir * di[k];
+            const int nj = j + dir * dj[k];
+            if (ni >= 0 && ni < ntiles[0] && nj >= 0 && nj < ntiles[1]) {
+                f(ni * ntiles[1] + nj);
+            }
+        }
+    }
+};
+
+/*
+ * Run tile (i, j) and then release its successors. The first successor this
+ * tile makes ready is executed inline so that chains of dependent tiles stay
+ * on the worker that produced their inputs; any others are spawned locally.
+ */
+template <typename T>
+inline void forasync2D_wavefront_tile(wavefront_state<T> *state, int tile) {
+    while (tile >= 0) {
+        const int i = tile / state->ntiles[1];
+        const int j = tile % state->ntiles[1];
+        const hclib_loop_domain_t *loop = state->loop;
+        const int low0 = loop[0].low + i * loop[0].tile;
+        const int low1 = loop[1].low + j * loop[1].tile;
+        const int high0 = low0 + loop[0].tile < loop[0].high ?
+            low0 + loop[0].tile : loop[0].high;
+        const int high1 = low1 + loop[1].tile < loop[1].high ?
+            low1 + loop[1].tile : loop[1].high;
+        state->lambda(low0, high0, low1, high1);
+
+        int next = -1;
+        state->for_each_neighbour(i, j, 1, [&](int succ) {
+            if (__sync_sub_and_fetch(&state->pending[succ], 1) == 0) {
+                if (next < 0) {
+                    next = succ;
+                } else {
+                    hclib::async([=]() {
+                        forasync2D_wavefront_tile<T>(state, succ);
+                    });
+                }
+            }
+        });
+
+        if (__sync_sub_and_fetch(&state->remaining, 1) == 0) {
+            delete state;
+        }
+        tile = next;
+    }
+}
+
+/*
+ * Execute a 2D loop tile by tile, where each tile may only start once the
+ * neighbouring tiles selected by deps_pattern (a combination of the
+ * FORASYNC_WAVEFRONT_* flags) have completed. lambda is called once per tile
+ * with the tile's bounds, as in forasync2D_range. Dependencies are tracked with
+ * a counter per tile rather than a promise per tile. Like forasync2D, this
+ * call does not wait for the loop to complete; wrap it in a finish scope.
+ */
+template <typename T>
+inline void forasync2D_wavefront(loop_domain_2d* loop, int deps_pattern,
+        T lambda) {
+    wavefront_state<T> *state = new wavefront_state<T>(loop->get_internal(),
+            deps_pattern, lambda);
+    const int ntiles = state->ntiles[0] * state->ntiles[1];
+    if (ntiles == 0) {
+        delete state;
+        return;
+    }
+
+    for (int t = 0; t < ntiles; t++) {
+        int npreds = 0;
+        state->for_each_neighbour(t / state->ntiles[1], t % state->ntiles[1],
+                -1, [&](int pred) { npreds++; });
+        state->pending[t] = npreds;
+    }
+
+    /*
+     * Collect the initially ready tiles before spawning any of them, as the
+     * state may be freed as soon as the last tile completes.
+     */
+    std::vector<int> ready;
+    for (int t = 0; t < ntiles; t++) {
+        if (state->pending[t] == 0) ready.push_back(t);
+    }
+    HASSERT(!ready.empty());
+    for (size_t r = 0; r < ready.size(); r++) {
+        const int tile = ready[r];
+        hclib::async([=]() {
+            forasync2D_wavefront_tile<T>(state, tile);
+        });
+    }
+}
+
 template <typename T>
 inline hclib::future_t<void> *forasync1D_future(loop_domain_1d* loop, T lambda,
         bool force_seq = false, int mode = FORASYNC_MODE_RECURSIVE,
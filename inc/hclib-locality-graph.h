@@ -63,13 +63,39 @@ typedef struct _hclib_locale_t {
     unsigned n_idle_funcs;
     int reachable;
 
-    struct _hclib_deque_t *deques;
+    /*
+     * One deque per worker, allocated by that worker the first time it pushes
+     * a task here, and a bitmap of the workers whose deques may hold tasks.
+     * Each worker sets its own bit after a push and only clears it once it has
+     * found its deque empty, so thieves can skip every victim whose bit is
+     * clear.
+     */
+    struct _hclib_deque_t * volatile *deques;
+    volatile unsigned long *nonempty;
 } hclib_locale_t;
 
+// Distance between locales that are not connected by any path of edges
+#define HCLIB_UNREACHABLE_DISTANCE 0xffff
+
 typedef struct _hclib_locality_graph {
     hclib_locale_t *locales;
     unsigned n_locales;
-    unsigned *edges;
+    /*
+     * Reachability edges as adjacency lists: locale i is connected to the
+     * n_neighbors[i] locales whose ids are in neighbors[i], sorted by id.
+     */
+    unsigned **neighbors;
+    unsigned *n_neighbors;
+    /*
+     * Filled in by check_locality_graph. distances holds the number of edges on
+     * the shortest path between every pair of locales, indexed by
+     * [from * n_locales + to]. nearest_of_type holds the id of the closest
+     * locale of each of the n_types known types, or -1 if none is reachable,
+     * indexed by [from * n_types + type].
+     */
+    unsigned short *distances;
+    int *nearest_of_type;
+    unsigned n_types;
 } hclib_locality_graph;
 
 typedef struct _hclib_locality_path {
@@ -77,10 +103,48 @@ typedef struct _hclib_locality_path {
     unsigned path_length;
 } hclib_locality_path;
 
+// How one worker has fared stealing from one locale on its steal path
+typedef struct _hclib_steal_locale_stats {
+    // Totals since launch
+    unsigned long long attempts;
+    unsigned long long successes;
+    // Time spent on the sampled attempts, and how many were sampled
+    unsigned long long cost_ns;
+    unsigned long long cost_samples;
+    // Counts for the current phase, halved every time the path is reordered
+    unsigned recent_attempts;
+    unsigned recent_successes;
+    unsigned long long recent_cost_ns;
+    unsigned recent_cost_samples;
+    // Set while the locale is chronically empty, so it is only rarely probed
+    int skipped;
+} hclib_steal_locale_stats;
+
+/*
+ * Steal statistics of one worker, used to reorder its steal path online. Both
+ * arrays are indexed by position in the static steal path, and order holds
+ * those positions in the order they are currently probed. Allocated by the
+ * worker itself on its first steal attempt.
+ *
+ * Only the worker writes order: it sorts into next_order and then copies that
+ * into order while order_seq is odd, so that other threads can take a
+ * consistent copy by retrying until they see the same even order_seq before
+ * and after.
+ */
+typedef struct _hclib_steal_stats {
+    unsigned long long ncalls;
+    unsigned long long nreorders;
+    volatile unsigned order_seq;
+    unsigned *order;
+    unsigned *next_order;
+    hclib_steal_locale_stats *locales;
+} hclib_steal_stats;
+
 typedef struct _hclib_worker_paths {
     hclib_locality_path *pop_path;
     hclib_locality_path *steal_path;
     int last_successful_steal_locale;
+    hclib_steal_stats *steal_stats;
 } hclib_worker_paths;
 
 extern void load_locality_info(const char *filename, int *nworkers_out,
@@ -93,6 +157,9 @@ extern void check_locality_graph(hclib_locality_graph *graph,
         hclib_worker_paths *worker_paths, int nworkers);
 extern void print_locality_graph(hclib_locality_graph *graph);
 extern void print_worker_paths(hclib_worker_paths *worker_paths, int nworkers);
+extern void dump_locality_info(const char *filename,
+        hclib_locality_graph *graph, hclib_worker_paths *worker_paths,
+        int nworkers);
 extern int deque_push_locale(hclib_worker_state *ws, hclib_locale_t *locale,
         void *ele);
 extern size_t workers_backlog(hclib_worker_state *ws);
@@ -118,7 +185,13 @@ extern hclib_locale_t *hclib_get_closest_locale_of_types(hclib_locale_t *locale,
 extern hclib_locale_t *hclib_get_closest_locale_of_type(hclib_locale_t *locale,
         int locale_type);
 extern hclib_locale_t **hclib_get_all_locales_of_type(int type, int *out_count);
+extern unsigned hclib_get_locale_distance(hclib_locale_t *from,
+        hclib_locale_t *to);
 extern int hclib_get_num_locales_of_type(int locale_type);
+extern unsigned hclib_get_steal_path(int wid, hclib_locale_t **locales,
+        unsigned max_locales);
+extern void hclib_print_steal_stats(FILE *fp);
+extern void hclib_free_steal_stats();
 
 extern unsigned hclib_add_known_locale_type(const char *lbl);
 
@@ -68,8 +68,26 @@ typedef struct {
 typedef hclib_locale_t *(*loop_dist_func)(const int,
         const hclib_loop_domain_t *, const hclib_loop_domain_t *, const int);
 
+/*
+ * An optional companion to a loop_dist_func, called with the same arguments
+ * plus the ID of the worker that executed that subset of the loop. Distribution
+ * functions can use this to adapt future placement to where work actually ran.
+ */
+typedef void (*loop_dist_record_func)(const int, const hclib_loop_domain_t *,
+        const hclib_loop_domain_t *, const int, const int);
+
+/*
+ * Shared state for all tasks created by a single forasync. If range_body is
+ * non-zero, user->_fp is invoked once per tile with the bounds of that tile
+ * rather than once per iteration index. loops is only filled in when a
+ * non-default distribution function is used, and holds the domain of the whole
+ * loop. It is copied into every chunk so that it needs no separate lifetime.
+ */
 typedef struct {
     hclib_task_t *user;
+    int range_body;
+    unsigned dist_func_id;
+    hclib_loop_domain_t loops[3];
 } forasync_t;
 
 typedef struct {
@@ -79,12 +79,42 @@ void hclib_set_idle_callback(void (*set_idle_callback)(unsigned, unsigned));
 
 void hclib_run_on_main_ctx(void (*fp)(void *), void *data);
 
+/*
+ * Built-in loop distribution functions, registered at launch.
+ *
+ *   HCLIB_DEFAULT_LOOP_DIST places every chunk at the central place.
+ *   HCLIB_BLOCK_LOOP_DIST assigns contiguous blocks of chunks to each worker's
+ *       thread-private locale.
+ *   HCLIB_CYCLIC_LOOP_DIST assigns chunks round-robin to each worker's
+ *       thread-private locale.
+ *   HCLIB_REPLAY_LOOP_DIST places each chunk at the thread-private locale of
+ *       the worker that last executed it in a loop with an identical domain,
+ *       falling back to a block distribution for chunks that have not run yet.
+ *       This keeps iterative codes (e.g. stencils) on the same worker from one
+ *       timestep to the next.
+ *
+ * Non-default distributions are only supported in FORASYNC_MODE_FLAT.
+ */
 #define HCLIB_DEFAULT_LOOP_DIST 0
+#define HCLIB_BLOCK_LOOP_DIST 1
+#define HCLIB_CYCLIC_LOOP_DIST 2
+#define HCLIB_REPLAY_LOOP_DIST 3
 
 unsigned hclib_register_dist_func(loop_dist_func func);
+unsigned hclib_register_dist_func_with_record(loop_dist_func func,
+        loop_dist_record_func record);
 
 loop_dist_func hclib_lookup_dist_func(unsigned id);
 
+/*
+ * Notify the distribution function registered under id that the calling worker
+ * has executed the provided subset of a loop. No-op if that distribution
+ * function did not register a record callback.
+ */
+void hclib_record_dist(unsigned id, const int dim,
+        const hclib_loop_domain_t *subloops, const hclib_loop_domain_t *loops,
+        const int mode);
+
 /*
  * Async definition and API
  */
@@ -139,6 +169,36 @@ typedef int forasync_mode_t;
 #define FORASYNC_MODE_RECURSIVE 1
 /** @brief Forasync mode to perform static chunking of the iteration space. */
 #define FORASYNC_MODE_FLAT 0
+/**
+ * @brief Forasync mode to lazily split the iteration space only when the
+ * executing worker runs out of local work. The tile of the loop domain is
+ * ignored.
+ */
+#define FORASYNC_MODE_ADAPTIVE 2
+/**
+ * @brief Target number of chunks per worker used by FORASYNC_MODE_ADAPTIVE,
+ * i.e. how often a worker checks whether it should split its remaining range.
+ */
+#ifndef FORASYNC_ADAPTIVE_CHUNKS_PER_WORKER
+#define FORASYNC_ADAPTIVE_CHUNKS_PER_WORKER 64
+#endif
+/**
+ * @brief Forasync mode to perform static chunking of the iteration space, but
+ * spawn tiles of 2D/3D loops in Morton (Z) order rather than row-major order.
+ */
+#define FORASYNC_MODE_MORTON 3
+/**
+ * @brief Like FORASYNC_MODE_MORTON, but using a generalized Hilbert curve for
+ * 2D loops. 3D loops use Morton order.
+ */
+#define FORASYNC_MODE_HILBERT 4
+/**
+ * @brief Forasync mode to recursively chunk the iteration space by always
+ * halving the longest remaining dimension (cache-oblivious splitting). As with
+ * FORASYNC_MODE_RECURSIVE, the non-blocking (_nb) forasync variants are not
+ * supported in this mode.
+ */
+#define FORASYNC_MODE_OBLIVIOUS 5
 /** @brief To indicate an async need not register with any finish scopes. */
 #define ESCAPING_ASYNC ((int) 0x2)
 #define COMM_ASYNC     ((int) 0x4)
@@ -168,6 +228,32 @@ typedef void (*forasync2D_Fct_t)(void *arg, int index_outer, int index_inner);
 typedef void (*forasync3D_Fct_t)(void *arg, int index_outer, int index_mid,
         int index_inner);
 
+/**
+ * @brief Function prototype for a 1-dimension range forasync, invoked once per
+ * tile rather than once per iteration. The body is responsible for iterating
+ * over [low, high) using the stride of the loop domain.
+ * @param[in] arg               Argument to the loop tile
+ * @param[in] low               First iteration index of this tile
+ * @param[in] high              Exclusive upper bound of this tile
+ */
+typedef void (*forasync1D_range_Fct_t)(void *arg, int low, int high);
+
+/**
+ * @brief Function prototype for a 2-dimensions range forasync, invoked once
+ * per tile with the bounds of the [low_outer, high_outer) x
+ * [low_inner, high_inner) box.
+ */
+typedef void (*forasync2D_range_Fct_t)(void *arg, int low_outer,
+        int high_outer, int low_inner, int high_inner);
+
+/**
+ * @brief Function prototype for a 3-dimensions range forasync, invoked once
+ * per tile with the bounds of the tile box.
+ */
+typedef void (*forasync3D_range_Fct_t)(void *arg, int low_outer,
+        int high_outer, int low_mid, int high_mid, int low_inner,
+        int high_inner);
+
 /**
  * @brief Parallel for loop 'forasync' (up to 3 dimensions).
  *
@@ -193,6 +279,49 @@ hclib_future_t *hclib_forasync_future(void *forasync_fct, void *argv,
                                       int dim, hclib_loop_domain_t *domain,
                                       forasync_mode_t mode);
 
+/*
+ * Variants of hclib_forasync and hclib_forasync_future that place each chunk of
+ * the loop using the distribution function registered under dist_func_id.
+ */
+void hclib_forasync_dist(void *forasync_fct, void *argv, int dim,
+                         hclib_loop_domain_t *domain, forasync_mode_t mode,
+                         unsigned dist_func_id);
+hclib_future_t *hclib_forasync_future_dist(void *forasync_fct, void *argv,
+                                           int dim,
+                                           hclib_loop_domain_t *domain,
+                                           forasync_mode_t mode,
+                                           unsigned dist_func_id);
+
+/**
+ * @brief Parallel for loop whose body is called once per tile.
+ *
+ * Chunks the iteration space exactly like hclib_forasync, but passes each
+ * tile's bounds to forasync_fct (a forasync1D_range_Fct_t,
+ * forasync2D_range_Fct_t, or forasync3D_range_Fct_t depending on dim). This
+ * removes the per-iteration indirect call and lets the compiler vectorize the
+ * inner loop of the body.
+ */
+void hclib_forasync_range(void *forasync_fct, void *argv, int dim,
+                          hclib_loop_domain_t *domain, forasync_mode_t mode);
+
+/*
+ * Semantically equivalent to hclib_forasync_range, but returns a promise that
+ * is triggered when all tasks belonging to this forasync have finished.
+ */
+hclib_future_t *hclib_forasync_range_future(void *forasync_fct, void *argv,
+                                            int dim,
+                                            hclib_loop_domain_t *domain,
+                                            forasync_mode_t mode);
+
+/*
+ * Fill order_out with the row-major linear indices of every tile in a grid of
+ * ntiles[0] x ... x ntiles[dim - 1] tiles, in the order the provided forasync
+ * mode visits them. Modes without a special traversal order produce row-major
+ * order.
+ */
+void hclib_forasync_tile_order(int dim, const int *ntiles,
+        forasync_mode_t mode, int *order_out);
+
 /**
  * @brief starts a new finish scope
  */
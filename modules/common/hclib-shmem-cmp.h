@@ -0,0 +1,63 @@
+#ifndef HCLIB_SHMEM_CMP_H
+#define HCLIB_SHMEM_CMP_H
+
+#include <shmem.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+namespace hclib {
+
+/*
+ * Comparison functors for the SHMEM_CMP_* operators. Each provides a scalar
+ * test and a test on GCC vector types, for which the comparison yields a mask
+ * with all bits set in every lane where it holds.
+ */
+struct shmem_cmp_eq {
+    template <typename T> static bool test(T a, T b) { return a == b; }
+    template <typename V> static V vtest(V a, V b) { return (V)(a == b); }
+};
+
+struct shmem_cmp_ne {
+    template <typename T> static bool test(T a, T b) { return a != b; }
+    template <typename V> static V vtest(V a, V b) { return (V)(a != b); }
+};
+
+struct shmem_cmp_gt {
+    template <typename T> static bool test(T a, T b) { return a > b; }
+    template <typename V> static V vtest(V a, V b) { return (V)(a > b); }
+};
+
+struct shmem_cmp_le {
+    template <typename T> static bool test(T a, T b) { return a <= b; }
+    template <typename V> static V vtest(V a, V b) { return (V)(a <= b); }
+};
+
+struct shmem_cmp_lt {
+    template <typename T> static bool test(T a, T b) { return a < b; }
+    template <typename V> static V vtest(V a, V b) { return (V)(a < b); }
+};
+
+struct shmem_cmp_ge {
+    template <typename T> static bool test(T a, T b) { return a >= b; }
+    template <typename V> static V vtest(V a, V b) { return (V)(a >= b); }
+};
+
+template <typename T>
+bool shmem_cmp_test(T value, int cmp, T cmp_value) {
+    switch (cmp) {
+        case SHMEM_CMP_EQ: return shmem_cmp_eq::test(value, cmp_value);
+        case SHMEM_CMP_NE: return shmem_cmp_ne::test(value, cmp_value);
+        case SHMEM_CMP_GT: return shmem_cmp_gt::test(value, cmp_value);
+        case SHMEM_CMP_LE: return shmem_cmp_le::test(value, cmp_value);
+        case SHMEM_CMP_LT: return shmem_cmp_lt::test(value, cmp_value);
+        case SHMEM_CMP_GE: return shmem_cmp_ge::test(value, cmp_value);
+        default:
+            fprintf(stderr, "Unsupported cmp type %d\n", cmp);
+            exit(1);
+    }
+}
+
+}
+
+#endif
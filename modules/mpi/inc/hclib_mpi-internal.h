@@ -24,6 +24,18 @@ HCLIB_MODULE_INITIALIZATION_FUNC(mpi_pre_initialize);
 HCLIB_MODULE_INITIALIZATION_FUNC(mpi_post_initialize);
 HCLIB_MODULE_INITIALIZATION_FUNC(mpi_finalize);
 
+/*
+ * By default MPI is initialized with MPI_THREAD_FUNNELED and every MPI call is
+ * made from tasks at the single Interconnect locale. Setting
+ * HCLIB_MPI_THREAD_MULTIPLE=1 initializes MPI_THREAD_MULTIPLE instead and
+ * allows several Interconnect locales in the locality graph (e.g.
+ * Interconnect_0, Interconnect_1, ...), each serviced by its own worker.
+ * Point-to-point operations on MPI_COMM_WORLD or on communicators created with
+ * hclib::MPI_Comm_dup/MPI_Comm_split are then routed to locale (tag % N) on a
+ * per-locale duplicate of the communicator, so receives in this mode may not
+ * use MPI_ANY_TAG. The duplicates are released when the communicator is freed,
+ * with either MPI_Comm_free or hclib::MPI_Comm_free.
+ */
 void MPI_Comm_rank(MPI_Comm comm, int *rank);
 void MPI_Comm_size(MPI_Comm comm, int *size);
 
@@ -49,6 +61,7 @@ inline double MPI_Wtime(void) {
 
 void MPI_Comm_dup(MPI_Comm comm, MPI_Comm *newcomm);
 void MPI_Comm_split(MPI_Comm comm, int color, int key, MPI_Comm *newcomm);
+void MPI_Comm_free(MPI_Comm *comm);
 
 void MPI_Allreduce(const void *sendbuf, void *recvbuf, int count,
         MPI_Datatype datatype, MPI_Op op, MPI_Comm comm);
@@ -62,5 +75,131 @@ void MPI_Barrier(MPI_Comm comm);
 
 void MPI_Reduce(const void *sendbuf, void *recvbuf, int count,
         MPI_Datatype datatype, MPI_Op op, int root, MPI_Comm comm);
+
+/*
+ * Non-blocking collectives. The returned future is satisfied once the
+ * collective completes, without tying up the Interconnect locale while it is
+ * in flight. Collectives (blocking or not) on a communicator are started in
+ * the order in which they are called on each rank.
+ */
+hclib::future_t<void> *MPI_Iallreduce(const void *sendbuf, void *recvbuf,
+        int count, MPI_Datatype datatype, MPI_Op op, MPI_Comm comm);
+hclib::future_t<void> *MPI_Iallgather(const void *sendbuf, int sendcount,
+        MPI_Datatype sendtype, void *recvbuf, int recvcount,
+        MPI_Datatype recvtype, MPI_Comm comm);
+hclib::future_t<void> *MPI_Ibcast(void *buffer, int count,
+        MPI_Datatype datatype, int root, MPI_Comm comm);
+hclib::future_t<void> *MPI_Ibarrier(MPI_Comm comm);
+hclib::future_t<void> *MPI_Ireduce(const void *sendbuf, void *recvbuf,
+        int count, MPI_Datatype datatype, MPI_Op op, int root, MPI_Comm comm);
+
+/*
+ * Small-message aggregation. Messages passed to MPI_Aggregate_send are
+ * coalesced into a per-destination buffer and shipped as a single MPI message
+ * from the Interconnect locale when the buffer fills, when it has been
+ * partially filled for longer than a timeout, or on an explicit flush. On the
+ * receiving rank each message is handed to the handler it was sent to, running
+ * on the Interconnect locale. The msg pointer passed to a handler is only valid
+ * for the duration of the call, and handlers must not block. Handlers may send
+ * further aggregated messages. Handlers run from the background poller belong
+ * to no finish, so tasks they spawn are not waited for by any finish.
+ *
+ * Handlers must be registered in the same order on every rank before any
+ * message targets them. Delivery is opportunistic while there is local
+ * aggregation traffic; MPI_Aggregate_quiesce is the collective that guarantees
+ * every message sent so far (including those sent from handlers) has been
+ * delivered. No ordering is guaranteed between messages.
+ *
+ * The buffer size and flush timeout are read from HCLIB_MPI_AGG_BUFFER_SIZE
+ * (bytes) and HCLIB_MPI_AGG_TIMEOUT_US, and must match across ranks.
+ */
+typedef void (*MPI_Aggregate_handler)(int source, void *msg, size_t nbytes);
+
+int MPI_Aggregate_register(MPI_Aggregate_handler handler);
+void MPI_Aggregate_send(int handler_id, const void *msg, size_t nbytes,
+        int dest);
+void MPI_Aggregate_flush();
+void MPI_Aggregate_quiesce();
+
+/*
+ * Distributed work stealing. A stealable task is a registered function plus a
+ * plain-old-data payload, which is copied when the task is spawned and may be
+ * shipped to and run on another rank. When a rank runs out of stealable work
+ * its Interconnect locale requests more from randomly chosen remote ranks.
+ *
+ * MPI_Distributed_finish is collective: every rank calls it, any of them may
+ * spawn stealable tasks from the lambda, and it returns on all ranks once every
+ * stealable task spawned on any rank (including those spawned by other
+ * stealable tasks) has completed. Stealable tasks may only be spawned from the
+ * lambda itself or directly from a running stealable task, not from other
+ * tasks they create, and distributed finishes may not be nested. Functions must
+ * be registered in the same order on every rank.
+ */
+typedef void (*MPI_Stealable_fn)(void *payload, size_t nbytes);
+
+int MPI_Stealable_register(MPI_Stealable_fn fn);
+void MPI_Stealable_spawn(int fn_id, const void *payload, size_t nbytes);
+void MPI_Distributed_finish(std::function<void()> lambda);
+
+/*
+ * Remote asyncs. MPI_Async_remote runs the handler registered under the given
+ * id as a task on the target rank, passing it a copy of the payload that the
+ * handler does not own. Payloads of up to HCLIB_MPI_REMOTE_EAGER_LIMIT bytes
+ * (512 by default) are copied and aggregated with other small messages, and
+ * NULL is returned. Larger payloads are sent directly from the caller's
+ * buffer, which must not be modified until the returned future is satisfied.
+ * MPI_Async_remote_copy always copies the payload, so the caller's buffer may
+ * be reused as soon as it returns. Handlers may issue further remote asyncs.
+ *
+ * MPI_Remote_finish is collective and returns on every rank once all remote
+ * asyncs issued so far on any rank, including those issued from handlers,
+ * have completed. Remote asyncs are only guaranteed to make progress inside a
+ * remote finish. Handlers must be registered in the same order on every rank.
+ */
+typedef void (*MPI_Remote_handler)(int source, void *payload, size_t nbytes);
+
+int MPI_Remote_register(MPI_Remote_handler handler);
+hclib::future_t<void> *MPI_Async_remote(int rank, int handler,
+        const void *payload, size_t nbytes);
+void MPI_Async_remote_copy(int rank, int handler, const void *payload,
+        size_t nbytes);
+void MPI_Remote_finish(std::function<void()> lambda);
+
+/*
+ * Global promises. A global promise is a promise owned by one rank and named
+ * by a (rank, id, generation) handle that can be shipped to other ranks by
+ * value and put from any of them. A put on another rank is aggregated with
+ * other small messages (see MPI_Aggregate_send) and then satisfies the owner's
+ * promise with hclib_promise_put on its Interconnect locale, releasing tasks
+ * waiting on its future as usual. The datum is carried by value, so it must
+ * not point into the putting rank's memory. Each global promise may be put
+ * once.
+ *
+ * MPI_Global_promise_create_n creates n promises with the consecutive ids
+ * first.id ... first.id + n - 1, all of first's generation, in one step, so
+ * that the ids of large batches can be exchanged as a single base. Futures may
+ * only be taken, and promises freed, on the owning rank. Freeing a promise
+ * bumps the generation of its id before the id is recycled, and a put is
+ * dropped unless its handle's generation is still current, so a put still in
+ * flight to a freed promise never satisfies a later one that reuses its id.
+ * Remote puts are delivered as long as any local global promise is
+ * unsatisfied, by keeping the aggregation poller running. The poller belongs
+ * to no finish, so creating global promises does not hold up the enclosing
+ * finish, but every one must be satisfied or freed before the program leaves
+ * hclib::launch, which otherwise waits for the poller. As with any aggregated
+ * message, a rank should flush or quiesce before blocking its Interconnect
+ * locale in a collective while puts it issued may still be buffered.
+ */
+typedef struct _MPI_Global_promise {
+    int rank;
+    unsigned id;
+    unsigned generation;
+} MPI_Global_promise;
+
+MPI_Global_promise MPI_Global_promise_create();
+MPI_Global_promise MPI_Global_promise_create_n(unsigned n);
+hclib::future_t<void *> *MPI_Global_promise_future(MPI_Global_promise promise);
+void MPI_Global_promise_put(MPI_Global_promise promise, void *datum);
+void MPI_Global_promise_free(MPI_Global_promise promise);
 }
 #endif
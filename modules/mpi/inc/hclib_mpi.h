@@ -3,8 +3,59 @@
 
 #include "hclib_mpi-internal.h"
 
+#include <string.h>
+#include <type_traits>
+
 namespace hclib {
 
+namespace mpi {
+
+/*
+ * Run a registered handler on the given rank with a copy of payload. The value
+ * is copied before this returns, while the (pointer, size) overload sends
+ * large payloads straight from the caller's buffer (see MPI_Async_remote).
+ */
+template <class T>
+void async_remote(int rank, int handler, const T &payload) {
+    static_assert(std::is_trivially_copyable<T>::value,
+            "remote async payloads must be trivially copyable");
+    hclib::MPI_Async_remote_copy(rank, handler, &payload, sizeof(T));
+}
+
+inline hclib::future_t<void> *async_remote(int rank, int handler,
+        const void *payload, size_t nbytes) {
+    return hclib::MPI_Async_remote(rank, handler, payload, nbytes);
+}
+
+template <class T>
+void remote_finish(T lambda) {
+    hclib::MPI_Remote_finish(lambda);
+}
+
+/*
+ * Typed views of a global promise, for pointer-sized values that are copied
+ * into the promise's datum.
+ */
+template <class T>
+void global_promise_put(MPI_Global_promise promise, T value) {
+    static_assert(sizeof(T) <= sizeof(void *) &&
+            std::is_trivially_copyable<T>::value,
+            "global promise values must be pointer-sized and trivially "
+            "copyable");
+    void *datum = NULL;
+    memcpy(&datum, &value, sizeof(T));
+    hclib::MPI_Global_promise_put(promise, datum);
+}
+
+template <class T>
+hclib::future_t<T> *global_promise_future(MPI_Global_promise promise) {
+    static_assert(sizeof(T) <= sizeof(void *),
+            "global promise values must be pointer-sized");
+    return (hclib::future_t<T> *)hclib::MPI_Global_promise_future(promise);
+}
+
+}
+
 }
 
 #endif
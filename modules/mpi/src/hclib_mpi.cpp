@@ -1,8 +1,10 @@
 #include "hclib_mpi-internal.h"
 #include "hclib-locality-graph.h"
-#include "hclib-module-common.h"
 
+#include <algorithm>
+#include <functional>
 #include <iostream>
+#include <string.h>
 
 #ifdef HCLIB_INSTRUMENT
 #include "hclib-instrument.h"
@@ -19,6 +21,12 @@ enum MPI_FUNC_LABELS {
     MPI_Allgather_lbl,
     MPI_Reduce_lbl,
     MPI_Waitall_lbl,
+    MPI_Aggregate_quiesce_lbl,
+    MPI_Iallreduce_lbl,
+    MPI_Ibcast_lbl,
+    MPI_Ibarrier_lbl,
+    MPI_Iallgather_lbl,
+    MPI_Ireduce_lbl,
     N_MPI_FUNCS
 };
 
@@ -33,7 +41,13 @@ const char *MPI_FUNC_NAMES[N_MPI_FUNCS] = {
     "MPI_Barrier",
     "MPI_Allgather",
     "MPI_Reduce",
-    "MPI_Waitall"
+    "MPI_Waitall",
+    "MPI_Aggregate_quiesce",
+    "MPI_Iallreduce",
+    "MPI_Ibcast",
+    "MPI_Ibarrier",
+    "MPI_Iallgather",
+    "MPI_Ireduce"
 };
 
 static int event_ids[N_MPI_FUNCS];
@@ -63,36 +77,524 @@ HCLIB_MODULE_INITIALIZATION_FUNC(mpi_pre_initialize) {
 #endif
 }
 
-typedef struct _pending_mpi_op {
-    MPI_Request req;
-    hclib::promise_t<void> *prom;
-    hclib_task_t *task;
-    struct _pending_mpi_op *next;
+/*
+ * Outstanding non-blocking requests, kept as parallel arrays so they can be
+ * handed to MPI_Testsome as contiguous batches and completed in bulk. Only
+ * accessed from the Interconnect locale, so no synchronization is needed.
+ */
+typedef struct _pending_mpi_table {
+    hclib::locale_t *locale;
+    MPI_Request *reqs;
+    hclib::promise_t<void> **proms;
 #ifdef HCLIB_INSTRUMENT
-    int event_type;
-    int event_id;
+    int *event_types;
+    int *event_ids;
+#endif
+    int *completed;
+    int count;
+    int capacity;
+    int poller_active;
+
+#ifdef HCLIB_STATS
+    unsigned long long n_polls;
+    unsigned long long n_completed;
+    int max_completed_per_poll;
+#endif
+} pending_mpi_table;
+
+/*
+ * A communication channel is an Interconnect locale plus the pending request
+ * table serviced from it. In the default MPI_THREAD_FUNNELED mode there is a
+ * single channel. When HCLIB_MPI_THREAD_MULTIPLE is set in the environment
+ * there is one channel per Interconnect locale in the locality graph, and
+ * point-to-point operations are spread across them by tag. Collectives and
+ * aggregation always use the first channel.
+ */
+typedef struct _mpi_channel {
+    pending_mpi_table pending;
+} mpi_channel;
+
+static mpi_channel *channels = NULL;
+static int n_channels = 0;
+
+/*
+ * Per-communicator state, kept for MPI_COMM_WORLD and for communicators
+ * created through hclib::MPI_Comm_dup/MPI_Comm_split. Each entry is attached to
+ * its communicator as an attribute, so that it is removed when the
+ * communicator is freed and MPI may hand out the same handle again.
+ *
+ * With several channels, each channel sends and receives on its own duplicate
+ * of the communicator, so that the MPI library can keep the channels' matching
+ * and progress independent. Traffic on any other communicator stays on the
+ * first channel.
+ */
+typedef struct _comm_state {
+    MPI_Comm comm;
+    // One duplicate of comm per channel, or NULL with a single channel
+    MPI_Comm *dups;
+    // Put by the most recently requested collective on comm once it started
+    hclib::promise_t<void> *last_collective_started;
+    struct _comm_state *next;
+} comm_state;
+
+static comm_state *comm_states = NULL;
+static volatile int comm_states_lock = 0;
+static int comm_state_keyval = MPI_KEYVAL_INVALID;
+// Ordering chain for collectives on communicators without a comm_state
+static hclib::promise_t<void> *other_last_collective_started = NULL;
+
+#ifndef MPI_PENDING_WINDOW
+#define MPI_PENDING_WINDOW 64
+#endif
+
+/*
+ * State for the small-message aggregation layer. Per-destination buffers are
+ * filled by any worker under a per-destination spinlock. Full or timed-out
+ * buffers are pushed onto agg_ready, from which the Interconnect locale issues
+ * them. Everything else (in-flight sends, posted receives, counters) is only
+ * touched from the Interconnect locale.
+ */
+#define MPI_AGG_MAX_HANDLERS 64
+#define MPI_AGG_N_RECVS 8
+#define MPI_AGG_DEFAULT_BUFFER_SIZE 8192
+#define MPI_AGG_DEFAULT_TIMEOUT_US 100
+#define MPI_AGG_TAG 0
+
+typedef struct _agg_header {
+    int handler;
+    int nbytes;
+} agg_header;
+
+typedef struct _agg_buffer {
+    char *data;
+    int nbytes;
+    int dest;
+    MPI_Request req;
+    struct _agg_buffer *next;
+} agg_buffer;
+
+typedef struct _agg_dest {
+    volatile int lock;
+    int nbytes;
+    char *data;
+    unsigned long long first_append_ns;
+} __attribute__((aligned(64))) agg_dest;
+
+static MPI_Comm agg_comm = MPI_COMM_NULL;
+static int agg_nranks = 0;
+static size_t agg_buffer_size = MPI_AGG_DEFAULT_BUFFER_SIZE;
+static unsigned long long agg_timeout_ns = MPI_AGG_DEFAULT_TIMEOUT_US * 1000ULL;
+
+static hclib::MPI_Aggregate_handler agg_handlers[MPI_AGG_MAX_HANDLERS];
+static volatile int agg_n_handlers = 0;
+
+static agg_dest *agg_dests = NULL;
+static agg_buffer *volatile agg_ready = NULL;
+static volatile int agg_n_buffered = 0;
+static volatile int agg_poller_active = 0;
+
+static agg_buffer *agg_inflight = NULL;
+static long long *agg_sent_to = NULL;
+static long long agg_n_sent = 0;
+static long long agg_n_received = 0;
+static MPI_Request agg_recv_reqs[MPI_AGG_N_RECVS];
+static char *agg_recv_bufs[MPI_AGG_N_RECVS];
+
+static void agg_initialize() {
+    const char *buffer_size_str = getenv("HCLIB_MPI_AGG_BUFFER_SIZE");
+    if (buffer_size_str) {
+        agg_buffer_size = atol(buffer_size_str);
+    }
+    const char *timeout_str = getenv("HCLIB_MPI_AGG_TIMEOUT_US");
+    if (timeout_str) {
+        agg_timeout_ns = atol(timeout_str) * 1000ULL;
+    }
+    HASSERT(agg_buffer_size >= 2 * sizeof(agg_header));
+
+    CHECK_MPI(::MPI_Comm_dup(MPI_COMM_WORLD, &agg_comm));
+    CHECK_MPI(::MPI_Comm_size(agg_comm, &agg_nranks));
+
+    agg_dests = (agg_dest *)calloc(agg_nranks, sizeof(agg_dest));
+    HASSERT(agg_dests);
+    agg_sent_to = (long long *)calloc(agg_nranks, sizeof(long long));
+    HASSERT(agg_sent_to);
+
+    for (int i = 0; i < MPI_AGG_N_RECVS; i++) {
+        agg_recv_bufs[i] = (char *)malloc(agg_buffer_size);
+        HASSERT(agg_recv_bufs[i]);
+        CHECK_MPI(::MPI_Irecv(agg_recv_bufs[i], agg_buffer_size, MPI_BYTE,
+                    MPI_ANY_SOURCE, MPI_AGG_TAG, agg_comm, &agg_recv_reqs[i]));
+    }
+}
+
+static void agg_finalize() {
+    for (int i = 0; i < MPI_AGG_N_RECVS; i++) {
+        CHECK_MPI(::MPI_Cancel(&agg_recv_reqs[i]));
+        CHECK_MPI(::MPI_Wait(&agg_recv_reqs[i], MPI_STATUS_IGNORE));
+        free(agg_recv_bufs[i]);
+    }
+    for (int i = 0; i < agg_nranks; i++) {
+        free(agg_dests[i].data);
+    }
+    free(agg_dests);
+    free(agg_sent_to);
+    CHECK_MPI(::MPI_Comm_free(&agg_comm));
+}
+
+/*
+ * State for distributed work stealing. Stealable tasks are kept as serialized
+ * descriptors in a per-rank pool, and for every descriptor added to the pool a
+ * plain task is spawned that pops and runs the newest descriptor left, if any.
+ * Local workers therefore pick up stealable work through the usual deques,
+ * while the Interconnect locale is free to hand the oldest descriptors to
+ * other ranks. A rank whose pool has run dry asks a random remote rank for
+ * work, and global termination is detected with Mattern's four-counter method
+ * over the number of stealable tasks spawned and completed on every rank.
+ */
+#define MPI_STEAL_MAX_FUNCS 64
+#define MPI_STEAL_REQUEST_TAG 0
+#define MPI_STEAL_RESPONSE_TAG 1
+
+#ifndef MPI_STEAL_MAX_TASKS
+#define MPI_STEAL_MAX_TASKS 32
 #endif
-} pending_mpi_op;
 
-pending_mpi_op *pending = NULL;
+typedef struct _stealable_task {
+    int fn_id;
+    int nbytes;
+} stealable_task;
+
+typedef struct _steal_send {
+    char *data;
+    MPI_Request req;
+    struct _steal_send *next;
+} steal_send;
+
+static MPI_Comm steal_comm = MPI_COMM_NULL;
+static int steal_rank = 0;
+static int steal_nranks = 0;
+
+static hclib::MPI_Stealable_fn steal_funcs[MPI_STEAL_MAX_FUNCS];
+static volatile int steal_n_funcs = 0;
+
+/*
+ * The pool is a ring buffer of descriptors protected by steal_pool_lock. The
+ * running count is incremented under the same lock as a descriptor is popped,
+ * so that a rank never looks idle between popping a task and running it.
+ */
+static volatile int steal_pool_lock = 0;
+static stealable_task **steal_pool = NULL;
+static int steal_pool_head = 0;
+static int steal_pool_size = 0;
+static int steal_pool_capacity = 0;
+static volatile int steal_n_running = 0;
+
+static volatile long long steal_n_spawned = 0;
+static volatile long long steal_n_completed = 0;
+static volatile int steal_finish_active = 0;
+
+/*
+ * The worker that runs tasks at the Interconnect locale. steal_inflight and the
+ * MPI calls serving steal requests are protected by steal_service_lock.
+ */
+static int steal_mpi_worker = -1;
+static volatile int steal_service_lock = 0;
+static steal_send *steal_inflight = NULL;
+
+#ifdef HCLIB_STATS
+static unsigned long long steal_n_requests = 0;
+static unsigned long long steal_n_successful = 0;
+static unsigned long long steal_n_tasks_received = 0;
+static unsigned long long steal_n_tasks_sent = 0;
+#endif
+
+static void steal_initialize() {
+    CHECK_MPI(::MPI_Comm_dup(MPI_COMM_WORLD, &steal_comm));
+    CHECK_MPI(::MPI_Comm_rank(steal_comm, &steal_rank));
+    CHECK_MPI(::MPI_Comm_size(steal_comm, &steal_nranks));
+}
+
+static void steal_finalize() {
+#ifdef HCLIB_STATS
+    printf("MPI rank %d: %llu remote steal attempts, %llu successful, %llu "
+            "tasks received, %llu tasks sent\n", steal_rank, steal_n_requests,
+            steal_n_successful, steal_n_tasks_received, steal_n_tasks_sent);
+#endif
+    HASSERT(steal_pool_size == 0);
+    free(steal_pool);
+    CHECK_MPI(::MPI_Comm_free(&steal_comm));
+}
+
+/*
+ * State for remote asyncs. A payload of up to remote_eager_limit bytes is
+ * copied into the aggregation layer behind a small header naming its handler.
+ * Larger payloads are sent straight from the caller's buffer on remote_comm,
+ * with the tag naming the handler, and received straight into the buffer that
+ * is handed to the handler. A remote finish detects termination by counting
+ * remote asyncs sent and completed on every rank.
+ */
+#define MPI_REMOTE_MAX_HANDLERS 64
+#define MPI_REMOTE_DEFAULT_EAGER_LIMIT 512
+
+typedef struct _remote_header {
+    int handler;
+    int pad;
+} remote_header;
+
+static MPI_Comm remote_comm = MPI_COMM_NULL;
+static size_t remote_eager_limit = MPI_REMOTE_DEFAULT_EAGER_LIMIT;
+static int remote_agg_handler = -1;
+
+static hclib::MPI_Remote_handler remote_handlers[MPI_REMOTE_MAX_HANDLERS];
+static volatile int remote_n_handlers = 0;
+
+static volatile long long remote_n_sent = 0;
+static volatile long long remote_n_completed = 0;
+static volatile int remote_n_running = 0;
+static volatile int remote_finish_active = 0;
+
+static void remote_deliver_eager(int source, void *msg, size_t nbytes);
+
+static void remote_initialize() {
+    const char *eager_limit_str = getenv("HCLIB_MPI_REMOTE_EAGER_LIMIT");
+    if (eager_limit_str) {
+        remote_eager_limit = atol(eager_limit_str);
+    }
+    // Eager payloads must fit in a single aggregation record
+    const size_t max_eager = (agg_buffer_size - sizeof(agg_header) -
+            sizeof(remote_header)) & ~((size_t)7);
+    if (remote_eager_limit > max_eager) {
+        remote_eager_limit = max_eager;
+    }
+
+    CHECK_MPI(::MPI_Comm_dup(MPI_COMM_WORLD, &remote_comm));
+    remote_agg_handler = hclib::MPI_Aggregate_register(remote_deliver_eager);
+}
+
+static void remote_finalize() {
+    CHECK_MPI(::MPI_Comm_free(&remote_comm));
+}
+
+/*
+ * State for global promises. Each rank keeps its promises in a two-level
+ * table: a fixed directory of lazily allocated chunks, indexed by the high
+ * and low bits of a handle's id, so that lookups from the aggregation handler
+ * are two loads and entries never move. Freed ids are recycled through a free
+ * list threaded through the entries. Each entry's state word packs a
+ * generation, bumped whenever the entry is freed and carried in handles and
+ * put messages, above a pending bit, so that a put can tell a recycled entry
+ * from the promise it was addressed to. While any local global promise is
+ * unsatisfied the aggregation poller keeps running, so that remote puts are
+ * delivered without a remote finish or quiesce.
+ */
+#define MPI_GP_CHUNK_BITS 16
+#define MPI_GP_CHUNK_SIZE (1U << MPI_GP_CHUNK_BITS)
+#define MPI_GP_MAX_CHUNKS (1U << 14)
+#define MPI_GP_NO_ID 0xffffffffU
+#define MPI_GP_PENDING 1U
+#define MPI_GP_STATE(generation, pending) (((generation) << 1) | (pending))
+#define MPI_GP_GENERATION(state) ((state) >> 1)
+
+typedef struct _gp_entry {
+    hclib_promise_t promise;
+    volatile unsigned state;
+    unsigned next_free;
+} gp_entry;
+
+typedef struct _gp_put_msg {
+    unsigned id;
+    unsigned generation;
+    void *datum;
+} gp_put_msg;
+
+static int gp_rank = -1;
+static int gp_agg_handler = -1;
+static gp_entry *volatile gp_chunks[MPI_GP_MAX_CHUNKS];
+static volatile unsigned gp_next_id = 0;
+static volatile int gp_free_lock = 0;
+static volatile unsigned gp_free_head = MPI_GP_NO_ID;
+static volatile long long gp_n_pending = 0;
+
+static void gp_deliver(int source, void *msg, size_t nbytes);
+
+static void gp_initialize() {
+    CHECK_MPI(::MPI_Comm_rank(MPI_COMM_WORLD, &gp_rank));
+    gp_agg_handler = hclib::MPI_Aggregate_register(gp_deliver);
+}
+
+static void gp_finalize() {
+    for (unsigned i = 0; i < MPI_GP_MAX_CHUNKS && gp_chunks[i]; i++) {
+        free(gp_chunks[i]);
+        gp_chunks[i] = NULL;
+    }
+}
+
+static inline void lock_comm_states() {
+    while (__sync_lock_test_and_set(&comm_states_lock, 1)) ;
+}
+
+static inline void unlock_comm_states() {
+    __sync_lock_release(&comm_states_lock);
+}
+
+static void add_comm_state(MPI_Comm comm) {
+    comm_state *entry = (comm_state *)malloc(sizeof(comm_state));
+    HASSERT(entry);
+    entry->comm = comm;
+    entry->dups = NULL;
+    entry->last_collective_started = NULL;
+    if (n_channels > 1) {
+        entry->dups = (MPI_Comm *)malloc(n_channels * sizeof(MPI_Comm));
+        HASSERT(entry->dups);
+        for (int i = 0; i < n_channels; i++) {
+            CHECK_MPI(::MPI_Comm_dup(comm, &entry->dups[i]));
+        }
+    }
+    CHECK_MPI(::MPI_Comm_set_attr(comm, comm_state_keyval, entry));
+
+    lock_comm_states();
+    entry->next = comm_states;
+    comm_states = entry;
+    unlock_comm_states();
+}
+
+/*
+ * Attribute delete callback, called by MPI when a communicator with state is
+ * freed (and for the remaining ones at finalization).
+ */
+static int free_comm_state(MPI_Comm comm, int keyval, void *attr_val,
+        void *extra_state) {
+    comm_state *entry = (comm_state *)attr_val;
+
+    lock_comm_states();
+    comm_state **prev = &comm_states;
+    while (*prev != entry) prev = &(*prev)->next;
+    *prev = entry->next;
+    unlock_comm_states();
+
+    if (entry->dups) {
+        for (int i = 0; i < n_channels; i++) {
+            CHECK_MPI(::MPI_Comm_free(&entry->dups[i]));
+        }
+        free(entry->dups);
+    }
+    delete entry->last_collective_started;
+    free(entry);
+    return MPI_SUCCESS;
+}
+
+/*
+ * Pick the channel for a point-to-point operation, and the communicator to
+ * issue it on. The choice must be the same on the sending and receiving ranks,
+ * so it depends only on the communicator and tag. The communicator's state is
+ * found through its attribute rather than the list, so that operations on
+ * different workers do not serialize on comm_states_lock; multiple channels
+ * imply MPI_THREAD_MULTIPLE, so any worker may read the attribute.
+ */
+static mpi_channel *select_channel(MPI_Comm comm, int tag,
+        MPI_Comm *channel_comm) {
+    *channel_comm = comm;
+    if (n_channels == 1) return channels;
+
+    comm_state *entry;
+    int found;
+    CHECK_MPI(::MPI_Comm_get_attr(comm, comm_state_keyval, &entry, &found));
+    if (!found) return channels;
+
+    HASSERT(tag != MPI_ANY_TAG);
+    const int channel = tag % n_channels;
+    *channel_comm = entry->dups[channel];
+    return channels + channel;
+}
 
 HCLIB_MODULE_INITIALIZATION_FUNC(mpi_post_initialize) {
+    const char *thread_multiple_str = getenv("HCLIB_MPI_THREAD_MULTIPLE");
+    const int thread_multiple = (thread_multiple_str &&
+            atoi(thread_multiple_str));
+
     int provided;
-    CHECK_MPI(MPI_Init_thread(NULL, NULL, MPI_THREAD_FUNNELED, &provided));
-    assert(provided == MPI_THREAD_FUNNELED);
+    if (thread_multiple) {
+        CHECK_MPI(MPI_Init_thread(NULL, NULL, MPI_THREAD_MULTIPLE, &provided));
+        if (provided != MPI_THREAD_MULTIPLE) {
+            fprintf(stderr, "HCLIB_MPI_THREAD_MULTIPLE is set but the MPI "
+                    "library only provides thread level %d\n", provided);
+            exit(1);
+        }
+    } else {
+        CHECK_MPI(MPI_Init_thread(NULL, NULL, MPI_THREAD_FUNNELED, &provided));
+        assert(provided == MPI_THREAD_FUNNELED);
+    }
 
     int n_nics;
     hclib::locale_t **nics = hclib::get_all_locales_of_type(nic_locale_id,
             &n_nics);
-    HASSERT(n_nics == 1);
+    HASSERT(thread_multiple || n_nics == 1);
     HASSERT(nics);
     HASSERT(nic == NULL);
-    nic = nics[0];
 
-    hclib_locale_mark_special(nic, "COMM");
+    /*
+     * Only Interconnect locales on some worker's path can make progress, e.g.
+     * when HCLIB_WORKERS trims the workers named in the locality file.
+     */
+    channels = (mpi_channel *)calloc(n_nics, sizeof(mpi_channel));
+    HASSERT(channels);
+    n_channels = 0;
+    for (int i = 0; i < n_nics && (thread_multiple || n_channels == 0); i++) {
+        if (nics[i]->reachable) {
+            channels[n_channels++].pending.locale = nics[i];
+            hclib_locale_mark_special(nics[i], "COMM");
+        }
+    }
+    HASSERT(n_channels > 0);
+    nic = channels[0].pending.locale;
+    free(nics);
+
+    CHECK_MPI(::MPI_Comm_create_keyval(MPI_COMM_NULL_COPY_FN,
+                free_comm_state, &comm_state_keyval, NULL));
+    add_comm_state(MPI_COMM_WORLD);
+    agg_initialize();
+    steal_initialize();
+    remote_initialize();
+    gp_initialize();
 }
 
 HCLIB_MODULE_INITIALIZATION_FUNC(mpi_finalize) {
+#ifdef HCLIB_STATS
+    int rank;
+    CHECK_MPI(::MPI_Comm_rank(MPI_COMM_WORLD, &rank));
+#endif
+    for (int i = 0; i < n_channels; i++) {
+        pending_mpi_table *pending = &channels[i].pending;
+#ifdef HCLIB_STATS
+        printf("MPI rank %d channel %d: %llu requests completed over %llu "
+                "polls, %f per poll on average, at most %d in one poll\n",
+                rank, i, pending->n_completed, pending->n_polls,
+                pending->n_polls == 0 ? 0.0 :
+                (double)pending->n_completed / (double)pending->n_polls,
+                pending->max_completed_per_poll);
+#endif
+        free(pending->reqs);
+        free(pending->proms);
+        free(pending->completed);
+#ifdef HCLIB_INSTRUMENT
+        free(pending->event_types);
+        free(pending->event_ids);
+#endif
+    }
+    free(channels);
+
+    while (comm_states) {
+        CHECK_MPI(::MPI_Comm_delete_attr(comm_states->comm,
+                    comm_state_keyval));
+    }
+    CHECK_MPI(::MPI_Comm_free_keyval(&comm_state_keyval));
+    delete other_last_collective_started;
+    other_last_collective_started = NULL;
+
+    agg_finalize();
+    steal_finalize();
+    remote_finalize();
+    gp_finalize();
     MPI_Finalize();
 }
 
@@ -106,40 +608,151 @@ void hclib::MPI_Comm_size(MPI_Comm comm, int *size) {
 
 void hclib::MPI_Send(void *buf, int count, MPI_Datatype datatype, int dest,
         int tag, MPI_Comm comm) {
+    MPI_Comm channel_comm;
+    mpi_channel *channel = select_channel(comm, tag, &channel_comm);
+
     hclib::finish([&] {
         hclib::async_nb_at([&] {
             MPI_START_OP(MPI_Send);
-            CHECK_MPI(::MPI_Send(buf, count, datatype, dest, tag, comm));
+            CHECK_MPI(::MPI_Send(buf, count, datatype, dest, tag,
+                        channel_comm));
             MPI_END_OP(MPI_Send);
-        }, nic);
+        }, channel->pending.locale);
     });
 }
 
 void hclib::MPI_Recv(void *buf, int count, MPI_Datatype datatype, int source,
         int tag, MPI_Comm comm, MPI_Status *status) {
+    MPI_Comm channel_comm;
+    mpi_channel *channel = select_channel(comm, tag, &channel_comm);
+
     hclib::finish([&] {
         hclib::async_nb_at([&] {
             MPI_START_OP(MPI_Recv);
-            CHECK_MPI(::MPI_Recv(buf, count, datatype, source, tag, comm,
-                    status));
+            CHECK_MPI(::MPI_Recv(buf, count, datatype, source, tag,
+                        channel_comm, status));
             MPI_END_OP(MPI_Recv);
-        }, nic);
+        }, channel->pending.locale);
     });
 }
 
-static bool test_mpi_completion(void *generic_op) {
-    pending_mpi_op *op = (pending_mpi_op *)generic_op;
+static void grow_pending_table(pending_mpi_table *table) {
+    table->capacity = (table->capacity == 0 ? 64 : 2 * table->capacity);
+    table->reqs = (MPI_Request *)realloc(table->reqs,
+            table->capacity * sizeof(MPI_Request));
+    table->proms = (hclib::promise_t<void> **)realloc(table->proms,
+            table->capacity * sizeof(hclib::promise_t<void> *));
+    table->completed = (int *)realloc(table->completed,
+            table->capacity * sizeof(int));
+    HASSERT(table->reqs && table->proms && table->completed);
+#ifdef HCLIB_INSTRUMENT
+    table->event_types = (int *)realloc(table->event_types,
+            table->capacity * sizeof(int));
+    table->event_ids = (int *)realloc(table->event_ids,
+            table->capacity * sizeof(int));
+    HASSERT(table->event_types && table->event_ids);
+#endif
+}
 
-    int complete;
-    CHECK_MPI(::MPI_Test(&op->req, &complete, MPI_STATUS_IGNORE));
+/*
+ * Test every pending request, MPI_PENDING_WINDOW at a time, recording the
+ * indices of completed requests in table->completed. MPI implementations
+ * commonly drive their progress engine once per MPI_Testsome call, so testing
+ * a very large table in one call starves progress; windows keep the number of
+ * progress calls proportional to the table size.
+ */
+static int test_pending_table(pending_mpi_table *table) {
+    int outcount = 0;
+    for (int start = 0; start < table->count; start += MPI_PENDING_WINDOW) {
+        const int window = (table->count - start < MPI_PENDING_WINDOW ?
+                table->count - start : MPI_PENDING_WINDOW);
+        int window_outcount;
+        CHECK_MPI(::MPI_Testsome(window, table->reqs + start,
+                    &window_outcount, table->completed + outcount,
+                    MPI_STATUSES_IGNORE));
+        HASSERT(window_outcount != MPI_UNDEFINED);
 
-    if (complete) {
-        return true;
-    } else {
-        return false;
+        for (int i = 0; i < window_outcount; i++) {
+            table->completed[outcount + i] += start;
+        }
+        outcount += window_outcount;
+    }
+    return outcount;
+}
+
+static void poll_pending_table(pending_mpi_table *table) {
+    while (table->count > 0) {
+        const int outcount = test_pending_table(table);
+
+#ifdef HCLIB_STATS
+        table->n_polls++;
+        table->n_completed += outcount;
+        if (outcount > table->max_completed_per_poll) {
+            table->max_completed_per_poll = outcount;
+        }
+#endif
+
+        if (outcount > 0) {
+            /*
+             * Satisfy the completed requests and fill each hole from the end of
+             * the table. Visiting holes from the highest index down guarantees
+             * that the entry moved into a hole is never itself complete.
+             */
+            std::sort(table->completed, table->completed + outcount,
+                    std::greater<int>());
+            for (int i = 0; i < outcount; i++) {
+                const int index = table->completed[i];
+#ifdef HCLIB_INSTRUMENT
+                hclib_register_event(table->event_types[index], END,
+                        table->event_ids[index]);
+#endif
+                table->proms[index]->put();
+
+                const int last = --table->count;
+                table->reqs[index] = table->reqs[last];
+                table->proms[index] = table->proms[last];
+#ifdef HCLIB_INSTRUMENT
+                table->event_types[index] = table->event_types[last];
+                table->event_ids[index] = table->event_ids[last];
+#endif
+            }
+        }
+
+        if (table->count > 0) {
+            hclib::yield_at(table->locale);
+        }
     }
+    table->poller_active = 0;
 }
 
+static void append_to_pending_table(pending_mpi_table *table, MPI_Request req,
+        hclib::promise_t<void> *prom, int event_type, int event_id) {
+    if (table->count == table->capacity) {
+        grow_pending_table(table);
+    }
+
+    const int index = table->count++;
+    table->reqs[index] = req;
+    table->proms[index] = prom;
+#ifdef HCLIB_INSTRUMENT
+    table->event_types[index] = event_type;
+    table->event_ids[index] = event_id;
+#endif
+
+    if (!table->poller_active) {
+        table->poller_active = 1;
+        hclib::async_at([table] {
+            poll_pending_table(table);
+        }, table->locale);
+    }
+}
+
+#ifdef HCLIB_INSTRUMENT
+#define PENDING_EVENT(funcname) event_ids[funcname##_lbl], _event_id
+#else
+#define PENDING_EVENT(funcname) -1, -1
+#endif
+
 void hclib::MPI_Waitall(int count, hclib::future_t<void> *array_of_requests[]) {
     MPI_START_OP(MPI_Waitall);
     for (int i = 0; i < count; i++) {
@@ -153,23 +766,19 @@ hclib::future_t<void> *hclib::MPI_Isend_await(void *buf, int count,
         hclib::future_t<void> *fut) {
     hclib::promise_t<void> *prom = new hclib::promise_t<void>();
 
+    MPI_Comm channel_comm;
+    mpi_channel *channel = select_channel(comm, tag, &channel_comm);
+
     hclib::async_nb_await_at([=] {
         MPI_START_OP(MPI_Isend);
 
         MPI_Request req;
-        CHECK_MPI(::MPI_Isend(buf, count, datatype, dest, tag, comm, &req));
+        CHECK_MPI(::MPI_Isend(buf, count, datatype, dest, tag, channel_comm,
+                    &req));
 
-        pending_mpi_op *op = (pending_mpi_op *)malloc(sizeof(pending_mpi_op));
-        assert(op);
-        op->req = req;
-        op->prom = prom;
-        op->task = NULL;
-#ifdef HCLIB_INSTRUMENT
-        op->event_type = event_ids[MPI_Isend_lbl];
-        op->event_id = _event_id;
-#endif
-        hclib::append_to_pending(op, &pending, test_mpi_completion, nic);
-    }, fut, nic);
+        append_to_pending_table(&channel->pending, req, prom,
+                PENDING_EVENT(MPI_Isend));
+    }, fut, channel->pending.locale);
 
     return prom->get_future();
 }
@@ -184,22 +793,18 @@ hclib::future_t<void> *hclib::MPI_Irecv_await(void *buf, int count,
         hclib::future_t<void> *fut) {
     hclib::promise_t<void> *prom = new hclib::promise_t<void>();
 
+    MPI_Comm channel_comm;
+    mpi_channel *channel = select_channel(comm, tag, &channel_comm);
+
     hclib::async_nb_await_at([=] {
         MPI_START_OP(MPI_Irecv);
         MPI_Request req;
-        CHECK_MPI(::MPI_Irecv(buf, count, datatype, source, tag, comm, &req));
+        CHECK_MPI(::MPI_Irecv(buf, count, datatype, source, tag, channel_comm,
+                    &req));
 
-        pending_mpi_op *op = (pending_mpi_op *)malloc(sizeof(pending_mpi_op));
-        assert(op);
-        op->req = req;
-        op->prom = prom;
-        op->task = NULL;
-#ifdef HCLIB_INSTRUMENT
-        op->event_type = event_ids[MPI_Irecv_lbl];
-        op->event_id = _event_id;
-#endif
-        hclib::append_to_pending(op, &pending, test_mpi_completion, nic);
-    }, fut, nic);
+        append_to_pending_table(&channel->pending, req, prom,
+                PENDING_EVENT(MPI_Irecv));
+    }, fut, channel->pending.locale);
 
     return prom->get_future();
 }
@@ -211,78 +816,1184 @@ hclib::future_t<void> *hclib::MPI_Irecv(void *buf, int count,
 
 void hclib::MPI_Comm_dup(MPI_Comm comm, MPI_Comm *newcomm) {
     CHECK_MPI(::MPI_Comm_dup(comm, newcomm));
+    add_comm_state(*newcomm);
 }
 
 void hclib::MPI_Comm_split(MPI_Comm comm, int color, int key, MPI_Comm *newcomm) {
     CHECK_MPI(::MPI_Comm_split(comm, color, key, newcomm));
+    if (*newcomm != MPI_COMM_NULL) {
+        add_comm_state(*newcomm);
+    }
+}
+
+void hclib::MPI_Comm_free(MPI_Comm *comm) {
+    CHECK_MPI(::MPI_Comm_free(comm));
+}
+
+/*
+ * Collectives on a communicator must be started in the same order on every
+ * rank, but tasks at the Interconnect locale do not necessarily run in the
+ * order they were created. Each collective's task therefore waits until the
+ * previously requested collective on the same communicator has been started
+ * before starting its own, and then deletes that collective's promise.
+ */
+static hclib::promise_t<void> *order_collective(MPI_Comm comm,
+        hclib::promise_t<void> **started) {
+    *started = new hclib::promise_t<void>();
+
+    lock_comm_states();
+    hclib::promise_t<void> **last = &other_last_collective_started;
+    for (comm_state *entry = comm_states; entry; entry = entry->next) {
+        if (entry->comm == comm) {
+            last = &entry->last_collective_started;
+            break;
+        }
+    }
+    hclib::promise_t<void> *prev = *last;
+    *last = *started;
+    unlock_comm_states();
+    return prev;
+}
+
+static inline hclib::future_t<void> *started_future(
+        hclib::promise_t<void> *started) {
+    return started ? started->get_future() : NULL;
 }
 
 void hclib::MPI_Allreduce(const void *sendbuf, void *recvbuf, int count,
         MPI_Datatype datatype, MPI_Op op, MPI_Comm comm) {
+    hclib::promise_t<void> *started;
+    hclib::promise_t<void> *prev = order_collective(comm, &started);
+
     hclib::finish([&] {
-        hclib::async_nb_at([&] {
+        hclib::async_nb_await_at([&] {
+            delete prev;
+            started->put();
             MPI_START_OP(MPI_Allreduce);
             CHECK_MPI(::MPI_Allreduce(sendbuf, recvbuf, count, datatype, op,
                     comm));
             MPI_END_OP(MPI_Allreduce);
-        }, nic);
+        }, started_future(prev), nic);
     });
 }
 
 hclib::future_t<void> *hclib::MPI_Allreduce_future(const void *sendbuf, void *recvbuf,
         int count, MPI_Datatype datatype, MPI_Op op, MPI_Comm comm) {
-    return hclib::async_nb_future_at([=] {
-        MPI_START_OP(MPI_Allreduce_future);
-        CHECK_MPI(::MPI_Allreduce(sendbuf, recvbuf, count, datatype, op,
-                comm));
-        MPI_END_OP(MPI_Allreduce_future);
-    }, nic);
+    return hclib::MPI_Iallreduce(sendbuf, recvbuf, count, datatype, op, comm);
 }
 
 void hclib::MPI_Allgather(const void *sendbuf, int sendcount,
         MPI_Datatype sendtype, void *recvbuf, int recvcount,
         MPI_Datatype recvtype, MPI_Comm comm) {
+    hclib::promise_t<void> *started;
+    hclib::promise_t<void> *prev = order_collective(comm, &started);
+
     hclib::finish([&] {
-        hclib::async_nb_at([&] {
+        hclib::async_nb_await_at([&] {
+            delete prev;
+            started->put();
             MPI_START_OP(MPI_Allgather);
             CHECK_MPI(::MPI_Allgather(sendbuf, sendcount, sendtype, recvbuf,
                     recvcount, recvtype, comm));
             MPI_END_OP(MPI_Allgather);
-        }, nic);
+        }, started_future(prev), nic);
     });
 }
 
 void hclib::MPI_Bcast(void *buffer, int count, MPI_Datatype datatype, int root, 
         MPI_Comm comm) {
+    hclib::promise_t<void> *started;
+    hclib::promise_t<void> *prev = order_collective(comm, &started);
+
     hclib::finish([&] {
-            hclib::async_nb_at([&] {
-                MPI_START_OP(MPI_Bcast);
-                CHECK_MPI(::MPI_Bcast(buffer, count, datatype, root, comm));
-                MPI_END_OP(MPI_Bcast);
-            }, nic);
+        hclib::async_nb_await_at([&] {
+            delete prev;
+            started->put();
+            MPI_START_OP(MPI_Bcast);
+            CHECK_MPI(::MPI_Bcast(buffer, count, datatype, root, comm));
+            MPI_END_OP(MPI_Bcast);
+        }, started_future(prev), nic);
     });
 }
 
 void hclib::MPI_Barrier(MPI_Comm comm) {
+    hclib::promise_t<void> *started;
+    hclib::promise_t<void> *prev = order_collective(comm, &started);
+
     hclib::finish([&] {
-        hclib::async_nb_at([&] {
+        hclib::async_nb_await_at([&] {
+            delete prev;
+            started->put();
             MPI_START_OP(MPI_Barrier);
             CHECK_MPI(::MPI_Barrier(comm));
             MPI_END_OP(MPI_Barrier);
-        }, nic);
+        }, started_future(prev), nic);
     });
 }
 
 void hclib::MPI_Reduce(const void *sendbuf, void *recvbuf, int count,
         MPI_Datatype datatype, MPI_Op op, int root, MPI_Comm comm) {
+    hclib::promise_t<void> *started;
+    hclib::promise_t<void> *prev = order_collective(comm, &started);
+
     hclib::finish([&] {
-        hclib::async_nb_at([&] {
+        hclib::async_nb_await_at([&] {
+            delete prev;
+            started->put();
             MPI_START_OP(MPI_Reduce);
             CHECK_MPI(::MPI_Reduce(sendbuf, recvbuf, count, datatype, op, root,
                     comm));
             MPI_END_OP(MPI_Reduce);
+        }, started_future(prev), nic);
+    });
+}
+
+hclib::future_t<void> *hclib::MPI_Iallreduce(const void *sendbuf, void *recvbuf,
+        int count, MPI_Datatype datatype, MPI_Op op, MPI_Comm comm) {
+    hclib::promise_t<void> *prom = new hclib::promise_t<void>();
+    hclib::promise_t<void> *started;
+    hclib::promise_t<void> *prev = order_collective(comm, &started);
+
+    hclib::async_nb_await_at([=] {
+        delete prev;
+        MPI_START_OP(MPI_Iallreduce);
+        MPI_Request req;
+        CHECK_MPI(::MPI_Iallreduce(sendbuf, recvbuf, count, datatype, op,
+                    comm, &req));
+        started->put();
+
+        append_to_pending_table(&channels[0].pending, req, prom,
+                PENDING_EVENT(MPI_Iallreduce));
+    }, started_future(prev), nic);
+
+    return prom->get_future();
+}
+
+hclib::future_t<void> *hclib::MPI_Iallgather(const void *sendbuf,
+        int sendcount, MPI_Datatype sendtype, void *recvbuf, int recvcount,
+        MPI_Datatype recvtype, MPI_Comm comm) {
+    hclib::promise_t<void> *prom = new hclib::promise_t<void>();
+    hclib::promise_t<void> *started;
+    hclib::promise_t<void> *prev = order_collective(comm, &started);
+
+    hclib::async_nb_await_at([=] {
+        delete prev;
+        MPI_START_OP(MPI_Iallgather);
+        MPI_Request req;
+        CHECK_MPI(::MPI_Iallgather(sendbuf, sendcount, sendtype, recvbuf,
+                    recvcount, recvtype, comm, &req));
+        started->put();
+
+        append_to_pending_table(&channels[0].pending, req, prom,
+                PENDING_EVENT(MPI_Iallgather));
+    }, started_future(prev), nic);
+
+    return prom->get_future();
+}
+
+hclib::future_t<void> *hclib::MPI_Ibcast(void *buffer, int count,
+        MPI_Datatype datatype, int root, MPI_Comm comm) {
+    hclib::promise_t<void> *prom = new hclib::promise_t<void>();
+    hclib::promise_t<void> *started;
+    hclib::promise_t<void> *prev = order_collective(comm, &started);
+
+    hclib::async_nb_await_at([=] {
+        delete prev;
+        MPI_START_OP(MPI_Ibcast);
+        MPI_Request req;
+        CHECK_MPI(::MPI_Ibcast(buffer, count, datatype, root, comm, &req));
+        started->put();
+
+        append_to_pending_table(&channels[0].pending, req, prom,
+                PENDING_EVENT(MPI_Ibcast));
+    }, started_future(prev), nic);
+
+    return prom->get_future();
+}
+
+hclib::future_t<void> *hclib::MPI_Ibarrier(MPI_Comm comm) {
+    hclib::promise_t<void> *prom = new hclib::promise_t<void>();
+    hclib::promise_t<void> *started;
+    hclib::promise_t<void> *prev = order_collective(comm, &started);
+
+    hclib::async_nb_await_at([=] {
+        delete prev;
+        MPI_START_OP(MPI_Ibarrier);
+        MPI_Request req;
+        CHECK_MPI(::MPI_Ibarrier(comm, &req));
+        started->put();
+
+        append_to_pending_table(&channels[0].pending, req, prom,
+                PENDING_EVENT(MPI_Ibarrier));
+    }, started_future(prev), nic);
+
+    return prom->get_future();
+}
+
+hclib::future_t<void> *hclib::MPI_Ireduce(const void *sendbuf, void *recvbuf,
+        int count, MPI_Datatype datatype, MPI_Op op, int root, MPI_Comm comm) {
+    hclib::promise_t<void> *prom = new hclib::promise_t<void>();
+    hclib::promise_t<void> *started;
+    hclib::promise_t<void> *prev = order_collective(comm, &started);
+
+    hclib::async_nb_await_at([=] {
+        delete prev;
+        MPI_START_OP(MPI_Ireduce);
+        MPI_Request req;
+        CHECK_MPI(::MPI_Ireduce(sendbuf, recvbuf, count, datatype, op,
+                    root, comm, &req));
+        started->put();
+
+        append_to_pending_table(&channels[0].pending, req, prom,
+                PENDING_EVENT(MPI_Ireduce));
+    }, started_future(prev), nic);
+
+    return prom->get_future();
+}
+
+static inline size_t agg_record_size(size_t nbytes) {
+    return sizeof(agg_header) + ((nbytes + 7) & ~((size_t)7));
+}
+
+static inline void agg_lock(agg_dest *d) {
+    while (__sync_lock_test_and_set(&d->lock, 1)) ;
+}
+
+static inline void agg_unlock(agg_dest *d) {
+    __sync_lock_release(&d->lock);
+}
+
+static void agg_push_ready(agg_buffer *buf) {
+    agg_buffer *old_head;
+    do {
+        old_head = agg_ready;
+        buf->next = old_head;
+    } while (!__sync_bool_compare_and_swap(&agg_ready, old_head, buf));
+}
+
+/*
+ * Detach the current contents of a destination's buffer and queue them to be
+ * sent. The caller must hold the destination's lock and the buffer must be
+ * non-empty.
+ */
+static void agg_detach(agg_dest *d, int dest) {
+    agg_buffer *buf = (agg_buffer *)malloc(sizeof(agg_buffer));
+    HASSERT(buf);
+    buf->data = d->data;
+    buf->nbytes = d->nbytes;
+    buf->dest = dest;
+
+    d->data = NULL;
+    d->nbytes = 0;
+    __sync_sub_and_fetch(&agg_n_buffered, 1);
+
+    agg_push_ready(buf);
+}
+
+static void agg_deliver(int source, char *data, int nbytes) {
+    int offset = 0;
+    while (offset < nbytes) {
+        agg_header *header = (agg_header *)(data + offset);
+        agg_handlers[header->handler](source, header + 1, header->nbytes);
+        offset += agg_record_size(header->nbytes);
+    }
+}
+
+/*
+ * One round of aggregation progress: issue queued buffers, retire completed
+ * sends, run handlers for any received buffers and flush buffers that have
+ * waited longer than the timeout. Must be called from the Interconnect locale.
+ * Returns true if local aggregation traffic remains outstanding.
+ */
+static bool agg_progress() {
+    agg_buffer *ready = __sync_lock_test_and_set(&agg_ready, NULL);
+    while (ready) {
+        agg_buffer *next = ready->next;
+        CHECK_MPI(::MPI_Isend(ready->data, ready->nbytes, MPI_BYTE,
+                    ready->dest, MPI_AGG_TAG, agg_comm, &ready->req));
+        agg_sent_to[ready->dest]++;
+        agg_n_sent++;
+        ready->next = agg_inflight;
+        agg_inflight = ready;
+        ready = next;
+    }
+
+    agg_buffer *prev = NULL;
+    agg_buffer *curr = agg_inflight;
+    while (curr) {
+        agg_buffer *next = curr->next;
+        int complete;
+        CHECK_MPI(::MPI_Test(&curr->req, &complete, MPI_STATUS_IGNORE));
+        if (complete) {
+            if (prev) prev->next = next;
+            else agg_inflight = next;
+            free(curr->data);
+            free(curr);
+        } else {
+            prev = curr;
+        }
+        curr = next;
+    }
+
+    for (int i = 0; i < MPI_AGG_N_RECVS; i++) {
+        while (true) {
+            int complete;
+            MPI_Status status;
+            CHECK_MPI(::MPI_Test(&agg_recv_reqs[i], &complete, &status));
+            if (!complete) break;
+
+            int nbytes;
+            CHECK_MPI(::MPI_Get_count(&status, MPI_BYTE, &nbytes));
+            agg_deliver(status.MPI_SOURCE, agg_recv_bufs[i], nbytes);
+            agg_n_received++;
+
+            CHECK_MPI(::MPI_Irecv(agg_recv_bufs[i], agg_buffer_size, MPI_BYTE,
+                        MPI_ANY_SOURCE, MPI_AGG_TAG, agg_comm,
+                        &agg_recv_reqs[i]));
+        }
+    }
+
+    if (agg_n_buffered > 0) {
+        const unsigned long long now = hclib_current_time_ns();
+        for (int dest = 0; dest < agg_nranks; dest++) {
+            agg_dest *d = agg_dests + dest;
+            if (d->nbytes > 0 && now - d->first_append_ns >= agg_timeout_ns) {
+                agg_lock(d);
+                if (d->nbytes > 0) agg_detach(d, dest);
+                agg_unlock(d);
+            }
+        }
+    }
+
+    return agg_inflight != NULL || agg_ready != NULL || agg_n_buffered > 0;
+}
+
+static void agg_poll() {
+    while (true) {
+        if (agg_progress() || gp_n_pending > 0) {
+            hclib::yield_at(nic);
+            continue;
+        }
+
+        /*
+         * Nothing outstanding. Another worker may have buffered a message
+         * after our check but before we clear the flag, in which case it saw
+         * the poller as still active and did not start a new one, so re-check
+         * after clearing.
+         */
+        agg_poller_active = 0;
+        __sync_synchronize();
+        if ((agg_ready == NULL && agg_n_buffered == 0 && gp_n_pending == 0) ||
+                !__sync_bool_compare_and_swap(&agg_poller_active, 0, 1)) {
+            break;
+        }
+    }
+}
+
+static void agg_start_poller() {
+    if (agg_poller_active == 0 &&
+            __sync_bool_compare_and_swap(&agg_poller_active, 0, 1)) {
+        // Escaping, so that no user finish waits on global promises
+        hclib::async_escaping_at([] {
+            agg_poll();
+        }, nic);
+    }
+}
+
+int hclib::MPI_Aggregate_register(hclib::MPI_Aggregate_handler handler) {
+    const int id = __sync_fetch_and_add(&agg_n_handlers, 1);
+    HASSERT(id < MPI_AGG_MAX_HANDLERS);
+    agg_handlers[id] = handler;
+    return id;
+}
+
+/*
+ * Append a message made of a prefix and a body to the buffer for dest, so that
+ * internal users of the aggregation layer can add their own header without
+ * first copying the body.
+ */
+static void agg_append(int handler_id, const void *prefix, size_t prefix_bytes,
+        const void *msg, size_t msg_bytes, int dest) {
+    HASSERT(handler_id >= 0 && handler_id < agg_n_handlers);
+    HASSERT(dest >= 0 && dest < agg_nranks);
+    const size_t nbytes = prefix_bytes + msg_bytes;
+    const size_t record_size = agg_record_size(nbytes);
+    HASSERT(record_size <= agg_buffer_size);
+
+    agg_dest *d = agg_dests + dest;
+    bool start_poller = false;
+
+    agg_lock(d);
+    if (d->nbytes + record_size > agg_buffer_size) {
+        agg_detach(d, dest);
+        start_poller = true;
+    }
+    if (d->data == NULL) {
+        d->data = (char *)malloc(agg_buffer_size);
+        HASSERT(d->data);
+    }
+    if (d->nbytes == 0) {
+        d->first_append_ns = hclib_current_time_ns();
+        __sync_add_and_fetch(&agg_n_buffered, 1);
+        start_poller = true;
+    }
+
+    agg_header *header = (agg_header *)(d->data + d->nbytes);
+    header->handler = handler_id;
+    header->nbytes = nbytes;
+    memcpy(header + 1, prefix, prefix_bytes);
+    memcpy((char *)(header + 1) + prefix_bytes, msg, msg_bytes);
+    d->nbytes += record_size;
+
+    if (agg_buffer_size - d->nbytes < sizeof(agg_header)) {
+        agg_detach(d, dest);
+    }
+    agg_unlock(d);
+
+    if (start_poller) {
+        agg_start_poller();
+    }
+}
+
+void hclib::MPI_Aggregate_send(int handler_id, const void *msg, size_t nbytes,
+        int dest) {
+    agg_append(handler_id, NULL, 0, msg, nbytes, dest);
+}
+
+void hclib::MPI_Aggregate_flush() {
+    bool any_flushed = false;
+    for (int dest = 0; dest < agg_nranks; dest++) {
+        agg_dest *d = agg_dests + dest;
+        if (d->nbytes > 0) {
+            agg_lock(d);
+            if (d->nbytes > 0) {
+                agg_detach(d, dest);
+                any_flushed = true;
+            }
+            agg_unlock(d);
+        }
+    }
+
+    if (any_flushed) {
+        agg_start_poller();
+    }
+}
+
+/*
+ * Repeatedly flush, agree on how many buffers each rank should have received
+ * so far, and drain until they have arrived. Handlers may send more messages
+ * while draining, so we only stop once a round completes in which no rank
+ * issued or buffered anything new. We never block on our own sends before a
+ * collective, as their receiver may already be inside it.
+ */
+void hclib::MPI_Aggregate_quiesce() {
+    hclib::finish([] {
+        hclib::async_nb_at([] {
+            MPI_START_OP(MPI_Aggregate_quiesce);
+            while (true) {
+                hclib::MPI_Aggregate_flush();
+                agg_progress();
+
+                const long long sent_before = agg_n_sent;
+                long long expected;
+                CHECK_MPI(::MPI_Reduce_scatter_block(agg_sent_to, &expected, 1,
+                            MPI_LONG_LONG, MPI_SUM, agg_comm));
+
+                while (agg_n_received < expected) {
+                    agg_progress();
+                }
+
+                int dirty = (agg_n_sent != sent_before || agg_ready != NULL ||
+                        agg_n_buffered > 0);
+                int any_dirty;
+                CHECK_MPI(::MPI_Allreduce(&dirty, &any_dirty, 1, MPI_INT,
+                            MPI_LOR, agg_comm));
+                if (!any_dirty) break;
+            }
+
+            // Every buffer issued has now been received, so these complete
+            while (agg_inflight != NULL) {
+                agg_progress();
+            }
+            MPI_END_OP(MPI_Aggregate_quiesce);
         }, nic);
     });
 }
 
+/*
+ * Termination detection for a set of counted activities (e.g. tasks spawned
+ * and completed, or messages sent and handled) using Mattern's four-counter
+ * method. Each wave sums every rank's local pair of counts with a
+ * non-blocking allreduce, and termination is declared once two consecutive
+ * waves saw the same global counts, equal to each other. Every rank sees the
+ * same wave results, so all ranks detect termination in the same wave.
+ */
+typedef struct _termination_wave {
+    MPI_Request req;
+    long long local[2];
+    long long global[2];
+    long long last_global[2];
+} termination_wave;
+
+static void termination_wave_init(termination_wave *wave) {
+    wave->req = MPI_REQUEST_NULL;
+    wave->last_global[0] = -1;
+    wave->last_global[1] = -1;
+}
+
+// The caller fills in wave->local before starting a wave
+static void termination_wave_start(termination_wave *wave, MPI_Comm comm) {
+    CHECK_MPI(::MPI_Iallreduce(wave->local, wave->global, 2, MPI_LONG_LONG,
+                MPI_SUM, comm, &wave->req));
+}
+
+/*
+ * Test for completion of the wave in flight, returning true if it detected
+ * termination.
+ */
+static bool termination_wave_test(termination_wave *wave) {
+    int complete;
+    CHECK_MPI(::MPI_Test(&wave->req, &complete, MPI_STATUS_IGNORE));
+    if (!complete) return false;
+
+    const bool terminated = (wave->global[0] == wave->global[1] &&
+            wave->global[0] == wave->last_global[0] &&
+            wave->global[1] == wave->last_global[1]);
+    wave->last_global[0] = wave->global[0];
+    wave->last_global[1] = wave->global[1];
+    return terminated;
+}
+
+static inline void steal_lock() {
+    while (__sync_lock_test_and_set(&steal_pool_lock, 1)) ;
+}
+
+static inline void steal_unlock() {
+    __sync_lock_release(&steal_pool_lock);
+}
+
+static void steal_pool_push_locked(stealable_task *task) {
+    if (steal_pool_size == steal_pool_capacity) {
+        const int new_capacity = (steal_pool_capacity == 0 ? 64 :
+                2 * steal_pool_capacity);
+        stealable_task **new_pool = (stealable_task **)malloc(
+                new_capacity * sizeof(stealable_task *));
+        HASSERT(new_pool);
+        for (int i = 0; i < steal_pool_size; i++) {
+            new_pool[i] = steal_pool[(steal_pool_head + i) %
+                steal_pool_capacity];
+        }
+        free(steal_pool);
+        steal_pool = new_pool;
+        steal_pool_head = 0;
+        steal_pool_capacity = new_capacity;
+    }
+    steal_pool[(steal_pool_head + steal_pool_size) % steal_pool_capacity] =
+        task;
+    steal_pool_size++;
+}
+
+static stealable_task *steal_pool_pop_newest_locked() {
+    steal_pool_size--;
+    return steal_pool[(steal_pool_head + steal_pool_size) %
+        steal_pool_capacity];
+}
+
+static stealable_task *steal_pool_pop_oldest_locked() {
+    stealable_task *task = steal_pool[steal_pool_head];
+    steal_pool_head = (steal_pool_head + 1) % steal_pool_capacity;
+    steal_pool_size--;
+    return task;
+}
+
+static void steal_serve_requests();
+static void steal_retire_sends();
+
+/*
+ * The driver only gets to run once its worker has no other local work, so a
+ * busy rank would leave thieves waiting. Stealable tasks running on the
+ * driver's worker, which is the one making MPI calls, therefore also answer
+ * pending steal requests whenever they spawn or complete.
+ */
+static void steal_service_from_task() {
+    if (hclib::get_current_worker() != steal_mpi_worker ||
+            __sync_lock_test_and_set(&steal_service_lock, 1)) {
+        return;
+    }
+    steal_serve_requests();
+    steal_retire_sends();
+    __sync_lock_release(&steal_service_lock);
+}
+
+static void steal_run_one() {
+    steal_lock();
+    if (steal_pool_size == 0) {
+        // Taken by another local task, or shipped to a remote rank
+        steal_unlock();
+        return;
+    }
+    stealable_task *task = steal_pool_pop_newest_locked();
+    steal_n_running++;
+    steal_unlock();
+
+    steal_funcs[task->fn_id](task + 1, task->nbytes);
+    free(task);
+
+    __sync_fetch_and_add(&steal_n_completed, 1);
+    __sync_fetch_and_sub(&steal_n_running, 1);
+
+    steal_service_from_task();
+}
+
+static void steal_spawn_runners(int n) {
+    for (int i = 0; i < n; i++) {
+        hclib::async([] {
+            steal_run_one();
+        });
+    }
+}
+
+/*
+ * Snapshot the local counters for a termination wave, but only if this rank
+ * has no stealable work queued or running.
+ */
+static bool steal_locally_idle(long long counts[2]) {
+    bool idle;
+    steal_lock();
+    idle = (steal_pool_size == 0 && steal_n_running == 0);
+    if (idle) {
+        counts[0] = steal_n_spawned;
+        counts[1] = steal_n_completed;
+    }
+    steal_unlock();
+    return idle;
+}
+
+static void steal_isend(char *data, int nbytes, int dest, int tag) {
+    steal_send *send = (steal_send *)malloc(sizeof(steal_send));
+    HASSERT(send);
+    send->data = data;
+    CHECK_MPI(::MPI_Isend(data, nbytes, MPI_BYTE, dest, tag, steal_comm,
+                &send->req));
+    send->next = steal_inflight;
+    steal_inflight = send;
+}
+
+static void steal_retire_sends() {
+    steal_send *prev = NULL;
+    steal_send *curr = steal_inflight;
+    while (curr) {
+        steal_send *next = curr->next;
+        int complete;
+        CHECK_MPI(::MPI_Test(&curr->req, &complete, MPI_STATUS_IGNORE));
+        if (complete) {
+            if (prev) prev->next = next;
+            else steal_inflight = next;
+            free(curr->data);
+            free(curr);
+        } else {
+            prev = curr;
+        }
+        curr = next;
+    }
+}
+
+/*
+ * Answer every pending steal request with up to half of the oldest
+ * descriptors in the local pool, packed back to back. An empty response means
+ * the request was denied.
+ */
+static void steal_serve_requests() {
+    while (true) {
+        int pending;
+        MPI_Status status;
+        CHECK_MPI(::MPI_Iprobe(MPI_ANY_SOURCE, MPI_STEAL_REQUEST_TAG,
+                    steal_comm, &pending, &status));
+        if (!pending) break;
+
+        const int thief = status.MPI_SOURCE;
+        CHECK_MPI(::MPI_Recv(NULL, 0, MPI_BYTE, thief, MPI_STEAL_REQUEST_TAG,
+                    steal_comm, MPI_STATUS_IGNORE));
+
+        stealable_task *tasks[MPI_STEAL_MAX_TASKS];
+        steal_lock();
+        int ntasks = (steal_pool_size + 1) / 2;
+        if (ntasks > MPI_STEAL_MAX_TASKS) ntasks = MPI_STEAL_MAX_TASKS;
+        for (int i = 0; i < ntasks; i++) {
+            tasks[i] = steal_pool_pop_oldest_locked();
+        }
+        steal_unlock();
+
+        int nbytes = 0;
+        for (int i = 0; i < ntasks; i++) {
+            nbytes += sizeof(stealable_task) + tasks[i]->nbytes;
+        }
+        char *data = (char *)malloc(nbytes > 0 ? nbytes : 1);
+        HASSERT(data);
+        int offset = 0;
+        for (int i = 0; i < ntasks; i++) {
+            const int task_size = sizeof(stealable_task) + tasks[i]->nbytes;
+            memcpy(data + offset, tasks[i], task_size);
+            offset += task_size;
+            free(tasks[i]);
+        }
+#ifdef HCLIB_STATS
+        steal_n_tasks_sent += ntasks;
+#endif
+
+        steal_isend(data, nbytes, thief, MPI_STEAL_RESPONSE_TAG);
+    }
+}
+
+/*
+ * Check for the response to our outstanding steal request, and add any
+ * descriptors it carries to the local pool. Returns true once the response
+ * has arrived.
+ */
+static bool steal_check_response(int victim) {
+    int arrived;
+    MPI_Status status;
+    CHECK_MPI(::MPI_Iprobe(victim, MPI_STEAL_RESPONSE_TAG, steal_comm,
+                &arrived, &status));
+    if (!arrived) return false;
+
+    int nbytes;
+    CHECK_MPI(::MPI_Get_count(&status, MPI_BYTE, &nbytes));
+    char *data = (char *)malloc(nbytes > 0 ? nbytes : 1);
+    HASSERT(data);
+    CHECK_MPI(::MPI_Recv(data, nbytes, MPI_BYTE, victim,
+                MPI_STEAL_RESPONSE_TAG, steal_comm, MPI_STATUS_IGNORE));
+
+    int ntasks = 0;
+    int offset = 0;
+    steal_lock();
+    while (offset < nbytes) {
+        stealable_task *header = (stealable_task *)(data + offset);
+        const int task_size = sizeof(stealable_task) + header->nbytes;
+        stealable_task *task = (stealable_task *)malloc(task_size);
+        HASSERT(task);
+        memcpy(task, header, task_size);
+        steal_pool_push_locked(task);
+        offset += task_size;
+        ntasks++;
+    }
+    steal_unlock();
+    free(data);
+
+#ifdef HCLIB_STATS
+    if (ntasks > 0) steal_n_successful++;
+    steal_n_tasks_received += ntasks;
+#endif
+    steal_spawn_runners(ntasks);
+    return true;
+}
+
+static void steal_driver_lock() {
+    while (__sync_lock_test_and_set(&steal_service_lock, 1)) ;
+}
+
+static void steal_driver_unlock() {
+    __sync_lock_release(&steal_service_lock);
+}
+
+/*
+ * Runs on the Interconnect locale for the duration of a distributed finish.
+ * Serves steal requests from other ranks, steals from a random remote rank
+ * while the local pool is empty, and takes part in termination waves while
+ * this rank is idle. All ranks leave the loop in the same wave, after
+ * which each rank waits for the answer to its last steal request and a
+ * barrier ensures no rank stops answering requests while another still
+ * expects a response.
+ */
+static void steal_drive() {
+    unsigned int seed = steal_rank;
+    int victim = -1;
+    bool terminated = false;
+    termination_wave wave;
+    termination_wave_init(&wave);
+
+    while (!terminated) {
+        steal_driver_lock();
+        steal_serve_requests();
+        if (victim >= 0 && steal_check_response(victim)) {
+            victim = -1;
+        }
+        steal_retire_sends();
+
+        if (victim < 0 && steal_nranks > 1 && steal_pool_size == 0 &&
+                steal_n_running < hclib::get_num_workers()) {
+            victim = rand_r(&seed) % (steal_nranks - 1);
+            if (victim >= steal_rank) victim++;
+            steal_isend(NULL, 0, victim, MPI_STEAL_REQUEST_TAG);
+#ifdef HCLIB_STATS
+            steal_n_requests++;
+#endif
+        }
+
+        if (wave.req != MPI_REQUEST_NULL) {
+            terminated = termination_wave_test(&wave);
+        } else if (steal_locally_idle(wave.local)) {
+            termination_wave_start(&wave, steal_comm);
+        }
+
+        if (!terminated) {
+            steal_driver_unlock();
+            hclib::yield_at(nic);
+        }
+    }
+
+    while (victim >= 0) {
+        steal_serve_requests();
+        if (steal_check_response(victim)) {
+            victim = -1;
+        }
+        steal_retire_sends();
+        steal_driver_unlock();
+        hclib::yield_at(nic);
+        steal_driver_lock();
+    }
+
+    MPI_Request barrier_req;
+    CHECK_MPI(::MPI_Ibarrier(steal_comm, &barrier_req));
+    while (true) {
+        steal_serve_requests();
+        steal_retire_sends();
+        int complete;
+        CHECK_MPI(::MPI_Test(&barrier_req, &complete, MPI_STATUS_IGNORE));
+        if (complete) break;
+        steal_driver_unlock();
+        hclib::yield_at(nic);
+        steal_driver_lock();
+    }
+
+    // Every response has been received by now, so these complete
+    while (steal_inflight) {
+        steal_retire_sends();
+    }
+    steal_driver_unlock();
+}
+
+int hclib::MPI_Stealable_register(hclib::MPI_Stealable_fn fn) {
+    const int id = __sync_fetch_and_add(&steal_n_funcs, 1);
+    HASSERT(id < MPI_STEAL_MAX_FUNCS);
+    steal_funcs[id] = fn;
+    return id;
+}
+
+void hclib::MPI_Stealable_spawn(int fn_id, const void *payload,
+        size_t nbytes) {
+    HASSERT(steal_finish_active);
+    HASSERT(fn_id >= 0 && fn_id < steal_n_funcs);
+
+    stealable_task *task = (stealable_task *)malloc(sizeof(stealable_task) +
+            nbytes);
+    HASSERT(task);
+    task->fn_id = fn_id;
+    task->nbytes = nbytes;
+    memcpy(task + 1, payload, nbytes);
+
+    __sync_fetch_and_add(&steal_n_spawned, 1);
+    steal_lock();
+    steal_pool_push_locked(task);
+    steal_unlock();
+
+    steal_spawn_runners(1);
+    steal_service_from_task();
+}
+
+void hclib::MPI_Distributed_finish(std::function<void()> lambda) {
+    const int was_active = __sync_lock_test_and_set(&steal_finish_active, 1);
+    HASSERT(!was_active);
+
+    hclib::finish([] {
+        hclib::async_at([] {
+            steal_mpi_worker = hclib::get_current_worker();
+        }, nic);
+    });
+
+    hclib::finish([&] {
+        lambda();
+        hclib::async_at([] {
+            steal_drive();
+        }, nic);
+    });
+
+    HASSERT(steal_pool_size == 0);
+    __sync_lock_release(&steal_finish_active);
+}
+
+static void remote_spawn_handler(int source, int handler, void *payload,
+        size_t nbytes) {
+    __sync_fetch_and_add(&remote_n_running, 1);
+    hclib::async([=] {
+        remote_handlers[handler](source, payload, nbytes);
+        free(payload);
+        __sync_fetch_and_add(&remote_n_completed, 1);
+        __sync_fetch_and_sub(&remote_n_running, 1);
+    });
+}
+
+// Aggregation handler for eager remote asyncs, runs on the Interconnect locale
+static void remote_deliver_eager(int source, void *msg, size_t nbytes) {
+    remote_header *header = (remote_header *)msg;
+    const size_t payload_bytes = nbytes - sizeof(remote_header);
+    void *payload = malloc(payload_bytes > 0 ? payload_bytes : 1);
+    HASSERT(payload);
+    memcpy(payload, header + 1, payload_bytes);
+    remote_spawn_handler(source, header->handler, payload, payload_bytes);
+}
+
+static void remote_receive_large() {
+    while (true) {
+        int pending;
+        MPI_Status status;
+        CHECK_MPI(::MPI_Iprobe(MPI_ANY_SOURCE, MPI_ANY_TAG, remote_comm,
+                    &pending, &status));
+        if (!pending) break;
+
+        int nbytes;
+        CHECK_MPI(::MPI_Get_count(&status, MPI_BYTE, &nbytes));
+        void *payload = malloc(nbytes);
+        HASSERT(payload);
+        CHECK_MPI(::MPI_Recv(payload, nbytes, MPI_BYTE, status.MPI_SOURCE,
+                    status.MPI_TAG, remote_comm, MPI_STATUS_IGNORE));
+        remote_spawn_handler(status.MPI_SOURCE, status.MPI_TAG, payload,
+                nbytes);
+    }
+}
+
+/*
+ * Runs on the Interconnect locale for the duration of a remote finish,
+ * flushing and delivering eager remote asyncs, receiving large ones, and
+ * taking part in termination waves while no handlers are queued or running
+ * locally.
+ */
+static void remote_drive() {
+    bool terminated = false;
+    termination_wave wave;
+    termination_wave_init(&wave);
+
+    while (!terminated) {
+        hclib::MPI_Aggregate_flush();
+        agg_progress();
+        remote_receive_large();
+
+        if (wave.req != MPI_REQUEST_NULL) {
+            terminated = termination_wave_test(&wave);
+        } else if (remote_n_running == 0) {
+            wave.local[0] = remote_n_sent;
+            wave.local[1] = remote_n_completed;
+            termination_wave_start(&wave, remote_comm);
+        }
+
+        if (!terminated) {
+            hclib::yield_at(nic);
+        }
+    }
+}
+
+int hclib::MPI_Remote_register(hclib::MPI_Remote_handler handler) {
+    const int id = __sync_fetch_and_add(&remote_n_handlers, 1);
+    HASSERT(id < MPI_REMOTE_MAX_HANDLERS);
+    remote_handlers[id] = handler;
+    return id;
+}
+
+hclib::future_t<void> *hclib::MPI_Async_remote(int rank, int handler,
+        const void *payload, size_t nbytes) {
+    HASSERT(handler >= 0 && handler < remote_n_handlers);
+    __sync_fetch_and_add(&remote_n_sent, 1);
+
+    if (nbytes <= remote_eager_limit) {
+        remote_header header;
+        header.handler = handler;
+        header.pad = 0;
+        agg_append(remote_agg_handler, &header, sizeof(header), payload,
+                nbytes, rank);
+        return NULL;
+    }
+
+    return hclib::MPI_Isend((void *)payload, nbytes, MPI_BYTE, rank, handler,
+            remote_comm);
+}
+
+void hclib::MPI_Async_remote_copy(int rank, int handler, const void *payload,
+        size_t nbytes) {
+    if (nbytes <= remote_eager_limit) {
+        hclib::MPI_Async_remote(rank, handler, payload, nbytes);
+        return;
+    }
+
+    void *copy = malloc(nbytes);
+    HASSERT(copy);
+    memcpy(copy, payload, nbytes);
+    hclib::future_t<void> *sent = hclib::MPI_Async_remote(rank, handler, copy,
+            nbytes);
+    hclib::async_await([=] {
+        free(copy);
+    }, sent);
+}
+
+void hclib::MPI_Remote_finish(std::function<void()> lambda) {
+    const int was_active = __sync_lock_test_and_set(&remote_finish_active, 1);
+    HASSERT(!was_active);
+
+    hclib::finish([&] {
+        lambda();
+        hclib::async_at([] {
+            remote_drive();
+        }, nic);
+    });
+
+    __sync_lock_release(&remote_finish_active);
+}
+
+static inline gp_entry *gp_lookup(unsigned id) {
+    gp_entry *chunk = gp_chunks[id >> MPI_GP_CHUNK_BITS];
+    HASSERT(chunk);
+    return chunk + (id & (MPI_GP_CHUNK_SIZE - 1));
+}
+
+static gp_entry *gp_ensure_chunk(unsigned chunk_index) {
+    HASSERT(chunk_index < MPI_GP_MAX_CHUNKS);
+    gp_entry *chunk = gp_chunks[chunk_index];
+    if (chunk == NULL) {
+        gp_entry *fresh = (gp_entry *)malloc(
+                MPI_GP_CHUNK_SIZE * sizeof(gp_entry));
+        HASSERT(fresh);
+        if (__sync_bool_compare_and_swap(&gp_chunks[chunk_index], NULL,
+                    fresh)) {
+            chunk = fresh;
+        } else {
+            free(fresh);
+            chunk = gp_chunks[chunk_index];
+        }
+    }
+    return chunk;
+}
+
+static void gp_init_entry(gp_entry *entry, unsigned generation) {
+    hclib_promise_init(&entry->promise);
+    entry->state = MPI_GP_STATE(generation, MPI_GP_PENDING);
+    entry->next_free = MPI_GP_NO_ID;
+}
+
+/*
+ * Puts and MPI_Global_promise_free race to clear the pending bit of the
+ * generation a put was addressed to, and only the winner retires the entry. A
+ * put that loses, to a promise abandoned while the put was in flight or to a
+ * later promise that recycled its entry, is dropped.
+ */
+static void gp_satisfy(gp_entry *entry, unsigned generation, void *datum) {
+    if (!__sync_bool_compare_and_swap(&entry->state,
+                MPI_GP_STATE(generation, MPI_GP_PENDING),
+                MPI_GP_STATE(generation, 0))) {
+        return;
+    }
+    hclib_promise_put(&entry->promise, datum);
+    __sync_fetch_and_sub(&gp_n_pending, 1);
+}
+
+// Aggregation handler for remote puts, runs on the Interconnect locale
+static void gp_deliver(int source, void *msg, size_t nbytes) {
+    HASSERT(nbytes == sizeof(gp_put_msg));
+    gp_put_msg *put = (gp_put_msg *)msg;
+    gp_satisfy(gp_lookup(put->id), put->generation, put->datum);
+}
+
+hclib::MPI_Global_promise hclib::MPI_Global_promise_create() {
+    unsigned id = MPI_GP_NO_ID;
+    if (gp_free_head != MPI_GP_NO_ID) {
+        while (__sync_lock_test_and_set(&gp_free_lock, 1)) ;
+        id = gp_free_head;
+        if (id != MPI_GP_NO_ID) {
+            gp_free_head = gp_lookup(id)->next_free;
+        }
+        __sync_lock_release(&gp_free_lock);
+    }
+
+    if (id == MPI_GP_NO_ID) {
+        return hclib::MPI_Global_promise_create_n(1);
+    }
+
+    // The free that recycled this entry already bumped its generation
+    gp_entry *entry = gp_lookup(id);
+    const unsigned generation = MPI_GP_GENERATION(entry->state);
+    gp_init_entry(entry, generation);
+    __sync_fetch_and_add(&gp_n_pending, 1);
+    agg_start_poller();
+
+    hclib::MPI_Global_promise promise;
+    promise.rank = gp_rank;
+    promise.id = id;
+    promise.generation = generation;
+    return promise;
+}
+
+hclib::MPI_Global_promise hclib::MPI_Global_promise_create_n(unsigned n) {
+    HASSERT(n > 0);
+    const unsigned first = __sync_fetch_and_add(&gp_next_id, n);
+    HASSERT(first + n > first);
+
+    unsigned id = first;
+    while (id != first + n) {
+        gp_entry *chunk = gp_ensure_chunk(id >> MPI_GP_CHUNK_BITS);
+        const unsigned chunk_end = std::min(first + n,
+                ((id >> MPI_GP_CHUNK_BITS) + 1) << MPI_GP_CHUNK_BITS);
+        for (; id != chunk_end; id++) {
+            gp_init_entry(chunk + (id & (MPI_GP_CHUNK_SIZE - 1)), 0);
+        }
+    }
+    __sync_fetch_and_add(&gp_n_pending, n);
+    agg_start_poller();
+
+    hclib::MPI_Global_promise promise;
+    promise.rank = gp_rank;
+    promise.id = first;
+    promise.generation = 0;
+    return promise;
+}
+
+hclib::future_t<void *> *hclib::MPI_Global_promise_future(
+        hclib::MPI_Global_promise promise) {
+    HASSERT(promise.rank == gp_rank);
+    gp_entry *entry = gp_lookup(promise.id);
+    HASSERT(MPI_GP_GENERATION(entry->state) == promise.generation);
+    return (hclib::future_t<void *> *)hclib_get_future_for_promise(
+            &entry->promise);
+}
+
+void hclib::MPI_Global_promise_put(hclib::MPI_Global_promise promise,
+        void *datum) {
+    if (promise.rank == gp_rank) {
+        gp_satisfy(gp_lookup(promise.id), promise.generation, datum);
+        return;
+    }
+
+    gp_put_msg put;
+    put.id = promise.id;
+    put.generation = promise.generation;
+    put.datum = datum;
+    agg_append(gp_agg_handler, NULL, 0, &put, sizeof(put), promise.rank);
+}
+
+void hclib::MPI_Global_promise_free(hclib::MPI_Global_promise promise) {
+    HASSERT(promise.rank == gp_rank);
+    gp_entry *entry = gp_lookup(promise.id);
+    HASSERT(MPI_GP_GENERATION(entry->state) == promise.generation);
+    const unsigned next = MPI_GP_STATE(promise.generation + 1, 0);
+    if (__sync_bool_compare_and_swap(&entry->state,
+                MPI_GP_STATE(promise.generation, MPI_GP_PENDING), next)) {
+        __sync_fetch_and_sub(&gp_n_pending, 1);
+    } else {
+        // Already satisfied, so no put can race with bumping the generation
+        entry->state = next;
+    }
+
+    while (__sync_lock_test_and_set(&gp_free_lock, 1)) ;
+    entry->next_free = gp_free_head;
+    gp_free_head = promise.id;
+    __sync_lock_release(&gp_free_lock);
+}
+
 HCLIB_REGISTER_MODULE("mpi", mpi_pre_initialize, mpi_post_initialize, mpi_finalize)
@@ -0,0 +1,146 @@
+/*
+ * GUPS-style random access benchmark over the MPI aggregation layer. Each rank
+ * owns 2^log_local_size words of a global table and generates four updates per
+ * local word from the HPCC RandomAccess stream. Every update is an 8-byte
+ * message routed to the owning rank, where a handler XORs it into the table.
+ * Running the same stream a second time should restore the table.
+ *
+ * Run as e.g. mpirun -np 4 ./aggregate_gups [log_local_size]. Setting
+ * HCLIB_MPI_AGG_BUFFER_SIZE=16 leaves room for a single update per MPI message
+ * and so measures the unaggregated cost of the same traffic.
+ */
+#include "hclib_cpp.h"
+#include "hclib_mpi.h"
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define POLY 0x0000000000000007ULL
+#define PERIOD 1317624576693539401LL
+
+static uint64_t *table = NULL;
+static int log_local_size = 20;
+static uint64_t local_size;
+static int update_handler;
+
+static uint64_t starts(int64_t n) {
+    int i, j;
+    uint64_t m2[64];
+    uint64_t temp, ran;
+
+    while (n < 0) n += PERIOD;
+    while (n > PERIOD) n -= PERIOD;
+    if (n == 0) return 0x1;
+
+    temp = 0x1;
+    for (i = 0; i < 64; i++) {
+        m2[i] = temp;
+        temp = (temp << 1) ^ ((int64_t)temp < 0 ? POLY : 0);
+        temp = (temp << 1) ^ ((int64_t)temp < 0 ? POLY : 0);
+    }
+
+    for (i = 62; i >= 0; i--) {
+        if ((n >> i) & 1) break;
+    }
+
+    ran = 0x2;
+    while (i > 0) {
+        temp = 0;
+        for (j = 0; j < 64; j++) {
+            if ((ran >> j) & 1) temp ^= m2[j];
+        }
+        ran = temp;
+        i -= 1;
+        if ((n >> i) & 1) {
+            ran = (ran << 1) ^ ((int64_t)ran < 0 ? POLY : 0);
+        }
+    }
+    return ran;
+}
+
+static void apply_update(int source, void *msg, size_t nbytes) {
+    assert(nbytes == sizeof(uint64_t));
+    const uint64_t ran = *((uint64_t *)msg);
+    table[ran & (local_size - 1)] ^= ran;
+}
+
+/*
+ * Spread this rank's update stream across one task per worker, each starting
+ * from its own offset in the random sequence.
+ */
+static void run_updates(int rank, int nranks, uint64_t nupdates) {
+    const int ntasks = hclib::get_num_workers();
+    const uint64_t per_task = (nupdates + ntasks - 1) / ntasks;
+    const uint64_t global_mask = local_size * nranks - 1;
+
+    hclib::finish([=] {
+        for (int t = 0; t < ntasks; t++) {
+            hclib::async([=] {
+                const uint64_t start = t * per_task;
+                const uint64_t end = (start + per_task > nupdates ? nupdates :
+                        start + per_task);
+                uint64_t ran = starts(rank * nupdates + start);
+                for (uint64_t i = start; i < end; i++) {
+                    ran = (ran << 1) ^ ((int64_t)ran < 0 ? POLY : 0);
+                    const int dest = (int)((ran & global_mask) >>
+                            log_local_size);
+                    hclib::MPI_Aggregate_send(update_handler, &ran,
+                            sizeof(ran), dest);
+                }
+            });
+        }
+    });
+    hclib::MPI_Aggregate_quiesce();
+}
+
+int main(int argc, char **argv) {
+    if (argc > 1) {
+        log_local_size = atoi(argv[1]);
+    }
+    local_size = 1ULL << log_local_size;
+
+    const char *deps[] = { "system" };
+    hclib::launch(deps, 1, [] () {
+        int rank, nranks;
+        hclib::MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+        hclib::MPI_Comm_size(MPI_COMM_WORLD, &nranks);
+        assert((nranks & (nranks - 1)) == 0);
+
+        table = (uint64_t *)malloc(local_size * sizeof(uint64_t));
+        assert(table);
+        for (uint64_t i = 0; i < local_size; i++) {
+            table[i] = rank * local_size + i;
+        }
+
+        update_handler = hclib::MPI_Aggregate_register(apply_update);
+        const uint64_t nupdates = 4 * local_size;
+
+        hclib::MPI_Barrier(MPI_COMM_WORLD);
+        const double start_time = hclib::MPI_Wtime();
+        run_updates(rank, nranks, nupdates);
+        hclib::MPI_Barrier(MPI_COMM_WORLD);
+        const double elapsed = hclib::MPI_Wtime() - start_time;
+
+        // Replaying the stream XORs every update out again
+        run_updates(rank, nranks, nupdates);
+
+        long long local_errors = 0, errors;
+        for (uint64_t i = 0; i < local_size; i++) {
+            if (table[i] != rank * local_size + i) local_errors++;
+        }
+        hclib::MPI_Allreduce(&local_errors, &errors, 1, MPI_LONG_LONG,
+                MPI_SUM, MPI_COMM_WORLD);
+
+        if (rank == 0) {
+            const double total_updates = (double)nupdates * nranks;
+            printf("%d ranks, %llu updates/rank, %.3f s, %.6f GUPS, %lld "
+                    "errors\n", nranks, (unsigned long long)nupdates, elapsed,
+                    total_updates / elapsed * 1e-9, errors);
+        }
+        assert(errors == 0);
+        free(table);
+    });
+    return 0;
+}
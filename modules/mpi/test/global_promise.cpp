@@ -0,0 +1,158 @@
+/*
+ * Exercises global promises. Every rank creates a large batch of global
+ * promises and its left neighbour puts a value to each of them, which this
+ * rank then checks by waiting on their futures. A token is then relayed
+ * around the ring a few times, each hop being a task awaiting a global promise
+ * that puts to the next rank's promise once it runs. Finally, each rank
+ * frees a promise and recycles its id before its left neighbour puts to both
+ * the stale and the new handle, checking that the stale put is dropped.
+ *
+ * Run as e.g. mpirun -np 4 ./global_promise [promises_per_rank] [laps]
+ */
+#include "hclib_cpp.h"
+#include "hclib_mpi.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+static volatile long long final_token = -1;
+
+int main(int argc, char **argv) {
+    unsigned promises_per_rank = 1 << 20;
+    int laps = 100;
+    if (argc > 1) promises_per_rank = atoi(argv[1]);
+    if (argc > 2) laps = atoi(argv[2]);
+
+    const char *deps[] = { "system" };
+    hclib::launch(deps, 1, [=] () {
+        int rank, nranks;
+        hclib::MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+        hclib::MPI_Comm_size(MPI_COMM_WORLD, &nranks);
+        const int right = (rank + 1) % nranks;
+
+        // Bulk: the ids of each batch are exchanged as a single base
+        hclib::MPI_Global_promise first =
+            hclib::MPI_Global_promise_create_n(promises_per_rank);
+        hclib::MPI_Global_promise *firsts = (hclib::MPI_Global_promise *)
+            malloc(nranks * sizeof(hclib::MPI_Global_promise));
+        assert(firsts);
+        hclib::MPI_Allgather(&first, sizeof(first), MPI_BYTE, firsts,
+                sizeof(first), MPI_BYTE, MPI_COMM_WORLD);
+
+        double start_time = hclib::MPI_Wtime();
+        for (unsigned i = 0; i < promises_per_rank; i++) {
+            hclib::MPI_Global_promise target = firsts[right];
+            target.id += i;
+            hclib::mpi::global_promise_put(target,
+                    (long long)i * nranks + rank);
+        }
+        hclib::MPI_Aggregate_flush();
+
+        const int left = (rank + nranks - 1) % nranks;
+        long long errors = 0;
+        for (unsigned i = 0; i < promises_per_rank; i++) {
+            hclib::MPI_Global_promise local = first;
+            local.id += i;
+            hclib::future_t<long long> *fut =
+                hclib::mpi::global_promise_future<long long>(local);
+            if (fut->wait() != (long long)i * nranks + left) errors++;
+            hclib::MPI_Global_promise_free(local);
+        }
+        const double bulk_elapsed = hclib::MPI_Wtime() - start_time;
+        // Our own puts may still be buffered ahead of the collectives below
+        hclib::MPI_Aggregate_quiesce();
+
+        /*
+         * Relay: the token starts at rank 0 and lap l passes it through
+         * hops[l] on every rank, rank 0 starting the next lap.
+         */
+        hclib::MPI_Global_promise *hops = (hclib::MPI_Global_promise *)malloc(
+                laps * sizeof(hclib::MPI_Global_promise));
+        hclib::MPI_Global_promise *all_hops =
+            (hclib::MPI_Global_promise *)malloc(
+                    nranks * laps * sizeof(hclib::MPI_Global_promise));
+        assert(hops && all_hops);
+        for (int l = 0; l < laps; l++) {
+            hops[l] = hclib::MPI_Global_promise_create();
+        }
+        hclib::MPI_Allgather(hops, laps * sizeof(*hops), MPI_BYTE, all_hops,
+                laps * sizeof(*hops), MPI_BYTE, MPI_COMM_WORLD);
+        hclib::MPI_Global_promise *right_hops = all_hops + right * laps;
+
+        start_time = hclib::MPI_Wtime();
+        hclib::finish([&] {
+            for (int l = 0; l < laps; l++) {
+                hclib::async_await([=] {
+                    const long long token = hclib::mpi::global_promise_future<
+                        long long>(hops[l])->get();
+                    if (rank != 0) {
+                        hclib::mpi::global_promise_put(right_hops[l],
+                                token + 1);
+                    } else if (l + 1 < laps) {
+                        hclib::mpi::global_promise_put(right_hops[l + 1],
+                                token + 1);
+                    } else {
+                        final_token = token;
+                    }
+                }, hclib::mpi::global_promise_future<long long>(hops[l]));
+            }
+
+            if (rank == 0) {
+                hclib::mpi::global_promise_put(right_hops[0], 1LL);
+            }
+        });
+        const double relay_elapsed = hclib::MPI_Wtime() - start_time;
+        hclib::MPI_Aggregate_quiesce();
+
+        for (int l = 0; l < laps; l++) {
+            hclib::MPI_Global_promise_free(hops[l]);
+        }
+
+        // Recycling: the free list hands the stale id straight back
+        hclib::MPI_Global_promise stale = hclib::MPI_Global_promise_create();
+        hclib::MPI_Allgather(&stale, sizeof(stale), MPI_BYTE, firsts,
+                sizeof(stale), MPI_BYTE, MPI_COMM_WORLD);
+        const hclib::MPI_Global_promise right_stale = firsts[right];
+        hclib::MPI_Global_promise_free(stale);
+        // A finish that only creates a promise must not wait for its put
+        hclib::MPI_Global_promise recycled;
+        hclib::finish([&] {
+            recycled = hclib::MPI_Global_promise_create();
+        });
+        assert(recycled.id == stale.id &&
+                recycled.generation != stale.generation);
+        hclib::MPI_Allgather(&recycled, sizeof(recycled), MPI_BYTE, firsts,
+                sizeof(recycled), MPI_BYTE, MPI_COMM_WORLD);
+
+        hclib::mpi::global_promise_put(right_stale, -1LL);
+        hclib::mpi::global_promise_put(firsts[right], (long long)rank);
+        hclib::MPI_Aggregate_flush();
+        if (hclib::mpi::global_promise_future<long long>(recycled)->wait() !=
+                (long long)left) {
+            errors++;
+        }
+        hclib::MPI_Global_promise_free(recycled);
+        hclib::MPI_Aggregate_quiesce();
+
+        long long all_errors;
+        hclib::MPI_Allreduce(&errors, &all_errors, 1, MPI_LONG_LONG, MPI_SUM,
+                MPI_COMM_WORLD);
+        const bool ok = (all_errors == 0 &&
+                (rank != 0 || final_token == (long long)laps * nranks));
+
+        if (rank == 0) {
+            printf("%d ranks, %u remote puts per rank in %f s, %d relay laps "
+                    "in %f s (%f us per hop)\n", nranks, promises_per_rank,
+                    bulk_elapsed, laps, relay_elapsed,
+                    relay_elapsed * 1e6 / ((double)laps * nranks));
+            printf("Check results: %s\n", ok ? "OK" : "FAILED");
+        }
+        assert(ok);
+
+        free(all_hops);
+        free(hops);
+        free(firsts);
+    });
+    return 0;
+}
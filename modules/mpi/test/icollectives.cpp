@@ -0,0 +1,65 @@
+#include "hclib_cpp.h"
+#include "hclib_mpi.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <iostream>
+
+/*
+ * Starts every non-blocking collective back to back, interleaved with a
+ * blocking one, and checks the results once all futures are satisfied.
+ */
+int main(int argc, char **argv) {
+    const char *deps[] = { "system" };
+    hclib::launch(deps, 1, [] () {
+        int rank, nranks;
+        hclib::MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+        hclib::MPI_Comm_size(MPI_COMM_WORLD, &nranks);
+
+        int sum = 0, max = 0, bcast = (rank == 0 ? 42 : -1);
+        int *gathered = (int *)malloc(nranks * sizeof(int));
+        assert(gathered);
+
+        hclib::future_t<void> *futs[5];
+        futs[0] = hclib::MPI_Iallreduce(&rank, &sum, 1, MPI_INT, MPI_SUM,
+                MPI_COMM_WORLD);
+        futs[1] = hclib::MPI_Ibcast(&bcast, 1, MPI_INT, 0, MPI_COMM_WORLD);
+        futs[2] = hclib::MPI_Iallgather(&rank, 1, MPI_INT, gathered, 1,
+                MPI_INT, MPI_COMM_WORLD);
+        hclib::MPI_Barrier(MPI_COMM_WORLD);
+        futs[3] = hclib::MPI_Ireduce(&rank, &max, 1, MPI_INT, MPI_MAX, 0,
+                MPI_COMM_WORLD);
+        futs[4] = hclib::MPI_Ibarrier(MPI_COMM_WORLD);
+        hclib::MPI_Waitall(5, futs);
+
+        assert(sum == nranks * (nranks - 1) / 2);
+        assert(bcast == 42);
+        for (int i = 0; i < nranks; i++) {
+            assert(gathered[i] == i);
+        }
+        if (rank == 0) {
+            assert(max == nranks - 1);
+            std::cout << "Check results: OK" << std::endl;
+        }
+        free(gathered);
+
+        /*
+         * Collectives on different communicators are ordered independently,
+         * and each communicator's ordering state goes away with it.
+         */
+        for (int i = 0; i < 4; i++) {
+            MPI_Comm comm;
+            hclib::MPI_Comm_dup(MPI_COMM_WORLD, &comm);
+            int comm_sum = 0;
+            hclib::future_t<void> *comm_futs[2];
+            comm_futs[0] = hclib::MPI_Iallreduce(&rank, &comm_sum, 1, MPI_INT,
+                    MPI_SUM, comm);
+            comm_futs[1] = hclib::MPI_Ibarrier(MPI_COMM_WORLD);
+            hclib::MPI_Waitall(2, comm_futs);
+            hclib::MPI_Barrier(comm);
+            assert(comm_sum == nranks * (nranks - 1) / 2);
+            hclib::MPI_Comm_free(&comm);
+        }
+    });
+    return 0;
+}
@@ -0,0 +1,58 @@
+#include "hclib_cpp.h"
+#include "hclib_mpi.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <iostream>
+
+/*
+ * Keeps many non-blocking requests in flight at once between pairs of ranks,
+ * exercising bulk completion of the pending request table. All messages share
+ * a tag so MPI's matching cost does not dominate, which means they may arrive
+ * in any order.
+ */
+int main(int argc, char **argv) {
+    const int nmsgs = (argc > 1 ? atoi(argv[1]) : 4096);
+
+    const char *deps[] = { "system" };
+    hclib::launch(deps, 1, [nmsgs] () {
+        int mpi_rank, nranks;
+        hclib::MPI_Comm_rank(MPI_COMM_WORLD, &mpi_rank);
+        hclib::MPI_Comm_size(MPI_COMM_WORLD, &nranks);
+        assert(nranks % 2 == 0);
+
+        const int partner = (mpi_rank % 2 == 0 ? mpi_rank + 1 : mpi_rank - 1);
+        int *send_data = (int *)malloc(nmsgs * sizeof(int));
+        int *recv_data = (int *)malloc(nmsgs * sizeof(int));
+        hclib::future_t<void> **futs = (hclib::future_t<void> **)malloc(
+                2 * nmsgs * sizeof(hclib::future_t<void> *));
+        assert(send_data && recv_data && futs);
+
+        const double start_time = hclib::MPI_Wtime();
+        for (int i = 0; i < nmsgs; i++) {
+            send_data[i] = mpi_rank * nmsgs + i;
+            futs[2 * i] = hclib::MPI_Irecv(recv_data + i, 1, MPI_INT, partner,
+                    0, MPI_COMM_WORLD);
+            futs[2 * i + 1] = hclib::MPI_Isend(send_data + i, 1, MPI_INT,
+                    partner, 0, MPI_COMM_WORLD);
+        }
+        hclib::MPI_Waitall(2 * nmsgs, futs);
+        const double elapsed = hclib::MPI_Wtime() - start_time;
+
+        std::sort(recv_data, recv_data + nmsgs);
+        for (int i = 0; i < nmsgs; i++) {
+            assert(recv_data[i] == partner * nmsgs + i);
+        }
+
+        if (mpi_rank == 0) {
+            std::cout << nmsgs << " messages each way in " << elapsed <<
+                " s" << std::endl;
+        }
+
+        free(send_data);
+        free(recv_data);
+        free(futs);
+    });
+    return 0;
+}
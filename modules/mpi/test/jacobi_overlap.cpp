@@ -0,0 +1,115 @@
+#include "hclib_cpp.h"
+#include "hclib_mpi.h"
+
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <iostream>
+
+/*
+ * Jacobi iteration for a 1D Poisson problem distributed across ranks, with a
+ * global residual norm computed every iteration. In the blocking variant each
+ * iteration waits on MPI_Allreduce before continuing. In the overlapped
+ * variant the residual allreduce is started with MPI_Iallreduce and the next
+ * sweep runs while it is in flight, so the convergence test lags by one
+ * iteration. Both variants run the same number of sweeps and must agree on
+ * the final residual.
+ *
+ * Usage: jacobi_overlap [points per rank] [iterations]
+ */
+
+static int n_local;
+static int rank, nranks;
+
+static void exchange_halos(double *u) {
+    hclib::future_t<void> *futs[4];
+    int nfuts = 0;
+    if (rank > 0) {
+        futs[nfuts++] = hclib::MPI_Irecv(u, 1, MPI_DOUBLE, rank - 1, 0,
+                MPI_COMM_WORLD);
+        futs[nfuts++] = hclib::MPI_Isend(u + 1, 1, MPI_DOUBLE, rank - 1, 1,
+                MPI_COMM_WORLD);
+    }
+    if (rank < nranks - 1) {
+        futs[nfuts++] = hclib::MPI_Irecv(u + n_local + 1, 1, MPI_DOUBLE,
+                rank + 1, 1, MPI_COMM_WORLD);
+        futs[nfuts++] = hclib::MPI_Isend(u + n_local, 1, MPI_DOUBLE,
+                rank + 1, 0, MPI_COMM_WORLD);
+    }
+    hclib::MPI_Waitall(nfuts, futs);
+}
+
+// One Jacobi sweep from u into unew, returning the local squared update norm
+static double sweep(const double *u, double *unew, double h2) {
+    double local = 0.0;
+    for (int i = 1; i <= n_local; i++) {
+        unew[i] = 0.5 * (u[i - 1] + u[i + 1] + h2);
+        const double diff = unew[i] - u[i];
+        local += diff * diff;
+    }
+    return local;
+}
+
+static double solve(bool overlap, int iters, double *elapsed) {
+    double *u = (double *)calloc(n_local + 2, sizeof(double));
+    double *unew = (double *)calloc(n_local + 2, sizeof(double));
+    assert(u && unew);
+    const double h = 1.0 / ((double)n_local * nranks + 1);
+    const double h2 = h * h;
+
+    double local_res[2], global_res[2];
+    hclib::future_t<void> *res_fut = NULL;
+
+    hclib::MPI_Barrier(MPI_COMM_WORLD);
+    const double start_time = hclib::MPI_Wtime();
+    for (int iter = 0; iter < iters; iter++) {
+        exchange_halos(u);
+        const int slot = iter % 2;
+        local_res[slot] = sweep(u, unew, h2);
+
+        if (overlap) {
+            // Retire the previous iteration's residual before reusing buffers
+            if (res_fut) res_fut->wait();
+            res_fut = hclib::MPI_Iallreduce(&local_res[slot],
+                    &global_res[slot], 1, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+        } else {
+            hclib::MPI_Allreduce(&local_res[slot], &global_res[slot], 1,
+                    MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+        }
+
+        double *tmp = u; u = unew; unew = tmp;
+    }
+    if (res_fut) res_fut->wait();
+    *elapsed = hclib::MPI_Wtime() - start_time;
+
+    free(u);
+    free(unew);
+    return sqrt(global_res[(iters - 1) % 2]);
+}
+
+int main(int argc, char **argv) {
+    n_local = (argc > 1 ? atoi(argv[1]) : 1 << 16);
+    const int iters = (argc > 2 ? atoi(argv[2]) : 500);
+
+    const char *deps[] = { "system" };
+    hclib::launch(deps, 1, [iters] () {
+        hclib::MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+        hclib::MPI_Comm_size(MPI_COMM_WORLD, &nranks);
+
+        double blocking_time, overlap_time;
+        const double blocking_res = solve(false, iters, &blocking_time);
+        const double overlap_res = solve(true, iters, &overlap_time);
+        assert(blocking_res == overlap_res);
+
+        if (rank == 0) {
+            std::cout << nranks << " ranks, " << n_local << " points/rank, " <<
+                iters << " iterations, residual " << overlap_res << std::endl;
+            std::cout << "  blocking allreduce:   " << blocking_time << " s" <<
+                std::endl;
+            std::cout << "  overlapped allreduce: " << overlap_time << " s" <<
+                std::endl;
+        }
+    });
+    return 0;
+}
@@ -0,0 +1,72 @@
+#include "hclib_cpp.h"
+#include "hclib_mpi.h"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <iostream>
+
+/*
+ * Small-message rate between pairs of ranks. Each even rank streams windows of
+ * 8-byte messages to the next odd rank, spread over ntags tags so that with
+ * HCLIB_MPI_THREAD_MULTIPLE=1 and several Interconnect locales the traffic is
+ * divided across them. For example:
+ *
+ *   HCLIB_MPI_THREAD_MULTIPLE=1 \
+ *   HCLIB_LOCALITY_FILE=locality_graphs/macbook.8cores.two_interconnects.json \
+ *   mpirun -np 4 ./message_rate [window] [iters] [ntags]
+ */
+int main(int argc, char **argv) {
+    const int window = (argc > 1 ? atoi(argv[1]) : 256);
+    const int iters = (argc > 2 ? atoi(argv[2]) : 100);
+    const int ntags = (argc > 3 ? atoi(argv[3]) : 16);
+
+    const char *deps[] = { "system" };
+    hclib::launch(deps, 1, [window, iters, ntags] () {
+        int mpi_rank, nranks;
+        hclib::MPI_Comm_rank(MPI_COMM_WORLD, &mpi_rank);
+        hclib::MPI_Comm_size(MPI_COMM_WORLD, &nranks);
+        assert(nranks % 2 == 0);
+
+        const bool sender = (mpi_rank % 2 == 0);
+        const int partner = (sender ? mpi_rank + 1 : mpi_rank - 1);
+        long *data = (long *)malloc(window * sizeof(long));
+        hclib::future_t<void> **futs = (hclib::future_t<void> **)malloc(
+                window * sizeof(hclib::future_t<void> *));
+        assert(data && futs);
+
+        hclib::MPI_Barrier(MPI_COMM_WORLD);
+        const double start_time = hclib::MPI_Wtime();
+        for (int iter = 0; iter < iters; iter++) {
+            for (int i = 0; i < window; i++) {
+                if (sender) {
+                    data[i] = (long)iter * window + i;
+                    futs[i] = hclib::MPI_Isend(data + i, 1, MPI_LONG, partner,
+                            i % ntags, MPI_COMM_WORLD);
+                } else {
+                    futs[i] = hclib::MPI_Irecv(data + i, 1, MPI_LONG, partner,
+                            i % ntags, MPI_COMM_WORLD);
+                }
+            }
+            hclib::MPI_Waitall(window, futs);
+
+            if (!sender) {
+                for (int i = 0; i < window; i++) {
+                    assert(data[i] % window % ntags == i % ntags);
+                }
+            }
+        }
+        hclib::MPI_Barrier(MPI_COMM_WORLD);
+        const double elapsed = hclib::MPI_Wtime() - start_time;
+
+        if (mpi_rank == 0) {
+            const double nmsgs = (double)(nranks / 2) * window * iters;
+            std::cout << nranks / 2 << " pairs, " << window <<
+                " messages per window, " << iters << " iterations: " <<
+                nmsgs / elapsed << " messages/s" << std::endl;
+        }
+
+        free(data);
+        free(futs);
+    });
+    return 0;
+}
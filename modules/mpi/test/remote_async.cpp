@@ -0,0 +1,123 @@
+/*
+ * Exercises remote asyncs. Every rank sends small messages to every rank
+ * (itself included), each of which is forwarded around the ring a few times
+ * by its handler, and a handful of large messages to its right neighbour,
+ * which take the zero-copy path. After the remote finish every handler must
+ * have run.
+ *
+ * Run as e.g. mpirun -np 4 ./remote_async [msgs_per_rank] [hops]
+ */
+#include "hclib_cpp.h"
+#include "hclib_mpi.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define N_LARGE 8
+#define LARGE_ELEMENTS (16 * 1024)
+
+typedef struct _hop_msg {
+    int origin;
+    int hops_left;
+    long long value;
+} hop_msg;
+
+static int rank, nranks;
+static int hop_handler, large_handler;
+static volatile long long hops_run = 0;
+static volatile long long hop_value_sum = 0;
+static volatile long long large_run = 0;
+static volatile long long large_errors = 0;
+
+static void run_hop(int source, void *payload, size_t nbytes) {
+    assert(nbytes == sizeof(hop_msg));
+    hop_msg *msg = (hop_msg *)payload;
+    __sync_fetch_and_add(&hops_run, 1);
+    __sync_fetch_and_add(&hop_value_sum, msg->value);
+
+    if (msg->hops_left > 0) {
+        hop_msg next = *msg;
+        next.hops_left--;
+        hclib::mpi::async_remote((rank + 1) % nranks, hop_handler, next);
+    }
+}
+
+static void run_large(int source, void *payload, size_t nbytes) {
+    assert(nbytes == LARGE_ELEMENTS * sizeof(long long));
+    long long *data = (long long *)payload;
+    for (int i = 0; i < LARGE_ELEMENTS; i++) {
+        if (data[i] != (long long)source * LARGE_ELEMENTS + i) {
+            __sync_fetch_and_add(&large_errors, 1);
+        }
+    }
+    __sync_fetch_and_add(&large_run, 1);
+}
+
+int main(int argc, char **argv) {
+    int msgs_per_rank = 1000;
+    int hops = 3;
+    if (argc > 1) msgs_per_rank = atoi(argv[1]);
+    if (argc > 2) hops = atoi(argv[2]);
+
+    const char *deps[] = { "system" };
+    hclib::launch(deps, 1, [=] () {
+        hclib::MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+        hclib::MPI_Comm_size(MPI_COMM_WORLD, &nranks);
+
+        hop_handler = hclib::MPI_Remote_register(run_hop);
+        large_handler = hclib::MPI_Remote_register(run_large);
+
+        long long *large = (long long *)malloc(
+                LARGE_ELEMENTS * sizeof(long long));
+        assert(large);
+        for (int i = 0; i < LARGE_ELEMENTS; i++) {
+            large[i] = (long long)rank * LARGE_ELEMENTS + i;
+        }
+
+        hclib::MPI_Barrier(MPI_COMM_WORLD);
+        const double start_time = hclib::MPI_Wtime();
+
+        hclib::mpi::remote_finish([=] {
+            for (int dest = 0; dest < nranks; dest++) {
+                for (int i = 0; i < msgs_per_rank; i++) {
+                    hop_msg msg;
+                    msg.origin = rank;
+                    msg.hops_left = hops;
+                    msg.value = i;
+                    hclib::mpi::async_remote(dest, hop_handler, msg);
+                }
+            }
+            for (int i = 0; i < N_LARGE; i++) {
+                hclib::future_t<void> *sent = hclib::mpi::async_remote(
+                        (rank + 1) % nranks, large_handler, large,
+                        LARGE_ELEMENTS * sizeof(long long));
+                assert(sent);
+            }
+        });
+
+        const double elapsed = hclib::MPI_Wtime() - start_time;
+
+        long long local[3] = { hops_run, hop_value_sum, large_run };
+        long long global[3];
+        hclib::MPI_Allreduce(local, global, 3, MPI_LONG_LONG, MPI_SUM,
+                MPI_COMM_WORLD);
+
+        const long long sends = (long long)nranks * nranks * msgs_per_rank;
+        const long long expected_hops = sends * (hops + 1);
+        const long long expected_sum = (long long)nranks * nranks * (hops + 1) *
+            ((long long)msgs_per_rank * (msgs_per_rank - 1) / 2);
+        const bool ok = (global[0] == expected_hops &&
+                global[1] == expected_sum && large_errors == 0 &&
+                global[2] == (long long)nranks * N_LARGE);
+
+        if (rank == 0) {
+            printf("%d ranks, %lld handlers run in %f s\n", nranks,
+                    global[0] + global[2], elapsed);
+            printf("Check results: %s\n", ok ? "OK" : "FAILED");
+        }
+        assert(ok);
+        free(large);
+    });
+    return 0;
+}
@@ -33,6 +33,26 @@ int main(int argc, char **argv) {
                 mpi_rank - 1, 0, MPI_COMM_WORLD, &status);
             assert(data == mpi_rank - 1);
         }
+
+        /*
+         * Freed communicators must drop their per-channel duplicates, even if
+         * MPI hands the same handle out again.
+         */
+        for (int i = 0; i < 8; i++) {
+            MPI_Comm comm;
+            hclib::MPI_Comm_dup(MPI_COMM_WORLD, &comm);
+            data = (mpi_rank % 2 == 0 ? mpi_rank + i : -1);
+            if (mpi_rank % 2 == 0) {
+                hclib::MPI_Send(&data, 1, MPI_INT, mpi_rank + 1, i, comm);
+            } else {
+                MPI_Status status;
+                hclib::MPI_Recv(&data, 1, MPI_INT, mpi_rank - 1, i, comm,
+                        &status);
+                assert(data == mpi_rank - 1 + i);
+            }
+            hclib::MPI_Comm_free(&comm);
+            assert(comm == MPI_COMM_NULL);
+        }
     });
     return 0;
 }
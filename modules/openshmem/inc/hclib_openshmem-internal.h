@@ -13,11 +13,15 @@
 namespace hclib {
 
 enum wait_type {
-    integer
+    integer,
+    long_integer,
+    long_long_integer
 };
 
 typedef union _wait_cmp_value_t {
     int i;
+    long l;
+    long long ll;
 } wait_cmp_value_t;
 
 typedef struct _wait_info_t {
@@ -32,6 +36,8 @@ typedef struct _wait_set_t {
     int ninfos;
     hclib_promise_t *signal;
     hclib_task_t *task;
+    // Set by the wait engine once any of the infos is satisfied
+    int satisfied;
 
     struct _wait_set_t *next;
 } wait_set_t;
@@ -45,6 +51,13 @@ int shmem_n_pes();
 void *shmem_malloc(size_t size);
 void shmem_free(void *ptr);
 void shmem_barrier_all();
+/*
+ * When workers issue RMA and atomics on their own contexts (see
+ * hclib_openshmem.cpp), shmem_quiet completes operations on every worker's
+ * context as well as the default one, and shmem_fence fences the caller's
+ * context after quieting all the others, since a task may have issued earlier
+ * operations from another worker.
+ */
 void shmem_fence();
 void shmem_quiet();
 void shmem_put64(void *dest, const void *source, size_t nelems, int pe);
@@ -97,9 +110,21 @@ void shmem_collect32(void *dest, const void *source, size_t nelems,
 void shmem_fcollect64(void *dest, const void *source, size_t nelems,
         int PE_start, int logPE_stride, int PE_size, long *pSync);
 
+/*
+ * All SHMEM_CMP_* comparisons are supported for int, long and long long
+ * variables. Waiting on many variables at once is cheapest when they are laid
+ * out contiguously (e.g. elements of a flag array) and share a comparison.
+ */
 void shmem_int_wait_until(volatile int *ivar, int cmp, int cmp_value);
 void shmem_int_wait_until_any(volatile int **ivars, int cmp,
         int *cmp_values, int nwaits);
+void shmem_long_wait_until(volatile long *ivar, int cmp, long cmp_value);
+void shmem_long_wait_until_any(volatile long **ivars, int cmp,
+        long *cmp_values, int nwaits);
+void shmem_longlong_wait_until(volatile long long *ivar, int cmp,
+        long long cmp_value);
+void shmem_longlong_wait_until_any(volatile long long **ivars, int cmp,
+        long long *cmp_values, int nwaits);
 
 void reset_oshmem_profiling_data();
 void print_oshmem_profiling_data();
@@ -132,39 +157,48 @@ void disable_oshmem_profiling();
 
 void enqueue_wait_set(wait_set_t *wait_set);
 
-template <typename T>
-void shmem_int_async_when(volatile int *ivar, int cmp,
-        int cmp_value, T&& lambda) {
-    typedef typename std::remove_reference<T>::type U;
-    hclib_task_t *task = _allocate_async(new U(lambda));
-
-    hclib_promise_t *promise = construct_and_insert_wait_set(&ivar, cmp,
-            &cmp_value, 1, integer, i, task);
-    HASSERT(promise == NULL);
-}
-
-template <typename T>
-void shmem_int_async_nb_when(volatile int *ivar, int cmp,
-        int cmp_value, T&& lambda) {
-    typedef typename std::remove_reference<T>::type U;
-    hclib_task_t *task = _allocate_async(new U(lambda));
-    task->non_blocking = 1;
-
-    hclib_promise_t *promise = construct_and_insert_wait_set(&ivar, cmp,
-            &cmp_value, 1, integer, i, task);
-    HASSERT(promise == NULL);
+/*
+ * Define shmem_<name>_async_when, shmem_<name>_async_nb_when and
+ * shmem_<name>_async_when_any for variables of type ctype.
+ */
+#define DEFINE_SHMEM_ASYNC_WHEN(name, ctype, wait_type_val, fieldname) \
+template <typename T> \
+void shmem_##name##_async_when(volatile ctype *ivar, int cmp, \
+        ctype cmp_value, T&& lambda) { \
+    typedef typename std::remove_reference<T>::type U; \
+    hclib_task_t *task = _allocate_async(new U(lambda)); \
+    \
+    hclib_promise_t *promise = construct_and_insert_wait_set(&ivar, cmp, \
+            &cmp_value, 1, wait_type_val, fieldname, task); \
+    HASSERT(promise == NULL); \
+} \
+\
+template <typename T> \
+void shmem_##name##_async_nb_when(volatile ctype *ivar, int cmp, \
+        ctype cmp_value, T&& lambda) { \
+    typedef typename std::remove_reference<T>::type U; \
+    hclib_task_t *task = _allocate_async(new U(lambda)); \
+    task->non_blocking = 1; \
+    \
+    hclib_promise_t *promise = construct_and_insert_wait_set(&ivar, cmp, \
+            &cmp_value, 1, wait_type_val, fieldname, task); \
+    HASSERT(promise == NULL); \
+} \
+\
+template <typename T> \
+void shmem_##name##_async_when_any(volatile ctype **ivars, int cmp, \
+        ctype *cmp_values, int nwaits, T&& lambda) { \
+    typedef typename std::remove_reference<T>::type U; \
+    hclib_task_t *task = _allocate_async(new U(lambda)); \
+    \
+    hclib_promise_t *promise = construct_and_insert_wait_set(ivars, cmp, \
+            cmp_values, nwaits, wait_type_val, fieldname, task); \
+    HASSERT(promise == NULL); \
 }
 
-template <typename T>
-void shmem_int_async_when_any(volatile int **ivars, int cmp,
-        int *cmp_values, int nwaits, T&& lambda) {
-    typedef typename std::remove_reference<T>::type U;
-    hclib_task_t *task = _allocate_async(new U(lambda));
-
-    hclib_promise_t *promise = construct_and_insert_wait_set(ivars, cmp,
-            cmp_values, nwaits, integer, i, task);
-    HASSERT(promise == NULL);
-}
+DEFINE_SHMEM_ASYNC_WHEN(int, int, integer, i)
+DEFINE_SHMEM_ASYNC_WHEN(long, long, long_integer, l)
+DEFINE_SHMEM_ASYNC_WHEN(longlong, long long, long_long_integer, ll)
 
 std::string shmem_name();
 
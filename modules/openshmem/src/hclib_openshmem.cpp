@@ -2,10 +2,14 @@
 
 #include "hclib-locality-graph.h"
 
+#include "hclib-shmem-cmp.h"
+
+#include <algorithm>
 #include <map>
 #include <vector>
 #include <iostream>
 #include <sstream>
+#include <string.h>
 
 // #define TRACE
 // #define PROFILE
@@ -130,8 +134,96 @@ static int nic_locale_id;
 static hclib::locale_t *nic = NULL;
 static std::map<long *, lock_context_t *> lock_info;
 static pthread_mutex_t lock_info_mutex = PTHREAD_MUTEX_INITIALIZER;
+// Whether the wait-set poller enters the library on each pass
+static bool poll_progress = false;
+
+#if SHMEM_MAJOR_VERSION > 1 || ( SHMEM_MAJOR_VERSION == 1 && SHMEM_MINOR_VERSION >= 4)
+#define HCLIB_OSHMEM_HAS_CONTEXTS
+
+/*
+ * With OpenSHMEM 1.4 or later and SHMEM_THREAD_MULTIPLE support, every worker
+ * gets its own context, and RMA and atomic operations are issued on it
+ * directly from the calling worker. shmem_quiet then completes operations on
+ * every worker's context as well as the default one. Otherwise, or if
+ * HCLIB_OSHMEM_CONTEXTS=0 is set, all operations are issued from tasks at the
+ * Interconnect locale.
+ */
+static bool use_contexts = false;
+static int n_worker_contexts = 0;
+static shmem_ctx_t *worker_contexts = NULL;
+static unsigned worker_context_id;
+
+static void init_worker_context(void *state, void *user_data, int tid) {
+    assert(user_data == NULL);
+    *((shmem_ctx_t *)state) = worker_contexts[tid];
+}
+
+static void release_worker_context(void *state, void *user_data) {
+    assert(user_data == NULL);
+    shmem_ctx_t ctx = *((shmem_ctx_t *)state);
+    ::shmem_ctx_quiet(ctx);
+    ::shmem_ctx_destroy(ctx);
+}
+
+static inline shmem_ctx_t current_worker_context() {
+    return *((shmem_ctx_t *)hclib_get_curr_worker_module_state(
+                worker_context_id));
+}
+
+/*
+ * Try to create one context per worker, returning false if the runtime does
+ * not support it.
+ */
+static bool create_worker_contexts() {
+    const char *env = getenv("HCLIB_OSHMEM_CONTEXTS");
+    if (env && atoi(env) == 0) {
+        ::shmem_init();
+        return false;
+    }
+
+    int provided;
+    ::shmem_init_thread(SHMEM_THREAD_MULTIPLE, &provided);
+    if (provided != SHMEM_THREAD_MULTIPLE) return false;
+
+    n_worker_contexts = hclib_get_num_workers();
+    worker_contexts = (shmem_ctx_t *)malloc(
+            n_worker_contexts * sizeof(*worker_contexts));
+    HASSERT(worker_contexts);
+
+    for (int i = 0; i < n_worker_contexts; i++) {
+        if (::shmem_ctx_create(0, worker_contexts + i) != 0) {
+            for (int j = 0; j < i; j++) {
+                ::shmem_ctx_destroy(worker_contexts[j]);
+            }
+            free(worker_contexts);
+            worker_contexts = NULL;
+            n_worker_contexts = 0;
+            return false;
+        }
+    }
+
+    worker_context_id = hclib_add_per_worker_module_state(
+            sizeof(shmem_ctx_t), init_worker_context, NULL);
+    return true;
+}
+
+/*
+ * Contexts are created shared under SHMEM_THREAD_MULTIPLE, so any worker may
+ * complete operations on all of them without going through the Interconnect
+ * locale. A fence only orders operations within a single context, though, so
+ * it cannot order a task's earlier operations on another worker's context
+ * (issued before it moved workers) against its later ones; shmem_fence quiets
+ * every context but the caller's, passed as except_worker, and fences that.
+ */
+static void quiet_worker_contexts(int except_worker) {
+    for (int i = 0; i < n_worker_contexts; i++) {
+        if (i != except_worker) {
+            ::shmem_ctx_quiet(worker_contexts[i]);
+        }
+    }
+}
+#endif
 
-static hclib::wait_set_t * volatile waiting_on_head = NULL;
 
 static int pe_to_locale_id(int pe) {
     HASSERT(pe >= 0);
@@ -184,7 +276,14 @@ HCLIB_MODULE_INITIALIZATION_FUNC(openshmem_pre_initialize) {
 }
 
 HCLIB_MODULE_INITIALIZATION_FUNC(openshmem_post_initialize) {
+#ifdef HCLIB_OSHMEM_HAS_CONTEXTS
+    use_contexts = create_worker_contexts();
+#else
     ::shmem_init();
+#endif
+
+    const char *poll_progress_str = getenv("HCLIB_OSHMEM_POLL_PROGRESS");
+    poll_progress = (poll_progress_str && atoi(poll_progress_str));
 
 #ifdef PROFILE
 #ifdef TRACING
@@ -211,6 +310,13 @@ HCLIB_MODULE_INITIALIZATION_FUNC(openshmem_finalize) {
 #ifdef TRACING
     fclose(trace_fp);
 #endif
+#endif
+#ifdef HCLIB_OSHMEM_HAS_CONTEXTS
+    if (use_contexts) {
+        hclib_release_per_worker_module_state(worker_context_id,
+                release_worker_context, NULL);
+        free(worker_contexts);
+    }
 #endif
     ::shmem_finalize();
 }
@@ -227,6 +333,7 @@ static hclib::locale_t *get_locale_for_pe(int pe) {
     memcpy((void *)new_locale->lbl, name_buf, strlen(name_buf) + 1);
     new_locale->metadata = NULL;
     new_locale->deques = NULL;
+    new_locale->nonempty = NULL;
     return new_locale;
 }
 
@@ -273,6 +380,11 @@ void hclib::shmem_free(void *ptr) {
 }
 
 void hclib::shmem_barrier_all() {
+#ifdef HCLIB_OSHMEM_HAS_CONTEXTS
+    // The barrier only completes operations on the default context
+    if (use_contexts) quiet_worker_contexts(-1);
+#endif
+
     hclib::finish([] {
         hclib::async_nb_at([] {
             START_PROFILE
@@ -286,6 +398,18 @@ void hclib::shmem_barrier_all() {
 }
 
 void hclib::shmem_fence() {
+#ifdef HCLIB_OSHMEM_HAS_CONTEXTS
+    if (use_contexts) {
+        START_PROFILE
+        // Only the caller's own context can be ordered by a fence alone
+        quiet_worker_contexts(hclib_get_current_worker());
+        ::shmem_quiet();
+        ::shmem_ctx_fence(current_worker_context());
+        END_PROFILE(shmem_fence)
+        return;
+    }
+#endif
+
     hclib::finish([] {
         hclib::async_nb_at([] {
             START_PROFILE
@@ -296,6 +420,16 @@ void hclib::shmem_fence() {
 }
 
 void hclib::shmem_quiet() {
+#ifdef HCLIB_OSHMEM_HAS_CONTEXTS
+    if (use_contexts) {
+        START_PROFILE
+        quiet_worker_contexts(-1);
+        ::shmem_quiet();
+        END_PROFILE(shmem_quiet)
+        return;
+    }
+#endif
+
     hclib::finish([] {
         hclib::async_nb_at([] {
             START_PROFILE
@@ -306,6 +440,16 @@ void hclib::shmem_quiet() {
 }
 
 void hclib::shmem_put64(void *dest, const void *source, size_t nelems, int pe) {
+#ifdef HCLIB_OSHMEM_HAS_CONTEXTS
+    if (use_contexts) {
+        START_PROFILE
+        ::shmem_ctx_put64(current_worker_context(), dest, source, nelems,
+                pe);
+        END_PROFILE(shmem_put64)
+        return;
+    }
+#endif
+
     hclib::finish([dest, source, nelems, pe] {
         hclib::async_nb_at([dest, source, nelems, pe] {
             START_PROFILE
@@ -417,6 +561,11 @@ void hclib::shmem_set_lock(volatile long *lock) {
 }
 
 void hclib::shmem_clear_lock(long *lock) {
+#ifdef HCLIB_OSHMEM_HAS_CONTEXTS
+    // Complete updates made under the lock before releasing it
+    if (use_contexts) quiet_worker_contexts(-1);
+#endif
+
     int err = pthread_mutex_lock(&lock_info_mutex);
     HASSERT(err == 0);
 
@@ -438,6 +587,16 @@ void hclib::shmem_clear_lock(long *lock) {
 }
 
 void hclib::shmem_int_get(int *dest, const int *source, size_t nelems, int pe) {
+#ifdef HCLIB_OSHMEM_HAS_CONTEXTS
+    if (use_contexts) {
+        START_PROFILE
+        ::shmem_ctx_int_get(current_worker_context(), dest, source,
+                nelems, pe);
+        END_PROFILE(shmem_int_get)
+        return;
+    }
+#endif
+
     hclib::finish([dest, source, nelems, pe] {
         hclib::async_nb_at([dest, source, nelems, pe] {
             START_PROFILE
@@ -453,6 +612,16 @@ void hclib::shmem_int_get(int *dest, const int *source, size_t nelems, int pe) {
 }
 
 void hclib::shmem_getmem(void *dest, const void *source, size_t nelems, int pe) {
+#ifdef HCLIB_OSHMEM_HAS_CONTEXTS
+    if (use_contexts) {
+        START_PROFILE
+        ::shmem_ctx_getmem(current_worker_context(), dest, source, nelems,
+                pe);
+        END_PROFILE(shmem_getmem)
+        return;
+    }
+#endif
+
     hclib::finish([dest, source, nelems, pe] {
         hclib::async_nb_at([dest, source, nelems, pe] {
             START_PROFILE
@@ -468,6 +637,16 @@ void hclib::shmem_getmem(void *dest, const void *source, size_t nelems, int pe)
 }
 
 void hclib::shmem_putmem(void *dest, const void *source, size_t nelems, int pe) {
+#ifdef HCLIB_OSHMEM_HAS_CONTEXTS
+    if (use_contexts) {
+        START_PROFILE
+        ::shmem_ctx_putmem(current_worker_context(), dest, source, nelems,
+                pe);
+        END_PROFILE(shmem_putmem)
+        return;
+    }
+#endif
+
     hclib::finish([&] {
         hclib::async_nb_at([&] {
             START_PROFILE
@@ -478,6 +657,16 @@ void hclib::shmem_putmem(void *dest, const void *source, size_t nelems, int pe)
 }
 
 void hclib::shmem_int_put(int *dest, const int *source, size_t nelems, int pe) {
+#ifdef HCLIB_OSHMEM_HAS_CONTEXTS
+    if (use_contexts) {
+        START_PROFILE
+        ::shmem_ctx_int_put(current_worker_context(), dest, source,
+                nelems, pe);
+        END_PROFILE(shmem_int_put)
+        return;
+    }
+#endif
+
     hclib::finish([dest, source, nelems, pe] {
         hclib::async_nb_at([dest, source, nelems, pe] {
             START_PROFILE
@@ -493,6 +682,15 @@ void hclib::shmem_int_put(int *dest, const int *source, size_t nelems, int pe) {
 }
 
 void hclib::shmem_int_p(int *dest, int value, int pe) {
+#ifdef HCLIB_OSHMEM_HAS_CONTEXTS
+    if (use_contexts) {
+        START_PROFILE
+        ::shmem_ctx_int_p(current_worker_context(), dest, value, pe);
+        END_PROFILE(shmem_int_p)
+        return;
+    }
+#endif
+
     hclib::finish([dest, value, pe] {
         hclib::async_nb_at([dest, value, pe] {
             START_PROFILE
@@ -509,6 +707,16 @@ void hclib::shmem_int_p(int *dest, int value, int pe) {
 #if SHMEM_MAJOR_VERSION > 1 || ( SHMEM_MAJOR_VERSION == 1 && SHMEM_MINOR_VERSION >= 3)
 void hclib::shmem_char_put_nbi(char *dest, const char *source, size_t nelems,
         int pe) {
+#ifdef HCLIB_OSHMEM_HAS_CONTEXTS
+    if (use_contexts) {
+        START_PROFILE
+        ::shmem_ctx_char_put_nbi(current_worker_context(), dest, source,
+                nelems, pe);
+        END_PROFILE(shmem_char_put_nbi)
+        return;
+    }
+#endif
+
     hclib::finish([&] {
         hclib::async_nb_at([&] {
             START_PROFILE
@@ -521,6 +729,19 @@ void hclib::shmem_char_put_nbi(char *dest, const char *source, size_t nelems,
 void hclib::shmem_char_put_signal_nbi(char *dest, const char *source,
         size_t nelems, char *signal_dest, const char *signal_source,
         size_t signal_nelems, int pe) {
+#ifdef HCLIB_OSHMEM_HAS_CONTEXTS
+    if (use_contexts) {
+        START_PROFILE
+        shmem_ctx_t ctx = current_worker_context();
+        ::shmem_ctx_char_put_nbi(ctx, dest, source, nelems, pe);
+        ::shmem_ctx_fence(ctx);
+        ::shmem_ctx_char_put_nbi(ctx, signal_dest, signal_source,
+                signal_nelems, pe);
+        END_PROFILE(shmem_char_put_signal_nbi)
+        return;
+    }
+#endif
+
     hclib::finish([&] {
         hclib::async_nb_at([&] {
             START_PROFILE
@@ -534,6 +755,16 @@ void hclib::shmem_char_put_signal_nbi(char *dest, const char *source,
 #endif
 
 void hclib::shmem_int_add(int *dest, int value, int pe) {
+#ifdef HCLIB_OSHMEM_HAS_CONTEXTS
+    if (use_contexts) {
+        START_PROFILE
+        ::shmem_ctx_int_atomic_add(current_worker_context(), dest, value,
+                pe);
+        END_PROFILE(shmem_int_add)
+        return;
+    }
+#endif
+
     hclib::finish([dest, value, pe] {
         hclib::async_nb_at([dest, value, pe] {
             START_PROFILE
@@ -549,6 +780,16 @@ void hclib::shmem_int_add(int *dest, int value, int pe) {
 
 long long hclib::shmem_longlong_fadd(long long *target, long long value,
         int pe) {
+#ifdef HCLIB_OSHMEM_HAS_CONTEXTS
+    if (use_contexts) {
+        START_PROFILE
+        const long long result = ::shmem_ctx_longlong_atomic_fetch_add(
+                current_worker_context(), target, value, pe);
+        END_PROFILE(shmem_longlong_fadd)
+        return result;
+    }
+#endif
+
     long long *val_ptr = (long long *)malloc(sizeof(long long));
     hclib::finish([target, value, pe, val_ptr] {
         hclib::async_nb_at([target, value, pe, val_ptr] {
@@ -570,6 +811,16 @@ long long hclib::shmem_longlong_fadd(long long *target, long long value,
 }
 
 int hclib::shmem_int_fadd(int *dest, int value, int pe) {
+#ifdef HCLIB_OSHMEM_HAS_CONTEXTS
+    if (use_contexts) {
+        START_PROFILE
+        const int result = ::shmem_ctx_int_atomic_fetch_add(
+                current_worker_context(), dest, value, pe);
+        END_PROFILE(shmem_int_fadd)
+        return result;
+    }
+#endif
+
     int *heap_fetched = (int *)malloc(sizeof(int));
     hclib::finish([dest, value, pe, heap_fetched] {
         hclib::async_nb_at([dest, value, pe, heap_fetched] {
@@ -591,6 +842,16 @@ int hclib::shmem_int_fadd(int *dest, int value, int pe) {
 }
 
 int hclib::shmem_int_finc(int *dest, int pe) {
+#ifdef HCLIB_OSHMEM_HAS_CONTEXTS
+    if (use_contexts) {
+        START_PROFILE
+        const int result = ::shmem_ctx_int_atomic_fetch_inc(
+                current_worker_context(), dest, pe);
+        END_PROFILE(shmem_int_finc)
+        return result;
+    }
+#endif
+
     int *heap_fetched = (int *)malloc(sizeof(int));
     hclib::finish([dest, pe, heap_fetched] {
         hclib::async_nb_at([dest, pe, heap_fetched] {
@@ -609,6 +870,16 @@ int hclib::shmem_int_finc(int *dest, int pe) {
 }
 
 int hclib::shmem_int_swap(int *dest, int value, int pe) {
+#ifdef HCLIB_OSHMEM_HAS_CONTEXTS
+    if (use_contexts) {
+        START_PROFILE
+        const int result = ::shmem_ctx_int_atomic_swap(
+                current_worker_context(), dest, value, pe);
+        END_PROFILE(shmem_int_swap)
+        return result;
+    }
+#endif
+
     int *heap_fetched = (int *)malloc(sizeof(int));
     hclib::finish([dest, value, pe, heap_fetched] {
         hclib::async_nb_at([dest, value, pe, heap_fetched] {
@@ -684,6 +955,15 @@ void hclib::shmem_longlong_max_to_all(long long *target, long long *source,
 }
 
 void hclib::shmem_longlong_p(long long *addr, long long value, int pe) {
+#ifdef HCLIB_OSHMEM_HAS_CONTEXTS
+    if (use_contexts) {
+        START_PROFILE
+        ::shmem_ctx_longlong_p(current_worker_context(), addr, value, pe);
+        END_PROFILE(shmem_longlong_p)
+        return;
+    }
+#endif
+
     hclib::finish([addr, value, pe] {
         hclib::async_nb_at([addr, value, pe] {
             START_PROFILE
@@ -699,6 +979,16 @@ void hclib::shmem_longlong_p(long long *addr, long long value, int pe) {
 
 void hclib::shmem_longlong_put(long long *dest, const long long *src,
                         size_t nelems, int pe) {
+#ifdef HCLIB_OSHMEM_HAS_CONTEXTS
+    if (use_contexts) {
+        START_PROFILE
+        ::shmem_ctx_longlong_put(current_worker_context(), dest, src,
+                nelems, pe);
+        END_PROFILE(shmem_longlong_put)
+        return;
+    }
+#endif
+
     hclib::finish([dest, src, nelems, pe] {
         hclib::async_nb_at([dest, src, nelems, pe] {
             START_PROFILE
@@ -755,101 +1045,281 @@ std::string hclib::shmem_name() {
     return ss.str();
 }
 
-static void poll_on_waits() {
-    do {
-        START_PROFILE
-        int wait_set_list_non_empty = 1;
-
-        hclib::wait_set_t *prev = NULL;
-        hclib::wait_set_t *wait_set = waiting_on_head;
-
-        assert(wait_set != NULL);
-
-        while (wait_set) {
-            hclib::wait_set_t *next = wait_set->next;
-
-            bool any_complete = false;
-            for (int i = 0; i < wait_set->ninfos && !any_complete; i++) {
-                hclib::wait_info_t *wait_info = wait_set->infos + i;
-
-                switch (wait_info->cmp) {
-                    case SHMEM_CMP_EQ:
-                        switch (wait_info->type) {
-                            case hclib::integer:
-                                if (*((volatile int *)wait_info->var) == wait_info->cmp_value.i) {
-                                    any_complete = true;
-                                }
-                                break; // integer
-
-                            default:
-                                std::cerr << "Unsupported wait type " << wait_info->type << std::endl;
-                                exit(1);
-                        }
-                        break; // SHMEM_CMP_EQ
-              
-                    case SHMEM_CMP_NE:
-                        switch (wait_info->type) {
-                            case hclib::integer:
-                                if (*((volatile int *)wait_info->var) != wait_info->cmp_value.i) {
-                                    any_complete = true;
-                                }
-                                break; // integer
-
-                            default:
-                                std::cerr << "Unsupported wait type " << wait_info->type << std::endl;
-                                exit(1);
-                        }
-                        break; // SHMEM_CMP_NE
-
-                    default:
-                        std::cerr << "Unsupported cmp type " << wait_info->cmp << std::endl;
-                        exit(1);
-                }
-            }
+/*
+ * Wait engine behind async_when and wait_until. New wait sets are pushed onto a
+ * lock-free incoming list from any worker, and a single polling task on the
+ * Interconnect locale moves their conditions into lanes, one per variable type
+ * and comparison. Each lane is kept sorted by address, so that conditions on
+ * the same variable are adjacent and conditions on contiguous variables (e.g.
+ * the elements of a flag array) form runs that are compared a vector at a
+ * time. Wait sets satisfied during a scan are released together once it is
+ * done.
+ */
+// SSE2 width, so that vectors passed to the comparison functors by value keep
+// the baseline x86-64 ABI when building without -mavx
+#define WAIT_VECTOR_BYTES 16
+#define N_WAIT_CMPS 6
+
+static hclib::wait_set_t * volatile incoming_wait_sets = NULL;
+static volatile int wait_poller_active = 0;
+
+template <typename T>
+struct wait_entry {
+    volatile T *var;
+    T cmp_value;
+    hclib::wait_set_t *wait_set;
+};
+
+template <typename T>
+struct wait_lane {
+    // Sorted by var
+    std::vector<wait_entry<T> > entries;
+    // Entries not yet merged into entries
+    std::vector<wait_entry<T> > added;
+    bool dirty;
+
+    /*
+     * Rebuilt from entries whenever it changes: the comparison values laid out
+     * contiguously, and the (start, length) of each run of entries on
+     * contiguous variables.
+     */
+    std::vector<T> cmp_values;
+    std::vector<std::pair<size_t, size_t> > runs;
+};
+
+template <typename T>
+struct wait_lanes {
+    wait_lane<T> by_cmp[N_WAIT_CMPS];
+};
+
+// Only touched by the polling task
+static wait_lanes<int> int_lanes;
+static wait_lanes<long> long_lanes;
+static wait_lanes<long long> long_long_lanes;
+static size_t n_wait_entries = 0;
+
+static int cmp_index(int cmp) {
+    switch (cmp) {
+        case SHMEM_CMP_EQ: return 0;
+        case SHMEM_CMP_NE: return 1;
+        case SHMEM_CMP_GT: return 2;
+        case SHMEM_CMP_LE: return 3;
+        case SHMEM_CMP_LT: return 4;
+        case SHMEM_CMP_GE: return 5;
+        default:
+            std::cerr << "Unsupported cmp type " << cmp << std::endl;
+            exit(1);
+    }
+}
+
+template <typename T>
+static bool wait_entry_before(const wait_entry<T> &a, const wait_entry<T> &b) {
+    return std::less<volatile T *>()(a.var, b.var);
+}
 
-            /*
-             * If a signal in the current wait_set was satisfied, trigger either
-             * a downstream task or promise.
-             */
-            if (any_complete) {
-                // Remove from singly linked list
-                if (prev == NULL) {
-                    /*
-                     * If previous is NULL, we *may* be looking at the front of
-                     * the list. It is also possible that another thread in the
-                     * meantime came along and added an entry to the front of
-                     * this singly-linked wait list, in which case we need to
-                     * ensure we update its next rather than updating the list
-                     * head. We do this by first trying to automatically update
-                     * the list head to be the next of wait_set, and if we fail
-                     * then we know we have a new head whose next points to
-                     * wait_set and which should be updated.
-                     */
-                    hclib::wait_set_t *old_head = __sync_val_compare_and_swap(
-                            &waiting_on_head, wait_set, wait_set->next);
-                    if (old_head != wait_set) {
-                        // Failed, someone else added a different head
-                        assert(old_head->next == wait_set);
-                        old_head->next = wait_set->next;
-                        prev = old_head;
-                    } else {
-                        /*
-                         * Success, new head is now wait_set->next. We want this
-                         * polling task to exit if we just set the head to NULL.
-                         * It is the responsibility of future async_when calls
-                         * to restart it upon discovering a null head.
-                         */
-                        wait_set_list_non_empty = (wait_set->next != NULL);
+template <typename T>
+static void add_wait_info(wait_lanes<T> *lanes, hclib::wait_info_t *info,
+        T cmp_value, hclib::wait_set_t *wait_set) {
+    wait_entry<T> entry;
+    entry.var = (volatile T *)info->var;
+    entry.cmp_value = cmp_value;
+    entry.wait_set = wait_set;
+
+    wait_lane<T> *lane = &lanes->by_cmp[cmp_index(info->cmp)];
+    lane->added.push_back(entry);
+    lane->dirty = true;
+}
+
+static void index_wait_set(hclib::wait_set_t *wait_set) {
+    for (int i = 0; i < wait_set->ninfos; i++) {
+        hclib::wait_info_t *info = wait_set->infos + i;
+        switch (info->type) {
+            case hclib::integer:
+                add_wait_info(&int_lanes, info, info->cmp_value.i, wait_set);
+                break;
+            case hclib::long_integer:
+                add_wait_info(&long_lanes, info, info->cmp_value.l, wait_set);
+                break;
+            case hclib::long_long_integer:
+                add_wait_info(&long_long_lanes, info, info->cmp_value.ll,
+                        wait_set);
+                break;
+            default:
+                std::cerr << "Unsupported wait type " << info->type <<
+                    std::endl;
+                exit(1);
+        }
+    }
+    n_wait_entries += wait_set->ninfos;
+}
+
+template <typename T>
+static void rebuild_lane(wait_lane<T> *lane) {
+    std::vector<wait_entry<T> > &entries = lane->entries;
+    if (!lane->added.empty()) {
+        std::sort(lane->added.begin(), lane->added.end(),
+                wait_entry_before<T>);
+        const size_t n_sorted = entries.size();
+        entries.insert(entries.end(), lane->added.begin(), lane->added.end());
+        std::inplace_merge(entries.begin(), entries.begin() + n_sorted,
+                entries.end(), wait_entry_before<T>);
+        lane->added.clear();
+    }
+
+    lane->cmp_values.resize(entries.size());
+    lane->runs.clear();
+    for (size_t i = 0; i < entries.size(); i++) {
+        lane->cmp_values[i] = entries[i].cmp_value;
+        if (i > 0 && entries[i].var == entries[i - 1].var + 1) {
+            lane->runs.back().second++;
+        } else {
+            lane->runs.push_back(std::make_pair(i, (size_t)1));
+        }
+    }
+    lane->dirty = false;
+}
+
+static inline void mark_satisfied(hclib::wait_set_t *wait_set,
+        std::vector<hclib::wait_set_t *> *satisfied) {
+    if (!wait_set->satisfied) {
+        wait_set->satisfied = 1;
+        satisfied->push_back(wait_set);
+    }
+}
+
+template <typename V>
+static inline bool vector_any(V mask) {
+    long long words[sizeof(V) / sizeof(long long)];
+    memcpy(words, &mask, sizeof(V));
+    long long any = 0;
+    for (unsigned i = 0; i < sizeof(V) / sizeof(long long); i++) {
+        any |= words[i];
+    }
+    return any != 0;
+}
+
+/*
+ * Test every condition in a lane. Runs of conditions on contiguous variables
+ * are compared WAIT_VECTOR_BYTES at a time. Everything else is compared one by
+ * one, reading each variable once even if several conditions are on it.
+ */
+template <typename T, class C>
+static void scan_lane(wait_lane<T> *lane,
+        std::vector<hclib::wait_set_t *> *satisfied) {
+    typedef T vec_t __attribute__((vector_size(WAIT_VECTOR_BYTES)));
+    const size_t vec_len = sizeof(vec_t) / sizeof(T);
+
+    wait_entry<T> *entries = lane->entries.data();
+    const T *cmp_values = lane->cmp_values.data();
+    volatile T *last_var = NULL;
+    T last_value = 0;
+
+    for (size_t r = 0; r < lane->runs.size(); r++) {
+        const size_t start = lane->runs[r].first;
+        const size_t end = start + lane->runs[r].second;
+        const volatile T *base = entries[start].var;
+
+        size_t i = start;
+        for (; i + vec_len <= end; i += vec_len) {
+            vec_t values, cmps;
+            memcpy(&values, (const void *)(base + (i - start)), sizeof(values));
+            memcpy(&cmps, cmp_values + i, sizeof(cmps));
+            const vec_t mask = C::vtest(values, cmps);
+            if (vector_any(mask)) {
+                for (size_t j = 0; j < vec_len; j++) {
+                    if (mask[j]) {
+                        mark_satisfied(entries[i + j].wait_set, satisfied);
                     }
-                } else {
-                    /*
-                     * If previous is non-null, we just adjust its next link to
-                     * jump over the current node.
-                     */
-                    assert(prev->next == wait_set);
-                    prev->next = wait_set->next;
                 }
+            }
+        }
+
+        for (; i < end; i++) {
+            if (entries[i].var != last_var) {
+                last_var = entries[i].var;
+                last_value = *last_var;
+            }
+            if (C::test(last_value, cmp_values[i])) {
+                mark_satisfied(entries[i].wait_set, satisfied);
+            }
+        }
+    }
+}
+
+template <typename T>
+static void scan_lanes(wait_lanes<T> *lanes,
+        std::vector<hclib::wait_set_t *> *satisfied) {
+    for (int c = 0; c < N_WAIT_CMPS; c++) {
+        wait_lane<T> *lane = &lanes->by_cmp[c];
+        if (lane->dirty) rebuild_lane(lane);
+        if (lane->entries.empty()) continue;
+
+        switch (c) {
+            case 0: scan_lane<T, hclib::shmem_cmp_eq>(lane, satisfied); break;
+            case 1: scan_lane<T, hclib::shmem_cmp_ne>(lane, satisfied); break;
+            case 2: scan_lane<T, hclib::shmem_cmp_gt>(lane, satisfied); break;
+            case 3: scan_lane<T, hclib::shmem_cmp_le>(lane, satisfied); break;
+            case 4: scan_lane<T, hclib::shmem_cmp_lt>(lane, satisfied); break;
+            case 5: scan_lane<T, hclib::shmem_cmp_ge>(lane, satisfied); break;
+        }
+    }
+}
 
+template <typename T>
+static bool entry_satisfied(const wait_entry<T> &entry) {
+    return entry.wait_set->satisfied;
+}
+
+// Drop the conditions of every satisfied wait set, including unsatisfied ones
+template <typename T>
+static void remove_satisfied(wait_lanes<T> *lanes) {
+    for (int c = 0; c < N_WAIT_CMPS; c++) {
+        wait_lane<T> *lane = &lanes->by_cmp[c];
+        const size_t before = lane->entries.size();
+        lane->entries.erase(std::remove_if(lane->entries.begin(),
+                    lane->entries.end(), entry_satisfied<T>),
+                lane->entries.end());
+        if (lane->entries.size() != before) {
+            n_wait_entries -= before - lane->entries.size();
+            rebuild_lane(lane);
+        }
+    }
+}
+
+static void poll_on_waits() {
+    std::vector<hclib::wait_set_t *> satisfied;
+
+    while (true) {
+        START_PROFILE
+        /*
+         * Some implementations (e.g. OpenMPI 4.1 under SHMEM_THREAD_MULTIPLE)
+         * only deliver incoming updates to static symmetric variables while
+         * the target PE is making progress inside the library, which a PE
+         * only polling memory never does. With HCLIB_OSHMEM_POLL_PROGRESS=1
+         * each pass quiets the default context, which only the Interconnect
+         * locale issues on, to drive progress without completing the
+         * workers' outstanding operations on their own contexts.
+         */
+        if (poll_progress) ::shmem_quiet();
+        hclib::wait_set_t *incoming = __sync_lock_test_and_set(
+                &incoming_wait_sets, NULL);
+        while (incoming) {
+            hclib::wait_set_t *next = incoming->next;
+            index_wait_set(incoming);
+            incoming = next;
+        }
+
+        scan_lanes(&int_lanes, &satisfied);
+        scan_lanes(&long_lanes, &satisfied);
+        scan_lanes(&long_long_lanes, &satisfied);
+
+        if (!satisfied.empty()) {
+            remove_satisfied(&int_lanes);
+            remove_satisfied(&long_lanes);
+            remove_satisfied(&long_long_lanes);
+
+            for (size_t i = 0; i < satisfied.size(); i++) {
+                hclib::wait_set_t *wait_set = satisfied[i];
                 if (wait_set->task) {
                     HASSERT(wait_set->signal == NULL);
                     spawn(wait_set->task);
@@ -859,61 +1329,69 @@ static void poll_on_waits() {
                 }
                 free(wait_set->infos);
                 free(wait_set);
-            } else {
-                prev = wait_set;
             }
-
-            wait_set = next;
+            satisfied.clear();
         }
-
         END_PROFILE(shmem_async_when_polling)
 
-        if (wait_set_list_non_empty) {
+        if (n_wait_entries > 0 || incoming_wait_sets != NULL) {
             hclib::yield_at(nic);
-        } else {
-            // Empty list
+            continue;
+        }
+
+        /*
+         * Nothing left to wait on. A wait set may have been enqueued after our
+         * check but before we clear the flag, in which case its enqueuer saw
+         * the poller as still active and did not start a new one, so re-check
+         * after clearing.
+         */
+        wait_poller_active = 0;
+        __sync_synchronize();
+        if (incoming_wait_sets == NULL ||
+                !__sync_bool_compare_and_swap(&wait_poller_active, 0, 1)) {
             break;
         }
-    } while (true);
+    }
 }
 
-void hclib::shmem_int_wait_until(volatile int *ivar, int cmp, int cmp_value) {
-    hclib_promise_t *promise = construct_and_insert_wait_set(&ivar, cmp,
-            &cmp_value, 1, integer, i, NULL);
-    HASSERT(promise);
-
-    hclib_future_wait(hclib_get_future_for_promise(promise));
-
-    hclib_promise_free(promise);
+#define DEFINE_SHMEM_WAIT_UNTIL(name, ctype, wait_type_val, fieldname) \
+void hclib::shmem_##name##_wait_until(volatile ctype *ivar, int cmp, \
+        ctype cmp_value) { \
+    hclib_promise_t *promise = construct_and_insert_wait_set(&ivar, cmp, \
+            &cmp_value, 1, wait_type_val, fieldname, NULL); \
+    HASSERT(promise); \
+    \
+    hclib_future_wait(hclib_get_future_for_promise(promise)); \
+    \
+    hclib_promise_free(promise); \
+} \
+\
+void hclib::shmem_##name##_wait_until_any(volatile ctype **ivars, int cmp, \
+        ctype *cmp_values, int nwaits) { \
+    hclib_promise_t *promise = construct_and_insert_wait_set(ivars, cmp, \
+            cmp_values, nwaits, wait_type_val, fieldname, NULL); \
+    HASSERT(promise); \
+    \
+    hclib_future_wait(hclib_get_future_for_promise(promise)); \
+    \
+    hclib_promise_free(promise); \
 }
 
-void hclib::shmem_int_wait_until_any(volatile int **ivars, int cmp,
-        int *cmp_values, int nwaits) {
-    hclib_promise_t *promise = construct_and_insert_wait_set(ivars, cmp,
-            cmp_values, nwaits, integer, i, NULL);
-    HASSERT(promise);
-
-    hclib_future_wait(hclib_get_future_for_promise(promise));
-
-    hclib_promise_free(promise);
-}
+DEFINE_SHMEM_WAIT_UNTIL(int, int, integer, i)
+DEFINE_SHMEM_WAIT_UNTIL(long, long, long_integer, l)
+DEFINE_SHMEM_WAIT_UNTIL(longlong, long long, long_long_integer, ll)
 
 void hclib::enqueue_wait_set(hclib::wait_set_t *wait_set) {
     START_PROFILE
-    wait_set->next = waiting_on_head;
-
     hclib::wait_set_t *old_head;
-    while (1) {
-        old_head = __sync_val_compare_and_swap(
-                &waiting_on_head, wait_set->next, wait_set);
-        if (old_head != wait_set->next) {
-            wait_set->next = old_head;
-        } else {
-            break;
-        }
-    }
+    do {
+        old_head = incoming_wait_sets;
+        wait_set->next = old_head;
+    } while (!__sync_bool_compare_and_swap(&incoming_wait_sets, old_head,
+                wait_set));
 
-    if (old_head == NULL) {
+    if (wait_poller_active == 0 &&
+            __sync_bool_compare_and_swap(&wait_poller_active, 0, 1)) {
         hclib::async_at([] {
             poll_on_waits();
         }, nic);
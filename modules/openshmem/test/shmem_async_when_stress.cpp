@@ -0,0 +1,143 @@
+/*
+ * Stress test for the async_when wait engine, extending
+ * shmem_int_async_when_any. Every PE registers an async_when on each element of
+ * symmetric int, long and long long flag arrays, cycling through all of the
+ * SHMEM_CMP_* comparisons, plus an async_when_any over groups of four int flags
+ * that share the EQ comparison. Its left neighbour then writes the flags in
+ * slices, and every task must fire exactly once.
+ *
+ * Run as e.g. oshrun -np 2 ./shmem_async_when_stress [nflags]
+ */
+#include "hclib_cpp.h"
+#include "hclib_openshmem.h"
+#include "hclib_system.h"
+
+#include <assert.h>
+#include <string.h>
+#include <iostream>
+
+#define SLICE 256
+#define ANY_GROUP 4
+
+static const int cmps[] = { SHMEM_CMP_EQ, SHMEM_CMP_NE, SHMEM_CMP_GT,
+    SHMEM_CMP_GE, SHMEM_CMP_LT, SHMEM_CMP_LE };
+#define N_CMPS ((int)(sizeof(cmps) / sizeof(cmps[0])))
+
+static volatile long long n_fired = 0;
+
+// Flags start at zero, and are written with final_value(i)
+static long long final_value(int i) {
+    const int cmp = cmps[i % N_CMPS];
+    return (cmp == SHMEM_CMP_LT || cmp == SHMEM_CMP_LE) ? -(i + 1) : i + 1;
+}
+
+// A comparison value that zero does not satisfy but final_value(i) does
+static long long cmp_value(int i) {
+    switch (cmps[i % N_CMPS]) {
+        case SHMEM_CMP_EQ: return final_value(i);
+        case SHMEM_CMP_GE: return 1;
+        case SHMEM_CMP_LE: return -1;
+        default: return 0;
+    }
+}
+
+template <typename T>
+static void fill_final_values(T *values, int nflags) {
+    for (int i = 0; i < nflags; i++) {
+        values[i] = (T)final_value(i);
+    }
+}
+
+template <typename T>
+static void put_in_slices(T *flags, const T *values, int nflags, int pe) {
+    for (int start = 0; start < nflags; start += SLICE) {
+        const int n = (nflags - start < SLICE ? nflags - start : SLICE);
+        hclib::shmem_putmem(flags + start, values + start, n * sizeof(T), pe);
+    }
+}
+
+int main(int argc, char **argv) {
+    int nflags = 6144;
+    if (argc > 1) nflags = atoi(argv[1]);
+    assert(nflags % (ANY_GROUP * N_CMPS) == 0);
+
+    const char *deps[] = { "system", "openshmem" };
+    hclib::launch(deps, 2, [nflags] {
+        const int pe = hclib::shmem_my_pe();
+        const int npes = hclib::shmem_n_pes();
+
+        int *iflags = (int *)hclib::shmem_malloc(nflags * sizeof(int));
+        long *lflags = (long *)hclib::shmem_malloc(nflags * sizeof(long));
+        long long *llflags = (long long *)hclib::shmem_malloc(
+                nflags * sizeof(long long));
+        assert(iflags && lflags && llflags);
+        memset(iflags, 0x00, nflags * sizeof(int));
+        memset(lflags, 0x00, nflags * sizeof(long));
+        memset(llflags, 0x00, nflags * sizeof(long long));
+
+        int *ivalues = (int *)malloc(nflags * sizeof(int));
+        long *lvalues = (long *)malloc(nflags * sizeof(long));
+        long long *llvalues = (long long *)malloc(nflags * sizeof(long long));
+        assert(ivalues && lvalues && llvalues);
+        fill_final_values(ivalues, nflags);
+        fill_final_values(lvalues, nflags);
+        fill_final_values(llvalues, nflags);
+
+        hclib::shmem_barrier_all();
+
+        unsigned long long start_time = 0;
+        hclib::finish([&] {
+            for (int i = 0; i < nflags; i++) {
+                const int cmp = cmps[i % N_CMPS];
+                hclib::shmem_int_async_when(iflags + i, cmp, (int)cmp_value(i),
+                        [] { __sync_fetch_and_add(&n_fired, 1); });
+                hclib::shmem_long_async_when(lflags + i, cmp,
+                        (long)cmp_value(i),
+                        [] { __sync_fetch_and_add(&n_fired, 1); });
+                hclib::shmem_longlong_async_when(llflags + i, cmp,
+                        cmp_value(i),
+                        [] { __sync_fetch_and_add(&n_fired, 1); });
+            }
+
+            for (int i = 0; i < nflags; i += ANY_GROUP * N_CMPS) {
+                /*
+                 * Every flag in a group is waited on with EQ, but only the
+                 * first is compared against the value it will receive.
+                 */
+                volatile int *wait_vars[ANY_GROUP];
+                int cmp_values[ANY_GROUP];
+                for (int j = 0; j < ANY_GROUP; j++) {
+                    wait_vars[j] = iflags + i + j * N_CMPS;
+                    cmp_values[j] = (j == 0 ? ivalues[i] : -1);
+                }
+                hclib::shmem_int_async_when_any(wait_vars, SHMEM_CMP_EQ,
+                        cmp_values, ANY_GROUP,
+                        [] { __sync_fetch_and_add(&n_fired, 1); });
+            }
+
+            hclib::shmem_barrier_all();
+            start_time = hclib_current_time_ns();
+
+            const int neighbor = (pe + 1) % npes;
+            put_in_slices(iflags, ivalues, nflags, neighbor);
+            put_in_slices(lflags, lvalues, nflags, neighbor);
+            put_in_slices(llflags, llvalues, nflags, neighbor);
+        });
+        const unsigned long long elapsed = hclib_current_time_ns() - start_time;
+
+        const long long expected = 3LL * nflags + nflags / (ANY_GROUP * N_CMPS);
+        std::cout << "PE " << pe << ": " << n_fired << "/" << expected <<
+            " waits satisfied in " << (elapsed / 1000) << " us" << std::endl;
+        assert(n_fired == expected);
+
+        hclib::shmem_barrier_all();
+
+        free(ivalues);
+        free(lvalues);
+        free(llvalues);
+        hclib::shmem_free(iflags);
+        hclib::shmem_free(lflags);
+        hclib::shmem_free(llflags);
+    });
+    return 0;
+}
@@ -0,0 +1,103 @@
+/*
+ * Issues atomics and puts from tasks on every worker, GUPS-style, then checks
+ * that every update landed. With per-worker contexts these are issued directly
+ * from the calling worker; run with HCLIB_OSHMEM_CONTEXTS=0 to compare against
+ * routing them all through the Interconnect locale.
+ *
+ * Run as e.g. oshrun -np 2 ./shmem_atomics_stress [updates_per_task]
+ */
+#include "hclib_cpp.h"
+#include "hclib_openshmem.h"
+#include "hclib_system.h"
+
+#include <assert.h>
+#include <string.h>
+#include <iostream>
+
+#define NTASKS 64
+#define TABLE_SIZE 1024
+
+int main(int argc, char **argv) {
+    int updates_per_task = 1000;
+    if (argc > 1) updates_per_task = atoi(argv[1]);
+
+    const char *deps[] = { "system", "openshmem" };
+    hclib::launch(deps, 2, [updates_per_task] {
+        const int pe = hclib::shmem_my_pe();
+        const int npes = hclib::shmem_n_pes();
+
+        int *table = (int *)hclib::shmem_malloc(TABLE_SIZE * sizeof(int));
+        long long *counter = (long long *)hclib::shmem_malloc(
+                sizeof(long long));
+        // One slot per task on every PE, written with a put once it is done
+        int *done = (int *)hclib::shmem_malloc(NTASKS * npes * sizeof(int));
+        assert(table && counter && done);
+        memset(table, 0x00, TABLE_SIZE * sizeof(int));
+        memset(done, 0x00, NTASKS * npes * sizeof(int));
+        *counter = 0;
+
+        hclib::shmem_barrier_all();
+        const unsigned long long start_time = hclib_current_time_ns();
+
+        hclib::finish([=] {
+            for (int t = 0; t < NTASKS; t++) {
+                hclib::async([=] {
+                    unsigned seed = pe * NTASKS + t;
+                    for (int i = 0; i < updates_per_task; i++) {
+                        const int target = rand_r(&seed) % npes;
+                        const int index = rand_r(&seed) % TABLE_SIZE;
+                        hclib::shmem_int_add(table + index, 1, target);
+                        hclib::shmem_longlong_fadd(counter, 1, target);
+                    }
+                    hclib::shmem_quiet();
+
+                    const int one = 1;
+                    for (int target = 0; target < npes; target++) {
+                        hclib::shmem_int_put(done + pe * NTASKS + t, &one, 1,
+                                target);
+                    }
+                });
+            }
+        });
+
+        hclib::shmem_barrier_all();
+        const unsigned long long elapsed = hclib_current_time_ns() -
+            start_time;
+
+        long long table_total = 0;
+        for (int i = 0; i < TABLE_SIZE; i++) table_total += table[i];
+        int n_done = 0;
+        for (int i = 0; i < NTASKS * npes; i++) n_done += done[i];
+
+        // Every PE receives updates from every other, so check the sums
+        long long *totals = (long long *)hclib::shmem_malloc(
+                2 * npes * sizeof(long long));
+        assert(totals);
+        long long local[2] = { table_total, *counter };
+        for (int target = 0; target < npes; target++) {
+            hclib::shmem_longlong_put(totals + 2 * pe, local, 2, target);
+        }
+        hclib::shmem_barrier_all();
+
+        long long all_table = 0, all_counter = 0;
+        for (int i = 0; i < npes; i++) {
+            all_table += totals[2 * i];
+            all_counter += totals[2 * i + 1];
+        }
+        const long long expected = (long long)npes * NTASKS * updates_per_task;
+
+        std::cout << "PE " << pe << ": " << (2LL * NTASKS * updates_per_task) <<
+            " atomics in " << (elapsed / 1000) << " us (" <<
+            (2.0 * NTASKS * updates_per_task / (elapsed / 1e9) / 1e6) <<
+            " M/s)" << std::endl;
+        assert(n_done == NTASKS * npes);
+        assert(all_table == expected && all_counter == expected);
+
+        hclib::shmem_barrier_all();
+        hclib::shmem_free(totals);
+        hclib::shmem_free(done);
+        hclib::shmem_free(counter);
+        hclib::shmem_free(table);
+    });
+    return 0;
+}
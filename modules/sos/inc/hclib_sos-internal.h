@@ -12,14 +12,16 @@
 #include <stdio.h>
 
 enum wait_type {
-    integer
+    integer,
+    long_integer,
+    long_long_integer
 };
 
 typedef struct _pending_sos_op {
     wait_type type;
     volatile void *var;
     int cmp;
-    union { int i; } cmp_value;
+    union { int i; long l; long long ll; } cmp_value;
 
     hclib::promise_t<void> *prom;
     hclib_task_t *task;
@@ -79,6 +81,17 @@ int shmem_int_fetch(const int *dest, int pe);
 long long shmem_longlong_fadd(long long *target, long long value,
                               int pe);
 
+/*
+ * Non-blocking variants of the fetching atomics, whose futures are satisfied
+ * with the fetched value. Set HCLIB_SOS_COMBINE_ATOMICS=1 to combine
+ * concurrent requests to the same address and PE into a single atomic.
+ */
+hclib::future_t<int> *shmem_int_fadd_nbi(int *dest, int value, int pe);
+hclib::future_t<int> *shmem_int_finc_nbi(int *dest, int pe);
+hclib::future_t<long> *shmem_long_finc_nbi(long *dest, int pe);
+hclib::future_t<long long> *shmem_longlong_fadd_nbi(long long *target,
+        long long value, int pe);
+
 void shmem_int_sum_to_all(int *target, int *source, int nreduce,
                           int PE_start, int logPE_stride,
                           int PE_size, int *pWrk, long *pSync);
@@ -1,5 +1,6 @@
 #include "hclib_sos-internal.h"
 #include "hclib-locality-graph.h"
+#include "hclib-shmem-cmp.h"
 
 extern "C" {
 #include "shmemx.h"
@@ -94,6 +95,7 @@ static unsigned domain_ctx_id = 0;
 static shmemx_domain_t *domains = NULL;
 static shmemx_ctx_t *contexts = NULL;
 static int nthreads = -1;
+static bool combine_atomics = false;
 
 typedef struct _lock_context_t {
     // A future satisfied by the last attempt to lock this global lock.
@@ -114,43 +116,20 @@ static pthread_mutex_t lock_info_mutex = PTHREAD_MUTEX_INITIALIZER;
 bool test_sos_completion(void *generic_op) {
     pending_sos_op *op = (pending_sos_op *)generic_op;
 
-    switch (op->cmp) {
-        case SHMEM_CMP_EQ:
-            switch (op->type) {
-                case integer:
-                    if (*((volatile int *)op->var) == op->cmp_value.i) {
-                        return true;
-                    }
-                    break; // integer
-
-                default:
-                    std::cerr << "Unsupported wait type " << op->type <<
-                        std::endl;
-                    exit(1);
-            }
-        break; // SHMEM_CMP_EQ
-              
-        case SHMEM_CMP_NE:
-            switch (op->type) {
-                case integer:
-                    if (*((volatile int *)op->var) != op->cmp_value.i) {
-                        return true;
-                    }
-                    break; // integer
-
-                default:
-                    std::cerr << "Unsupported wait type " << op->type <<
-                        std::endl;
-                    exit(1);
-            }
-            break; // SHMEM_CMP_NE
-
-            default:
-                std::cerr << "Unsupported cmp type " << op->cmp << std::endl;
-                exit(1);
+    switch (op->type) {
+        case integer:
+            return hclib::shmem_cmp_test(*((volatile int *)op->var), op->cmp,
+                    op->cmp_value.i);
+        case long_integer:
+            return hclib::shmem_cmp_test(*((volatile long *)op->var), op->cmp,
+                    op->cmp_value.l);
+        case long_long_integer:
+            return hclib::shmem_cmp_test(*((volatile long long *)op->var),
+                    op->cmp, op->cmp_value.ll);
+        default:
+            std::cerr << "Unsupported wait type " << op->type << std::endl;
+            exit(1);
     }
-
-    return false;
 }
 
 HCLIB_MODULE_PRE_INITIALIZATION_FUNC(sos_pre_initialize) {
@@ -231,6 +210,9 @@ HCLIB_MODULE_INITIALIZATION_FUNC(sos_post_initialize) {
     }
 #endif
 
+    const char *combine = getenv("HCLIB_SOS_COMBINE_ATOMICS");
+    combine_atomics = (combine && atoi(combine) != 0);
+
     domain_ctx_id = hclib_add_per_worker_module_state(
             sizeof(shmemx_domain_t) + sizeof(shmemx_ctx_t), init_sos_state,
             NULL);
@@ -555,6 +537,157 @@ int hclib::shmem_int_finc(int *dest, int pe) {
     return ::shmemx_ctx_int_finc(dest, pe, *ctx);
 }
 
+/*
+ * Non-blocking fetching atomics. Each request joins a batch for its target
+ * address and PE, and the batch is issued as a single fetch-and-add of the sum
+ * of its requests' increments by a task running on whichever worker picks it
+ * up, on that worker's context. The result fetched for the batch is then handed
+ * out to the requests' futures as if they had been applied back to back in the
+ * order in which they joined.
+ *
+ * Without combining every request is a batch of its own. With
+ * HCLIB_SOS_COMBINE_ATOMICS=1, requests made by different tasks on this PE to
+ * the same address and PE while a batch is waiting to be issued join it.
+ */
+typedef struct _fadd_request {
+    long long value;
+    // A hclib::promise_t<T> for the type of the batch
+    void *prom;
+    struct _fadd_request *next;
+} fadd_request;
+
+typedef struct _fadd_batch {
+    wait_type type;
+    void *dest;
+    int pe;
+    long long total;
+    fadd_request *head;
+    fadd_request *tail;
+} fadd_batch;
+
+static std::map<std::pair<void *, int>, fadd_batch *> open_fadd_batches;
+static pthread_mutex_t fadd_batches_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+template <typename T>
+static void complete_fadd_batch(fadd_batch *batch, T fetched) {
+    fadd_request *req = batch->head;
+    while (req) {
+        fadd_request *next = req->next;
+        ((hclib::promise_t<T> *)req->prom)->put(fetched);
+        fetched += (T)req->value;
+        free(req);
+        req = next;
+    }
+    free(batch);
+}
+
+static void issue_fadd_batch(fadd_batch *batch) {
+    if (combine_atomics) {
+        int err = pthread_mutex_lock(&fadd_batches_mutex);
+        HASSERT(err == 0);
+        open_fadd_batches.erase(std::make_pair(batch->dest, batch->pe));
+        err = pthread_mutex_unlock(&fadd_batches_mutex);
+        HASSERT(err == 0);
+    }
+
+    void *state = hclib_get_curr_worker_module_state(domain_ctx_id);
+    assert(state);
+    shmemx_domain_t *domain = (shmemx_domain_t *)state;
+    shmemx_ctx_t *ctx = (shmemx_ctx_t *)(domain + 1);
+
+    switch (batch->type) {
+        case integer:
+            complete_fadd_batch<int>(batch, ::shmemx_ctx_int_fadd(
+                        (int *)batch->dest, (int)batch->total, batch->pe,
+                        *ctx));
+            break;
+        case long_integer:
+            complete_fadd_batch<long>(batch, ::shmemx_ctx_long_fadd(
+                        (long *)batch->dest, (long)batch->total, batch->pe,
+                        *ctx));
+            break;
+        case long_long_integer:
+            complete_fadd_batch<long long>(batch, ::shmemx_ctx_longlong_fadd(
+                        (long long *)batch->dest, batch->total, batch->pe,
+                        *ctx));
+            break;
+        default:
+            std::cerr << "Unsupported atomic type " << batch->type <<
+                std::endl;
+            exit(1);
+    }
+}
+
+template <typename T>
+static hclib::future_t<T> *fadd_nbi(wait_type type, T *dest, T value,
+        int pe) {
+    hclib::promise_t<T> *prom = new hclib::promise_t<T>();
+
+    fadd_request *req = (fadd_request *)malloc(sizeof(*req));
+    assert(req);
+    req->value = value;
+    req->prom = prom;
+    req->next = NULL;
+
+    if (combine_atomics) {
+        int err = pthread_mutex_lock(&fadd_batches_mutex);
+        HASSERT(err == 0);
+
+        std::map<std::pair<void *, int>, fadd_batch *>::iterator found =
+            open_fadd_batches.find(std::make_pair((void *)dest, pe));
+        if (found != open_fadd_batches.end()) {
+            fadd_batch *batch = found->second;
+            HASSERT(batch->type == type);
+            batch->total += value;
+            batch->tail->next = req;
+            batch->tail = req;
+
+            err = pthread_mutex_unlock(&fadd_batches_mutex);
+            HASSERT(err == 0);
+            return prom->get_future();
+        }
+    }
+
+    fadd_batch *batch = (fadd_batch *)malloc(sizeof(*batch));
+    assert(batch);
+    batch->type = type;
+    batch->dest = dest;
+    batch->pe = pe;
+    batch->total = value;
+    batch->head = batch->tail = req;
+
+    if (combine_atomics) {
+        open_fadd_batches.insert(std::make_pair(
+                    std::make_pair((void *)dest, pe), batch));
+        const int err = pthread_mutex_unlock(&fadd_batches_mutex);
+        HASSERT(err == 0);
+    }
+
+    hclib::async_nb([batch] {
+        issue_fadd_batch(batch);
+    });
+
+    return prom->get_future();
+}
+
+hclib::future_t<int> *hclib::shmem_int_fadd_nbi(int *dest, int value,
+        int pe) {
+    return fadd_nbi(integer, dest, value, pe);
+}
+
+hclib::future_t<int> *hclib::shmem_int_finc_nbi(int *dest, int pe) {
+    return fadd_nbi(integer, dest, 1, pe);
+}
+
+hclib::future_t<long> *hclib::shmem_long_finc_nbi(long *dest, int pe) {
+    return fadd_nbi(long_integer, dest, 1L, pe);
+}
+
+hclib::future_t<long long> *hclib::shmem_longlong_fadd_nbi(long long *target,
+        long long value, int pe) {
+    return fadd_nbi(long_long_integer, target, value, pe);
+}
+
 void hclib::shmem_int_sum_to_all(int *target, int *source, int nreduce,
                           int PE_start, int logPE_stride,
                           int PE_size, int *pWrk, long *pSync) {
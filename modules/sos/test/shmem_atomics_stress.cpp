@@ -7,11 +7,21 @@
 // long lock = 0L;
 static int pe = -1;
 
+/*
+ * Every PE increments a counter on PE 0 from many tasks, first with the
+ * blocking shmem_long_finc and then with shmem_long_finc_nbi. Run with
+ * HCLIB_SOS_COMBINE_ATOMICS=1 to combine the non-blocking increments.
+ *
+ * Usage: shmem_atomics_stress [ntasks]
+ */
 int main(int argc, char **argv) {
     const char *deps[] = { "system", "sos" };
+    int ntasks = 10;
+    if (argc > 1) ntasks = atoi(argv[1]);
 
-    hclib::launch(deps, 2, [] {
+    hclib::launch(deps, 2, [ntasks] {
         pe = hclib::shmem_my_pe();
+        const int npes = hclib::shmem_n_pes();
 
         long *target = (long *)shmem_malloc(sizeof(long));
         assert(target);
@@ -26,16 +36,48 @@ int main(int argc, char **argv) {
             set_to = 0;
         }
 
+        unsigned long long start_time = hclib_current_time_ns();
         hclib::finish([&] {
-            for (int i = 0; i < 10; i++) {
+            for (int i = 0; i < ntasks; i++) {
                 hclib::async([=] {
                     const int ret = hclib::shmem_long_finc(target, 0);
                 });
             }
         });
+        const unsigned long long blocking_time = hclib_current_time_ns() -
+            start_time;
 
         fprintf(stderr, "%d out of finish\n", ::shmem_my_pe());
 
+        hclib::shmem_barrier_all();
+
+        hclib::future_t<long> **fetched = (hclib::future_t<long> **)malloc(
+                ntasks * sizeof(*fetched));
+        assert(fetched);
+        start_time = hclib_current_time_ns();
+        hclib::finish([&] {
+            for (int i = 0; i < ntasks; i++) {
+                hclib::async([=] {
+                    fetched[i] = hclib::shmem_long_finc_nbi(target, 0);
+                });
+            }
+        });
+        for (int i = 0; i < ntasks; i++) {
+            fetched[i]->wait();
+        }
+        const unsigned long long nbi_time = hclib_current_time_ns() -
+            start_time;
+        free(fetched);
+
+        fprintf(stderr, "PE %d: %d blocking fincs in %llu us, %d non-blocking "
+                "fincs in %llu us\n", pe, ntasks, blocking_time / 1000, ntasks,
+                nbi_time / 1000);
+
+        hclib::shmem_barrier_all();
+        if (pe == 0) {
+            assert(*target == 2L * npes * ntasks);
+        }
+
         hclib::shmem_barrier_all();
         hclib::shmem_free(target);
     });
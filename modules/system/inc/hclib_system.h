@@ -14,6 +14,27 @@ HCLIB_MODULE_INITIALIZATION_FUNC(system_initialize);
 
 hclib::locale_t *get_closest_cpu_locale();
 
+/*
+ * The locale whose workers are nearest to the memory at ptr: the NUMA locale
+ * closest to the locale it was allocated at through this module, or holding its
+ * page according to the kernel otherwise. Returns NULL if that is unknown.
+ */
+hclib::locale_t *get_locale_near(const void *ptr);
+
+/*
+ * Spawn lambda at the locale nearest to the memory at ptr, or like a plain
+ * async when its placement is unknown.
+ */
+template <typename T>
+inline void async_near(const void *ptr, T&& lambda) {
+    hclib::locale_t *locale = get_locale_near(ptr);
+    if (locale) {
+        hclib::async_at(std::forward<T>(lambda), locale);
+    } else {
+        hclib::async(std::forward<T>(lambda));
+    }
+}
+
 }
 
 #endif
@@ -1,17 +1,437 @@
 #include "hclib_system.h"
 #include "hclib-locality-graph.h"
+#include "hclib-tree.h"
 
 #include <iostream>
+#include <mutex>
 
-static int l1_locale_id, l2_locale_id, l3_locale_id, sysmem_locale_id;
+#include <ctype.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#ifdef __linux__
+#include <linux/mempolicy.h>
+#include <malloc.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+static int l1_locale_id, l2_locale_id, l3_locale_id, numa_locale_id,
+           sysmem_locale_id;
+
+/*
+ * Allocations of at least BIND_THRESHOLD bytes are mapped directly and bound to
+ * the NUMA node owning their locale (or interleaved across all nodes for
+ * sysmem). Smaller ones come from the per-locale pools below, or from malloc
+ * placed by first touch when they do not fit in a size class.
+ */
+#define BIND_THRESHOLD (64 * 1024)
+#define NO_NODE -1
+#define INTERLEAVE_NODES -2
+#define MAX_NUMA_NODES 1024
+#define NODE_MASK_WORDS (MAX_NUMA_NODES / (8 * sizeof(unsigned long)))
+
+#define PARALLEL_COPY_THRESHOLD (4 * 1024 * 1024)
+#define COPY_CHUNK_SIZE (1024 * 1024)
+#define STREAM_COPY_THRESHOLD (8 * 1024 * 1024)
+
+/*
+ * The locale whose workers are nearest to memory at each locale, indexed by id.
+ * Chunks of large copies and tasks spawned with async_near are placed there.
+ */
+static hclib_locale_t **near_locales = NULL;
+
+// NUMA node, NO_NODE or INTERLEAVE_NODES for each locale, indexed by id
+static int *locale_nodes = NULL;
+static unsigned long allowed_nodes[NODE_MASK_WORDS];
+static int n_allowed_nodes = 0;
+
+/*
+ * Selected with HCLIB_HUGE_PAGES. In transparent mode large mappings are
+ * advised to use transparent huge pages, in explicit mode they are backed by
+ * reserved huge pages (MAP_HUGETLB) when any are available.
+ */
+enum huge_page_mode_t {
+    HUGE_PAGES_NONE,
+    HUGE_PAGES_TRANSPARENT,
+    HUGE_PAGES_EXPLICIT
+};
+static huge_page_mode_t huge_page_mode = HUGE_PAGES_NONE;
+static size_t page_size = 4096;
+static size_t huge_page_size = 2 * 1024 * 1024;
+
+/*
+ * All live mappings created by map_pages, with the id of the locale they were
+ * allocated at as their payload, so that async_near can find the owner of any
+ * address inside them.
+ */
+static pthread_rwlock_t mappings_lock = PTHREAD_RWLOCK_INITIALIZER;
+static hclib_memory_tree_node *mappings = NULL;
+
+// NUMA locale for each node, indexed by OS index
+static hclib_locale_t **node_locales = NULL;
+
+/*
+ * Direct-mapped cache of the NUMA locales found for pages outside of any
+ * allocation made by this module. Each entry packs a page number with the id of
+ * its locale plus one, so that it can be read and written without a lock.
+ */
+#define PAGE_CACHE_SIZE 1024
+#define PAGE_CACHE_ID_BITS 16
+static volatile uint64_t page_cache[PAGE_CACHE_SIZE];
+
+/*
+ * Small allocations are served from per-locale size-class pools. Slabs are
+ * carved out of a single reserved range of address space, bound to their
+ * locale's NUMA node, and split into blocks of one power-of-two size class.
+ * Since every slab lives in that range a block can be mapped back to its locale
+ * and class from its address alone. Each worker keeps its own free lists for
+ * every locale and class so the common case takes no locks. A worker list that
+ * grows past POOL_CACHE_SIZE bytes spills half of its blocks to a locked depot
+ * for that locale and class, and an empty worker list is refilled from the
+ * depot before a new slab is carved, so that blocks freed by one worker flow
+ * back to the workers allocating them. Threads that are not hclib workers
+ * allocate from and free to the depots directly.
+ */
+#define POOL_MIN_CLASS_SHIFT 4
+#define POOL_MAX_CLASS_SHIFT 15
+#define POOL_N_CLASSES (POOL_MAX_CLASS_SHIFT - POOL_MIN_CLASS_SHIFT + 1)
+#define POOL_MAX_NBYTES (1UL << POOL_MAX_CLASS_SHIFT)
+#define POOL_SLAB_SHIFT 18
+#define POOL_SLAB_SIZE (1UL << POOL_SLAB_SHIFT)
+#define POOL_ARENA_SIZE (16UL << 30)
+#define POOL_CACHE_SIZE (64UL << 10)
+
+typedef struct _pool_block {
+    struct _pool_block *next;
+} pool_block;
+
+typedef struct _pool_slab {
+    int locale_id;
+    int size_class;
+} pool_slab;
+
+static char *pool_arena = NULL;
+static volatile size_t pool_arena_used = 0;
+// Owner of each slab in the arena, indexed by offset / POOL_SLAB_SIZE
+static pool_slab *pool_slabs = NULL;
+// Free lists indexed by [worker][locale][class], the depots after the workers
+static pool_block **pool_lists = NULL;
+// Number of blocks on each worker's free lists
+static unsigned *pool_counts = NULL;
+static int pool_n_locales = 0;
+static int pool_n_workers = 0;
+static std::mutex pool_shared_lock;
+
+static size_t round_up(size_t nbytes, size_t multiple) {
+    return (nbytes + multiple - 1) / multiple * multiple;
+}
+
+#ifdef __linux__
+static void bind_pages(void *ptr, size_t len, int node) {
+    static bool warned = false;
+    unsigned long mask[NODE_MASK_WORDS];
+    int mode;
+
+    if (node == INTERLEAVE_NODES) {
+        memcpy(mask, allowed_nodes, sizeof(mask));
+        mode = MPOL_INTERLEAVE;
+    } else {
+        memset(mask, 0x00, sizeof(mask));
+        mask[node / (8 * sizeof(unsigned long))] |=
+            1UL << (node % (8 * sizeof(unsigned long)));
+        mode = MPOL_BIND;
+    }
+
+    if (syscall(SYS_mbind, ptr, len, mode, mask, MAX_NUMA_NODES, 0) != 0 &&
+            !warned) {
+        warned = true;
+        fprintf(stderr, "WARNING: mbind failed (%s), falling back to first "
+                "touch placement\n", strerror(errno));
+    }
+}
+
+static int get_locale_node(hclib_locale_t *locale) {
+    return locale_nodes ? locale_nodes[locale->id] : NO_NODE;
+}
+
+static void register_mapping(void *ptr, size_t len, int locale_id) {
+    pthread_rwlock_wrlock(&mappings_lock);
+    hclib_memory_tree_insert_data(ptr, len, (void *)(intptr_t)locale_id,
+            &mappings);
+    pthread_rwlock_unlock(&mappings_lock);
+}
+
+static void *map_pages(size_t nbytes, hclib_locale_t *locale) {
+    const int node = get_locale_node(locale);
+    void *ptr = MAP_FAILED;
+    size_t len;
+
+    if (huge_page_mode == HUGE_PAGES_EXPLICIT && nbytes >= huge_page_size) {
+        len = round_up(nbytes, huge_page_size);
+        ptr = mmap(NULL, len, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    }
+
+    if (ptr == MAP_FAILED) {
+        len = round_up(nbytes, page_size);
+        ptr = mmap(NULL, len, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (ptr == MAP_FAILED) return NULL;
+
+        // Explicit mode falls back to transparent huge pages
+        if (huge_page_mode != HUGE_PAGES_NONE && len >= huge_page_size) {
+            madvise(ptr, len, MADV_HUGEPAGE);
+        }
+    }
+
+    // Pages are only placed when first faulted in, so bind before touching
+    if (node != NO_NODE) bind_pages(ptr, len, node);
+
+    register_mapping(ptr, len, locale->id);
+    return ptr;
+}
+
+/*
+ * Remove ptr from the live mappings, returning its length and storing the id of
+ * its locale in locale_id, or returning 0 if it was not mapped.
+ */
+static size_t unregister_mapping(void *ptr, int *locale_id) {
+    size_t len = 0;
+    pthread_rwlock_wrlock(&mappings_lock);
+    hclib_memory_tree_node *mapping = (mappings && ptr ?
+            hclib_memory_tree_find(ptr, &mappings) : NULL);
+    if (mapping && mapping->start_address == ptr) {
+        len = mapping->length;
+        *locale_id = (int)(intptr_t)mapping->data;
+        hclib_memory_tree_remove(ptr, &mappings);
+    }
+    pthread_rwlock_unlock(&mappings_lock);
+    return len;
+}
+
+static bool should_map(size_t nbytes, hclib_locale_t *locale) {
+    return nbytes >= BIND_THRESHOLD && (get_locale_node(locale) != NO_NODE ||
+            huge_page_mode != HUGE_PAGES_NONE);
+}
+
+static int pool_size_class(size_t nbytes) {
+    if (nbytes <= (1UL << POOL_MIN_CLASS_SHIFT)) return 0;
+    return (int)(8 * sizeof(unsigned long)) - __builtin_clzl(nbytes - 1) -
+        POOL_MIN_CLASS_SHIFT;
+}
+
+// Returns the slab ptr was carved from, or NULL if it is not a pool block
+static pool_slab *pool_slab_for(void *ptr) {
+    if (pool_arena == NULL || (char *)ptr < pool_arena ||
+            (size_t)((char *)ptr - pool_arena) >= pool_arena_used) {
+        return NULL;
+    }
+    return pool_slabs + (((char *)ptr - pool_arena) >> POOL_SLAB_SHIFT);
+}
+
+// Index of the free list of list_owner (a worker id, or pool_n_workers)
+static size_t pool_list_index(int list_owner, int locale_id, int size_class) {
+    return ((size_t)list_owner * pool_n_locales + locale_id) * POOL_N_CLASSES +
+        size_class;
+}
+
+// Number of blocks a worker list may hold before spilling to the depot
+static unsigned pool_cache_blocks(int size_class) {
+    const unsigned nblocks = (unsigned)(POOL_CACHE_SIZE >>
+            (size_class + POOL_MIN_CLASS_SHIFT));
+    return (nblocks < 2 ? 2 : nblocks);
+}
+
+/*
+ * Carve a new slab bound to locale into blocks and push them on list,
+ * returning the number of blocks added.
+ */
+static unsigned pool_refill(pool_block **list, hclib_locale_t *locale,
+        int size_class) {
+    const size_t offset = __sync_fetch_and_add(&pool_arena_used,
+            POOL_SLAB_SIZE);
+    if (offset + POOL_SLAB_SIZE > POOL_ARENA_SIZE) return 0;
+
+    char *slab = pool_arena + offset;
+    if (mprotect(slab, POOL_SLAB_SIZE, PROT_READ | PROT_WRITE) != 0) return 0;
+    const int node = get_locale_node(locale);
+    if (node != NO_NODE) bind_pages(slab, POOL_SLAB_SIZE, node);
+
+    pool_slab *info = pool_slabs + (offset >> POOL_SLAB_SHIFT);
+    info->locale_id = locale->id;
+    info->size_class = size_class;
+
+    // Linking the blocks also first-touches the slab from this worker
+    const size_t block_size = 1UL << (size_class + POOL_MIN_CLASS_SHIFT);
+    size_t i;
+    for (i = POOL_SLAB_SIZE; i >= block_size; i -= block_size) {
+        pool_block *block = (pool_block *)(slab + i - block_size);
+        block->next = *list;
+        *list = block;
+    }
+    return (unsigned)(POOL_SLAB_SIZE / block_size);
+}
+
+// Move up to max blocks from depot onto the empty list, returning how many
+static unsigned pool_take(pool_block **list, pool_block **depot,
+        unsigned max) {
+    unsigned nblocks = 0;
+    pool_shared_lock.lock();
+    pool_block *head = *depot;
+    pool_block *tail = NULL;
+    for (pool_block *block = head; block && nblocks < max;
+            block = block->next) {
+        tail = block;
+        nblocks++;
+    }
+    if (tail) {
+        *depot = tail->next;
+        tail->next = NULL;
+        *list = head;
+    }
+    pool_shared_lock.unlock();
+    return nblocks;
+}
+
+// Keep the first keep blocks of list and push the rest onto depot
+static void pool_spill(pool_block **list, pool_block **depot, unsigned keep) {
+    pool_block *last = *list;
+    for (unsigned i = 1; i < keep; i++) last = last->next;
+    pool_block *excess = last->next;
+    last->next = NULL;
+
+    pool_block *tail = excess;
+    while (tail->next) tail = tail->next;
+
+    pool_shared_lock.lock();
+    tail->next = *depot;
+    *depot = excess;
+    pool_shared_lock.unlock();
+}
+
+static void *pool_alloc(size_t nbytes, hclib_locale_t *locale) {
+    if (pool_lists == NULL || nbytes > POOL_MAX_NBYTES ||
+            locale->id >= pool_n_locales) {
+        return NULL;
+    }
+
+    hclib_worker_state *ws = CURRENT_WS_INTERNAL;
+    const int size_class = pool_size_class(nbytes);
+    pool_block **depot = pool_lists + pool_list_index(pool_n_workers,
+            locale->id, size_class);
+    pool_block *block;
+
+    if (ws == NULL) {
+        pool_shared_lock.lock();
+        if (*depot == NULL) pool_refill(depot, locale, size_class);
+        block = *depot;
+        if (block) *depot = block->next;
+        pool_shared_lock.unlock();
+        return block;
+    }
+
+    const size_t index = pool_list_index(ws->id, locale->id, size_class);
+    pool_block **list = pool_lists + index;
+    if (*list == NULL) {
+        pool_counts[index] = pool_take(list, depot,
+                pool_cache_blocks(size_class) / 2);
+    }
+    if (*list == NULL) {
+        pool_counts[index] = pool_refill(list, locale, size_class);
+    }
+    block = *list;
+    if (block) {
+        *list = block->next;
+        pool_counts[index]--;
+    }
+    return block;
+}
+
+static void pool_free(void *ptr, pool_slab *slab) {
+    // Blocks from a previous launch with more locales are simply dropped
+    if (slab->locale_id >= pool_n_locales) return;
+
+    hclib_worker_state *ws = CURRENT_WS_INTERNAL;
+    pool_block **depot = pool_lists + pool_list_index(pool_n_workers,
+            slab->locale_id, slab->size_class);
+    pool_block *block = (pool_block *)ptr;
+
+    if (ws == NULL) {
+        pool_shared_lock.lock();
+        block->next = *depot;
+        *depot = block;
+        pool_shared_lock.unlock();
+        return;
+    }
+
+    const size_t index = pool_list_index(ws->id, slab->locale_id,
+            slab->size_class);
+    pool_block **list = pool_lists + index;
+    block->next = *list;
+    *list = block;
+
+    const unsigned cache_blocks = pool_cache_blocks(slab->size_class);
+    if (++pool_counts[index] > cache_blocks) {
+        pool_spill(list, depot, cache_blocks / 2);
+        pool_counts[index] = cache_blocks / 2;
+    }
+}
+
+static void init_pools() {
+    if (pool_arena == NULL) {
+        void *arena = mmap(NULL, POOL_ARENA_SIZE, PROT_NONE,
+                MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (arena == MAP_FAILED) {
+            fprintf(stderr, "WARNING: Unable to reserve memory for locale "
+                    "pools, falling back to malloc\n");
+            return;
+        }
+        pool_arena = (char *)arena;
+        pool_slabs = (pool_slab *)calloc(POOL_ARENA_SIZE / POOL_SLAB_SIZE,
+                sizeof(pool_slab));
+        assert(pool_slabs);
+    }
+
+    // Blocks still on the lists of a previous launch are abandoned
+    free(pool_lists);
+    free(pool_counts);
+    pool_n_locales = hclib_get_num_locales();
+    pool_n_workers = hclib_get_num_workers();
+    pool_lists = (pool_block **)calloc((size_t)(pool_n_workers + 1) *
+            pool_n_locales * POOL_N_CLASSES, sizeof(pool_block *));
+    assert(pool_lists);
+    pool_counts = (unsigned *)calloc((size_t)pool_n_workers *
+            pool_n_locales * POOL_N_CLASSES, sizeof(unsigned));
+    assert(pool_counts);
+}
+#endif
 
 static void *allocation_func(size_t nbytes, hclib_locale_t *locale) {
-    void *ptr = malloc(nbytes);
+    void *ptr = NULL;
+#ifdef __linux__
+    if (should_map(nbytes, locale)) {
+        ptr = map_pages(nbytes, locale);
+    } else {
+        ptr = pool_alloc(nbytes, locale);
+    }
+    if (ptr == NULL)
+#endif
+    {
+        ptr = malloc(nbytes);
+        if (ptr) memset(ptr, 42, 1); // first touch allocation
+    }
 #ifdef VERBOSE
     std::cerr << __func__ << " ptr=" << ptr << " nbytes=" << nbytes <<
         " locale=" << locale << std::endl;
 #endif
-    if (ptr) memset(ptr, 42, 1); // first touch allocation
     return ptr;
 }
 
@@ -20,6 +440,41 @@ static void *reallocation_func(void *old, size_t nbytes,
 #ifdef VERBOSE
     std::cerr << __func__ << " old=" << old << " nbytes=" << nbytes <<
         " locale=" << locale << std::endl;
+#endif
+#ifdef __linux__
+    pool_slab *slab = (old ? pool_slab_for(old) : NULL);
+    if (slab) {
+        const size_t block_size = 1UL << (slab->size_class +
+                POOL_MIN_CLASS_SHIFT);
+        if (nbytes <= block_size) return old;
+
+        void *ptr = allocation_func(nbytes, locale);
+        if (ptr) {
+            memcpy(ptr, old, block_size);
+            pool_free(old, slab);
+        }
+        return ptr;
+    }
+
+    int old_locale_id;
+    const size_t old_len = unregister_mapping(old, &old_locale_id);
+    if (old_len > 0 || should_map(nbytes, locale)) {
+        void *ptr = allocation_func(nbytes, locale);
+        if (ptr == NULL) {
+            if (old_len > 0) register_mapping(old, old_len, old_locale_id);
+            return NULL;
+        }
+
+        const size_t old_nbytes = (old_len > 0 ? old_len :
+                malloc_usable_size(old));
+        memcpy(ptr, old, old_nbytes < nbytes ? old_nbytes : nbytes);
+        if (old_len > 0) {
+            munmap(old, old_len);
+        } else {
+            free(old);
+        }
+        return ptr;
+    }
 #endif
     void *ptr = realloc(old, nbytes);
     return ptr;
@@ -29,6 +484,20 @@ static void free_func(void *ptr, hclib_locale_t *locale) {
 #ifdef VERBOSE
     std::cerr << __func__ << " ptr=" << ptr << " locale=" << locale <<
         std::endl;
+#endif
+#ifdef __linux__
+    pool_slab *slab = (ptr ? pool_slab_for(ptr) : NULL);
+    if (slab) {
+        pool_free(ptr, slab);
+        return;
+    }
+
+    int locale_id;
+    const size_t len = unregister_mapping(ptr, &locale_id);
+    if (len > 0) {
+        munmap(ptr, len);
+        return;
+    }
 #endif
     free(ptr);
 }
@@ -42,53 +511,328 @@ static void memset_func(void *ptr, int val, size_t nbytes,
     memset(ptr, val, nbytes);
 }
 
+/*
+ * Copy with non-temporal stores, so that a large copy does not evict the whole
+ * cache only to fill it with a destination that will not be read soon.
+ */
+static void stream_copy(void *dst, const void *src, size_t nbytes) {
+#ifdef __SSE2__
+    char *d = (char *)dst;
+    const char *s = (const char *)src;
+
+    // Streaming stores need an aligned destination
+    const size_t head = (16 - ((uintptr_t)d & 15)) & 15;
+    if (head >= nbytes) {
+        memcpy(d, s, nbytes);
+        return;
+    }
+    memcpy(d, s, head);
+    d += head;
+    s += head;
+    nbytes -= head;
+
+    size_t i;
+    for (i = 0; i + 64 <= nbytes; i += 64) {
+        const __m128i a = _mm_loadu_si128((const __m128i *)(s + i));
+        const __m128i b = _mm_loadu_si128((const __m128i *)(s + i + 16));
+        const __m128i c = _mm_loadu_si128((const __m128i *)(s + i + 32));
+        const __m128i e = _mm_loadu_si128((const __m128i *)(s + i + 48));
+        _mm_stream_si128((__m128i *)(d + i), a);
+        _mm_stream_si128((__m128i *)(d + i + 16), b);
+        _mm_stream_si128((__m128i *)(d + i + 32), c);
+        _mm_stream_si128((__m128i *)(d + i + 48), e);
+    }
+    memcpy(d + i, s + i, nbytes - i);
+    // Order the streaming stores before whatever signals completion
+    _mm_sfence();
+#else
+    memcpy(dst, src, nbytes);
+#endif
+}
+
+static void copy_range(void *dst, const void *src, size_t nbytes,
+        bool streaming) {
+    if (streaming) {
+        stream_copy(dst, src, nbytes);
+    } else {
+        memcpy(dst, src, nbytes);
+    }
+}
+
+/*
+ * Copies of at least PARALLEL_COPY_THRESHOLD bytes are split into chunks of
+ * about COPY_CHUNK_SIZE bytes, each ending on a page boundary of the
+ * destination, and copied by tasks placed near the destination. Copies of at
+ * least STREAM_COPY_THRESHOLD bytes use non-temporal stores.
+ */
 static void copy_func(hclib_locale_t *dst_locale, void *dst,
         hclib_locale_t *src_locale, void *src, size_t nbytes) {
-    memcpy(dst, src, nbytes);
+    const bool streaming = (nbytes >= STREAM_COPY_THRESHOLD);
+    if (nbytes < PARALLEL_COPY_THRESHOLD || hclib::get_num_workers() == 1) {
+        copy_range(dst, src, nbytes, streaming);
+        return;
+    }
+
+    hclib_locale_t *chunk_locale = (near_locales ?
+            near_locales[dst_locale->id] : dst_locale);
+    hclib::finish([=] {
+        char *d = (char *)dst;
+        const char *s = (const char *)src;
+        size_t offset = 0;
+        while (offset < nbytes) {
+            const uintptr_t end_addr = round_up((uintptr_t)d + offset +
+                    COPY_CHUNK_SIZE, page_size);
+            const size_t end = (end_addr - (uintptr_t)d < nbytes ?
+                    end_addr - (uintptr_t)d : nbytes);
+            hclib::async_at([=] {
+                copy_range(d + offset, s + offset, end - offset, streaming);
+            }, chunk_locale);
+            offset = end;
+        }
+    });
 }
 
+/*
+ * Work on memory at a locale is placed at the NUMA locale closest to it when
+ * there is one, so that the workers on that node run it, and otherwise at
+ * sysmem where any worker may pick it up.
+ */
+static void init_near_locales() {
+    int i;
+    const int n_locales = hclib_get_num_locales();
+    hclib_locale_t *locales = hclib_get_all_locales();
+    const bool have_numa = hclib_get_num_locales_of_type(numa_locale_id) > 0;
+    const bool have_sysmem = hclib_get_num_locales_of_type(
+            sysmem_locale_id) > 0;
+
+    near_locales = (hclib_locale_t **)malloc(n_locales *
+            sizeof(hclib_locale_t *));
+    assert(near_locales);
+
+    for (i = 0; i < n_locales; i++) {
+        hclib_locale_t *locale = locales + i;
+        hclib_locale_t *near = NULL;
+        if (have_numa) {
+            near = hclib_get_closest_locale_of_type(locale, numa_locale_id);
+        }
+        if (near == NULL && have_sysmem) {
+            near = hclib_get_closest_locale_of_type(locale, sysmem_locale_id);
+        }
+        near_locales[i] = (near ? near : locale);
+    }
+}
+
+#ifdef __linux__
+// NUMA locales are expected to end in the OS index of their node, e.g. NUMA_1
+static int parse_node_from_label(const char *lbl) {
+    const char *end = lbl + strlen(lbl);
+    const char *start = end;
+    while (start > lbl && isdigit(start[-1])) start--;
+    if (start == end) return NO_NODE;
+
+    const int node = atoi(start);
+    if (node >= MAX_NUMA_NODES || !(allowed_nodes[node /
+                (8 * sizeof(unsigned long))] & (1UL << (node %
+                        (8 * sizeof(unsigned long)))))) {
+        return NO_NODE;
+    }
+    return node;
+}
+
+static void init_memory_placement() {
+    int i;
+
+    page_size = sysconf(_SC_PAGESIZE);
+    FILE *meminfo = fopen("/proc/meminfo", "r");
+    if (meminfo) {
+        char line[256];
+        unsigned long kb;
+        while (fgets(line, sizeof(line), meminfo)) {
+            if (sscanf(line, "Hugepagesize: %lu kB", &kb) == 1) {
+                huge_page_size = kb * 1024;
+                break;
+            }
+        }
+        fclose(meminfo);
+    }
+
+    const char *huge_pages = getenv("HCLIB_HUGE_PAGES");
+    if (huge_pages) {
+        if (strcmp(huge_pages, "none") == 0) {
+            huge_page_mode = HUGE_PAGES_NONE;
+        } else if (strcmp(huge_pages, "transparent") == 0) {
+            huge_page_mode = HUGE_PAGES_TRANSPARENT;
+        } else if (strcmp(huge_pages, "explicit") == 0) {
+            huge_page_mode = HUGE_PAGES_EXPLICIT;
+        } else {
+            fprintf(stderr, "Unsupported huge page mode \"%s\" specified "
+                    "with HCLIB_HUGE_PAGES.\n", huge_pages);
+            exit(1);
+        }
+    }
+
+    memset(allowed_nodes, 0x00, sizeof(allowed_nodes));
+    if (syscall(SYS_get_mempolicy, NULL, allowed_nodes, MAX_NUMA_NODES, NULL,
+                MPOL_F_MEMS_ALLOWED) != 0) {
+        // No NUMA support in the kernel, leave everything to first touch
+        return;
+    }
+    for (i = 0; i < (int)NODE_MASK_WORDS; i++) {
+        n_allowed_nodes += __builtin_popcountl(allowed_nodes[i]);
+    }
+
+    const int n_locales = hclib_get_num_locales();
+    hclib_locale_t *locales = hclib_get_all_locales();
+    const bool have_numa = hclib_get_num_locales_of_type(numa_locale_id) > 0;
+    locale_nodes = (int *)malloc(n_locales * sizeof(int));
+    assert(locale_nodes);
+
+    for (i = 0; i < n_locales; i++) {
+        hclib_locale_t *locale = locales + i;
+        locale_nodes[i] = NO_NODE;
+
+        if (locale->type == sysmem_locale_id) {
+            if (n_allowed_nodes > 1) locale_nodes[i] = INTERLEAVE_NODES;
+        } else if (have_numa && (locale->type == l1_locale_id ||
+                    locale->type == l2_locale_id ||
+                    locale->type == l3_locale_id ||
+                    locale->type == numa_locale_id)) {
+            hclib_locale_t *numa = hclib_get_closest_locale_of_type(locale,
+                    numa_locale_id);
+            if (numa) locale_nodes[i] = parse_node_from_label(numa->lbl);
+        }
+
+        if (locale->type == numa_locale_id) {
+            const int node = parse_node_from_label(locale->lbl);
+            if (node != NO_NODE) {
+                if (node_locales == NULL) {
+                    node_locales = (hclib_locale_t **)calloc(MAX_NUMA_NODES,
+                            sizeof(hclib_locale_t *));
+                    assert(node_locales);
+                }
+                node_locales[node] = locale;
+            }
+        }
+    }
+}
+
+// The NUMA locale holding the page at ptr according to the kernel, or NULL
+static hclib_locale_t *get_page_locale(const void *ptr) {
+    if (node_locales == NULL) return NULL;
+
+    void *page = (void *)((uintptr_t)ptr & ~(uintptr_t)(page_size - 1));
+    const uint64_t page_number = (uintptr_t)page / page_size;
+    volatile uint64_t *entry = page_cache + page_number % PAGE_CACHE_SIZE;
+    const uint64_t cached = *entry;
+    if (cached != 0 && (cached >> PAGE_CACHE_ID_BITS) == page_number) {
+        return hclib_get_all_locales() + ((cached &
+                    ((1UL << PAGE_CACHE_ID_BITS) - 1)) - 1);
+    }
+
+    // Without a nodes array move_pages only reports where each page is
+    int status = -1;
+    if (syscall(SYS_move_pages, 0, 1UL, &page, NULL, &status, 0) != 0 ||
+            status < 0 || status >= MAX_NUMA_NODES) {
+        return NULL;
+    }
+    hclib_locale_t *locale = node_locales[status];
+    if (locale && locale->id + 1 < (1 << PAGE_CACHE_ID_BITS)) {
+        *entry = (page_number << PAGE_CACHE_ID_BITS) | (locale->id + 1);
+    }
+    return locale;
+}
+#endif
+
 HCLIB_MODULE_PRE_INITIALIZATION_FUNC(system_pre_initialize) {
     l1_locale_id = hclib_add_known_locale_type("L1");
     l2_locale_id = hclib_add_known_locale_type("L2");
     l3_locale_id = hclib_add_known_locale_type("L3");
+    numa_locale_id = hclib_add_known_locale_type("NUMA");
     sysmem_locale_id = hclib_add_known_locale_type("sysmem");
 }
 
 HCLIB_MODULE_INITIALIZATION_FUNC(system_post_initialize) {
+#ifdef __linux__
+    init_memory_placement();
+    init_pools();
+#endif
+    init_near_locales();
+
     hclib_register_alloc_func(l1_locale_id, allocation_func);
     hclib_register_alloc_func(l2_locale_id, allocation_func);
     hclib_register_alloc_func(l3_locale_id, allocation_func);
+    hclib_register_alloc_func(numa_locale_id, allocation_func);
     hclib_register_alloc_func(sysmem_locale_id, allocation_func);
 
     hclib_register_realloc_func(l1_locale_id, reallocation_func);
     hclib_register_realloc_func(l2_locale_id, reallocation_func);
     hclib_register_realloc_func(l3_locale_id, reallocation_func);
+    hclib_register_realloc_func(numa_locale_id, reallocation_func);
     hclib_register_realloc_func(sysmem_locale_id, reallocation_func);
 
     hclib_register_free_func(l1_locale_id, free_func);
     hclib_register_free_func(l2_locale_id, free_func);
     hclib_register_free_func(l3_locale_id, free_func);
+    hclib_register_free_func(numa_locale_id, free_func);
     hclib_register_free_func(sysmem_locale_id, free_func);
 
     hclib_register_memset_func(l1_locale_id, memset_func);
     hclib_register_memset_func(l2_locale_id, memset_func);
     hclib_register_memset_func(l3_locale_id, memset_func);
+    hclib_register_memset_func(numa_locale_id, memset_func);
     hclib_register_memset_func(sysmem_locale_id, memset_func);
 
     hclib_register_copy_func(l1_locale_id, copy_func, MAY_USE);
     hclib_register_copy_func(l2_locale_id, copy_func, MAY_USE);
     hclib_register_copy_func(l3_locale_id, copy_func, MAY_USE);
+    hclib_register_copy_func(numa_locale_id, copy_func, MAY_USE);
     hclib_register_copy_func(sysmem_locale_id, copy_func, MAY_USE);
 }
 
 HCLIB_MODULE_INITIALIZATION_FUNC(system_finalize) {
+    free(locale_nodes);
+    locale_nodes = NULL;
+    free(near_locales);
+    near_locales = NULL;
+#ifdef __linux__
+    free(node_locales);
+    node_locales = NULL;
+    memset((void *)page_cache, 0x00, sizeof(page_cache));
+#endif
+    // Pool blocks stay valid, the lists are only replaced by the next launch
 }
 
 hclib::locale_t *hclib::get_closest_cpu_locale() {
-    int type_arr[4] = { l1_locale_id, l2_locale_id, l3_locale_id,
-        sysmem_locale_id };
+    int type_arr[5] = { l1_locale_id, l2_locale_id, l3_locale_id,
+        numa_locale_id, sysmem_locale_id };
     return hclib_get_closest_locale_of_types(hclib_get_closest_locale(),
-            type_arr, 4);
+            type_arr, 5);
+}
+
+hclib::locale_t *hclib::get_locale_near(const void *ptr) {
+    if (near_locales == NULL || ptr == NULL) return NULL;
+#ifdef __linux__
+    const int n_locales = hclib_get_num_locales();
+    pool_slab *slab = pool_slab_for((void *)ptr);
+    if (slab) {
+        return (slab->locale_id < n_locales ? near_locales[slab->locale_id] :
+                NULL);
+    }
+
+    int locale_id = -1;
+    pthread_rwlock_rdlock(&mappings_lock);
+    hclib_memory_tree_node *mapping = (mappings ?
+            hclib_memory_tree_find((void *)ptr, &mappings) : NULL);
+    if (mapping) locale_id = (int)(intptr_t)mapping->data;
+    pthread_rwlock_unlock(&mappings_lock);
+    if (mapping) {
+        return (locale_id < n_locales ? near_locales[locale_id] : NULL);
+    }
+
+    return get_page_locale(ptr);
+#else
+    return NULL;
+#endif
 }
 
 HCLIB_REGISTER_MODULE("system", system_pre_initialize, system_post_initialize, system_finalize)
@@ -10,7 +10,7 @@ int main(int argc, char **argv) {
         int N = 1024;
 
         hclib::locale_t *locale = hclib::get_closest_locale();
-        hclib::future_t *fut = hclib::allocate_at(N * sizeof(double), locale);
+        hclib::future_t<void*> *fut = hclib::allocate_at(N * sizeof(double), locale);
         double *alloc = (double *)fut->wait();
         assert(alloc);
         for (i = 0; i < N; i++) alloc[i] = i;
@@ -0,0 +1,149 @@
+/*
+ * Allocates small (pooled) and large arrays at each CPU locale, then checks
+ * that get_locale_near maps their first, interior and last bytes back to the
+ * NUMA locale closest to where they were allocated (or sysmem without NUMA
+ * locales), and that tasks spawned with async_near over chunks of them all
+ * run. Large arrays are only tracked in the range tree when they are mapped, so
+ * run with HCLIB_HUGE_PAGES=transparent on machines without NUMA locales to
+ * cover it.
+ * Finally the cost of a lookup is reported.
+ *
+ * Usage: async_near [large array bytes] [narrays per locale]
+ */
+#include "hclib_cpp.h"
+#include "hclib_system.h"
+
+#include <iostream>
+
+#define MAX_LOCALES 16
+#define SMALL_NBYTES 1000
+#define CHUNK_SIZE (64 * 1024)
+
+static volatile int nerrors = 0;
+static volatile long long nchunks_run = 0;
+
+static void add_locale(hclib::locale_t **locales, int *nlocales,
+        hclib::locale_t *locale) {
+    for (int i = 0; i < *nlocales; i++) {
+        if (locales[i] == locale) return;
+    }
+    assert(*nlocales < MAX_LOCALES);
+    locales[(*nlocales)++] = locale;
+}
+
+static hclib::locale_t *expected_near(hclib::locale_t *locale) {
+    const unsigned numa_type = hclib_add_known_locale_type("NUMA");
+    hclib::locale_t *near = NULL;
+    if (hclib_get_num_locales_of_type(numa_type) > 0) {
+        near = hclib_get_closest_locale_of_type(locale, numa_type);
+    }
+    if (near == NULL) {
+        near = hclib_get_closest_locale_of_type(locale,
+                hclib_add_known_locale_type("sysmem"));
+    }
+    return near;
+}
+
+static void check_near(const char *ptr, size_t nbytes,
+        hclib::locale_t *expected, bool may_be_unknown) {
+    const char *probes[3] = { ptr, ptr + nbytes / 2, ptr + nbytes - 1 };
+    for (int p = 0; p < 3; p++) {
+        hclib::locale_t *near = hclib::get_locale_near(probes[p]);
+        if (near != expected && !(may_be_unknown && near == NULL)) {
+            std::cerr << "get_locale_near(" << (void *)probes[p] << ") = " <<
+                (near ? near->lbl : "NULL") << ", expected " <<
+                expected->lbl << std::endl;
+            __sync_fetch_and_add(&nerrors, 1);
+        }
+    }
+}
+
+int main(int argc, char **argv) {
+    size_t nbytes = 1024 * 1024;
+    int narrays = 8;
+    if (argc > 1) nbytes = atol(argv[1]);
+    if (argc > 2) narrays = atoi(argv[2]);
+
+    const char *deps[] = { "system" };
+    hclib::launch(deps, 1, [nbytes, narrays] {
+        const char *types[] = { "sysmem", "NUMA", "L3", "L2", "L1" };
+        hclib::locale_t *locales[MAX_LOCALES];
+        int nlocales = 0;
+        for (unsigned t = 0; t < sizeof(types) / sizeof(types[0]); t++) {
+            int count;
+            hclib::locale_t **of_type = hclib::get_all_locales_of_type(
+                    hclib_add_known_locale_type(types[t]), &count);
+            if (count > 0) {
+                add_locale(locales, &nlocales, of_type[0]);
+                add_locale(locales, &nlocales, of_type[count - 1]);
+            }
+            free(of_type);
+        }
+
+        const int nbuffers = nlocales * narrays;
+        char **small = (char **)malloc(nbuffers * sizeof(*small));
+        char **large = (char **)malloc(nbuffers * sizeof(*large));
+        assert(small && large);
+        for (int i = 0; i < nbuffers; i++) {
+            hclib::locale_t *locale = locales[i % nlocales];
+            small[i] = (char *)hclib::allocate_at(SMALL_NBYTES,
+                    locale)->wait();
+            large[i] = (char *)hclib::allocate_at(nbytes, locale)->wait();
+            assert(small[i] && large[i]);
+            memset(large[i], 0x00, nbytes);
+        }
+
+        // Free every other array so that ranges are removed from the tree
+        for (int i = 0; i < nbuffers; i += 2) {
+            hclib::free_at(large[i], locales[i % nlocales]);
+            large[i] = NULL;
+        }
+
+        for (int i = 0; i < nbuffers; i++) {
+            hclib::locale_t *expected = expected_near(locales[i % nlocales]);
+            check_near(small[i], SMALL_NBYTES, expected, false);
+            if (large[i]) check_near(large[i], nbytes, expected, true);
+        }
+
+        hclib::finish([=] {
+            for (int i = 1; i < nbuffers; i += 2) {
+                for (size_t start = 0; start < nbytes; start += CHUNK_SIZE) {
+                    char *chunk = large[i] + start;
+                    const size_t len = (start + CHUNK_SIZE < nbytes ?
+                            CHUNK_SIZE : nbytes - start);
+                    hclib::async_near(chunk, [=] {
+                        memset(chunk, 0x01, len);
+                        __sync_fetch_and_add(&nchunks_run, 1);
+                    });
+                }
+            }
+        });
+        const long long nchunks = (long long)(nbuffers / 2) *
+            ((nbytes + CHUNK_SIZE - 1) / CHUNK_SIZE);
+        if (nchunks_run != nchunks) __sync_fetch_and_add(&nerrors, 1);
+
+        const int nreps = 100000;
+        const unsigned long long start_time = hclib_current_time_ns();
+        for (int i = 0; i < nreps; i++) {
+            hclib::get_locale_near(large[1 + 2 * (i % (nbuffers / 2))] +
+                    (i % nbytes));
+        }
+        const unsigned long long elapsed = hclib_current_time_ns() -
+            start_time;
+        std::cout << nreps << " lookups in " << (elapsed / 1000) << " us (" <<
+            ((double)elapsed / nreps) << " ns each)" << std::endl;
+
+        for (int i = 0; i < nbuffers; i++) {
+            hclib::locale_t *locale = locales[i % nlocales];
+            hclib::free_at(small[i], locale);
+            if (large[i]) hclib::free_at(large[i], locale);
+        }
+        free(small);
+        free(large);
+
+        std::cout << "Check results: " << (nerrors == 0 ? "OK" : "FAILED") <<
+            std::endl;
+        assert(nerrors == 0);
+    });
+    return 0;
+}
@@ -0,0 +1,103 @@
+/*
+ * Measures hclib::async_copy bandwidth between pairs of CPU locales: sysmem and
+ * the first and last locale of each cache/NUMA type in the locality graph. A
+ * plain memcpy from the launching task is reported first for reference. To
+ * reproduce the davinci layout without its GPU and interconnect locales, run
+ * with
+ *
+ *   HCLIB_LOCALITY_FILE=locality_graphs/davinci.no_gpu.no_interconnect.json
+ *
+ * Usage: copy_bandwidth [MB per copy] [ntrials]
+ */
+#include "hclib_cpp.h"
+#include "hclib_system.h"
+
+#include <float.h>
+#include <string.h>
+#include <iostream>
+
+#define MAX_LOCALES 16
+
+static void add_locale(hclib::locale_t **locales, int *nlocales,
+        hclib::locale_t *locale) {
+    for (int i = 0; i < *nlocales; i++) {
+        if (locales[i] == locale) return;
+    }
+    assert(*nlocales < MAX_LOCALES);
+    locales[(*nlocales)++] = locale;
+}
+
+int main(int argc, char **argv) {
+    size_t mb = 64;
+    int ntrials = 5;
+    if (argc > 1) mb = atol(argv[1]);
+    if (argc > 2) ntrials = atoi(argv[2]);
+    const size_t nbytes = mb * 1024 * 1024;
+
+    const char *deps[] = { "system" };
+    hclib::launch(deps, 1, [nbytes, ntrials] {
+        const char *types[] = { "sysmem", "NUMA", "L3", "L2", "L1" };
+        hclib::locale_t *locales[MAX_LOCALES];
+        int nlocales = 0;
+        for (unsigned t = 0; t < sizeof(types) / sizeof(types[0]); t++) {
+            int count;
+            hclib::locale_t **of_type = hclib::get_all_locales_of_type(
+                    hclib_add_known_locale_type(types[t]), &count);
+            if (count > 0) {
+                add_locale(locales, &nlocales, of_type[0]);
+                add_locale(locales, &nlocales, of_type[count - 1]);
+            }
+            free(of_type);
+        }
+
+        char *buffers[MAX_LOCALES];
+        for (int l = 0; l < nlocales; l++) {
+            buffers[l] = (char *)hclib::allocate_at(nbytes, locales[l])->wait();
+            assert(buffers[l]);
+            hclib::memset_at(buffers[l], l + 1, nbytes, locales[l])->wait();
+        }
+
+        double best = DBL_MAX;
+        for (int t = 0; t < ntrials; t++) {
+            const unsigned long long start_time = hclib_current_time_ns();
+            memcpy(buffers[0], buffers[nlocales - 1], nbytes);
+            const double elapsed = (hclib_current_time_ns() - start_time) /
+                1e9;
+            if (elapsed < best) best = elapsed;
+        }
+        std::cout << "memcpy: " << (nbytes / best / 1e9) << " GB/s" <<
+            std::endl;
+
+        int nerrors = 0;
+        for (int s = 0; s < nlocales; s++) {
+            for (int d = 0; d < nlocales; d++) {
+                if (s == d) continue;
+
+                // Mark the source so that each pair copies fresh contents
+                memset(buffers[s], s * nlocales + d, nbytes);
+                best = DBL_MAX;
+                for (int t = 0; t < ntrials; t++) {
+                    const unsigned long long start_time =
+                        hclib_current_time_ns();
+                    hclib::async_copy(locales[d], buffers[d], locales[s],
+                            buffers[s], nbytes)->wait();
+                    const double elapsed = (hclib_current_time_ns() -
+                            start_time) / 1e9;
+                    if (elapsed < best) best = elapsed;
+                }
+                if (memcmp(buffers[d], buffers[s], nbytes) != 0) nerrors++;
+
+                std::cout << locales[s]->lbl << " -> " << locales[d]->lbl <<
+                    ": " << (nbytes / best / 1e9) << " GB/s" << std::endl;
+            }
+        }
+
+        for (int l = 0; l < nlocales; l++) {
+            hclib::free_at(buffers[l], locales[l]);
+        }
+        std::cout << "Check results: " << (nerrors == 0 ? "OK" : "FAILED") <<
+            std::endl;
+        assert(nerrors == 0);
+    });
+    return 0;
+}
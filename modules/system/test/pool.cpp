@@ -0,0 +1,132 @@
+/*
+ * Exercises the per-locale allocation pools. Many tasks allocate, fill, grow and
+ * free blocks of every size class at each CPU locale, checking that no two live
+ * blocks overlap, then the rate of allocate/free pairs made from tasks that own
+ * the locale (and so get already satisfied futures) is reported. Blocks
+ * allocated on one worker and freed on another must find their way back to the
+ * allocating worker rather than it carving new slabs forever.
+ *
+ * Usage: pool [ntasks] [allocs per task]
+ */
+#include "hclib_cpp.h"
+#include "hclib_system.h"
+
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
+#define NSIZES 12
+
+static const size_t sizes[NSIZES] = { 1, 8, 16, 24, 100, 256, 1000, 4096,
+    5000, 16384, 32768, 40000 };
+
+static volatile int nerrors = 0;
+
+int main(int argc, char **argv) {
+    int ntasks = 64;
+    int nallocs = 256;
+    if (argc > 1) ntasks = atoi(argv[1]);
+    if (argc > 2) nallocs = atoi(argv[2]);
+
+    const char *deps[] = { "system" };
+    hclib::launch(deps, 1, [ntasks, nallocs] {
+        hclib::locale_t **worker_locales =
+            hclib::get_thread_private_locales();
+        hclib::locale_t *sysmem = hclib::get_all_locales();
+
+        hclib::finish([=] {
+            for (int t = 0; t < ntasks; t++) {
+                hclib::async([=] {
+                    hclib::locale_t *locale = (t % 2 == 0 ? sysmem :
+                            worker_locales[hclib::get_current_worker()]);
+                    if (locale == NULL) locale = sysmem;
+
+                    unsigned char **ptrs = (unsigned char **)malloc(
+                            nallocs * sizeof(*ptrs));
+                    for (int i = 0; i < nallocs; i++) {
+                        const size_t nbytes = sizes[i % NSIZES];
+                        ptrs[i] = (unsigned char *)hclib::allocate_at(nbytes,
+                                locale)->wait();
+                        assert(ptrs[i]);
+                        memset(ptrs[i], (t + i) & 0xff, nbytes);
+                    }
+
+                    // Grow every other block, which must keep its contents
+                    for (int i = 0; i < nallocs; i += 2) {
+                        const size_t nbytes = sizes[i % NSIZES];
+                        ptrs[i] = (unsigned char *)hclib::reallocate_at(
+                                ptrs[i], 3 * nbytes, locale)->wait();
+                        assert(ptrs[i]);
+                        memset(ptrs[i] + nbytes, (t + i) & 0xff, 2 * nbytes);
+                    }
+
+                    for (int i = 0; i < nallocs; i++) {
+                        const size_t nbytes = sizes[i % NSIZES] *
+                            (i % 2 == 0 ? 3 : 1);
+                        for (size_t j = 0; j < nbytes; j++) {
+                            if (ptrs[i][j] != ((t + i) & 0xff)) {
+                                __sync_fetch_and_add(&nerrors, 1);
+                                break;
+                            }
+                        }
+                        hclib::free_at(ptrs[i], locale);
+                    }
+                    free(ptrs);
+                });
+            }
+        });
+
+        if (hclib::get_num_workers() > 1 && worker_locales) {
+            const int nrounds = 64;
+            const int nblocks = 1024;
+            void **blocks = (void **)malloc(nblocks * sizeof(*blocks));
+            std::vector<void *> seen;
+            for (int r = 0; r < nrounds; r++) {
+                hclib::finish([=, &seen] {
+                    hclib::async_at([=, &seen] {
+                        for (int i = 0; i < nblocks; i++) {
+                            blocks[i] = hclib::allocate_at(64, sysmem)->wait();
+                            seen.push_back(blocks[i]);
+                        }
+                    }, worker_locales[0]);
+                });
+                hclib::finish([=] {
+                    hclib::async_at([=] {
+                        for (int i = 0; i < nblocks; i++) {
+                            hclib::free_at(blocks[i], sysmem);
+                        }
+                    }, worker_locales[1]);
+                });
+            }
+            free(blocks);
+
+            std::sort(seen.begin(), seen.end());
+            const size_t ndistinct = std::unique(seen.begin(), seen.end()) -
+                seen.begin();
+            std::cout << nrounds * nblocks << " blocks freed by another "
+                "worker reused " << ndistinct << " distinct addresses" <<
+                std::endl;
+            if (ndistinct > (size_t)nrounds * nblocks / 4) {
+                __sync_fetch_and_add(&nerrors, 1);
+            }
+        }
+
+        const int nreps = 100000;
+        hclib::locale_t *closest = hclib::get_closest_locale();
+        const unsigned long long start_time = hclib_current_time_ns();
+        for (int i = 0; i < nreps; i++) {
+            void *ptr = hclib::allocate_at(sizes[i % NSIZES], closest)->wait();
+            hclib::free_at(ptr, closest);
+        }
+        const unsigned long long elapsed = hclib_current_time_ns() -
+            start_time;
+
+        std::cout << nreps << " allocate/free pairs at " << closest->lbl <<
+            " in " << (elapsed / 1000) << " us (" << ((double)elapsed / nreps) <<
+            " ns each)" << std::endl;
+        std::cout << "Check results: " << (nerrors == 0 ? "OK" : "FAILED") <<
+            std::endl;
+        assert(nerrors == 0);
+    });
+    return 0;
+}
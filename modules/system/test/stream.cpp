@@ -0,0 +1,137 @@
+/*
+ * STREAM-style bandwidth benchmark. For every NUMA locale (or sysmem, whose
+ * large allocations are interleaved across nodes) three arrays are allocated at
+ * that locale and the copy, scale, add and triad kernels are run on them from
+ * tasks placed at the same locale, so that each result approximates the
+ * bandwidth of one socket. Run with HCLIB_HUGE_PAGES=transparent or explicit
+ * to compare against huge-page backed arrays.
+ *
+ * Usage: stream [elements per array] [ntrials]
+ */
+#include "hclib_cpp.h"
+#include "hclib_system.h"
+
+#include <float.h>
+#include <iostream>
+
+#define NKERNELS 4
+#define CHUNK_SIZE (256 * 1024)
+
+static const char *kernel_names[NKERNELS] = { "Copy", "Scale", "Add",
+    "Triad" };
+static const int kernel_arrays[NKERNELS] = { 2, 2, 3, 3 };
+
+static void run_kernel(int kernel, double *a, double *b, double *c,
+        size_t start, size_t end) {
+    const double scalar = 3.0;
+    size_t i;
+    switch (kernel) {
+        case 0:
+            for (i = start; i < end; i++) c[i] = a[i];
+            break;
+        case 1:
+            for (i = start; i < end; i++) b[i] = scalar * c[i];
+            break;
+        case 2:
+            for (i = start; i < end; i++) c[i] = a[i] + b[i];
+            break;
+        case 3:
+            for (i = start; i < end; i++) a[i] = b[i] + scalar * c[i];
+            break;
+        default:
+            assert(false);
+    }
+}
+
+// Apply a kernel in chunks, from tasks placed at locale
+static void run_at(int kernel, double *a, double *b, double *c, size_t n,
+        hclib::locale_t *locale) {
+    hclib::finish([=] {
+        for (size_t start = 0; start < n; start += CHUNK_SIZE) {
+            const size_t end = (start + CHUNK_SIZE < n ? start + CHUNK_SIZE :
+                    n);
+            hclib::async_at([=] {
+                run_kernel(kernel, a, b, c, start, end);
+            }, locale);
+        }
+    });
+}
+
+int main(int argc, char **argv) {
+    size_t n = 20 * 1024 * 1024;
+    int ntrials = 10;
+    if (argc > 1) n = atol(argv[1]);
+    if (argc > 2) ntrials = atoi(argv[2]);
+
+    const char *deps[] = { "system" };
+    hclib::launch(deps, 1, [n, ntrials] {
+        const int numa_type = hclib_add_known_locale_type("NUMA");
+        int nlocales;
+        hclib::locale_t **locales = hclib_get_all_locales_of_type(numa_type,
+                &nlocales);
+        if (nlocales == 0) {
+            free(locales);
+            nlocales = 1;
+            locales = (hclib::locale_t **)malloc(sizeof(*locales));
+            locales[0] = hclib_get_all_locales(); // sysmem
+        }
+
+        std::cout << "Array size = " << n << " elements, " <<
+            (n * sizeof(double) / (1024 * 1024)) << " MB per array, " <<
+            ntrials << " trials" << std::endl;
+
+        for (int l = 0; l < nlocales; l++) {
+            hclib::locale_t *locale = locales[l];
+            double *a = (double *)hclib::allocate_at(n * sizeof(double),
+                    locale)->wait();
+            double *b = (double *)hclib::allocate_at(n * sizeof(double),
+                    locale)->wait();
+            double *c = (double *)hclib::allocate_at(n * sizeof(double),
+                    locale)->wait();
+            assert(a && b && c);
+
+            // Initialize from the locale too, placing any unbound pages
+            hclib::finish([=] {
+                for (size_t start = 0; start < n; start += CHUNK_SIZE) {
+                    const size_t end = (start + CHUNK_SIZE < n ?
+                            start + CHUNK_SIZE : n);
+                    hclib::async_at([=] {
+                        for (size_t i = start; i < end; i++) {
+                            a[i] = 1.0;
+                            b[i] = 2.0;
+                            c[i] = 0.0;
+                        }
+                    }, locale);
+                }
+            });
+
+            double best[NKERNELS];
+            for (int k = 0; k < NKERNELS; k++) best[k] = DBL_MAX;
+
+            for (int t = 0; t < ntrials; t++) {
+                for (int k = 0; k < NKERNELS; k++) {
+                    const unsigned long long start_time =
+                        hclib_current_time_ns();
+                    run_at(k, a, b, c, n, locale);
+                    const double elapsed = (hclib_current_time_ns() -
+                            start_time) / 1e9;
+                    if (t > 0 && elapsed < best[k]) best[k] = elapsed;
+                }
+            }
+
+            for (int k = 0; k < NKERNELS; k++) {
+                const double mb = (double)kernel_arrays[k] * n *
+                    sizeof(double) / 1e6;
+                std::cout << locale->lbl << " " << kernel_names[k] << ": " <<
+                    (ntrials > 1 ? mb / best[k] : 0.0) << " MB/s" <<
+                    std::endl;
+            }
+
+            hclib::free_at(a, locale);
+            hclib::free_at(b, locale);
+            hclib::free_at(c, locale);
+        }
+        free(locales);
+    });
+    return 0;
+}
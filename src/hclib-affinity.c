@@ -0,0 +1,279 @@
+/*
+ * Thread pinning for builds without hwloc, on Linux. The CPUs this process may
+ * run on (as inherited from taskset, srun, aprun, etc.) are read with
+ * sched_getaffinity and their package, core and NUMA node from
+ * /sys/devices/system/cpu. Workers are then bound with pthread_setaffinity_np
+ * following the policy selected with HCLIB_AFFINITY:
+ *
+ *   none        - Do not pin workers (the default).
+ *   compact     - Pin worker i to the ith CPU, taking all hyperthreads of a core
+ *                 and all cores of a package before moving on to the next.
+ *   scatter     - Pin consecutive workers to CPUs in different packages, then
+ *                 different cores, using hyperthreads last.
+ *   numa-spread - Deal workers round-robin across NUMA nodes, each bound to all
+ *                 of its node's CPUs.
+ *
+ * With more workers than CPUs, compact places consecutive workers on the same
+ * CPU and scatter wraps around. Builds with hwloc use HCLIB_AFFINITY=strided or
+ * chunked instead, see create_worker_cpusets.
+ */
+#if !defined(USE_HWLOC) && defined(__linux__)
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <sched.h>
+#include <pthread.h>
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "hclib-internal.h"
+
+#define SYSFS_CPU_DIR "/sys/devices/system/cpu"
+
+typedef enum {
+    AFFINITY_NONE,
+    AFFINITY_COMPACT,
+    AFFINITY_SCATTER,
+    AFFINITY_NUMA_SPREAD
+} affinity_policy_t;
+
+typedef struct _cpu_info {
+    int cpu;
+    int package;
+    int core;
+    int node;
+    // Index of this CPU among the hyperthreads of its core
+    int thread_index;
+    // Index of its core among the cores of its package
+    int core_index;
+    // Index of its package among the packages we may run on
+    int package_index;
+} cpu_info;
+
+// One CPU set per worker, or NULL if workers are not pinned
+static cpu_set_t *worker_cpusets = NULL;
+
+static affinity_policy_t get_affinity_policy() {
+    const char *selected = getenv("HCLIB_AFFINITY");
+    if (selected == NULL || strcmp(selected, "none") == 0) {
+        return AFFINITY_NONE;
+    } else if (strcmp(selected, "compact") == 0) {
+        return AFFINITY_COMPACT;
+    } else if (strcmp(selected, "scatter") == 0) {
+        return AFFINITY_SCATTER;
+    } else if (strcmp(selected, "numa-spread") == 0) {
+        return AFFINITY_NUMA_SPREAD;
+    } else {
+        fprintf(stderr, "Unsupported thread affinity \"%s\" specified with "
+                "HCLIB_AFFINITY, expected one of none, compact, scatter or "
+                "numa-spread.\n", selected);
+        exit(1);
+    }
+}
+
+static int read_topology_id(const int cpu, const char *name,
+        const int default_id) {
+    char path[256];
+    snprintf(path, sizeof(path), SYSFS_CPU_DIR "/cpu%d/topology/%s", cpu,
+            name);
+    FILE *fp = fopen(path, "r");
+    if (fp == NULL) return default_id;
+
+    int id;
+    if (fscanf(fp, "%d", &id) != 1 || id < 0) id = default_id;
+    fclose(fp);
+    return id;
+}
+
+// Each CPU's directory holds a nodeN link to the NUMA node it belongs to
+static int read_node_id(const int cpu) {
+    char path[256];
+    snprintf(path, sizeof(path), SYSFS_CPU_DIR "/cpu%d", cpu);
+    DIR *dir = opendir(path);
+    if (dir == NULL) return 0;
+
+    int node = 0;
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if (sscanf(entry->d_name, "node%d", &node) == 1) break;
+    }
+    closedir(dir);
+    return node;
+}
+
+static int compare_compact(const void *a, const void *b) {
+    const cpu_info *x = (const cpu_info *)a;
+    const cpu_info *y = (const cpu_info *)b;
+    if (x->node != y->node) return x->node - y->node;
+    if (x->package != y->package) return x->package - y->package;
+    if (x->core != y->core) return x->core - y->core;
+    return x->cpu - y->cpu;
+}
+
+static int compare_scatter(const void *a, const void *b) {
+    const cpu_info *x = (const cpu_info *)a;
+    const cpu_info *y = (const cpu_info *)b;
+    if (x->thread_index != y->thread_index) {
+        return x->thread_index - y->thread_index;
+    }
+    if (x->core_index != y->core_index) return x->core_index - y->core_index;
+    return x->package_index - y->package_index;
+}
+
+/*
+ * Fill in the package, core, and node of each CPU in allowed, sorted in compact
+ * order. Returns the number of CPUs.
+ */
+static int get_cpu_topology(const cpu_set_t *allowed, cpu_info **out) {
+    const int ncpus = CPU_COUNT(allowed);
+    cpu_info *cpus = (cpu_info *)malloc(ncpus * sizeof(*cpus));
+    assert(cpus);
+
+    int count = 0;
+    for (int cpu = 0; count < ncpus; cpu++) {
+        if (!CPU_ISSET(cpu, allowed)) continue;
+
+        cpus[count].cpu = cpu;
+        cpus[count].package = read_topology_id(cpu, "physical_package_id", 0);
+        cpus[count].core = read_topology_id(cpu, "core_id", cpu);
+        cpus[count].node = read_node_id(cpu);
+        count++;
+    }
+    qsort(cpus, ncpus, sizeof(*cpus), compare_compact);
+
+    // Number hyperthreads, cores, and packages in the order they now appear
+    for (int i = 0; i < ncpus; i++) {
+        if (i == 0) {
+            cpus[i].package_index = 0;
+            cpus[i].core_index = 0;
+            cpus[i].thread_index = 0;
+        } else if (cpus[i].package != cpus[i - 1].package ||
+                cpus[i].node != cpus[i - 1].node) {
+            cpus[i].package_index = cpus[i - 1].package_index + 1;
+            cpus[i].core_index = 0;
+            cpus[i].thread_index = 0;
+        } else if (cpus[i].core != cpus[i - 1].core) {
+            cpus[i].package_index = cpus[i - 1].package_index;
+            cpus[i].core_index = cpus[i - 1].core_index + 1;
+            cpus[i].thread_index = 0;
+        } else {
+            cpus[i].package_index = cpus[i - 1].package_index;
+            cpus[i].core_index = cpus[i - 1].core_index;
+            cpus[i].thread_index = cpus[i - 1].thread_index + 1;
+        }
+    }
+
+    *out = cpus;
+    return ncpus;
+}
+
+static void assign_numa_spread(const cpu_info *cpus, const int ncpus,
+        const int nworkers) {
+    // CPUs are sorted by node, so find where each node's CPUs start
+    int *node_starts = (int *)malloc((ncpus + 1) * sizeof(*node_starts));
+    assert(node_starts);
+    int nnodes = 0;
+    for (int i = 0; i < ncpus; i++) {
+        if (i == 0 || cpus[i].node != cpus[i - 1].node) {
+            node_starts[nnodes++] = i;
+        }
+    }
+    node_starts[nnodes] = ncpus;
+
+    for (int w = 0; w < nworkers; w++) {
+        const int n = w % nnodes;
+        for (int i = node_starts[n]; i < node_starts[n + 1]; i++) {
+            CPU_SET(cpus[i].cpu, &worker_cpusets[w]);
+        }
+    }
+    free(node_starts);
+}
+
+#ifdef VERBOSE
+static void print_worker_cpuset(const int wid) {
+    fprintf(stderr, "Worker %d bound to %d CPU(s):", wid,
+            CPU_COUNT(&worker_cpusets[wid]));
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+        if (CPU_ISSET(cpu, &worker_cpusets[wid])) fprintf(stderr, " %d", cpu);
+    }
+    fprintf(stderr, "\n");
+}
+#endif
+
+void hclib_init_worker_affinities(const int nworkers) {
+    const affinity_policy_t policy = get_affinity_policy();
+    if (policy == AFFINITY_NONE) return;
+
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+        perror("WARNING: Not pinning workers, sched_getaffinity");
+        return;
+    }
+
+    cpu_info *cpus;
+    const int ncpus = get_cpu_topology(&allowed, &cpus);
+
+    worker_cpusets = (cpu_set_t *)malloc(nworkers * sizeof(*worker_cpusets));
+    assert(worker_cpusets);
+    for (int w = 0; w < nworkers; w++) {
+        CPU_ZERO(&worker_cpusets[w]);
+    }
+
+    switch (policy) {
+        case (AFFINITY_COMPACT):
+            for (int w = 0; w < nworkers; w++) {
+                const int i = (nworkers <= ncpus ? w :
+                        (int)((long)w * ncpus / nworkers));
+                CPU_SET(cpus[i].cpu, &worker_cpusets[w]);
+            }
+            break;
+        case (AFFINITY_SCATTER):
+            qsort(cpus, ncpus, sizeof(*cpus), compare_scatter);
+            for (int w = 0; w < nworkers; w++) {
+                CPU_SET(cpus[w % ncpus].cpu, &worker_cpusets[w]);
+            }
+            break;
+        case (AFFINITY_NUMA_SPREAD):
+            assign_numa_spread(cpus, ncpus, nworkers);
+            break;
+        default:
+            assert(0);
+    }
+    free(cpus);
+
+    if (nworkers > ncpus) {
+        fprintf(stderr, "WARNING: Oversubscribing %d CPUs with %d workers\n",
+                ncpus, nworkers);
+    }
+#ifdef VERBOSE
+    fprintf(stderr, "Pinning %d workers to %d CPUs with HCLIB_AFFINITY=%s\n",
+            nworkers, ncpus, getenv("HCLIB_AFFINITY"));
+    for (int w = 0; w < nworkers; w++) {
+        print_worker_cpuset(w);
+    }
+#endif
+}
+
+// Pin the calling thread as worker wid, if workers are being pinned
+void hclib_bind_worker(const int wid) {
+    if (worker_cpusets == NULL) return;
+
+    const int err = pthread_setaffinity_np(pthread_self(),
+            sizeof(worker_cpusets[wid]), &worker_cpusets[wid]);
+    if (err != 0) {
+        fprintf(stderr, "WARNING: Failed setting pthread affinity of worker "
+                "thread %d: %s\n", wid, strerror(err));
+    }
+}
+
+void hclib_free_worker_affinities() {
+    free(worker_cpusets);
+    worker_cpusets = NULL;
+}
+
+#endif
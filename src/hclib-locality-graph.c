@@ -8,6 +8,7 @@
 #include <stdio.h>
 #include <assert.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 
 // #define VERBOSE
@@ -306,6 +307,29 @@ static int parse_paths(int starting_token_index, int n_paths, char *json,
     return path_index;
 }
 
+/*
+ * Steal path autotuning: each worker reorders its steal path every
+ * STEAL_REORDER_INTERVAL steal attempts, skips locales that have not yielded a
+ * task in STEAL_EMPTY_ATTEMPTS probes except on every
+ * STEAL_SKIPPED_PROBE_INTERVAL'th attempt, and times one in
+ * STEAL_COST_SAMPLE_INTERVAL attempts. STEAL_COST_FLOOR_NS keeps the timing
+ * noise of cheap probes from dominating their score, and samples are capped at
+ * STEAL_COST_MAX_NS so that a worker being descheduled mid-probe does not.
+ */
+#define STEAL_REORDER_INTERVAL 256
+#define STEAL_EMPTY_ATTEMPTS 64
+#define STEAL_SKIPPED_PROBE_INTERVAL 16
+#define STEAL_COST_SAMPLE_INTERVAL 16
+#define STEAL_COST_FLOOR_NS 50.0
+#define STEAL_COST_MAX_NS 10000
+
+// Cleared with HCLIB_STEAL_AUTOTUNE=0
+static int steal_autotune = 1;
+
+#define BITS_PER_WORD (8 * sizeof(unsigned long))
+#define WORKER_BITMAP_WORDS(nworkers) (((nworkers) + BITS_PER_WORD - 1) / \
+        BITS_PER_WORD)
+
 inline void init_hclib_deque_t(hclib_deque_t *hcdeq, hclib_locale_t *locale) {
     hcdeq->deque.head = hcdeq->deque.tail = 0;
     hcdeq->locale = locale;
@@ -345,13 +369,11 @@ static void initialize_locale(hclib_locale_t *locale, int id, const char *lbl,
     locale->special_type = NULL;
     locale->idle_funcs = NULL;
     locale->n_idle_funcs = 0;
-    locale->deques = (hclib_deque_t *)calloc(nworkers,
+    locale->deques = (hclib_deque_t * volatile *)calloc(nworkers,
             sizeof(*(locale->deques)));
-    assert(locale->deques);
-    for (i = 0; i < nworkers; i++) {
-        hclib_deque_t *deq = locale->deques + i;
-        init_hclib_deque_t(deq, locale);
-    }
+    locale->nonempty = (volatile unsigned long *)calloc(
+            WORKER_BITMAP_WORDS(nworkers), sizeof(unsigned long));
+    assert(locale->deques && locale->nonempty);
 
     if (hclib_has_func_for(metadata_size_registrations, locale_type_id)) {
         hclib_locale_metadata_size_func_type size_func = hclib_get_func_for(
@@ -369,6 +391,48 @@ static void initialize_locale(hclib_locale_t *locale, int id, const char *lbl,
 /*
  * See locality_graphs/davinci.json for an example locality graph.
  */
+static hclib_locality_graph *create_locality_graph(hclib_locale_t *locales,
+        unsigned n_locales) {
+    hclib_locality_graph *graph = (hclib_locality_graph *)calloc(1,
+            sizeof(hclib_locality_graph));
+    assert(graph);
+    graph->locales = locales;
+    graph->n_locales = n_locales;
+    graph->neighbors = (unsigned **)calloc(n_locales, sizeof(unsigned *));
+    graph->n_neighbors = (unsigned *)calloc(n_locales, sizeof(unsigned));
+    assert(graph->neighbors && graph->n_neighbors);
+    return graph;
+}
+
+// Insert to into the adjacency list of from, which is kept sorted by id
+static void add_neighbor(hclib_locality_graph *graph, unsigned from,
+        unsigned to) {
+    unsigned i;
+    const unsigned n = graph->n_neighbors[from];
+    unsigned pos = 0;
+    while (pos < n && graph->neighbors[from][pos] < to) pos++;
+    if (pos < n && graph->neighbors[from][pos] == to) return;
+
+    // Lists grow by doubling whenever their length reaches a power of two
+    if ((n & (n - 1)) == 0) {
+        graph->neighbors[from] = (unsigned *)realloc(graph->neighbors[from],
+                (n == 0 ? 1 : 2 * n) * sizeof(unsigned));
+        assert(graph->neighbors[from]);
+    }
+    for (i = n; i > pos; i--) {
+        graph->neighbors[from][i] = graph->neighbors[from][i - 1];
+    }
+    graph->neighbors[from][pos] = to;
+    graph->n_neighbors[from] = n + 1;
+}
+
+// Add an undirected reachability edge between the locales with ids a and b
+static void add_locale_edge(hclib_locality_graph *graph, unsigned a,
+        unsigned b) {
+    add_neighbor(graph, a, b);
+    add_neighbor(graph, b, a);
+}
+
 void load_locality_info(const char *filename, int *nworkers_out,
         hclib_locality_graph **graph_out,
         hclib_worker_paths **worker_paths_out) {
@@ -455,13 +519,7 @@ void load_locality_info(const char *filename, int *nworkers_out,
     token_index += nlocales;
 
     // Initialize a graph object now that we have a list of all locales in the current system
-    hclib_locality_graph *graph = (hclib_locality_graph *)malloc(sizeof(hclib_locality_graph));
-    assert(graph);
-    graph->locales = locales;
-    graph->n_locales = nlocales;
-    graph->edges = (unsigned *)malloc(nlocales * nlocales * sizeof(unsigned));
-    assert(graph->edges);
-    memset(graph->edges, 0x00, nlocales * nlocales * sizeof(unsigned));
+    hclib_locality_graph *graph = create_locality_graph(locales, nlocales);
 
     // list of reachability edges
     assert(string_token_equals(tokens + token_index, json, "reachability") == 0);
@@ -495,8 +553,7 @@ void load_locality_info(const char *filename, int *nworkers_out,
         }
         edge_index++;
 
-        graph->edges[locale1->id * nlocales + locale2->id] = 1;
-        graph->edges[locale2->id * nlocales + locale1->id] = 1;
+        add_locale_edge(graph, locale1->id, locale2->id);
     }
     token_index = edge_index;
 
@@ -572,16 +629,7 @@ static char *create_heap_allocated_str(const char *s) {
     return heap_allocated;
 }
 
-/*
- * Generates a default locality graph consisting of one central node (ostensibly
- * representing some shared, high-latency, system memory) and one node hanging
- * off of the central node for each worker (allowing each worker to still be
- * individually targetable if we want to.
- */
-void generate_locality_info(int *nworkers_out,
-        hclib_locality_graph **graph_out,
-        hclib_worker_paths **worker_paths_out) {
-    int i;
+static int get_nworkers(int default_nworkers) {
     const char *nworkers_str = getenv("HCLIB_WORKERS");
     int nworkers;
     if (nworkers_str) {
@@ -589,21 +637,356 @@ void generate_locality_info(int *nworkers_out,
         fprintf(stderr, "WARNING: HCLIB_WORKERS provided, creating locale "
                 "graph based on %u workers\n", nworkers);
     } else {
-        nworkers = sysconf(_SC_NPROCESSORS_ONLN);
+        nworkers = default_nworkers;
         fprintf(stderr, "WARNING: HCLIB_WORKERS not provided, running with "
                 "default of %u\n", nworkers);
     }
+    return nworkers;
+}
 
-    hclib_locality_graph *graph = (hclib_locality_graph *)malloc(
-            sizeof(hclib_locality_graph));
-    assert(graph);
-    graph->n_locales = 1 + nworkers;
-    graph->locales = (hclib_locale_t *)malloc(graph->n_locales *
+static hclib_locality_path *create_locality_path(hclib_locale_t **locales,
+        unsigned path_length) {
+    hclib_locality_path *path = (hclib_locality_path *)malloc(
+            sizeof(hclib_locality_path));
+    assert(path);
+    path->path_length = path_length;
+    path->locales = (hclib_locale_t **)malloc(
+            path_length * sizeof(hclib_locale_t *));
+    assert(path->locales);
+    memcpy(path->locales, locales, path_length * sizeof(hclib_locale_t *));
+    return path;
+}
+
+#ifdef USE_HWLOC
+/*
+ * Levels of the memory hierarchy that get a locale in a generated graph, below
+ * the single sysmem locale and above the per-worker L1 locales. A level is
+ * skipped if no loaded module registered its locale type.
+ */
+#define N_TOPOLOGY_LEVELS 3
+static const char *topology_level_lbls[N_TOPOLOGY_LEVELS] = { "L2", "L3",
+    "NUMA" };
+
+static int is_exactly_known_locale_type(const char *lbl) {
+    int i;
+    for (i = 0; i < n_known_locale_types; i++) {
+        if (strcmp(known_locale_types[i], lbl) == 0) return 1;
+    }
+    return 0;
+}
+
+/*
+ * Find the cache at the given level (2 or 3) containing all CPUs in set, or
+ * NULL if there is none (e.g. set spans two sockets).
+ */
+static hwloc_obj_t get_covering_cache(hwloc_topology_t topology,
+        hwloc_const_bitmap_t set, unsigned level) {
+    hwloc_obj_t obj = hwloc_get_obj_covering_cpuset(topology, set);
+    while (obj) {
+#if HWLOC_API_VERSION >= 0x00020000
+        if (obj->type == (level == 2 ? HWLOC_OBJ_L2CACHE : HWLOC_OBJ_L3CACHE)) {
+#else
+        if (obj->type == HWLOC_OBJ_CACHE && obj->attr->cache.depth == level) {
+#endif
+            return obj;
+        }
+        obj = obj->parent;
+    }
+    return NULL;
+}
+
+/*
+ * Find the single NUMA node local to all CPUs in set, or NULL if they are
+ * spread across more than one.
+ */
+static hwloc_obj_t get_covering_numa_node(hwloc_topology_t topology,
+        hwloc_const_bitmap_t set) {
+    hwloc_obj_t node = NULL;
+    hwloc_bitmap_t nodeset = hwloc_bitmap_alloc();
+    assert(nodeset);
+
+    hwloc_cpuset_to_nodeset(topology, set, nodeset);
+    if (hwloc_bitmap_weight(nodeset) == 1) {
+        const unsigned os_index = hwloc_bitmap_first(nodeset);
+        while ((node = hwloc_get_next_obj_by_type(topology, HWLOC_OBJ_NUMANODE,
+                        node)) != NULL) {
+            if (node->os_index == os_index) break;
+        }
+    }
+
+    hwloc_bitmap_free(nodeset);
+    return node;
+}
+
+/*
+ * Relative distance between two NUMA nodes. Uses the distance matrix reported
+ * by the OS when there is one, and otherwise how far up the topology tree we
+ * have to go to find a common ancestor.
+ */
+static unsigned long long numa_distance(hwloc_topology_t topology,
+        hwloc_obj_t a, hwloc_obj_t b) {
+#if HWLOC_API_VERSION >= 0x00020000
+    unsigned nr = 1;
+    struct hwloc_distances_s *distances;
+    if (hwloc_distances_get_by_type(topology, HWLOC_OBJ_NUMANODE, &nr,
+                &distances, 0, 0) == 0 && nr > 0) {
+        const int ia = hwloc_distances_obj_index(distances, a);
+        const int ib = hwloc_distances_obj_index(distances, b);
+        unsigned long long dist = 0;
+        const int found = (ia >= 0 && ib >= 0);
+        if (found) {
+            dist = distances->values[ia * distances->nbobjs + ib];
+        }
+        hwloc_distances_release(topology, distances);
+        if (found) return dist;
+    }
+#endif
+    hwloc_obj_t ancestor = hwloc_get_common_ancestor_obj(topology, a, b);
+    return hwloc_topology_get_depth(topology) - ancestor->depth;
+}
+
+static int add_unique_obj(hwloc_obj_t obj, hwloc_obj_t *objs, int *nobjs) {
+    int i;
+    for (i = 0; i < *nobjs; i++) {
+        if (objs[i] == obj) return i;
+    }
+    objs[*nobjs] = obj;
+    return (*nobjs)++;
+}
+
+/*
+ * Generates a locality graph from the hwloc topology of the CPUs this process
+ * may run on (as restricted by taskset, srun, etc). The graph has one sysmem
+ * locale, one locale per NUMA node, L3 and L2 cache that holds at least one
+ * worker, and one private L1 locale per worker. Workers are placed on CPUs
+ * exactly as create_worker_cpusets will later pin them.
+ *
+ * A worker pops from its own L1 up through the L2, L3 and NUMA node that cover
+ * its CPUs, ordered from the closest out, and then sysmem. It steals along the
+ * same path followed by the remaining NUMA nodes, nearest first, so that work
+ * placed on a NUMA node only leaves the socket once everything else is empty.
+ *
+ * Returns 0 if the topology could not be discovered.
+ */
+static int generate_hwloc_locality_info(int *nworkers_out,
+        hclib_locality_graph **graph_out,
+        hclib_worker_paths **worker_paths_out) {
+    int i, j, l;
+    hwloc_topology_t topology;
+
+    if (hwloc_topology_init(&topology) != 0) return 0;
+    if (hwloc_topology_load(topology) != 0) {
+        hwloc_topology_destroy(topology);
+        return 0;
+    }
+
+    hwloc_bitmap_t cpuset = hwloc_bitmap_alloc();
+    assert(cpuset);
+    if (hwloc_get_cpubind(topology, cpuset, HWLOC_CPUBIND_PROCESS) != 0) {
+        // Binding not queryable, e.g. for a topology loaded from XML
+        hwloc_bitmap_copy(cpuset, hwloc_topology_get_allowed_cpuset(topology));
+    }
+    if (hwloc_bitmap_iszero(cpuset)) {
+        hwloc_bitmap_free(cpuset);
+        hwloc_topology_destroy(topology);
+        return 0;
+    }
+
+    const int nworkers = get_nworkers(hwloc_bitmap_weight(cpuset));
+
+    hwloc_bitmap_t *thread_cpusets = (hwloc_bitmap_t *)malloc(nworkers *
+            sizeof(*thread_cpusets));
+    assert(thread_cpusets);
+    for (i = 0; i < nworkers; i++) {
+        thread_cpusets[i] = hwloc_bitmap_alloc();
+        assert(thread_cpusets[i]);
+    }
+    hclib_assign_worker_cpusets(cpuset, nworkers, thread_cpusets);
+
+    /*
+     * For each level find the object covering each worker, and the set of
+     * distinct objects at that level that cover at least one worker.
+     */
+    hwloc_obj_t *worker_objs = (hwloc_obj_t *)calloc(
+            nworkers * N_TOPOLOGY_LEVELS, sizeof(*worker_objs));
+    assert(worker_objs);
+    hwloc_obj_t *level_objs[N_TOPOLOGY_LEVELS];
+    int n_level_objs[N_TOPOLOGY_LEVELS];
+    int level_base[N_TOPOLOGY_LEVELS];
+    int n_locales = 1;
+    for (l = 0; l < N_TOPOLOGY_LEVELS; l++) {
+        level_objs[l] = (hwloc_obj_t *)malloc(nworkers * sizeof(hwloc_obj_t));
+        assert(level_objs[l]);
+        n_level_objs[l] = 0;
+        level_base[l] = n_locales;
+
+        if (!is_exactly_known_locale_type(topology_level_lbls[l])) continue;
+
+        for (i = 0; i < nworkers; i++) {
+            if (hwloc_bitmap_iszero(thread_cpusets[i])) continue;
+
+            hwloc_obj_t obj;
+            if (l == N_TOPOLOGY_LEVELS - 1) {
+                obj = get_covering_numa_node(topology, thread_cpusets[i]);
+            } else {
+                obj = get_covering_cache(topology, thread_cpusets[i], l + 2);
+            }
+            if (obj) {
+                worker_objs[i * N_TOPOLOGY_LEVELS + l] = obj;
+                add_unique_obj(obj, level_objs[l], n_level_objs + l);
+            }
+        }
+        n_locales += n_level_objs[l];
+    }
+    const int l1_base = n_locales;
+    n_locales += nworkers;
+
+    hclib_locale_t *locales = (hclib_locale_t *)malloc(n_locales *
+            sizeof(hclib_locale_t));
+    assert(locales);
+    hclib_locality_graph *graph = create_locality_graph(locales, n_locales);
+
+    initialize_locale(graph->locales + 0, 0,
+            create_heap_allocated_str("sysmem"), nworkers);
+    for (l = 0; l < N_TOPOLOGY_LEVELS; l++) {
+        for (i = 0; i < n_level_objs[l]; i++) {
+            /*
+             * NUMA locales are named after the OS index of their node so that
+             * allocators can bind memory to it.
+             */
+            char buf[128];
+            sprintf(buf, "%s_%u", topology_level_lbls[l],
+                    l == N_TOPOLOGY_LEVELS - 1 ? level_objs[l][i]->os_index :
+                    level_objs[l][i]->logical_index);
+            initialize_locale(graph->locales + level_base[l] + i,
+                    level_base[l] + i, create_heap_allocated_str(buf),
+                    nworkers);
+        }
+    }
+    for (i = 0; i < nworkers; i++) {
+        char buf[128];
+        sprintf(buf, "L1_%d", i);
+        initialize_locale(graph->locales + l1_base + i, l1_base + i,
+                create_heap_allocated_str(buf), nworkers);
+    }
+
+    hclib_worker_paths *worker_paths = (hclib_worker_paths *)calloc(nworkers,
+            sizeof(*worker_paths));
+    assert(worker_paths);
+
+    const int numa_level = N_TOPOLOGY_LEVELS - 1;
+    hclib_locale_t **path = (hclib_locale_t **)malloc(
+            (N_TOPOLOGY_LEVELS + 2 + n_level_objs[numa_level]) *
+            sizeof(hclib_locale_t *));
+    assert(path);
+    for (i = 0; i < nworkers; i++) {
+        /*
+         * The levels are not necessarily nested in the order they are listed
+         * (e.g. an L3 may be shared by several NUMA nodes), so order this
+         * worker's objects from the fewest CPUs covered to the most.
+         */
+        hwloc_obj_t objs[N_TOPOLOGY_LEVELS];
+        int obj_levels[N_TOPOLOGY_LEVELS];
+        int nobjs = 0;
+        for (l = 0; l < N_TOPOLOGY_LEVELS; l++) {
+            hwloc_obj_t obj = worker_objs[i * N_TOPOLOGY_LEVELS + l];
+            if (obj == NULL) continue;
+
+            j = nobjs;
+            while (j > 0 && hwloc_bitmap_weight(objs[j - 1]->cpuset) >
+                    hwloc_bitmap_weight(obj->cpuset)) {
+                objs[j] = objs[j - 1];
+                obj_levels[j] = obj_levels[j - 1];
+                j--;
+            }
+            objs[j] = obj;
+            obj_levels[j] = l;
+            nobjs++;
+        }
+
+        unsigned path_length = 0;
+        path[path_length++] = graph->locales + l1_base + i;
+        for (j = 0; j < nobjs; j++) {
+            const int index = add_unique_obj(objs[j], level_objs[obj_levels[j]],
+                    n_level_objs + obj_levels[j]);
+            path[path_length++] = graph->locales + level_base[obj_levels[j]] +
+                index;
+        }
+        path[path_length++] = graph->locales + 0;
+
+        for (j = 0; j + 1 < path_length; j++) {
+            add_locale_edge(graph, path[j]->id, path[j + 1]->id);
+        }
+
+        worker_paths[i].pop_path = create_locality_path(path, path_length);
+
+        // Append the other NUMA nodes to the steal path, nearest first
+        hwloc_obj_t home = worker_objs[i * N_TOPOLOGY_LEVELS + numa_level];
+        const unsigned first_remote = path_length;
+        for (j = 0; j < n_level_objs[numa_level]; j++) {
+            hwloc_obj_t node = level_objs[numa_level][j];
+            if (node == home) continue;
+
+            const unsigned long long dist = (home ?
+                    numa_distance(topology, home, node) : 0);
+            unsigned k = path_length;
+            while (k > first_remote && home && numa_distance(topology, home,
+                        level_objs[numa_level][path[k - 1]->id -
+                        level_base[numa_level]]) > dist) {
+                path[k] = path[k - 1];
+                k--;
+            }
+            path[k] = graph->locales + level_base[numa_level] + j;
+            path_length++;
+        }
+
+        worker_paths[i].steal_path = create_locality_path(path, path_length);
+    }
+
+    free(path);
+    for (l = 0; l < N_TOPOLOGY_LEVELS; l++) {
+        free(level_objs[l]);
+    }
+    free(worker_objs);
+    for (i = 0; i < nworkers; i++) {
+        hwloc_bitmap_free(thread_cpusets[i]);
+    }
+    free(thread_cpusets);
+    hwloc_bitmap_free(cpuset);
+    hwloc_topology_destroy(topology);
+
+    *nworkers_out = nworkers;
+    *graph_out = graph;
+    *worker_paths_out = worker_paths;
+    return 1;
+}
+#endif
+
+/*
+ * Generates a default locality graph consisting of one central node (ostensibly
+ * representing some shared, high-latency, system memory) and one node hanging
+ * off of the central node for each worker (allowing each worker to still be
+ * individually targetable if we want to. When built with hwloc, the graph is
+ * instead discovered from the platform topology.
+ */
+void generate_locality_info(int *nworkers_out,
+        hclib_locality_graph **graph_out,
+        hclib_worker_paths **worker_paths_out) {
+    int i;
+#ifdef USE_HWLOC
+    if (generate_hwloc_locality_info(nworkers_out, graph_out,
+                worker_paths_out)) {
+        return;
+    }
+    fprintf(stderr, "WARNING: Unable to discover the hwloc topology, falling "
+            "back to a flat locality graph\n");
+#endif
+    const int nworkers = get_nworkers(sysconf(_SC_NPROCESSORS_ONLN));
+
+    hclib_locale_t *locales = (hclib_locale_t *)malloc((1 + nworkers) *
             sizeof(hclib_locale_t));
-    assert(graph->locales);
-    graph->edges = (unsigned *)malloc(graph->n_locales * graph->n_locales *
-            sizeof(unsigned));
-    assert(graph->edges);
+    assert(locales);
+    hclib_locality_graph *graph = create_locality_graph(locales, 1 + nworkers);
 
     hclib_worker_paths *worker_paths = (hclib_worker_paths *)calloc(nworkers,
             sizeof(*worker_paths));
@@ -617,24 +1000,11 @@ void generate_locality_info(int *nworkers_out,
         initialize_locale(graph->locales + i, i, create_heap_allocated_str(buf),
                     nworkers);
 
-        graph->edges[i * graph->n_locales + 0] = 1;
-        graph->edges[0 * graph->n_locales + i] = 1;
-
-        worker_paths[i - 1].pop_path = (hclib_locality_path *)malloc(
-                sizeof(hclib_locality_path));
-        worker_paths[i - 1].pop_path->path_length = 2;
-        worker_paths[i - 1].pop_path->locales = (hclib_locale_t **)malloc(
-                2 * sizeof(hclib_locale_t *));
-        worker_paths[i - 1].pop_path->locales[0] = graph->locales + i;
-        worker_paths[i - 1].pop_path->locales[1] = graph->locales + 0;
+        add_locale_edge(graph, i, 0);
 
-        worker_paths[i - 1].steal_path = (hclib_locality_path *)malloc(
-                sizeof(hclib_locality_path));
-        worker_paths[i - 1].steal_path->path_length = 2;
-        worker_paths[i - 1].steal_path->locales = (hclib_locale_t **)malloc(
-                2 * sizeof(hclib_locale_t *));
-        worker_paths[i - 1].steal_path->locales[0] = graph->locales + i;
-        worker_paths[i - 1].steal_path->locales[1] = graph->locales + 0;
+        hclib_locale_t *path[2] = { graph->locales + i, graph->locales + 0 };
+        worker_paths[i - 1].pop_path = create_locality_path(path, 2);
+        worker_paths[i - 1].steal_path = create_locality_path(path, 2);
     }
 
     *nworkers_out = nworkers;
@@ -642,6 +1012,58 @@ void generate_locality_info(int *nworkers_out,
     *worker_paths_out = worker_paths;
 }
 
+/*
+ * A breadth-first traversal from every locale fills in the distances between
+ * all pairs of locales and the closest locale of every known type. Neighbors
+ * are visited in order of id, so among locales of a type at the same distance
+ * the first one reached is always picked.
+ */
+static void compute_locale_distances(hclib_locality_graph *graph) {
+    const unsigned n_locales = graph->n_locales;
+    const unsigned n_types = n_known_locale_types;
+    unsigned from, i;
+
+    unsigned *queue = (unsigned *)malloc(n_locales * sizeof(unsigned));
+    assert(queue);
+    free(graph->distances);
+    free(graph->nearest_of_type);
+    graph->distances = (unsigned short *)malloc((size_t)n_locales * n_locales *
+            sizeof(unsigned short));
+    graph->nearest_of_type = (int *)malloc((size_t)n_locales * n_types *
+            sizeof(int));
+    assert(graph->distances && graph->nearest_of_type);
+    graph->n_types = n_types;
+
+    for (from = 0; from < n_locales; from++) {
+        unsigned short *distances = graph->distances + from * n_locales;
+        int *nearest = graph->nearest_of_type + from * n_types;
+        for (i = 0; i < n_locales; i++) {
+            distances[i] = HCLIB_UNREACHABLE_DISTANCE;
+        }
+        for (i = 0; i < n_types; i++) {
+            nearest[i] = -1;
+        }
+
+        unsigned head = 0, tail = 0;
+        distances[from] = 0;
+        queue[tail++] = from;
+        while (head < tail) {
+            const unsigned curr = queue[head++];
+            const unsigned type = graph->locales[curr].type;
+            if (type < n_types && nearest[type] < 0) nearest[type] = curr;
+
+            for (i = 0; i < graph->n_neighbors[curr]; i++) {
+                const unsigned next = graph->neighbors[curr][i];
+                if (distances[next] == HCLIB_UNREACHABLE_DISTANCE) {
+                    distances[next] = distances[curr] + 1;
+                    queue[tail++] = next;
+                }
+            }
+        }
+    }
+    free(queue);
+}
+
 void check_locality_graph(hclib_locality_graph *graph,
         hclib_worker_paths *worker_paths, int nworkers) {
     int i;
@@ -661,7 +1083,13 @@ void check_locality_graph(hclib_locality_graph *graph,
         }
         // Check appropriately initialized
         assert(curr->last_successful_steal_locale == 0);
+        assert(curr->steal_stats == NULL);
     }
+
+    const char *autotune = getenv("HCLIB_STEAL_AUTOTUNE");
+    steal_autotune = (autotune == NULL || atoi(autotune) != 0);
+
+    compute_locale_distances(graph);
 }
 
 void print_locality_graph(hclib_locality_graph *graph) {
@@ -672,15 +1100,11 @@ void print_locality_graph(hclib_locality_graph *graph) {
     for (i = 0; i < graph->n_locales; i++) {
         hclib_locale_t *curr = graph->locales + i;
         printf("======== locale %d - %s - connected to ", curr->id, curr->lbl);
-        int count_connected = 0;
         int j;
-        for (j = 0; j < graph->n_locales; j++) {
-            if (graph->edges[i * graph->n_locales + j]) {
-                printf("%s ", graph->locales[j].lbl);
-                count_connected++;
-            }
+        for (j = 0; j < graph->n_neighbors[i]; j++) {
+            printf("%s ", graph->locales[graph->neighbors[i][j]].lbl);
         }
-        if (count_connected == 0) {
+        if (graph->n_neighbors[i] == 0) {
             printf("no locales\n");
         }
         printf("\n");
@@ -714,29 +1138,149 @@ void print_worker_paths(hclib_worker_paths *worker_paths, int nworkers) {
     printf("\n");
 }
 
+static void dump_locality_path(FILE *fp, hclib_locality_path *path) {
+    int i;
+    fprintf(fp, "[");
+    for (i = 0; i < path->path_length; i++) {
+        fprintf(fp, "%s\"%s\"", i == 0 ? "" : ", ", path->locales[i]->lbl);
+    }
+    fprintf(fp, "]");
+}
+
+static void dump_worker_paths(FILE *fp, const char *key,
+        hclib_worker_paths *worker_paths, int nworkers, int steal) {
+    int i;
+    fprintf(fp, "    \"%s\": {\n", key);
+    for (i = -1; i < nworkers; i++) {
+        // Worker 0's path doubles as the default required by the loader
+        hclib_worker_paths *curr = worker_paths + (i < 0 ? 0 : i);
+        if (i < 0) {
+            fprintf(fp, "        \"default\": ");
+        } else {
+            fprintf(fp, "        %d: ", i);
+        }
+        dump_locality_path(fp, steal ? curr->steal_path : curr->pop_path);
+        fprintf(fp, "%s\n", i == nworkers - 1 ? "" : ",");
+    }
+    fprintf(fp, "    }");
+}
+
+/*
+ * Write a locality graph and worker paths out in the format read by
+ * load_locality_info, so that a generated graph can be inspected, edited and
+ * passed back in through HCLIB_LOCALITY_FILE.
+ */
+void dump_locality_info(const char *filename, hclib_locality_graph *graph,
+        hclib_worker_paths *worker_paths, int nworkers) {
+    int i, j;
+    FILE *fp = fopen(filename, "w");
+    if (!fp) {
+        fprintf(stderr, "WARNING: Unable to open \"%s\" to dump the locality "
+                "graph\n", filename);
+        return;
+    }
+
+    fprintf(fp, "{\n");
+    fprintf(fp, "    \"nworkers\": %d,\n", nworkers);
+
+    fprintf(fp, "    \"declarations\": [\n");
+    for (i = 0; i < graph->n_locales; i++) {
+        fprintf(fp, "        \"%s\"%s\n", graph->locales[i].lbl,
+                i == graph->n_locales - 1 ? "" : ",");
+    }
+    fprintf(fp, "    ],\n");
+
+    fprintf(fp, "    \"reachability\": [");
+    int nedges = 0;
+    for (i = 0; i < graph->n_locales; i++) {
+        for (j = 0; j < graph->n_neighbors[i]; j++) {
+            const unsigned other = graph->neighbors[i][j];
+            if (other > i) {
+                fprintf(fp, "%s\n        [\"%s\", \"%s\"]",
+                        nedges == 0 ? "" : ",", graph->locales[i].lbl,
+                        graph->locales[other].lbl);
+                nedges++;
+            }
+        }
+    }
+    fprintf(fp, "\n    ],\n");
+
+    dump_worker_paths(fp, "pop_paths", worker_paths, nworkers, 0);
+    fprintf(fp, ",\n");
+    dump_worker_paths(fp, "steal_paths", worker_paths, nworkers, 1);
+    fprintf(fp, "\n}\n");
+
+    fclose(fp);
+}
+
 /*
  * *************************************************
  *                  Runtime code
  * *************************************************
  */
 
+// Whether worker wid's deque at locale may hold tasks
+static inline int may_have_tasks(hclib_locale_t *locale, int wid) {
+    return (locale->nonempty[wid / BITS_PER_WORD] >> (wid % BITS_PER_WORD)) &
+        1;
+}
+
+static inline int any_may_have_tasks(hclib_locale_t *locale, int nworkers) {
+    int i;
+    for (i = 0; i < WORKER_BITMAP_WORDS(nworkers); i++) {
+        if (locale->nonempty[i]) return 1;
+    }
+    return 0;
+}
+
+// Only called by worker wid itself, after pushing to its deque at locale
+static inline void mark_may_have_tasks(hclib_locale_t *locale, int wid) {
+    if (!may_have_tasks(locale, wid)) {
+        __sync_fetch_and_or(locale->nonempty + wid / BITS_PER_WORD,
+                1UL << (wid % BITS_PER_WORD));
+    }
+}
+
+/*
+ * Only called by worker wid itself, once it has found its deque at locale
+ * empty. As it is the only worker pushing there, the deque stays empty until
+ * its next push sets the bit again.
+ */
+static inline void mark_empty(hclib_locale_t *locale, int wid) {
+    if (may_have_tasks(locale, wid)) {
+        __sync_fetch_and_and(locale->nonempty + wid / BITS_PER_WORD,
+                ~(1UL << (wid % BITS_PER_WORD)));
+    }
+}
+
 /*
  * Get the deque owned by the current worker at the specified locale.
  */
 static inline hclib_deque_t *get_deque_locale(hclib_worker_state *ws,
         hclib_locale_t *locale) {
     assert(locale);
-    return &(locale->deques[ws->id]);
+    hclib_deque_t *deq = locale->deques[ws->id];
+    if (deq == NULL) {
+        deq = (hclib_deque_t *)malloc(sizeof(hclib_deque_t));
+        assert(deq);
+        init_hclib_deque_t(deq, locale);
+        // Published before the bit that lets thieves look at it
+        locale->deques[ws->id] = deq;
+    }
+    return deq;
 }
 
 /*
- * Push a task onto the deque for this thread at the specified locale.
+ * Push a task onto the deque for this thread at the specified locale,
+ * allocating that deque if this thread has never pushed there before.
  */
 int deque_push_locale(hclib_worker_state *ws, hclib_locale_t *locale,
         void *ele) {
     assert(locale->reachable);
     hclib_deque_t *deq = get_deque_locale(ws, locale);
-    return deque_push(&deq->deque, ele);
+    if (!deque_push(&deq->deque, ele)) return 0;
+    mark_may_have_tasks(locale, ws->id);
+    return 1;
 }
 
 size_t workers_backlog(hclib_worker_state *ws) {
@@ -748,9 +1292,10 @@ size_t workers_backlog(hclib_worker_state *ws) {
     size_t sum_work = 0;
     for (i = 0; i < pop->path_length; i++) {
         hclib_locale_t *locale = pop->locales[i];
-        hclib_internal_deque_t *deq = &(locale->deques[wid].deque);
-        const int tail = deq->tail;
-        const int head = deq->head;
+        hclib_deque_t *deq = locale->deques[wid];
+        if (deq == NULL) continue;
+        const int tail = deq->deque.tail;
+        const int head = deq->deque.head;
         sum_work += (tail - head);
     }
 
@@ -760,9 +1305,9 @@ size_t workers_backlog(hclib_worker_state *ws) {
 unsigned locale_num_tasks(hclib_locale_t *locale) {
     unsigned count = 0;
     int i;
-    hclib_deque_t *deqs = locale->deques;
     for (i = 0; i < hc_context->nworkers; i++) {
-        count += deque_size(&(deqs[i].deque));
+        hclib_deque_t *deq = locale->deques[i];
+        if (deq) count += deque_size(&(deq->deque));
     }
     return count;
 }
@@ -789,7 +1334,8 @@ hclib_task_t *locale_pop_task(hclib_worker_state *ws) {
                 "locale->deques=%p locale->lbl=%s\n", wid, i, locale,
                 locale->deques, locale->lbl);
 #endif
-        hclib_task_t *task = deque_pop(&(locale->deques[wid].deque));
+        if (!may_have_tasks(locale, wid)) continue;
+        hclib_task_t *task = deque_pop(&(locale->deques[wid]->deque));
         if (task) {
 #ifdef VERBOSE
         fprintf(stderr, "locale_pop_task: wid=%d i=%d locale=%p "
@@ -799,6 +1345,7 @@ hclib_task_t *locale_pop_task(hclib_worker_state *ws) {
 
             return task;
         }
+        mark_empty(locale, wid);
     }
 
     return NULL;
@@ -836,14 +1383,197 @@ void hclib_locale_mark_special(hclib_locale_t *locale,
     }
 }
 
+/*
+ * Try to steal from the deque of victim at locale, skipping it if victim has
+ * not pushed anything there since its deque was last found empty.
+ */
+static inline int try_steal_from(hclib_worker_state *ws, hclib_locale_t *locale,
+        int victim, void **stolen) {
+    if (!may_have_tasks(locale, victim)) return 0;
+
+    hclib_internal_deque_t *deq = &(locale->deques[victim]->deque);
+    const int nstolen = deque_steal(deq, stolen);
+    if (nstolen == 0 && victim == ws->id && deque_size(deq) == 0) {
+        mark_empty(locale, victim);
+    }
+    return nstolen;
+}
+
+/*
+ * Try each worker's deque at locale, starting with the workers that share a
+ * NUMA node with us.
+ */
+static int steal_from_locale(hclib_worker_state *ws, hclib_locale_t *locale,
+        void **stolen, int *out_victim) {
+    int j;
+    const int nworkers = ws->nworkers;
+    if (!any_may_have_tasks(locale, nworkers)) return 0;
+
+    for (j = ws->base_intra_socket_workers; j < ws->limit_intra_socket_workers; j++) {
+        const int victim = j;
+        const int nstolen = try_steal_from(ws, locale, victim, stolen);
+        if (nstolen) {
+            *out_victim = victim;
+            return nstolen;
+        }
+    }
+
+    const int leftover = nworkers - (ws->limit_intra_socket_workers -
+            ws->base_intra_socket_workers);
+    for (j = 0; j < leftover; j++) {
+        const int victim = (ws->limit_intra_socket_workers + j) % nworkers;
+        const int nstolen = try_steal_from(ws, locale, victim, stolen);
+        if (nstolen) {
+            *out_victim = victim;
+            return nstolen;
+        }
+    }
+    return 0;
+}
+
+static hclib_steal_stats *create_steal_stats(const unsigned path_length) {
+    unsigned i;
+    hclib_steal_stats *stats = (hclib_steal_stats *)hclib_alloc_per_worker(
+            sizeof(*stats));
+    assert(stats);
+    stats->order = (unsigned *)hclib_alloc_per_worker(
+            path_length * sizeof(*(stats->order)));
+    stats->next_order = (unsigned *)hclib_alloc_per_worker(
+            path_length * sizeof(*(stats->next_order)));
+    stats->locales = (hclib_steal_locale_stats *)hclib_alloc_per_worker(
+            path_length * sizeof(*(stats->locales)));
+    assert(stats->order && stats->next_order && stats->locales);
+    for (i = 0; i < path_length; i++) {
+        stats->order[i] = i;
+    }
+    return stats;
+}
+
+// Expected tasks found per nanosecond spent probing a locale
+static double steal_score(const hclib_steal_locale_stats *locale) {
+    const double success_rate = (locale->recent_successes + 1.0) /
+        (locale->recent_attempts + 2.0);
+    const double cost = (locale->recent_cost_samples == 0 ? 0.0 :
+            (double)locale->recent_cost_ns /
+            (double)locale->recent_cost_samples);
+    return success_rate / (cost + STEAL_COST_FLOOR_NS);
+}
+
+/*
+ * Sort the steal path by decreasing score, keeping the static order between
+ * equal scores, and skip locales that have not yielded a task in a while,
+ * though never all of them, so that an idle worker still probes its best
+ * locale on every attempt. The counts of the phase that just ended are then
+ * halved so that the path keeps adapting as the placement of work changes.
+ */
+static void reorder_steal_path(hclib_steal_stats *stats,
+        const unsigned path_length) {
+    unsigned i, j;
+    unsigned nskipped = 0;
+    for (i = 0; i < path_length; i++) {
+        hclib_steal_locale_stats *locale = stats->locales + i;
+        if (locale->recent_successes > 0) {
+            locale->skipped = 0;
+        } else if (locale->recent_attempts >= STEAL_EMPTY_ATTEMPTS) {
+            locale->skipped = 1;
+        }
+        nskipped += locale->skipped;
+    }
+
+    unsigned *sorted = stats->next_order;
+    for (i = 0; i < path_length; i++) {
+        const unsigned index = i;
+        const double score = steal_score(stats->locales + index);
+        for (j = i; j > 0 &&
+                steal_score(stats->locales + sorted[j - 1]) < score; j--) {
+            sorted[j] = sorted[j - 1];
+        }
+        sorted[j] = index;
+    }
+    if (nskipped == path_length) {
+        stats->locales[sorted[0]].skipped = 0;
+    }
+
+    // Publish the new order, see hclib_steal_stats
+    stats->order_seq++;
+    __sync_synchronize();
+    memcpy(stats->order, sorted, path_length * sizeof(*sorted));
+    __sync_synchronize();
+    stats->order_seq++;
+
+    for (i = 0; i < path_length; i++) {
+        stats->locales[i].recent_attempts /= 2;
+        stats->locales[i].recent_successes /= 2;
+        stats->locales[i].recent_cost_ns /= 2;
+        stats->locales[i].recent_cost_samples /= 2;
+    }
+    stats->nreorders++;
+}
+
+/*
+ * Steal following the order learned for this worker, see reorder_steal_path.
+ * Skipped locales are still probed every STEAL_SKIPPED_PROBE_INTERVAL calls
+ * so that work placed there is eventually found, and only a sample of calls
+ * is timed to keep the cost of tracking low.
+ */
+static int autotuned_steal_task(hclib_worker_state *ws, void **stolen,
+        int *out_victim) {
+    unsigned i;
+    hclib_worker_paths *paths = ws->paths;
+    hclib_locality_path *steal = paths->steal_path;
+    const unsigned steal_path_length = steal->path_length;
+
+    hclib_steal_stats *stats = paths->steal_stats;
+    if (stats == NULL) {
+        stats = paths->steal_stats = create_steal_stats(steal_path_length);
+    }
+
+    const unsigned long long call = stats->ncalls++;
+    if (call > 0 && call % STEAL_REORDER_INTERVAL == 0) {
+        reorder_steal_path(stats, steal_path_length);
+    }
+    const int probe_skipped = (call % STEAL_SKIPPED_PROBE_INTERVAL == 0);
+    const int sample_cost = (call % STEAL_COST_SAMPLE_INTERVAL == 0);
+
+    for (i = 0; i < steal_path_length; i++) {
+        const unsigned index = stats->order[i];
+        hclib_steal_locale_stats *locale = stats->locales + index;
+        if (locale->skipped && !probe_skipped) continue;
+
+        const unsigned long long start_time = (sample_cost ?
+                hclib_current_time_ns() : 0);
+        const int nstolen = steal_from_locale(ws, steal->locales[index],
+                stolen, out_victim);
+        if (sample_cost) {
+            unsigned long long cost = hclib_current_time_ns() - start_time;
+            if (cost > STEAL_COST_MAX_NS) cost = STEAL_COST_MAX_NS;
+            locale->cost_ns += cost;
+            locale->cost_samples++;
+            locale->recent_cost_ns += cost;
+            locale->recent_cost_samples++;
+        }
+        locale->attempts++;
+        locale->recent_attempts++;
+
+        if (nstolen) {
+            locale->successes++;
+            locale->recent_successes++;
+            locale->skipped = 0;
+            return nstolen;
+        }
+    }
+    return 0;
+}
+
 /*
  * Try to find new work by stealing work from some other worker. We traverse the
- * steal path for the current worker and check all deques at each locale.
+ * steal path for the current worker and check the deques at each locale that
+ * may hold tasks. Unless disabled with HCLIB_STEAL_AUTOTUNE=0, the order in
+ * which locales are visited is learned from where past steals succeeded.
  */
 int locale_steal_task(hclib_worker_state *ws, void **stolen, int *out_victim) {
-    int i, j;
+    int i;
     const int wid = ws->id;
-    const int nworkers = ws->nworkers;
     hclib_worker_paths *paths = ws->paths;
     hclib_locality_path *steal = paths->steal_path;
 
@@ -855,36 +1585,119 @@ int locale_steal_task(hclib_worker_state *ws, void **stolen, int *out_victim) {
     MARK_SEARCH(wid); // Set the state of this worker for timing
 
     const int steal_path_length = steal->path_length;
+    if (steal_autotune && steal_path_length > 1) {
+        return autotuned_steal_task(ws, stolen, out_victim);
+    }
+
     const int last_successful_locale = paths->last_successful_steal_locale;
     for (i = 0; i < steal_path_length; i++) {
         const int locale_index = (last_successful_locale + i) % steal_path_length;
-        hclib_locale_t *locale = steal->locales[locale_index];
-        hclib_deque_t *deqs = locale->deques;
-
-        for (j = ws->base_intra_socket_workers; j < ws->limit_intra_socket_workers; j++) {
-            const int victim = j;
-            const int nstolen = deque_steal(&(deqs[victim].deque), stolen);
-            if (nstolen) {
-                paths->last_successful_steal_locale = locale_index;
-                *out_victim = victim;
-                return nstolen;
-            }
+        const int nstolen = steal_from_locale(ws, steal->locales[locale_index],
+                stolen, out_victim);
+        if (nstolen) {
+            paths->last_successful_steal_locale = locale_index;
+            return nstolen;
         }
+    }
 
-        const int leftover = nworkers - (ws->limit_intra_socket_workers -
-                ws->base_intra_socket_workers);
-        for (j = 0; j < leftover; j++) {
-            const int victim = (ws->limit_intra_socket_workers + j) % nworkers;
-            const int nstolen = deque_steal(&(deqs[victim].deque), stolen);
-            if (nstolen) {
-                paths->last_successful_steal_locale = locale_index;
-                *out_victim = victim;
-                return nstolen;
-            }
+    return 0;
+}
+
+/*
+ * Copy the order in which another worker currently probes its steal path into
+ * out, retrying while that worker is publishing a new order.
+ */
+static void copy_steal_order(hclib_steal_stats *stats,
+        const unsigned path_length, unsigned *out) {
+    unsigned seq;
+    do {
+        while ((seq = stats->order_seq) & 1) ;
+        __sync_synchronize();
+        memcpy(out, stats->order, path_length * sizeof(*out));
+        __sync_synchronize();
+    } while (stats->order_seq != seq);
+}
+
+/*
+ * Copy the locales that worker wid currently probes when stealing, in the
+ * order it probes them, into locales and return how many there are. Locales
+ * that it is skipping are left out. Until the worker has tried to steal this
+ * is its static steal path. The worker keeps reordering its path as it runs,
+ * so this is only a snapshot of the order at the time of the call.
+ */
+unsigned hclib_get_steal_path(int wid, hclib_locale_t **locales,
+        unsigned max_locales) {
+    unsigned i;
+    unsigned count = 0;
+    assert(wid >= 0 && wid < hc_context->nworkers);
+    hclib_worker_paths *paths = hc_context->worker_paths + wid;
+    hclib_locality_path *steal = paths->steal_path;
+    hclib_steal_stats *stats = paths->steal_stats;
+
+    if (stats == NULL) {
+        for (i = 0; i < steal->path_length && count < max_locales; i++) {
+            locales[count++] = steal->locales[i];
         }
+        return count;
     }
 
-    return 0;
+    unsigned *order = (unsigned *)malloc(steal->path_length * sizeof(*order));
+    assert(order);
+    copy_steal_order(stats, steal->path_length, order);
+    for (i = 0; i < steal->path_length && count < max_locales; i++) {
+        if (!stats->locales[order[i]].skipped) {
+            locales[count++] = steal->locales[order[i]];
+        }
+    }
+    free(order);
+    return count;
+}
+
+// Print each worker's learned steal path, with its statistics for each locale
+void hclib_print_steal_stats(FILE *fp) {
+    int i;
+    unsigned j;
+    for (i = 0; i < hc_context->nworkers; i++) {
+        hclib_worker_paths *paths = hc_context->worker_paths + i;
+        hclib_steal_stats *stats = paths->steal_stats;
+        if (stats == NULL) continue;
+
+        const unsigned path_length = paths->steal_path->path_length;
+        unsigned *order = (unsigned *)malloc(path_length * sizeof(*order));
+        assert(order);
+        copy_steal_order(stats, path_length, order);
+
+        fprintf(fp, "  Worker %d steal path after %llu steal attempts, %llu "
+                "reorders:", i, stats->ncalls, stats->nreorders);
+        for (j = 0; j < path_length; j++) {
+            const unsigned index = order[j];
+            hclib_steal_locale_stats *locale = stats->locales + index;
+            fprintf(fp, " %s (%llu/%llu, %.0f ns%s)",
+                    paths->steal_path->locales[index]->lbl,
+                    locale->successes, locale->attempts,
+                    locale->cost_samples == 0 ? 0.0 :
+                    (double)locale->cost_ns / (double)locale->cost_samples,
+                    locale->skipped ? ", skipped" : "");
+        }
+        fprintf(fp, "\n");
+        free(order);
+    }
+}
+
+// Free the steal statistics of every worker, once they have all exited
+void hclib_free_steal_stats() {
+    int i;
+    for (i = 0; i < hc_context->nworkers; i++) {
+        hclib_worker_paths *paths = hc_context->worker_paths + i;
+        hclib_steal_stats *stats = paths->steal_stats;
+        if (stats == NULL) continue;
+
+        free(stats->order);
+        free(stats->next_order);
+        free(stats->locales);
+        free(stats);
+        paths->steal_stats = NULL;
+    }
 }
 
 /*
@@ -1100,14 +1913,6 @@ hclib_locale_t *hclib_get_all_locales() {
     return hc_context->graph->locales;
 }
 
-static int contains(int target, int *list, int N) {
-    int i;
-    for (i = 0; i < N; i++) {
-        if (list[i] == target) return true;
-    }
-    return false;
-}
-
 /*
  * Return a list of all locales of the given type.
  */
@@ -1129,34 +1934,30 @@ hclib_locale_t **hclib_get_all_locales_of_type(int type, int *out_count) {
 }
 
 /*
- * Using a breadth-first traversal, find the closest locale of the provided type
- * to the provided locale. If multiple locales of the desired type are an
- * equivalent distance from the provided locale, a random one is returned.
+ * Find the closest locale of any of the provided types to the provided locale,
+ * using the distances precomputed by check_locality_graph. If locales of
+ * several of the types are an equivalent distance from the provided locale, the
+ * one of the type listed first is returned.
  */
 hclib_locale_t *hclib_get_closest_locale_of_types(hclib_locale_t *locale,
         int *locale_types, int n_locale_types) {
-    const int n_locales = hc_context->graph->n_locales;
+    hclib_locality_graph *graph = hc_context->graph;
+    const unsigned short *distances = graph->distances +
+        locale->id * graph->n_locales;
+    const int *nearest = graph->nearest_of_type + locale->id * graph->n_types;
+    hclib_locale_t *closest = NULL;
+    unsigned closest_distance = HCLIB_UNREACHABLE_DISTANCE;
+    int i;
 
-    int visiting_index = 0;
-    int to_visit_index = 0;
-    int *to_visit = (int *)malloc(sizeof(int) * n_locales);
-    hclib_locale_t *curr = locale;
-    while (!contains(curr->type, locale_types, n_locale_types) &&
-            visiting_index <= n_locales) {
-        const int id = curr->id;
-        int i;
-        for (i = 0; i < n_locales; i++) {
-            if (hc_context->graph->edges[id * n_locales + i] &&
-                    !contains(i, to_visit, to_visit_index)) {
-                to_visit[to_visit_index++] = i;
-            }
+    for (i = 0; i < n_locale_types; i++) {
+        if (locale_types[i] < 0 || locale_types[i] >= graph->n_types) continue;
+        const int id = nearest[locale_types[i]];
+        if (id >= 0 && distances[id] < closest_distance) {
+            closest = graph->locales + id;
+            closest_distance = distances[id];
         }
-
-        curr = hc_context->graph->locales + to_visit[visiting_index++];
     }
-
-    if (visiting_index > n_locales) return NULL; // none of that type found
-    else return curr;
+    return closest;
 }
 
 hclib_locale_t *hclib_get_closest_locale_of_type(hclib_locale_t *locale,
@@ -1165,6 +1966,15 @@ hclib_locale_t *hclib_get_closest_locale_of_type(hclib_locale_t *locale,
     return hclib_get_closest_locale_of_types(locale, type_arr, 1);
 }
 
+/*
+ * Number of reachability edges on the shortest path between two locales, or
+ * HCLIB_UNREACHABLE_DISTANCE if there is none.
+ */
+unsigned hclib_get_locale_distance(hclib_locale_t *from, hclib_locale_t *to) {
+    hclib_locality_graph *graph = hc_context->graph;
+    return graph->distances[from->id * graph->n_locales + to->id];
+}
+
 int hclib_get_num_locales_of_type(int locale_type) {
     int i;
     const int n_locales = hc_context->graph->n_locales;
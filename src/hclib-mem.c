@@ -49,6 +49,34 @@ void hclib_register_copy_func(int locale_id,
     hclib_register_func(&copy_registrations, locale_id, func, priority);
 }
 
+/*
+ * Memory operations at a locale on the calling worker's pop path would most
+ * likely be run by that worker anyway, so they are run in place and return an
+ * already satisfied future rather than paying for a task. Operations at any
+ * other locale (e.g. device memory) are still spawned there, as are memsets and
+ * reallocations of more than IN_PLACE_MAX_NBYTES, which may take long enough
+ * that another worker should be able to pick them up in parallel.
+ */
+#define IN_PLACE_MAX_NBYTES 4096
+
+static int can_run_in_place(hclib_locale_t *locale) {
+    int i;
+    hclib_worker_state *ws = CURRENT_WS_INTERNAL;
+    if (ws == NULL) return 0;
+
+    hclib_locality_path *pop = ws->paths->pop_path;
+    for (i = 0; i < pop->path_length; i++) {
+        if (pop->locales[i] == locale) return 1;
+    }
+    return 0;
+}
+
+static hclib_future_t *satisfied_future(void *datum) {
+    hclib_promise_t *promise = hclib_promise_create();
+    hclib_promise_put(promise, datum);
+    return hclib_get_future_for_promise(promise);
+}
+
 typedef struct _malloc_struct {
     size_t nbytes;
     hclib_locale_t *locale;
@@ -65,6 +93,12 @@ static void allocate_kernel(void *arg) {
 
 hclib_future_t *hclib_allocate_at(size_t nbytes, hclib_locale_t *locale) {
     assert(hclib_has_func_for(alloc_registrations, locale->type));
+    hclib_module_alloc_impl_func_type cb = hclib_get_func_for(
+            alloc_registrations, locale->type);
+
+    if (can_run_in_place(locale)) {
+        return satisfied_future(cb(nbytes, locale));
+    }
 
     hclib_promise_t *promise = hclib_promise_create();
 
@@ -72,7 +106,7 @@ hclib_future_t *hclib_allocate_at(size_t nbytes, hclib_locale_t *locale) {
     ms->nbytes = nbytes;
     ms->locale = locale;
     ms->promise = promise;
-    ms->cb = hclib_get_func_for(alloc_registrations, locale->type);
+    ms->cb = cb;
 
     hclib_async(allocate_kernel, ms, NULL, 0, locale);
     return hclib_get_future_for_promise(promise);
@@ -96,6 +130,12 @@ static void reallocate_kernel(void *arg) {
 hclib_future_t *hclib_reallocate_at(void *ptr, size_t new_nbytes,
         hclib_locale_t *locale) {
     assert(hclib_has_func_for(realloc_registrations, locale->type));
+    hclib_module_realloc_impl_func_type cb = hclib_get_func_for(
+            realloc_registrations, locale->type);
+
+    if (new_nbytes <= IN_PLACE_MAX_NBYTES && can_run_in_place(locale)) {
+        return satisfied_future(cb(ptr, new_nbytes, locale));
+    }
 
     hclib_promise_t *promise = hclib_promise_create();
 
@@ -104,7 +144,7 @@ hclib_future_t *hclib_reallocate_at(void *ptr, size_t new_nbytes,
     rs->nbytes = new_nbytes;
     rs->locale = locale;
     rs->promise = promise;
-    rs->cb = hclib_get_func_for(realloc_registrations, locale->type);
+    rs->cb = cb;
 
     hclib_async(reallocate_kernel, rs, NULL, 0, locale);
     return hclib_get_future_for_promise(promise);
@@ -129,6 +169,13 @@ static void memset_kernel(void *arg) {
 hclib_future_t *hclib_memset_at(void *ptr, int pattern, size_t nbytes,
         hclib_locale_t *locale) {
     assert(hclib_has_func_for(memset_registrations, locale->type));
+    hclib_module_memset_impl_func_type cb = hclib_get_func_for(
+            memset_registrations, locale->type);
+
+    if (nbytes <= IN_PLACE_MAX_NBYTES && can_run_in_place(locale)) {
+        cb(ptr, pattern, nbytes, locale);
+        return satisfied_future(NULL);
+    }
 
     hclib_promise_t *promise = hclib_promise_create();
 
@@ -138,7 +185,7 @@ hclib_future_t *hclib_memset_at(void *ptr, int pattern, size_t nbytes,
     ms->pattern = pattern;
     ms->locale = locale;
     ms->promise = promise;
-    ms->cb = hclib_get_func_for(memset_registrations, locale->type);
+    ms->cb = cb;
 
     hclib_async(memset_kernel, ms, NULL, 0, locale);
     return hclib_get_future_for_promise(promise);
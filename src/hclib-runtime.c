@@ -47,6 +47,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <sys/time.h>
 #include <dlfcn.h>
 #include <stddef.h>
+#include <string.h>
 
 #include <hclib.h>
 #include <hclib-internal.h>
@@ -97,12 +98,15 @@ typedef struct _per_worker_stats {
     size_t count_yields;
     size_t count_yield_iterations;
 } per_worker_stats;
-static per_worker_stats *worker_stats = NULL;
+// Allocated by each worker for itself, see localize_worker_state
+static per_worker_stats **worker_stats = NULL;
 #endif
 
 void hclib_start_finish();
 static void set_up_worker_thread_affinities(const int wid);
-static void create_hwloc_cpusets();
+static void localize_worker_state(const int wid);
+static volatile int nworkers_localized = 0;
+static void create_worker_cpusets();
 
 void log_(const char *file, int line, hclib_worker_state *ws,
           const char *format,
@@ -150,43 +154,6 @@ static void set_current_worker(int wid) {
     if ((err = pthread_setspecific(ws_key, hc_context->workers[wid])) != 0) {
         log_die("Cannot set thread-local worker state");
     }
-
-    /*
-     * don't bother worrying about core affinity on Mac OS since no one will be
-     * running performance tests there anyway and it doesn't support
-     * pthread_setaffinity_np.
-     */
-#ifndef __MACH__
-    /*
-     * Using pthread_setaffinity_np can interfere with other tools trying to
-     * control affinity (e.g. if you are using srun/aprun/taskset from outside
-     * the HClib process). For now we disable this.
-     */
-#if 0
-    cpu_set_t cpu_set;
-    CPU_ZERO(&cpu_set);
-    if (wid >= hc_context->ncores) {
-        /*
-         * If we are spawning more worker threads than there are cores, allow
-         * the extras to float around.
-         */
-        int i;
-        for (i = 0; i < hc_context->ncores; i++) {
-            CPU_SET(i, &cpu_set);
-        }
-    } else {
-        // Pin worker i to core i
-        CPU_SET(wid, &cpu_set);
-    }
-
-    if ((err = pthread_setaffinity_np(pthread_self(), sizeof(cpu_set),
-                &cpu_set)) != 0) {
-        fprintf(stderr, "WARNING: Failed setting pthread affinity of worker "
-                "thread %d, ncores=%d: %s\n", wid, hc_context->ncores,
-                strerror(err));
-    }
-#endif
-#endif
 }
 
 int hclib_get_current_worker() {
@@ -235,6 +202,151 @@ hclib_locale_t *default_dist_func(const int dim,
     return central_place;
 }
 
+/*
+ * Thread-private locale of each worker, used as the target of the built-in
+ * block, cyclic, and replay loop distributions. Workers without a
+ * thread-private locale fall back to the central place.
+ */
+static hclib_locale_t **dist_worker_locales = NULL;
+
+static hclib_locale_t *dist_locale_for_worker(const int wid) {
+    hclib_locale_t *locale = dist_worker_locales[wid];
+    return locale ? locale : default_dist_func(0, NULL, NULL, 0);
+}
+
+/*
+ * Linearize the position of subloops within loops, returning the index of this
+ * chunk and storing the total number of chunks in nchunks_out.
+ */
+static int dist_chunk_index(const int dim, const hclib_loop_domain_t *subloops,
+        const hclib_loop_domain_t *loops, int *nchunks_out) {
+    int i;
+    int index = 0;
+    int nchunks = 1;
+    for (i = 0; i < dim; i++) {
+        const int tile = loops[i].tile;
+        const int n = (loops[i].high - loops[i].low + tile - 1) / tile;
+        index = index * n + (subloops[i].low - loops[i].low) / tile;
+        nchunks *= n;
+    }
+    *nchunks_out = nchunks;
+    return index;
+}
+
+static int dist_block_worker(const int index, const int nchunks) {
+    return (int)(((long long)index * hc_context->nworkers) / nchunks);
+}
+
+hclib_locale_t *block_dist_func(const int dim,
+        const hclib_loop_domain_t *subloops, const hclib_loop_domain_t *loops,
+        const int mode) {
+    int nchunks;
+    const int index = dist_chunk_index(dim, subloops, loops, &nchunks);
+    return dist_locale_for_worker(dist_block_worker(index, nchunks));
+}
+
+hclib_locale_t *cyclic_dist_func(const int dim,
+        const hclib_loop_domain_t *subloops, const hclib_loop_domain_t *loops,
+        const int mode) {
+    int nchunks;
+    const int index = dist_chunk_index(dim, subloops, loops, &nchunks);
+    return dist_locale_for_worker(index % hc_context->nworkers);
+}
+
+/*
+ * The replay distribution remembers, for every loop domain it has seen, which
+ * worker last executed each chunk. Entries are only ever prepended to this list
+ * so it can be searched without locks. Once MAX_REPLAY_ENTRIES domains have
+ * been recorded, further ones are placed as with the block distribution, and
+ * the log is freed when the runtime shuts down.
+ */
+#define MAX_REPLAY_ENTRIES 256
+
+typedef struct _replay_entry_t {
+    int dim;
+    hclib_loop_domain_t loops[3];
+    int nchunks;
+    volatile int *last_worker;
+    struct _replay_entry_t *next;
+} replay_entry_t;
+
+static replay_entry_t *volatile replay_entries = NULL;
+static volatile int n_replay_entries = 0;
+
+static replay_entry_t *find_replay_entry(const int dim,
+        const hclib_loop_domain_t *loops) {
+    replay_entry_t *curr = replay_entries;
+    while (curr) {
+        if (curr->dim == dim && memcmp(curr->loops, loops,
+                    dim * sizeof(*loops)) == 0) {
+            return curr;
+        }
+        curr = curr->next;
+    }
+    return NULL;
+}
+
+static replay_entry_t *find_or_create_replay_entry(const int dim,
+        const hclib_loop_domain_t *loops, const int nchunks) {
+    int i;
+    replay_entry_t *entry = find_replay_entry(dim, loops);
+    if (entry) return entry;
+    if (hc_atomic_inc(&n_replay_entries) > MAX_REPLAY_ENTRIES) return NULL;
+
+    entry = (replay_entry_t *)calloc(1, sizeof(*entry));
+    HASSERT(entry);
+    entry->dim = dim;
+    memcpy(entry->loops, loops, dim * sizeof(*loops));
+    entry->nchunks = nchunks;
+    entry->last_worker = (volatile int *)malloc(nchunks * sizeof(int));
+    HASSERT(entry->last_worker);
+    for (i = 0; i < nchunks; i++) {
+        entry->last_worker[i] = -1;
+    }
+
+    do {
+        entry->next = replay_entries;
+    } while (!__sync_bool_compare_and_swap(&replay_entries, entry->next,
+                entry));
+    return entry;
+}
+
+hclib_locale_t *replay_dist_func(const int dim,
+        const hclib_loop_domain_t *subloops, const hclib_loop_domain_t *loops,
+        const int mode) {
+    int nchunks;
+    const int index = dist_chunk_index(dim, subloops, loops, &nchunks);
+    replay_entry_t *entry = find_or_create_replay_entry(dim, loops, nchunks);
+
+    int wid = (entry ? entry->last_worker[index] : -1);
+    if (wid < 0) {
+        wid = dist_block_worker(index, nchunks);
+    }
+    return dist_locale_for_worker(wid);
+}
+
+void replay_dist_record(const int dim, const hclib_loop_domain_t *subloops,
+        const hclib_loop_domain_t *loops, const int mode, const int wid) {
+    int nchunks;
+    const int index = dist_chunk_index(dim, subloops, loops, &nchunks);
+    replay_entry_t *entry = find_replay_entry(dim, loops);
+    if (entry) {
+        entry->last_worker[index] = wid;
+    }
+}
+
+static void free_replay_entries() {
+    replay_entry_t *curr = replay_entries;
+    while (curr) {
+        replay_entry_t *next = curr->next;
+        free((void *)curr->last_worker);
+        free(curr);
+        curr = next;
+    }
+    replay_entries = NULL;
+    n_replay_entries = 0;
+}
+
 /*
  * Main initialization function for the hclib_context object.
  */
@@ -257,6 +369,11 @@ void hclib_global_init() {
         fprintf(stderr, "WARNING: HCLIB_LOCALITY_FILE not provided, generating "
                 "sane default locality information\n");
         generate_locality_info(&nworkers, &graph, &worker_paths);
+
+        const char *dump_path = getenv("HCLIB_LOCALITY_DUMP");
+        if (dump_path) {
+            dump_locality_info(dump_path, graph, worker_paths, nworkers);
+        }
     }
     check_locality_graph(graph, worker_paths, nworkers);
 
@@ -277,8 +394,9 @@ void hclib_global_init() {
     assert(hc_context->workers);
 
     for (int i = 0; i < hc_context->nworkers; i++) {
-        hclib_worker_state *ws = (hclib_worker_state *)calloc(1,
+        hclib_worker_state *ws = (hclib_worker_state *)hclib_alloc_per_worker(
                 sizeof(*ws));
+        assert(ws);
         ws->context = hc_context;
         ws->id = i;
         ws->nworkers = hc_context->nworkers;
@@ -356,14 +474,9 @@ static void hclib_entrypoint(const char **module_dependencies,
     pthread_setconcurrency(hc_context->nworkers);
 
 #ifdef HCLIB_STATS
-    worker_stats = (per_worker_stats *)calloc(hc_context->nworkers,
+    worker_stats = (per_worker_stats **)calloc(hc_context->nworkers,
             sizeof(*worker_stats));
     HASSERT(worker_stats);
-    for (int i = 0; i < hc_context->nworkers; i++) {
-        worker_stats[i].stolen_tasks_per_thread = (size_t *)calloc(
-                hc_context->nworkers, sizeof(size_t));
-        HASSERT(worker_stats[i].stolen_tasks_per_thread);
-    }
 #endif
 
     // Launch the worker threads
@@ -373,11 +486,16 @@ static void hclib_entrypoint(const char **module_dependencies,
         exit(3);
     }
 
-    create_hwloc_cpusets();
+    create_worker_cpusets();
 
-    // Start workers
+    /*
+     * Start workers. Each one replaces its state with its own copy as soon as
+     * it starts, so wait for all of them to have done so before going on.
+     */
+    nworkers_localized = 0;
     for (int i = 1; i < hc_context->nworkers; i++) {
-        if (pthread_create(&hc_context->workers[i]->t, &attr, worker_routine,
+        pthread_t thread;
+        if (pthread_create(&thread, &attr, worker_routine,
                            &hc_context->workers[i]->id) != 0) {
             fprintf(stderr, "Error launching thread\n");
             exit(4);
@@ -387,9 +505,20 @@ static void hclib_entrypoint(const char **module_dependencies,
     set_current_worker(0);
 
     set_up_worker_thread_affinities(0);
+    localize_worker_state(0);
+    while (nworkers_localized < hc_context->nworkers) sched_yield();
+
+    dist_worker_locales = hclib_get_thread_private_locales();
 
-    const unsigned dist_id = hclib_register_dist_func(default_dist_func);
+    unsigned dist_id = hclib_register_dist_func(default_dist_func);
     HASSERT(dist_id == HCLIB_DEFAULT_LOOP_DIST);
+    dist_id = hclib_register_dist_func(block_dist_func);
+    HASSERT(dist_id == HCLIB_BLOCK_LOOP_DIST);
+    dist_id = hclib_register_dist_func(cyclic_dist_func);
+    HASSERT(dist_id == HCLIB_CYCLIC_LOOP_DIST);
+    dist_id = hclib_register_dist_func_with_record(replay_dist_func,
+            replay_dist_record);
+    HASSERT(dist_id == HCLIB_REPLAY_LOOP_DIST);
 
     // allocate root finish
     hclib_start_finish();
@@ -417,8 +546,13 @@ void hclib_join(int nb_workers) {
 
 void hclib_cleanup() {
     pthread_key_delete(ws_key);
+#if !defined(USE_HWLOC) && defined(__linux__)
+    hclib_free_worker_affinities();
+#endif
 
     hclib_call_finalize_functions();
+    free_replay_entries();
+    hclib_free_steal_stats();
 
     free(hc_context);
 }
@@ -458,7 +592,7 @@ static inline void execute_task(hclib_task_t *task) {
 #endif
 
 #ifdef HCLIB_STATS
-    worker_stats[ws->id].executed_tasks++;
+    worker_stats[ws->id]->executed_tasks++;
 #endif
 
     // task->_fp is of type 'void (*generic_frame_ptr)(void*)'
@@ -475,7 +609,7 @@ static inline void rt_schedule_async(hclib_task_t *async_task,
 #endif
 
 #ifdef HCLIB_STATS
-    worker_stats[ws->id].scheduled_tasks++;
+    worker_stats[ws->id]->scheduled_tasks++;
 #endif
 
     if (async_task->locale) {
@@ -491,22 +625,19 @@ static inline void rt_schedule_async(hclib_task_t *async_task,
          * current locale might be a good thing to implement in the future.
          * TODO.
          */
-        const int wid = hclib_get_current_worker();
 #ifdef VERBOSE
         fprintf(stderr, "rt_schedule_async: scheduling on worker wid=%d "
-                "hc_context=%p hc_context->graph=%p\n", wid, hc_context,
+                "hc_context=%p hc_context->graph=%p\n", ws->id, hc_context,
                 hc_context->graph);
 #endif
         hclib_locale_t *default_locale = hc_context->graph->locales + 0;
-        assert(default_locale->reachable);
-        if (!deque_push(&(default_locale->deques[wid].deque),
-                    async_task)) {
+        if (!deque_push_locale(ws, default_locale, async_task)) {
             // Deque is full
             assert(false);
         }
 #ifdef VERBOSE
         fprintf(stderr, "rt_schedule_async: finished scheduling on worker "
-                "wid=%d\n", wid);
+                "wid=%d\n", ws->id);
 #endif
     }
 }
@@ -543,7 +674,7 @@ void try_schedule_async(hclib_task_t *async_task, hclib_worker_state *ws) {
 #endif
 
 #ifdef HCLIB_STATS
-    worker_stats[ws->id].spawned_tasks++;
+    worker_stats[ws->id]->spawned_tasks++;
 #endif
 
     if (is_eligible_to_schedule(async_task)) {
@@ -612,6 +743,8 @@ void spawn_await(hclib_task_t *task, hclib_future_t **futures,
     spawn_await_at(task, futures, nfutures, NULL);
 }
 
+static void _finish_ctx_resume(void *arg);
+
 static hclib_task_t *find_and_run_task(hclib_worker_state *ws,
         const int on_fresh_ctx, volatile int *flag, const int flag_val,
         finish_t *current_finish) {
@@ -626,9 +759,9 @@ static hclib_task_t *find_and_run_task(hclib_worker_state *ws,
             const int nstolen = locale_steal_task(ws, (void **)stolen, &victim);
             if (nstolen) {
 #ifdef HCLIB_STATS
-                worker_stats[ws->id].count_steals++;
-                worker_stats[ws->id].stolen_tasks += nstolen;
-                worker_stats[ws->id].stolen_tasks_per_thread[victim] += nstolen;
+                worker_stats[ws->id]->count_steals++;
+                worker_stats[ws->id]->stolen_tasks += nstolen;
+                worker_stats[ws->id]->stolen_tasks_per_thread[victim] += nstolen;
 #endif
                 task = stolen[0];
                 for (int i = 1; i < nstolen; i++) {
@@ -639,9 +772,17 @@ static hclib_task_t *find_and_run_task(hclib_worker_state *ws,
         }
     }
 
+    /*
+     * A task that resumes a suspended context (e.g. a task that yielded) never
+     * returns to its caller, so it may only run on the disposable context of a
+     * work loop and not inline from a help_finish, whose context would be lost.
+     */
+    const int resumes_ctx = (task && task->_fp == _finish_ctx_resume);
+
     if (task == NULL) {
         return NULL;
-    } else if (task && (on_fresh_ctx || task->non_blocking ||
+    } else if (task && ((on_fresh_ctx && !(current_finish && resumes_ctx)) ||
+                task->non_blocking ||
                 (task->current_finish && task->current_finish == current_finish))) {
         /*
          * If the retrieved task is either:
@@ -697,24 +838,17 @@ static void crt_work_loop(LiteCtx *ctx) {
     HASSERT(0); // Should never return here
 }
 
-static void create_hwloc_cpusets() {
 #ifdef USE_HWLOC
-    int i;
-
-    int err = hwloc_topology_init(&topology);
-    assert(err == 0);
-
-    err = hwloc_topology_load(topology);
-    assert(err == 0);
-
-    hwloc_bitmap_t cpuset = hwloc_bitmap_alloc();
-    assert(cpuset);
-
-    err = hwloc_get_cpubind(topology, cpuset, HWLOC_CPUBIND_PROCESS);
-    assert(err == 0);
+/*
+ * Split the CPUs in cpuset between nworkers worker threads following the
+ * affinity selected with HCLIB_AFFINITY. thread_cpusets must hold nworkers
+ * allocated bitmaps. This is shared with the locality graph generator so that
+ * the graph it builds matches where workers are later pinned.
+ */
+void hclib_assign_worker_cpusets(hwloc_const_bitmap_t cpuset,
+        const int num_workers, hwloc_bitmap_t *thread_cpusets) {
     const int available_pus = hwloc_bitmap_weight(cpuset);
     const int last_set_index = hwloc_bitmap_last(cpuset);
-    const int num_workers = hc_context->nworkers;
 
     hclib_affinity_t selected_affinity = HCLIB_AFFINITY_STRIDED;
     const char *user_selected_affinity = getenv("HCLIB_AFFINITY");
@@ -730,15 +864,6 @@ static void create_hwloc_cpusets() {
         }
     }
 
-    thread_cpusets = (hwloc_bitmap_t *)malloc(hc_context->nworkers *
-            sizeof(*thread_cpusets));
-    assert(thread_cpusets);
-
-    for (i = 0; i < hc_context->nworkers; i++) {
-        thread_cpusets[i] = hwloc_bitmap_alloc();
-        assert(thread_cpusets[i]);
-    }
-
     switch (selected_affinity) {
         case (HCLIB_AFFINITY_STRIDED): {
             if (available_pus < num_workers) {
@@ -778,6 +903,36 @@ static void create_hwloc_cpusets() {
         default:
             assert(false);
     }
+}
+#endif
+
+static void create_worker_cpusets() {
+#ifdef USE_HWLOC
+    int i;
+
+    int err = hwloc_topology_init(&topology);
+    assert(err == 0);
+
+    err = hwloc_topology_load(topology);
+    assert(err == 0);
+
+    hwloc_bitmap_t cpuset = hwloc_bitmap_alloc();
+    assert(cpuset);
+
+    err = hwloc_get_cpubind(topology, cpuset, HWLOC_CPUBIND_PROCESS);
+    assert(err == 0);
+
+    thread_cpusets = (hwloc_bitmap_t *)malloc(hc_context->nworkers *
+            sizeof(*thread_cpusets));
+    assert(thread_cpusets);
+
+    for (i = 0; i < hc_context->nworkers; i++) {
+        thread_cpusets[i] = hwloc_bitmap_alloc();
+        assert(thread_cpusets[i]);
+    }
+
+    hclib_assign_worker_cpusets(cpuset, hc_context->nworkers, thread_cpusets);
+    hwloc_bitmap_free(cpuset);
 
     hwloc_bitmap_t nodeset = hwloc_bitmap_alloc();
     hwloc_bitmap_t other_nodeset = hwloc_bitmap_alloc();
@@ -857,6 +1012,8 @@ static void create_hwloc_cpusets() {
 #endif
     }
 
+#elif defined(__linux__)
+    hclib_init_worker_affinities(hc_context->nworkers);
 #endif
 }
 
@@ -865,9 +1022,56 @@ static void set_up_worker_thread_affinities(const int wid) {
     int err = hwloc_set_cpubind(topology, thread_cpusets[wid],
             HWLOC_CPUBIND_THREAD);
     assert(err == 0);
+#elif defined(__linux__)
+    hclib_bind_worker(wid);
 #endif
 }
 
+/*
+ * Allocate zeroed memory for a structure written by a single worker, padded
+ * out to whole cache lines so that it never shares one with another worker's.
+ */
+void *hclib_alloc_per_worker(size_t nbytes) {
+    void *ptr;
+    const size_t padded = (nbytes == 0 ? PER_WORKER_ALIGNMENT :
+            (nbytes + PER_WORKER_ALIGNMENT - 1) / PER_WORKER_ALIGNMENT *
+            PER_WORKER_ALIGNMENT);
+    if (posix_memalign(&ptr, PER_WORKER_ALIGNMENT, padded) != 0) return NULL;
+    memset(ptr, 0x00, padded);
+    return ptr;
+}
+
+/*
+ * The master thread sets up every worker's state before starting them. Once a
+ * worker is bound to its CPUs it moves that state, and its module state, into
+ * memory that it allocates and first touches itself so that they live on its
+ * own NUMA node, and allocates its stats the same way.
+ */
+static void localize_worker_state(const int wid) {
+    hclib_worker_state *initial = hc_context->workers[wid];
+    hclib_worker_state *ws = (hclib_worker_state *)hclib_alloc_per_worker(
+            sizeof(*ws));
+    assert(ws);
+    memcpy(ws, initial, sizeof(*ws));
+    ws->t = pthread_self();
+    ws->module_state = hclib_localize_per_worker_module_state(
+            initial->module_state);
+    hc_context->workers[wid] = ws;
+    set_current_worker(wid);
+    free(initial);
+
+#ifdef HCLIB_STATS
+    worker_stats[wid] = (per_worker_stats *)hclib_alloc_per_worker(
+            sizeof(per_worker_stats));
+    HASSERT(worker_stats[wid]);
+    worker_stats[wid]->stolen_tasks_per_thread = (size_t *)
+        hclib_alloc_per_worker(hc_context->nworkers * sizeof(size_t));
+    HASSERT(worker_stats[wid]->stolen_tasks_per_thread);
+#endif
+
+    hc_atomic_inc(&nworkers_localized);
+}
+
 /*
  * With the addition of lightweight context switching, worker creation becomes a
  * bit more complicated because we need all task creation and finish scopes to
@@ -881,9 +1085,10 @@ static void set_up_worker_thread_affinities(const int wid) {
 static void *worker_routine(void *args) {
     const int wid = *((int *)args);
     set_current_worker(wid);
-    hclib_worker_state *ws = CURRENT_WS_INTERNAL;
 
     set_up_worker_thread_affinities(wid);
+    localize_worker_state(wid);
+    hclib_worker_state *ws = CURRENT_WS_INTERNAL;
 
     // Create proxy original context to switch from
     LiteCtx *currentCtx = LiteCtx_proxy_create(__func__);
@@ -894,9 +1099,9 @@ static void *worker_routine(void *args) {
      * crt_work_loop at the top of the stack.
      */
     LiteCtx *newCtx = LiteCtx_create(crt_work_loop);
-    newCtx->arg1 = args;
+    newCtx->arg1 = &ws->id;
 #ifdef HCLIB_STATS
-    worker_stats[CURRENT_WS_INTERNAL->id].count_ctx_creates++;
+    worker_stats[CURRENT_WS_INTERNAL->id]->count_ctx_creates++;
 #endif
 
     // Swap in the newCtx lite context
@@ -955,7 +1160,7 @@ void *hclib_future_wait(hclib_future_t *future) {
     }
 
 #ifdef HCLIB_STATS
-    worker_stats[CURRENT_WS_INTERNAL->id].count_future_waits++;
+    worker_stats[CURRENT_WS_INTERNAL->id]->count_future_waits++;
 #endif
 
     // save current finish scope (in case of worker swap)
@@ -978,7 +1183,7 @@ void *hclib_future_wait(hclib_future_t *future) {
         newCtx->arg2 = need_to_swap_ctx;
 
 #ifdef HCLIB_STATS
-        worker_stats[CURRENT_WS_INTERNAL->id].count_ctx_creates++;
+        worker_stats[CURRENT_WS_INTERNAL->id]->count_ctx_creates++;
 #endif
 
         ctx_swap(currentCtx, newCtx, __func__);
@@ -1067,7 +1272,7 @@ void help_finish(finish_t *finish) {
         newCtx->arg1 = finish;
         newCtx->arg2 = need_to_swap_ctx;
 #ifdef HCLIB_STATS
-        worker_stats[CURRENT_WS_INTERNAL->id].count_ctx_creates++;
+        worker_stats[CURRENT_WS_INTERNAL->id]->count_ctx_creates++;
 #endif
 
 #ifdef VERBOSE
@@ -1115,7 +1320,7 @@ void hclib_yield(hclib_locale_t *locale) {
     hclib_task_t *old_task = ws->curr_task;
 
 #ifdef HCLIB_STATS
-    worker_stats[ws->id].count_yields++;
+    worker_stats[ws->id]->count_yields++;
 #endif
 
     hclib_task_t *task;
@@ -1123,7 +1328,7 @@ void hclib_yield(hclib_locale_t *locale) {
         ws = CURRENT_WS_INTERNAL;
 
 #ifdef HCLIB_STATS
-    worker_stats[ws->id].count_yield_iterations++;
+    worker_stats[ws->id]->count_yield_iterations++;
 #endif
 
         task = locale_pop_task(ws);
@@ -1132,9 +1337,9 @@ void hclib_yield(hclib_locale_t *locale) {
             const int nstolen = locale_steal_task(ws, (void **)stolen, &victim);
             if (nstolen) {
 #ifdef HCLIB_STATS
-                worker_stats[ws->id].count_steals++;
-                worker_stats[ws->id].stolen_tasks += nstolen;
-                worker_stats[ws->id].stolen_tasks_per_thread[victim] += nstolen;
+                worker_stats[ws->id]->count_steals++;
+                worker_stats[ws->id]->stolen_tasks += nstolen;
+                worker_stats[ws->id]->stolen_tasks_per_thread[victim] += nstolen;
 #endif
                 task = stolen[0];
                 for (int i = 1; i < nstolen; i++) {
@@ -1154,7 +1359,7 @@ void hclib_yield(hclib_locale_t *locale) {
                 newCtx->arg1 = task;
                 newCtx->arg2 = locale;
 #ifdef HCLIB_STATS
-                worker_stats[ws->id].count_ctx_creates++;
+                worker_stats[ws->id]->count_ctx_creates++;
 #endif
                 ctx_swap(currentCtx, newCtx, __func__);
 
@@ -1218,7 +1423,7 @@ void hclib_end_finish() {
             current_finish, CURRENT_WS_INTERNAL);
 #endif
 #ifdef HCLIB_STATS
-    worker_stats[CURRENT_WS_INTERNAL->id].count_end_finishes++;
+    worker_stats[CURRENT_WS_INTERNAL->id]->count_end_finishes++;
 #endif
 
     HASSERT(current_finish);
@@ -1246,7 +1451,7 @@ void hclib_end_finish_nonblocking_helper(hclib_promise_t *event) {
     hclib_task_t *current_task = ws->curr_task;
 
 #ifdef HCLIB_STATS
-    worker_stats[CURRENT_WS_INTERNAL->id].count_end_finishes_nonblocking++;
+    worker_stats[CURRENT_WS_INTERNAL->id]->count_end_finishes_nonblocking++;
 #endif
 
     HASSERT(current_finish->counter > 0);
@@ -1345,21 +1550,21 @@ void hclib_print_runtime_stats(FILE *fp) {
         printf("  Worker %d: %lu tasks executed, %lu tasks spawned, "
                 "%lu tasks scheduled, %lu steals, %lu stolen tasks, "
                 "%f tasks per steal, stolen from = [ ", i,
-                worker_stats[i].executed_tasks, worker_stats[i].spawned_tasks,
-                worker_stats[i].scheduled_tasks, worker_stats[i].count_steals,
-                worker_stats[i].stolen_tasks,
-                (double)worker_stats[i].stolen_tasks / (double)worker_stats[i].count_steals);
+                worker_stats[i]->executed_tasks, worker_stats[i]->spawned_tasks,
+                worker_stats[i]->scheduled_tasks, worker_stats[i]->count_steals,
+                worker_stats[i]->stolen_tasks,
+                (double)worker_stats[i]->stolen_tasks / (double)worker_stats[i]->count_steals);
         for (int j = 0; j < hc_context->nworkers; j++) {
-            printf("%lu ", worker_stats[i].stolen_tasks_per_thread[j]);
+            printf("%lu ", worker_stats[i]->stolen_tasks_per_thread[j]);
         }
         printf("]\n");
-        sum_end_finishes += worker_stats[i].count_end_finishes;
-        sum_future_waits += worker_stats[i].count_future_waits;
-        sum_end_finishes_nonblocking += worker_stats[i].count_end_finishes_nonblocking;
-        sum_ctx_creates += worker_stats[i].count_ctx_creates;
-        sum_yields += worker_stats[i].count_yields;
-        sum_yield_iters += worker_stats[i].count_yield_iterations;
-        sum_tasks += worker_stats[i].executed_tasks;
+        sum_end_finishes += worker_stats[i]->count_end_finishes;
+        sum_future_waits += worker_stats[i]->count_future_waits;
+        sum_end_finishes_nonblocking += worker_stats[i]->count_end_finishes_nonblocking;
+        sum_ctx_creates += worker_stats[i]->count_ctx_creates;
+        sum_yields += worker_stats[i]->count_yields;
+        sum_yield_iters += worker_stats[i]->count_yield_iterations;
+        sum_tasks += worker_stats[i]->executed_tasks;
     }
 
     printf("Total: %lu tasks, %lu end finishes, %lu future waits, "
@@ -1368,6 +1573,11 @@ void hclib_print_runtime_stats(FILE *fp) {
             sum_future_waits, sum_end_finishes_nonblocking, sum_ctx_creates,
             sum_yields,
             sum_yields == 0 ? 0.0 : (double)sum_yield_iters / (double)sum_yields);
+    hclib_print_steal_stats(fp);
+    for (i = 0; i < hc_context->nworkers; i++) {
+        free(worker_stats[i]->stolen_tasks_per_thread);
+        free(worker_stats[i]);
+    }
     free(worker_stats);
 #endif
 }
@@ -1376,7 +1586,7 @@ static void hclib_finalize(const int instrument) {
     LiteCtx *finalize_ctx = LiteCtx_proxy_create(__func__);
     LiteCtx *finish_ctx = LiteCtx_create(_hclib_finalize_ctx);
 #ifdef HCLIB_STATS
-    worker_stats[CURRENT_WS_INTERNAL->id].count_ctx_creates++;
+    worker_stats[CURRENT_WS_INTERNAL->id]->count_ctx_creates++;
 #endif
     CURRENT_WS_INTERNAL->root_ctx = finalize_ctx;
     ctx_swap(finalize_ctx, finish_ctx, __func__);
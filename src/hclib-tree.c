@@ -7,17 +7,19 @@
 
 /*
  * This self-balancing tree implementation is used to efficiently track pinned
- * memory ranges allocated for HClib GPU programs.
+ * memory ranges allocated for HClib GPU programs, and the locales owning large
+ * allocations made through the system module.
  */
 
 static hclib_memory_tree_node *create_memory_tree_node(void *address,
-        size_t length) {
+        size_t length, void *data) {
     hclib_memory_tree_node *node = (hclib_memory_tree_node *)malloc(
                                        sizeof(hclib_memory_tree_node));
     HASSERT(node);
 
     node->start_address = address;
     node->length = length;
+    node->data = data;
     node->height = -1;
     node->children[LEFT] = NULL;
     node->children[RIGHT] = NULL;
@@ -95,8 +97,8 @@ static hclib_memory_tree_node *find(void *address,
     }
 }
 
-void hclib_memory_tree_insert(void *address, size_t length,
-                              hclib_memory_tree_node **rootp) {
+void hclib_memory_tree_insert_data(void *address, size_t length, void *data,
+                                   hclib_memory_tree_node **rootp) {
     unsigned char *c_address = (unsigned char *)address;
     hclib_memory_tree_node *root = *rootp;
 
@@ -106,19 +108,26 @@ void hclib_memory_tree_insert(void *address, size_t length,
 #endif
 
     if (root == NULL) {
-        *rootp = create_memory_tree_node(address, length);
+        *rootp = create_memory_tree_node(address, length, data);
     } else {
         HASSERT(c_address < root->start_address ||
                 c_address >= root->start_address + root->length);
         if (c_address < root->start_address) {
-            hclib_memory_tree_insert(address, length, &root->children[LEFT]);
+            hclib_memory_tree_insert_data(address, length, data,
+                                          &root->children[LEFT]);
         } else {
-            hclib_memory_tree_insert(address, length, &root->children[RIGHT]);
+            hclib_memory_tree_insert_data(address, length, data,
+                                          &root->children[RIGHT]);
         }
         adjust_balance(rootp);
     }
 }
 
+void hclib_memory_tree_insert(void *address, size_t length,
+                              hclib_memory_tree_node **rootp) {
+    hclib_memory_tree_insert_data(address, length, NULL, rootp);
+}
+
 void hclib_memory_tree_remove(void *address,
                               hclib_memory_tree_node **rootp) {
     hclib_memory_tree_node *root = *rootp;
@@ -147,4 +156,10 @@ int hclib_memory_tree_contains(void *address, hclib_memory_tree_node **root) {
     return find(address, *root) != NULL;
 }
 
+// Returns the node whose range contains address, or NULL if there is none
+hclib_memory_tree_node *hclib_memory_tree_find(void *address,
+                                               hclib_memory_tree_node **root) {
+    return find(address, *root);
+}
+
 
@@ -14,14 +14,25 @@ extern "C" {
 #endif
 
 static loop_dist_func *registered_dist_funcs = NULL;
+static loop_dist_record_func *registered_dist_record_funcs = NULL;
 static unsigned n_registered_dist_funcs = 0;
 
-unsigned hclib_register_dist_func(loop_dist_func func) {
+unsigned hclib_register_dist_func_with_record(loop_dist_func func,
+        loop_dist_record_func record) {
     registered_dist_funcs = (loop_dist_func *)realloc(registered_dist_funcs,
             (n_registered_dist_funcs + 1) * sizeof(loop_dist_func));
     HASSERT(registered_dist_funcs);
-    registered_dist_funcs[n_registered_dist_funcs++] = func;
-    return n_registered_dist_funcs - 1;
+    registered_dist_record_funcs = (loop_dist_record_func *)realloc(
+            registered_dist_record_funcs,
+            (n_registered_dist_funcs + 1) * sizeof(loop_dist_record_func));
+    HASSERT(registered_dist_record_funcs);
+    registered_dist_funcs[n_registered_dist_funcs] = func;
+    registered_dist_record_funcs[n_registered_dist_funcs] = record;
+    return n_registered_dist_funcs++;
+}
+
+unsigned hclib_register_dist_func(loop_dist_func func) {
+    return hclib_register_dist_func_with_record(func, NULL);
 }
 
 loop_dist_func hclib_lookup_dist_func(unsigned id) {
@@ -29,6 +40,16 @@ loop_dist_func hclib_lookup_dist_func(unsigned id) {
     return registered_dist_funcs[id];
 }
 
+void hclib_record_dist(unsigned id, const int dim,
+        const hclib_loop_domain_t *subloops, const hclib_loop_domain_t *loops,
+        const int mode) {
+    HASSERT(id < n_registered_dist_funcs);
+    loop_dist_record_func record = registered_dist_record_funcs[id];
+    if (record) {
+        record(dim, subloops, loops, mode, hclib_get_current_worker());
+    }
+}
+
 /*** START ASYNC IMPLEMENTATION ***/
 
 void hclib_async(generic_frame_ptr fp, void *arg, hclib_future_t **futures,
@@ -113,6 +134,14 @@ static void forasync1D_runner(void *forasync_arg) {
     forasync1D_Fct_t user_fct_ptr = (forasync1D_Fct_t) user->_fp;
     void *user_arg = (void *) user->args;
     hclib_loop_domain_t loop0 = forasync->loop;
+    if (forasync->base.dist_func_id != HCLIB_DEFAULT_LOOP_DIST) {
+        hclib_record_dist(forasync->base.dist_func_id, 1, &forasync->loop,
+                forasync->base.loops, FORASYNC_MODE_FLAT);
+    }
+    if (forasync->base.range_body) {
+        ((forasync1D_range_Fct_t)user->_fp)(user_arg, loop0.low, loop0.high);
+        return;
+    }
     int i=0;
     for(i=loop0.low; i<loop0.high; i+=loop0.stride) {
         (*user_fct_ptr)(user_arg, i);
@@ -126,6 +155,15 @@ static void forasync2D_runner(void *forasync_arg) {
     void *user_arg = (void *) user->args;
     hclib_loop_domain_t loop0 = forasync->loop[0];
     hclib_loop_domain_t loop1 = forasync->loop[1];
+    if (forasync->base.dist_func_id != HCLIB_DEFAULT_LOOP_DIST) {
+        hclib_record_dist(forasync->base.dist_func_id, 2, forasync->loop,
+                forasync->base.loops, FORASYNC_MODE_FLAT);
+    }
+    if (forasync->base.range_body) {
+        ((forasync2D_range_Fct_t)user->_fp)(user_arg, loop0.low, loop0.high,
+                loop1.low, loop1.high);
+        return;
+    }
     int i=0,j=0;
     for(i=loop0.low; i<loop0.high; i+=loop0.stride) {
         for(j=loop1.low; j<loop1.high; j+=loop1.stride) {
@@ -142,6 +180,15 @@ static void forasync3D_runner(void *forasync_arg) {
     hclib_loop_domain_t loop0 = forasync->loop[0];
     hclib_loop_domain_t loop1 = forasync->loop[1];
     hclib_loop_domain_t loop2 = forasync->loop[2];
+    if (forasync->base.dist_func_id != HCLIB_DEFAULT_LOOP_DIST) {
+        hclib_record_dist(forasync->base.dist_func_id, 3, forasync->loop,
+                forasync->base.loops, FORASYNC_MODE_FLAT);
+    }
+    if (forasync->base.range_body) {
+        ((forasync3D_range_Fct_t)user->_fp)(user_arg, loop0.low, loop0.high,
+                loop1.low, loop1.high, loop2.low, loop2.high);
+        return;
+    }
     int i=0,j=0,k=0;
     for(i=loop0.low; i<loop0.high; i+=loop0.stride) {
         for(j=loop1.low; j<loop1.high; j+=loop1.stride) {
@@ -170,7 +217,7 @@ void forasync1D_recursive(void *forasync_arg) {
         forasync1D_task_t *new_forasync_task = allocate_forasync1D_task();
         new_forasync_task->forasync_task._fp = forasync1D_recursive;
         new_forasync_task->forasync_task.args = &(new_forasync_task->def);
-        new_forasync_task->def.base.user = forasync->base.user;
+        new_forasync_task->def.base = forasync->base;
         new_forasync_task->def.loop.low = mid;
         new_forasync_task->def.loop.high = high0;
         new_forasync_task->def.loop.stride = stride0;
@@ -210,7 +257,7 @@ void forasync2D_recursive(void *forasync_arg) {
         new_forasync_task = allocate_forasync2D_task();
         new_forasync_task->forasync_task._fp = forasync2D_recursive;
         new_forasync_task->forasync_task.args = &(new_forasync_task->def);
-        new_forasync_task->def.base.user = forasync->base.user;
+        new_forasync_task->def.base = forasync->base;
         hclib_loop_domain_t new_loop0 = {mid, high0, stride0, tile0};;
         new_forasync_task->def.loop[0] = new_loop0;
         new_forasync_task->def.loop[1] = loop1;
@@ -222,7 +269,7 @@ void forasync2D_recursive(void *forasync_arg) {
         new_forasync_task = allocate_forasync2D_task();
         new_forasync_task->forasync_task._fp = forasync2D_recursive;
         new_forasync_task->forasync_task.args = &(new_forasync_task->def);
-        new_forasync_task->def.base.user = forasync->base.user;
+        new_forasync_task->def.base = forasync->base;
         new_forasync_task->def.loop[0] = loop0;
         hclib_loop_domain_t new_loop1 = {mid, high1, stride1, tile1};
         new_forasync_task->def.loop[1] = new_loop1;
@@ -267,7 +314,7 @@ void forasync3D_recursive(void *forasync_arg) {
         new_forasync_task = allocate_forasync3D_task();
         new_forasync_task->forasync_task._fp = forasync3D_recursive;
         new_forasync_task->forasync_task.args = &(new_forasync_task->def);
-        new_forasync_task->def.base.user = forasync->base.user;
+        new_forasync_task->def.base = forasync->base;
         hclib_loop_domain_t new_loop0 = {mid, high0, stride0, tile0};
         new_forasync_task->def.loop[0] = new_loop0;
         new_forasync_task->def.loop[1] = loop1;
@@ -280,7 +327,7 @@ void forasync3D_recursive(void *forasync_arg) {
         new_forasync_task = allocate_forasync3D_task();
         new_forasync_task->forasync_task._fp = forasync3D_recursive;
         new_forasync_task->forasync_task.args = &(new_forasync_task->def);
-        new_forasync_task->def.base.user = forasync->base.user;
+        new_forasync_task->def.base = forasync->base;
         new_forasync_task->def.loop[0] = loop0;
         hclib_loop_domain_t new_loop1 = {mid, high1, stride1, tile1};
         new_forasync_task->def.loop[1] = new_loop1;
@@ -293,7 +340,7 @@ void forasync3D_recursive(void *forasync_arg) {
         new_forasync_task = allocate_forasync3D_task();
         new_forasync_task->forasync_task._fp = forasync3D_recursive;
         new_forasync_task->forasync_task.args = &(new_forasync_task->def);
-        new_forasync_task->def.base.user = forasync->base.user;
+        new_forasync_task->def.base = forasync->base;
         new_forasync_task->def.loop[0] = loop0;
         new_forasync_task->def.loop[1] = loop1;
         hclib_loop_domain_t new_loop2 = {mid, high2, stride2, tile2};
@@ -313,6 +360,211 @@ void forasync3D_recursive(void *forasync_arg) {
     }
 }
 
+/*
+ * Index of the dimension with the most iterations that is still larger than
+ * its tile, or -1 if every dimension fits in a single tile.
+ */
+static int longest_splittable_dim(int dim, const hclib_loop_domain_t *loops) {
+    int d;
+    int longest = -1;
+    for (d = 0; d < dim; d++) {
+        const int extent = loops[d].high - loops[d].low;
+        if (extent > loops[d].tile && (longest < 0 ||
+                    extent > loops[longest].high - loops[longest].low)) {
+            longest = d;
+        }
+    }
+    return longest;
+}
+
+/*
+ * Cache-oblivious variants of the recursive forasyncs: always halve the
+ * longest remaining dimension rather than exhausting dimensions in order, so
+ * that every leaf tile is as close to square as its tile sizes allow and tiles
+ * executed one after another by the same worker share a boundary.
+ */
+void forasync2D_oblivious(void *forasync_arg) {
+    forasync2D_t *forasync = (forasync2D_t *) forasync_arg;
+    const int d = longest_splittable_dim(2, forasync->loop);
+    if (d < 0) {
+        forasync2D_runner(forasync_arg);
+        return;
+    }
+
+    const int mid = (forasync->loop[d].low + forasync->loop[d].high) / 2;
+    forasync2D_task_t *new_forasync_task = allocate_forasync2D_task();
+    new_forasync_task->forasync_task._fp = forasync2D_oblivious;
+    new_forasync_task->forasync_task.args = &(new_forasync_task->def);
+    new_forasync_task->def.base = forasync->base;
+    new_forasync_task->def.loop[0] = forasync->loop[0];
+    new_forasync_task->def.loop[1] = forasync->loop[1];
+    new_forasync_task->def.loop[d].low = mid;
+    forasync->loop[d].high = mid;
+
+    spawn((hclib_task_t *)new_forasync_task);
+    forasync2D_oblivious(forasync_arg);
+}
+
+void forasync3D_oblivious(void *forasync_arg) {
+    forasync3D_t *forasync = (forasync3D_t *) forasync_arg;
+    const int d = longest_splittable_dim(3, forasync->loop);
+    if (d < 0) {
+        forasync3D_runner(forasync_arg);
+        return;
+    }
+
+    const int mid = (forasync->loop[d].low + forasync->loop[d].high) / 2;
+    forasync3D_task_t *new_forasync_task = allocate_forasync3D_task();
+    new_forasync_task->forasync_task._fp = forasync3D_oblivious;
+    new_forasync_task->forasync_task.args = &(new_forasync_task->def);
+    new_forasync_task->def.base = forasync->base;
+    new_forasync_task->def.loop[0] = forasync->loop[0];
+    new_forasync_task->def.loop[1] = forasync->loop[1];
+    new_forasync_task->def.loop[2] = forasync->loop[2];
+    new_forasync_task->def.loop[d].low = mid;
+    forasync->loop[d].high = mid;
+
+    spawn((hclib_task_t *)new_forasync_task);
+    forasync3D_oblivious(forasync_arg);
+}
+
+/*
+ * Number of iterations a lazily split forasync executes between checks of the
+ * local deque. Rounded up to a multiple of stride so that each chunk starts on
+ * an iteration of the loop.
+ */
+static int adaptive_chunk_size(int niters, int stride) {
+    const int nworkers = hclib_get_num_workers();
+    int chunk = niters / (nworkers * FORASYNC_ADAPTIVE_CHUNKS_PER_WORKER);
+    if (chunk < 1) chunk = 1;
+    return ((chunk + stride - 1) / stride) * stride;
+}
+
+/*
+ * Midpoint of [low, high) aligned to stride, or high if the range cannot be
+ * split without leaving one side empty.
+ */
+static int adaptive_split_point(int low, int high, int stride) {
+    const int half = (((high - low) / 2) / stride) * stride;
+    return half > 0 ? low + half : high;
+}
+
+/*
+ * Lazy binary splitting: execute the outermost dimension of the loop in small
+ * chunks, and only hand half of the remaining iterations off as a new task
+ * when this worker has no other work queued locally. A worker whose deque is
+ * empty has either been stolen from or is the only one with work, so this
+ * creates parallelism exactly where the runtime is starving for it and
+ * otherwise runs the loop with no task creation overhead. Inner dimensions of
+ * 2D and 3D loops are never split.
+ */
+void forasync1D_adaptive(void *forasync_arg) {
+    forasync1D_t *forasync = (forasync1D_t *) forasync_arg;
+    const hclib_loop_domain_t loop0 = forasync->loop;
+    const int stride0 = loop0.stride;
+    const int chunk0 = loop0.tile;
+    int low0 = loop0.low;
+    int high0 = loop0.high;
+
+    while (low0 < high0) {
+        if (high0 - low0 > chunk0 && hclib_current_worker_backlog() == 0) {
+            const int mid = adaptive_split_point(low0, high0, stride0);
+            forasync1D_task_t *new_forasync_task = allocate_forasync1D_task();
+            new_forasync_task->forasync_task._fp = forasync1D_adaptive;
+            new_forasync_task->forasync_task.args = &(new_forasync_task->def);
+            new_forasync_task->def.base = forasync->base;
+            hclib_loop_domain_t new_loop0 = {mid, high0, stride0, chunk0};
+            new_forasync_task->def.loop = new_loop0;
+            spawn((hclib_task_t *)new_forasync_task);
+            high0 = mid;
+            continue;
+        }
+
+        const int end = (high0 - low0 > chunk0) ? low0 + chunk0 : high0;
+        forasync->loop.low = low0;
+        forasync->loop.high = end;
+        forasync1D_runner(forasync_arg);
+        low0 = end;
+    }
+}
+
+void forasync2D_adaptive(void *forasync_arg) {
+    forasync2D_t *forasync = (forasync2D_t *) forasync_arg;
+    const hclib_loop_domain_t loop0 = forasync->loop[0];
+    const int stride0 = loop0.stride;
+    const int chunk0 = loop0.tile;
+    int low0 = loop0.low;
+    int high0 = loop0.high;
+
+    while (low0 < high0) {
+        if (high0 - low0 > chunk0 && hclib_current_worker_backlog() == 0) {
+            const int mid = adaptive_split_point(low0, high0, stride0);
+            forasync2D_task_t *new_forasync_task = allocate_forasync2D_task();
+            new_forasync_task->forasync_task._fp = forasync2D_adaptive;
+            new_forasync_task->forasync_task.args = &(new_forasync_task->def);
+            new_forasync_task->def.base = forasync->base;
+            hclib_loop_domain_t new_loop0 = {mid, high0, stride0, chunk0};
+            new_forasync_task->def.loop[0] = new_loop0;
+            new_forasync_task->def.loop[1] = forasync->loop[1];
+            spawn((hclib_task_t *)new_forasync_task);
+            high0 = mid;
+            continue;
+        }
+
+        const int end = (high0 - low0 > chunk0) ? low0 + chunk0 : high0;
+        forasync->loop[0].low = low0;
+        forasync->loop[0].high = end;
+        forasync2D_runner(forasync_arg);
+        low0 = end;
+    }
+}
+
+void forasync3D_adaptive(void *forasync_arg) {
+    forasync3D_t *forasync = (forasync3D_t *) forasync_arg;
+    const hclib_loop_domain_t loop0 = forasync->loop[0];
+    const int stride0 = loop0.stride;
+    const int chunk0 = loop0.tile;
+    int low0 = loop0.low;
+    int high0 = loop0.high;
+
+    while (low0 < high0) {
+        if (high0 - low0 > chunk0 && hclib_current_worker_backlog() == 0) {
+            const int mid = adaptive_split_point(low0, high0, stride0);
+            forasync3D_task_t *new_forasync_task = allocate_forasync3D_task();
+            new_forasync_task->forasync_task._fp = forasync3D_adaptive;
+            new_forasync_task->forasync_task.args = &(new_forasync_task->def);
+            new_forasync_task->def.base = forasync->base;
+            hclib_loop_domain_t new_loop0 = {mid, high0, stride0, chunk0};
+            new_forasync_task->def.loop[0] = new_loop0;
+            new_forasync_task->def.loop[1] = forasync->loop[1];
+            new_forasync_task->def.loop[2] = forasync->loop[2];
+            spawn((hclib_task_t *)new_forasync_task);
+            high0 = mid;
+            continue;
+        }
+
+        const int end = (high0 - low0 > chunk0) ? low0 + chunk0 : high0;
+        forasync->loop[0].low = low0;
+        forasync->loop[0].high = end;
+        forasync3D_runner(forasync_arg);
+        low0 = end;
+    }
+}
+
+/*
+ * Place a chunk of a flat forasync using the distribution function it was
+ * created with.
+ */
+static void forasync_spawn(forasync_t *base, hclib_task_t *task, int dim,
+        const hclib_loop_domain_t *subloops) {
+    if (base->dist_func_id == HCLIB_DEFAULT_LOOP_DIST) {
+        spawn(task);
+    } else {
+        loop_dist_func func = hclib_lookup_dist_func(base->dist_func_id);
+        spawn_at(task, func(dim, subloops, base->loops, FORASYNC_MODE_FLAT));
+    }
+}
+
 void forasync1D_flat(void *forasync_arg) {
     forasync1D_t *forasync = (forasync1D_t *) forasync_arg;
     hclib_loop_domain_t loop0 = forasync->loop;
@@ -330,10 +582,11 @@ void forasync1D_flat(void *forasync_arg) {
         forasync1D_task_t *new_forasync_task = allocate_forasync1D_task();
         new_forasync_task->forasync_task._fp = forasync1D_runner;
         new_forasync_task->forasync_task.args = &(new_forasync_task->def);
-        new_forasync_task->def.base.user = forasync->base.user;
+        new_forasync_task->def.base = forasync->base;
         hclib_loop_domain_t new_loop0 = {low0, low0+tile0, stride0, tile0};
         new_forasync_task->def.loop = new_loop0;
-        spawn((hclib_task_t *)new_forasync_task);
+        forasync_spawn(&forasync->base, (hclib_task_t *)new_forasync_task, 1,
+                &new_forasync_task->def.loop);
     }
     // handling leftover
     if (size < high0) {
@@ -343,10 +596,11 @@ void forasync1D_flat(void *forasync_arg) {
         forasync1D_task_t *new_forasync_task = allocate_forasync1D_task();
         new_forasync_task->forasync_task._fp = forasync1D_runner;
         new_forasync_task->forasync_task.args = &(new_forasync_task->def);
-        new_forasync_task->def.base.user = forasync->base.user;
+        new_forasync_task->def.base = forasync->base;
         hclib_loop_domain_t new_loop0 = {low0, high0, loop0.stride, loop0.tile};
         new_forasync_task->def.loop = new_loop0;
-        spawn((hclib_task_t *)new_forasync_task);
+        forasync_spawn(&forasync->base, (hclib_task_t *)new_forasync_task, 1,
+                &new_forasync_task->def.loop);
     }
 }
 
@@ -368,12 +622,13 @@ void forasync2D_flat(void *forasync_arg) {
             forasync2D_task_t *new_forasync_task = allocate_forasync2D_task();
             new_forasync_task->forasync_task._fp = forasync2D_runner;
             new_forasync_task->forasync_task.args = &(new_forasync_task->def);
-            new_forasync_task->def.base.user = forasync->base.user;
+            new_forasync_task->def.base = forasync->base;
             hclib_loop_domain_t new_loop0 = {low0, high0, loop0.stride, loop0.tile};
             new_forasync_task->def.loop[0] = new_loop0;
             hclib_loop_domain_t new_loop1 = {low1, high1, loop1.stride, loop1.tile};
             new_forasync_task->def.loop[1] = new_loop1;
-            spawn((hclib_task_t *)new_forasync_task);
+            forasync_spawn(&forasync->base, (hclib_task_t *)new_forasync_task,
+                    2, new_forasync_task->def.loop);
         }
     }
 }
@@ -402,22 +657,248 @@ void forasync3D_flat(void *forasync_arg) {
                 forasync3D_task_t *new_forasync_task = allocate_forasync3D_task();
                 new_forasync_task->forasync_task._fp = forasync3D_runner;
                 new_forasync_task->forasync_task.args = &(new_forasync_task->def);
-                new_forasync_task->def.base.user = forasync->base.user;
+                new_forasync_task->def.base = forasync->base;
                 hclib_loop_domain_t new_loop0 = {low0, high0, loop0.stride, loop0.tile};
                 new_forasync_task->def.loop[0] = new_loop0;
                 hclib_loop_domain_t new_loop1 = {low1, high1, loop1.stride, loop1.tile};
                 new_forasync_task->def.loop[1] = new_loop1;
                 hclib_loop_domain_t new_loop2 = {low2, high2, loop2.stride, loop2.tile};
                 new_forasync_task->def.loop[2] = new_loop2;
-                spawn((hclib_task_t *)new_forasync_task);
+                forasync_spawn(&forasync->base,
+                        (hclib_task_t *)new_forasync_task, 3,
+                        new_forasync_task->def.loop);
             }
         }
     }
 }
 
+/*
+ * Generalized Morton (Z) order over an arbitrary box of tiles: halve every
+ * dimension that spans more than one tile and visit the children in Z order.
+ */
+static int *morton_visit(int dim, const int *lo, const int *hi,
+        const int *ntiles, int *out) {
+    int d, c;
+    int mid[3];
+    int nsplit = 0;
+    for (d = 0; d < dim; d++) {
+        if (hi[d] - lo[d] > 1) {
+            mid[d] = lo[d] + (hi[d] - lo[d]) / 2;
+            nsplit++;
+        } else {
+            mid[d] = hi[d];
+        }
+    }
+
+    if (nsplit == 0) {
+        int linear = 0;
+        for (d = 0; d < dim; d++) {
+            linear = linear * ntiles[d] + lo[d];
+        }
+        *out = linear;
+        return out + 1;
+    }
+
+    for (c = 0; c < (1 << dim); c++) {
+        int child_lo[3], child_hi[3];
+        int empty = 0;
+        for (d = 0; d < dim; d++) {
+            const int upper = (c >> (dim - 1 - d)) & 1;
+            child_lo[d] = upper ? mid[d] : lo[d];
+            child_hi[d] = upper ? hi[d] : mid[d];
+            if (child_lo[d] == child_hi[d]) empty = 1;
+        }
+        if (!empty) {
+            out = morton_visit(dim, child_lo, child_hi, ntiles, out);
+        }
+    }
+    return out;
+}
+
+static int sign(int v) {
+    return (v > 0) - (v < 0);
+}
+
+// Division by two rounding towards negative infinity
+static int floor_half(int v) {
+    return v >= 0 ? v / 2 : -((-v + 1) / 2);
+}
+
+/*
+ * Generalized Hilbert order over a w x h rectangle of tiles anchored at (x, y)
+ * with major axis (ax, ay) and minor axis (bx, by). Unlike the classic Hilbert
+ * curve this handles rectangles of any size, keeping every step between
+ * neighbouring tiles (with at most one diagonal step for odd sizes).
+ */
+static int *hilbert_visit(int x, int y, int ax, int ay, int bx, int by,
+        int ncols, int *out) {
+    const int w = abs(ax + ay);
+    const int h = abs(bx + by);
+    const int dax = sign(ax), day = sign(ay);
+    const int dbx = sign(bx), dby = sign(by);
+    int i;
+
+    if (h == 1) {
+        for (i = 0; i < w; i++) {
+            *(out++) = y * ncols + x;
+            x += dax;
+            y += day;
+        }
+        return out;
+    }
+    if (w == 1) {
+        for (i = 0; i < h; i++) {
+            *(out++) = y * ncols + x;
+            x += dbx;
+            y += dby;
+        }
+        return out;
+    }
+
+    int ax2 = floor_half(ax), ay2 = floor_half(ay);
+    int bx2 = floor_half(bx), by2 = floor_half(by);
+    const int w2 = abs(ax2 + ay2);
+    const int h2 = abs(bx2 + by2);
+
+    if (2 * w > 3 * h) {
+        if ((w2 % 2) && (w > 2)) {
+            ax2 += dax;
+            ay2 += day;
+        }
+        out = hilbert_visit(x, y, ax2, ay2, bx, by, ncols, out);
+        out = hilbert_visit(x + ax2, y + ay2, ax - ax2, ay - ay2, bx, by, ncols,
+                out);
+    } else {
+        if ((h2 % 2) && (h > 2)) {
+            bx2 += dbx;
+            by2 += dby;
+        }
+        out = hilbert_visit(x, y, bx2, by2, ax2, ay2, ncols, out);
+        out = hilbert_visit(x + bx2, y + by2, ax, ay, bx - bx2, by - by2, ncols,
+                out);
+        out = hilbert_visit(x + (ax - dax) + (bx2 - dbx),
+                y + (ay - day) + (by2 - dby), -bx2, -by2, -(ax - ax2),
+                -(ay - ay2), ncols, out);
+    }
+    return out;
+}
+
+void hclib_forasync_tile_order(int dim, const int *ntiles,
+        forasync_mode_t mode, int *order_out) {
+    HASSERT(dim > 0 && dim < 4);
+    int d;
+    int total = 1;
+    for (d = 0; d < dim; d++) total *= ntiles[d];
+
+    if (mode == FORASYNC_MODE_HILBERT && dim == 2) {
+        // x walks columns (the inner dimension), y walks rows
+        int *end;
+        if (ntiles[1] >= ntiles[0]) {
+            end = hilbert_visit(0, 0, ntiles[1], 0, 0, ntiles[0], ntiles[1],
+                    order_out);
+        } else {
+            end = hilbert_visit(0, 0, 0, ntiles[0], ntiles[1], 0, ntiles[1],
+                    order_out);
+        }
+        HASSERT(end - order_out == total);
+    } else if (mode == FORASYNC_MODE_HILBERT || mode == FORASYNC_MODE_MORTON) {
+        int lo[3] = {0, 0, 0};
+        int *end = morton_visit(dim, lo, ntiles, ntiles, order_out);
+        HASSERT(end - order_out == total);
+    } else {
+        for (d = 0; d < total; d++) order_out[d] = d;
+    }
+}
+
+static int loop_num_tiles(const hclib_loop_domain_t *loop) {
+    return (loop->high - loop->low + loop->tile - 1) / loop->tile;
+}
+
+static hclib_loop_domain_t loop_nth_tile(const hclib_loop_domain_t *loop,
+        int n) {
+    const int low = loop->low + n * loop->tile;
+    const int high = low + loop->tile;
+    hclib_loop_domain_t tile = {low, high > loop->high ? loop->high : high,
+        loop->stride, loop->tile};
+    return tile;
+}
+
+/*
+ * Flat forasyncs that spawn their tiles along a space-filling curve, so that
+ * tiles popped in sequence by a worker (or stolen in sequence from it) are
+ * spatially adjacent.
+ */
+static void forasync2D_ordered(void *forasync_arg, forasync_mode_t mode) {
+    forasync2D_t *forasync = (forasync2D_t *) forasync_arg;
+    const int ntiles[2] = {loop_num_tiles(&forasync->loop[0]),
+        loop_num_tiles(&forasync->loop[1])};
+    int *order = (int *)malloc(ntiles[0] * ntiles[1] * sizeof(int));
+    HASSERT(order);
+    hclib_forasync_tile_order(2, ntiles, mode, order);
+
+    int i;
+    for (i = 0; i < ntiles[0] * ntiles[1]; i++) {
+        forasync2D_task_t *new_forasync_task = allocate_forasync2D_task();
+        new_forasync_task->forasync_task._fp = forasync2D_runner;
+        new_forasync_task->forasync_task.args = &(new_forasync_task->def);
+        new_forasync_task->def.base = forasync->base;
+        new_forasync_task->def.loop[0] = loop_nth_tile(&forasync->loop[0],
+                order[i] / ntiles[1]);
+        new_forasync_task->def.loop[1] = loop_nth_tile(&forasync->loop[1],
+                order[i] % ntiles[1]);
+        forasync_spawn(&forasync->base, (hclib_task_t *)new_forasync_task, 2,
+                new_forasync_task->def.loop);
+    }
+    free(order);
+}
+
+static void forasync3D_ordered(void *forasync_arg, forasync_mode_t mode) {
+    forasync3D_t *forasync = (forasync3D_t *) forasync_arg;
+    const int ntiles[3] = {loop_num_tiles(&forasync->loop[0]),
+        loop_num_tiles(&forasync->loop[1]), loop_num_tiles(&forasync->loop[2])};
+    const int total = ntiles[0] * ntiles[1] * ntiles[2];
+    int *order = (int *)malloc(total * sizeof(int));
+    HASSERT(order);
+    hclib_forasync_tile_order(3, ntiles, mode, order);
+
+    int i;
+    for (i = 0; i < total; i++) {
+        forasync3D_task_t *new_forasync_task = allocate_forasync3D_task();
+        new_forasync_task->forasync_task._fp = forasync3D_runner;
+        new_forasync_task->forasync_task.args = &(new_forasync_task->def);
+        new_forasync_task->def.base = forasync->base;
+        new_forasync_task->def.loop[0] = loop_nth_tile(&forasync->loop[0],
+                order[i] / (ntiles[1] * ntiles[2]));
+        new_forasync_task->def.loop[1] = loop_nth_tile(&forasync->loop[1],
+                (order[i] / ntiles[2]) % ntiles[1]);
+        new_forasync_task->def.loop[2] = loop_nth_tile(&forasync->loop[2],
+                order[i] % ntiles[2]);
+        forasync_spawn(&forasync->base, (hclib_task_t *)new_forasync_task, 3,
+                new_forasync_task->def.loop);
+    }
+    free(order);
+}
+
+void forasync2D_morton(void *forasync_arg) {
+    forasync2D_ordered(forasync_arg, FORASYNC_MODE_MORTON);
+}
+
+void forasync3D_morton(void *forasync_arg) {
+    forasync3D_ordered(forasync_arg, FORASYNC_MODE_MORTON);
+}
+
+void forasync2D_hilbert(void *forasync_arg) {
+    forasync2D_ordered(forasync_arg, FORASYNC_MODE_HILBERT);
+}
+
+void forasync3D_hilbert(void *forasync_arg) {
+    forasync3D_ordered(forasync_arg, FORASYNC_MODE_HILBERT);
+}
+
 static void forasync_internal(void *user_fct_ptr, void *user_arg,
                               int dim, const hclib_loop_domain_t *loop_domain,
-                              forasync_mode_t mode) {
+                              forasync_mode_t mode, int range_body,
+                              unsigned dist_func_id) {
     // All the sub-asyncs share async_def
 
     // The user loop code to execute
@@ -434,23 +915,70 @@ static void forasync_internal(void *user_fct_ptr, void *user_arg,
     async_fct_t fct_ptr_flat[3] = { forasync1D_flat, forasync2D_flat,
                                    forasync3D_flat
                                  };
-    async_fct_t *fct_ptr = (mode == FORASYNC_MODE_RECURSIVE) ? fct_ptr_rec :
-                          fct_ptr_flat;
+    async_fct_t fct_ptr_adaptive[3] = { forasync1D_adaptive,
+                                        forasync2D_adaptive,
+                                        forasync3D_adaptive
+                                      };
+    // 1D loops have no traversal order, so these fall back to flat/recursive
+    async_fct_t fct_ptr_morton[3] = { forasync1D_flat, forasync2D_morton,
+                                      forasync3D_morton
+                                    };
+    async_fct_t fct_ptr_hilbert[3] = { forasync1D_flat, forasync2D_hilbert,
+                                       forasync3D_hilbert
+                                     };
+    async_fct_t fct_ptr_oblivious[3] = { forasync1D_recursive,
+                                         forasync2D_oblivious,
+                                         forasync3D_oblivious
+                                       };
+    async_fct_t *fct_ptr;
+    switch (mode) {
+        case FORASYNC_MODE_RECURSIVE:
+            fct_ptr = fct_ptr_rec;
+            break;
+        case FORASYNC_MODE_ADAPTIVE:
+            fct_ptr = fct_ptr_adaptive;
+            break;
+        case FORASYNC_MODE_MORTON:
+            fct_ptr = fct_ptr_morton;
+            break;
+        case FORASYNC_MODE_HILBERT:
+            fct_ptr = fct_ptr_hilbert;
+            break;
+        case FORASYNC_MODE_OBLIVIOUS:
+            fct_ptr = fct_ptr_oblivious;
+            break;
+        default:
+            fct_ptr = fct_ptr_flat;
+    }
+
+    // Chunks must be able to find the whole loop after this frame is gone
+    forasync_t base = {user_def, range_body, dist_func_id};
+    if (dist_func_id != HCLIB_DEFAULT_LOOP_DIST) {
+        HASSERT(mode == FORASYNC_MODE_FLAT || mode == FORASYNC_MODE_MORTON ||
+                mode == FORASYNC_MODE_HILBERT);
+        memcpy(base.loops, loop_domain, dim * sizeof(*loop_domain));
+    }
+
+    // The adaptive mode ignores the user tile and uses it for its chunk size
+    hclib_loop_domain_t outer = loop_domain[0];
+    if (mode == FORASYNC_MODE_ADAPTIVE) {
+        outer.tile = adaptive_chunk_size(outer.high - outer.low, outer.stride);
+    }
+
     if (dim == 1) {
-        forasync1D_t forasync = {{user_def}, loop_domain[0]};
+        forasync1D_t forasync = {base, outer};
         (fct_ptr[dim-1])((void *) &forasync);
     } else if (dim == 2) {
-        forasync2D_t forasync = {{user_def}, {loop_domain[0], loop_domain[1]}};
+        forasync2D_t forasync = {base, {outer, loop_domain[1]}};
         (fct_ptr[dim-1])((void *) &forasync);
     } else if (dim == 3) {
-        forasync3D_t forasync = {{user_def}, {loop_domain[0], loop_domain[1],
+        forasync3D_t forasync = {base, {outer, loop_domain[1],
             loop_domain[2]}};
         (fct_ptr[dim-1])((void *) &forasync);
     }
 }
 
-void hclib_forasync(void *forasync_fct, void *argv, int dim,
-                    hclib_loop_domain_t *domain, forasync_mode_t mode) {
+static void set_default_tiles(int dim, hclib_loop_domain_t *domain) {
     const int nworkers = hclib_get_num_workers();
     int i;
     for (i = 0; i < dim; i++) {
@@ -459,8 +987,13 @@ void hclib_forasync(void *forasync_fct, void *argv, int dim,
                 nworkers;
         }
     }
+}
 
-    forasync_internal(forasync_fct, argv, dim, domain, mode);
+void hclib_forasync(void *forasync_fct, void *argv, int dim,
+                    hclib_loop_domain_t *domain, forasync_mode_t mode) {
+    set_default_tiles(dim, domain);
+    forasync_internal(forasync_fct, argv, dim, domain, mode, 0,
+            HCLIB_DEFAULT_LOOP_DIST);
 }
 
 hclib_future_t *hclib_forasync_future(void *forasync_fct, void *argv,
@@ -472,6 +1005,39 @@ hclib_future_t *hclib_forasync_future(void *forasync_fct, void *argv,
     return hclib_end_finish_nonblocking();
 }
 
+void hclib_forasync_dist(void *forasync_fct, void *argv, int dim,
+                         hclib_loop_domain_t *domain, forasync_mode_t mode,
+                         unsigned dist_func_id) {
+    set_default_tiles(dim, domain);
+    forasync_internal(forasync_fct, argv, dim, domain, mode, 0, dist_func_id);
+}
+
+hclib_future_t *hclib_forasync_future_dist(void *forasync_fct, void *argv,
+                                           int dim,
+                                           hclib_loop_domain_t *domain,
+                                           forasync_mode_t mode,
+                                           unsigned dist_func_id) {
+    hclib_start_finish();
+    hclib_forasync_dist(forasync_fct, argv, dim, domain, mode, dist_func_id);
+    return hclib_end_finish_nonblocking();
+}
+
+void hclib_forasync_range(void *forasync_fct, void *argv, int dim,
+                          hclib_loop_domain_t *domain, forasync_mode_t mode) {
+    set_default_tiles(dim, domain);
+    forasync_internal(forasync_fct, argv, dim, domain, mode, 1,
+            HCLIB_DEFAULT_LOOP_DIST);
+}
+
+hclib_future_t *hclib_forasync_range_future(void *forasync_fct, void *argv,
+                                            int dim,
+                                            hclib_loop_domain_t *domain,
+                                            forasync_mode_t mode) {
+    hclib_start_finish();
+    hclib_forasync_range(forasync_fct, argv, dim, domain, mode);
+    return hclib_end_finish_nonblocking();
+}
+
 void hclib_get_curr_task_info(void (**fp_out)(void *), void **args_out) {
     hclib_worker_state *ws = CURRENT_WS_INTERNAL;
     hclib_task_t *curr_task = (hclib_task_t *)ws->curr_task;
@@ -134,9 +134,14 @@ unsigned hclib_add_per_worker_module_state(size_t state_size,
 
     for (i = 0; i < hc_context->nworkers; i++) {
         hclib_worker_state *ws = hc_context->workers[i];
-        ws->module_state = (char *)realloc(ws->module_state,
+        char *module_state = (char *)hclib_alloc_per_worker(
                 worker_state_size + state_size);
-        assert(ws->module_state);
+        assert(module_state);
+        if (ws->module_state) {
+            memcpy(module_state, ws->module_state, worker_state_size);
+            free(ws->module_state);
+        }
+        ws->module_state = module_state;
 
         cb(ws->module_state + offset, user_data, i);
     }
@@ -146,6 +151,20 @@ unsigned hclib_add_per_worker_module_state(size_t state_size,
     return offset;
 }
 
+/*
+ * Copy module_state into memory allocated by the calling worker, freeing the
+ * original. Called by each worker when it starts, see localize_worker_state.
+ */
+char *hclib_localize_per_worker_module_state(char *module_state) {
+    if (module_state == NULL) return NULL;
+
+    char *local = (char *)hclib_alloc_per_worker(worker_state_size);
+    assert(local);
+    memcpy(local, module_state, worker_state_size);
+    free(module_state);
+    return local;
+}
+
 void *hclib_get_curr_worker_module_state(const unsigned state_id) {
     hclib_worker_state *ws = current_ws();
     return ws->module_state + state_id;
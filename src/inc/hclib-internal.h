@@ -47,6 +47,10 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "litectx.h"
 #include "hclib-locality-graph.h"
 
+#ifdef USE_HWLOC
+#include <hwloc.h>
+#endif
+
 #define LOG_LEVEL_FATAL         1
 #define LOG_LEVEL_WARN          2
 #define LOG_LEVEL_INFO          3
@@ -127,4 +131,21 @@ int static inline _hclib_promise_is_satisfied(hclib_promise_t *p) {
     return p->wait_list_head == SATISFIED_FUTURE_WAITLIST_PTR;
 }
 
+// Alignment and padding of structures written by a single worker
+#define PER_WORKER_ALIGNMENT 128
+
+void *hclib_alloc_per_worker(size_t nbytes);
+char *hclib_localize_per_worker_module_state(char *module_state);
+
+#ifdef USE_HWLOC
+// thread affinity
+void hclib_assign_worker_cpusets(hwloc_const_bitmap_t cpuset,
+        const int num_workers, hwloc_bitmap_t *thread_cpusets);
+#elif defined(__linux__)
+// thread affinity, see hclib-affinity.c
+void hclib_init_worker_affinities(const int nworkers);
+void hclib_bind_worker(const int wid);
+void hclib_free_worker_affinities();
+#endif
+
 #endif /* HCLIB_INTERNAL_H_ */
@@ -6,19 +6,33 @@
 #define LEFT 0
 #define RIGHT 1
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 typedef struct _hclib_memory_tree_node {
     int height;
     struct _hclib_memory_tree_node *children[2];
 
     unsigned char *start_address;
     size_t length;
+    // Caller-provided payload associated with this range
+    void *data;
 } hclib_memory_tree_node;
 
 extern void hclib_memory_tree_insert(void *address, size_t length,
         hclib_memory_tree_node **root);
+extern void hclib_memory_tree_insert_data(void *address, size_t length,
+        void *data, hclib_memory_tree_node **root);
 extern void hclib_memory_tree_remove(void *address,
         hclib_memory_tree_node **root);
 extern int hclib_memory_tree_contains(void *address,
         hclib_memory_tree_node **root);
+extern hclib_memory_tree_node *hclib_memory_tree_find(void *address,
+        hclib_memory_tree_node **root);
+
+#ifdef __cplusplus
+}
+#endif
 
 #endif
@@ -0,0 +1,147 @@
+/* Copyright (c) 2013, Rice University
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+
+1.  Redistributions of source code must retain the above copyright
+     notice, this list of conditions and the following disclaimer.
+2.  Redistributions in binary form must reproduce the above
+     copyright notice, this list of conditions and the following
+     disclaimer in the documentation and/or other materials provided
+     with the distribution.
+3.  Neither the name of Rice University
+     nor the names of its contributors may be used to endorse or
+     promote products derived from this software without specific
+     prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+
+
+/**
+ * DESC: Per-worker runtime state does not share cache lines across workers.
+ *
+ * One task is placed at each worker's thread-private locale, so that every
+ * worker runs at least one, followed by many tiny tasks anywhere, and each
+ * records the worker state and module state it sees. These must all be aligned
+ * to 128 bytes, and no two workers' states may share a cache line.
+ * Where the kernel allows it, the cache misses taken by the whole run are also
+ * counted and reported per task, to compare before and after layout changes.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#include "hclib.h"
+
+#define ALIGNMENT 128
+#define MAX_WORKERS 1024
+#define TASKS_PER_WORKER 4096
+
+static hclib_worker_state *seen_ws[MAX_WORKERS];
+static char *seen_module_state[MAX_WORKERS];
+static volatile long ntasks_run = 0;
+
+void record_worker(void *arg) {
+    hclib_worker_state *ws = current_ws();
+    assert(ws->id < MAX_WORKERS);
+    seen_ws[ws->id] = ws;
+    seen_module_state[ws->id] = ws->module_state;
+    __sync_fetch_and_add(&ntasks_run, 1);
+}
+
+static int same_line(const void *a, const void *b) {
+    return (uintptr_t)a / ALIGNMENT == (uintptr_t)b / ALIGNMENT;
+}
+
+void entrypoint(void *arg) {
+    const int nworkers = hclib_get_num_workers();
+    const long ntasks = (long)nworkers * TASKS_PER_WORKER;
+    assert(nworkers <= MAX_WORKERS);
+
+    hclib_locale_t **private_locales = hclib_get_thread_private_locales();
+    hclib_start_finish();
+    for (int w = 0; w < nworkers; w++) {
+        assert(private_locales[w]);
+        hclib_async(record_worker, NULL, NO_FUTURE, 0, private_locales[w]);
+    }
+    for (long i = 0; i < ntasks; i++) {
+        hclib_async(record_worker, NULL, NO_FUTURE, 0, ANY_PLACE);
+    }
+    hclib_end_finish();
+    assert(ntasks_run == nworkers + ntasks);
+    free(private_locales);
+
+    int nseen = 0;
+    for (int i = 0; i < nworkers; i++) {
+        hclib_worker_state *ws = seen_ws[i];
+        if (ws == NULL) continue;
+        nseen++;
+
+        assert((uintptr_t)ws % ALIGNMENT == 0);
+        assert((uintptr_t)seen_module_state[i] % ALIGNMENT == 0);
+        for (int j = 0; j < nworkers; j++) {
+            if (j == i || seen_ws[j] == NULL) continue;
+            // Worker states are whole lines, so only their ends can overlap
+            assert(!same_line((char *)ws + sizeof(*ws) - 1, seen_ws[j]));
+            if (seen_module_state[i] && seen_module_state[j]) {
+                assert(!same_line(seen_module_state[i],
+                            seen_module_state[j]));
+            }
+        }
+    }
+    printf("Checked the state of %d of %d workers\n", nseen, nworkers);
+    assert(nseen == nworkers);
+}
+
+/*
+ * Count cache misses in this thread and every thread it creates from here on,
+ * or return -1 if the counter is not available.
+ */
+static int open_cache_miss_counter() {
+    struct perf_event_attr attr;
+    memset(&attr, 0x00, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = PERF_COUNT_HW_CACHE_MISSES;
+    attr.inherit = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+int main(int argc, char ** argv) {
+    const int fd = open_cache_miss_counter();
+
+    char const *deps[] = { "system" };
+    hclib_launch(entrypoint, NULL, deps, 1);
+
+    long long misses;
+    // Inherited counts are added to ours as the workers exit
+    if (fd >= 0 && read(fd, &misses, sizeof(misses)) == sizeof(misses)) {
+        printf("%lld cache misses, %f per task\n", misses,
+                (double)misses / (double)ntasks_run);
+        close(fd);
+    } else {
+        printf("Cache miss counter unavailable, not reporting misses\n");
+    }
+    printf("Passed\n");
+    return 0;
+}
@@ -0,0 +1,124 @@
+/* Copyright (c) 2013, Rice University
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+
+1.  Redistributions of source code must retain the above copyright
+     notice, this list of conditions and the following disclaimer.
+2.  Redistributions in binary form must reproduce the above
+     copyright notice, this list of conditions and the following
+     disclaimer in the documentation and/or other materials provided
+     with the distribution.
+3.  Neither the name of Rice University
+     nor the names of its contributors may be used to endorse or
+     promote products derived from this software without specific
+     prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+
+/**
+ * DESC: Flat forasync placed with the built-in loop distributions
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <assert.h>
+
+#include "hclib.h"
+
+#define H1 1024
+#define T1 33
+#define NSTEPS 4
+
+typedef struct {
+    int *ran;
+    int *worker;
+} loop_state_t;
+
+void forasync_fct1(void *argv, int idx) {
+    loop_state_t *state = (loop_state_t *)argv;
+    assert(state->ran[idx] == -1);
+    state->ran[idx] = idx;
+    state->worker[idx] = hclib_get_current_worker();
+}
+
+void init_ran(int *ran, int size) {
+    while (size > 0) {
+        ran[size-1] = -1;
+        size--;
+    }
+}
+
+void check_ran(int *ran, int size) {
+    int i = 0;
+    while (i < size) {
+        assert(ran[i] == i);
+        i++;
+    }
+}
+
+void entrypoint(void *arg) {
+    loop_state_t *state = (loop_state_t *)arg;
+    int *prev_worker = (int *)malloc(H1 * sizeof(int));
+    assert(prev_worker);
+    unsigned dists[] = { HCLIB_BLOCK_LOOP_DIST, HCLIB_CYCLIC_LOOP_DIST,
+        HCLIB_REPLAY_LOOP_DIST };
+    int d, step, i;
+
+    for (d = 0; d < 3; d++) {
+        for (step = 0; step < NSTEPS; step++) {
+            hclib_loop_domain_t loop = {0, H1, 1, T1};
+            init_ran(state->ran, H1);
+            hclib_start_finish();
+            hclib_forasync_dist((void *)forasync_fct1, (void *)state, 1, &loop,
+                    FORASYNC_MODE_FLAT, dists[d]);
+            hclib_end_finish();
+            check_ran(state->ran, H1);
+
+            /*
+             * Thread-private locales are only visited by their owner, so every
+             * distribution here is deterministic across timesteps.
+             */
+            if (step > 0) {
+                for (i = 0; i < H1; i++) {
+                    assert(state->worker[i] == prev_worker[i]);
+                }
+            }
+            for (i = 0; i < H1; i++) {
+                prev_worker[i] = state->worker[i];
+            }
+        }
+    }
+    free(prev_worker);
+
+    printf("Call Finalize\n");
+}
+
+int main (int argc, char ** argv) {
+    printf("Call Init\n");
+    loop_state_t state;
+    state.ran = (int *)malloc(H1 * sizeof(int));
+    state.worker = (int *)malloc(H1 * sizeof(int));
+    assert(state.ran && state.worker);
+
+    char const *deps[] = { "system" };
+    hclib_launch(entrypoint, &state, deps, 1);
+    printf("Check results: ");
+    check_ran(state.ran, H1);
+    free(state.ran);
+    free(state.worker);
+    printf("OK\n");
+    return 0;
+}
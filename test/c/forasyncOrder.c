@@ -0,0 +1,147 @@
+/* Copyright (c) 2013, Rice University
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+
+1.  Redistributions of source code must retain the above copyright
+     notice, this list of conditions and the following disclaimer.
+2.  Redistributions in binary form must reproduce the above
+     copyright notice, this list of conditions and the following
+     disclaimer in the documentation and/or other materials provided
+     with the distribution.
+3.  Neither the name of Rice University
+     nor the names of its contributors may be used to endorse or
+     promote products derived from this software without specific
+     prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+
+/**
+ * DESC: 2D/3D forasync with space-filling curve and cache-oblivious orders
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <assert.h>
+
+#include "hclib.h"
+
+#define H1 300
+#define H2 170
+#define H3 24
+#define T1 7
+#define T2 11
+#define T3 5
+
+void forasync_fct2(void *argv, int idx1, int idx2) {
+    int *ran = (int *)argv;
+    assert(ran[idx1 * H2 + idx2] == -1);
+    ran[idx1 * H2 + idx2] = idx1 * H2 + idx2;
+}
+
+void forasync_fct3(void *argv, int idx1, int idx2, int idx3) {
+    int *ran = (int *)argv;
+    const int idx = (idx1 * H2 + idx2) * H3 + idx3;
+    assert(ran[idx] == -1);
+    ran[idx] = idx;
+}
+
+void init_ran(int *ran, int size) {
+    while (size > 0) {
+        ran[size-1] = -1;
+        size--;
+    }
+}
+
+void check_ran(int *ran, int size) {
+    int i = 0;
+    while (i < size) {
+        assert(ran[i] == i);
+        i++;
+    }
+}
+
+/*
+ * Every tile must be visited exactly once, and consecutive tiles of a Hilbert
+ * traversal must touch (at most one diagonal step).
+ */
+void check_order(int rows, int cols, forasync_mode_t mode) {
+    const int ntiles[2] = {rows, cols};
+    int *order = (int *)malloc(rows * cols * sizeof(int));
+    int *seen = (int *)calloc(rows * cols, sizeof(int));
+    assert(order && seen);
+    hclib_forasync_tile_order(2, ntiles, mode, order);
+
+    int i;
+    for (i = 0; i < rows * cols; i++) {
+        assert(order[i] >= 0 && order[i] < rows * cols);
+        assert(seen[order[i]] == 0);
+        seen[order[i]] = 1;
+
+        if (mode == FORASYNC_MODE_HILBERT && i > 0) {
+            const int dr = abs(order[i] / cols - order[i - 1] / cols);
+            const int dc = abs(order[i] % cols - order[i - 1] % cols);
+            assert(dr <= 1 && dc <= 1);
+        }
+    }
+    free(order);
+    free(seen);
+}
+
+void entrypoint(void *arg) {
+    int *ran = (int *)arg;
+    forasync_mode_t modes[] = { FORASYNC_MODE_MORTON, FORASYNC_MODE_HILBERT,
+        FORASYNC_MODE_OBLIVIOUS };
+    int m;
+
+    check_order(1, 1, FORASYNC_MODE_HILBERT);
+    check_order(8, 8, FORASYNC_MODE_HILBERT);
+    check_order(5, 13, FORASYNC_MODE_HILBERT);
+    check_order(17, 3, FORASYNC_MODE_HILBERT);
+    check_order(5, 13, FORASYNC_MODE_MORTON);
+
+    for (m = 0; m < 3; m++) {
+        hclib_loop_domain_t loop2[2] = {{0, H1, 1, T1}, {0, H2, 1, T2}};
+        init_ran(ran, H1 * H2);
+        hclib_start_finish();
+        hclib_forasync((void *)forasync_fct2, (void *)ran, 2, loop2, modes[m]);
+        hclib_end_finish();
+        check_ran(ran, H1 * H2);
+
+        hclib_loop_domain_t loop3[3] = {{0, H1, 1, T1}, {0, H2, 1, T2},
+            {0, H3, 1, T3}};
+        init_ran(ran, H1 * H2 * H3);
+        hclib_start_finish();
+        hclib_forasync((void *)forasync_fct3, (void *)ran, 3, loop3, modes[m]);
+        hclib_end_finish();
+        check_ran(ran, H1 * H2 * H3);
+    }
+
+    printf("Call Finalize\n");
+}
+
+int main (int argc, char ** argv) {
+    printf("Call Init\n");
+    int *ran = (int *)malloc(H1 * H2 * H3 * sizeof(int));
+    assert(ran);
+
+    char const *deps[] = { "system" };
+    hclib_launch(entrypoint, ran, deps, 1);
+    printf("Check results: ");
+    check_ran(ran, H1 * H2 * H3);
+    free(ran);
+    printf("OK\n");
+    return 0;
+}
@@ -0,0 +1,141 @@
+/* Copyright (c) 2013, Rice University
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+
+1.  Redistributions of source code must retain the above copyright
+     notice, this list of conditions and the following disclaimer.
+2.  Redistributions in binary form must reproduce the above
+     copyright notice, this list of conditions and the following
+     disclaimer in the documentation and/or other materials provided
+     with the distribution.
+3.  Neither the name of Rice University
+     nor the names of its contributors may be used to endorse or
+     promote products derived from this software without specific
+     prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+
+/**
+ * DESC: Range-body forasync over 1D, 2D, and 3D domains
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <assert.h>
+
+#include "hclib.h"
+
+#define H1 1024
+#define H2 64
+#define H3 32
+#define T1 33
+#define T2 7
+#define T3 5
+
+void range_fct1(void *argv, int low, int high) {
+    int *ran = (int *)argv;
+    int i;
+    for (i = low; i < high; i++) {
+        assert(ran[i] == -1);
+        ran[i] = i;
+    }
+}
+
+void range_fct2(void *argv, int low0, int high0, int low1, int high1) {
+    int *ran = (int *)argv;
+    int i, j;
+    for (i = low0; i < high0; i++) {
+        for (j = low1; j < high1; j++) {
+            assert(ran[i * H2 + j] == -1);
+            ran[i * H2 + j] = i * H2 + j;
+        }
+    }
+}
+
+void range_fct3(void *argv, int low0, int high0, int low1, int high1,
+        int low2, int high2) {
+    int *ran = (int *)argv;
+    int i, j, k;
+    for (i = low0; i < high0; i++) {
+        for (j = low1; j < high1; j++) {
+            for (k = low2; k < high2; k++) {
+                const int idx = (i * H2 + j) * H3 + k;
+                assert(ran[idx] == -1);
+                ran[idx] = idx;
+            }
+        }
+    }
+}
+
+void init_ran(int *ran, int size) {
+    while (size > 0) {
+        ran[size-1] = -1;
+        size--;
+    }
+}
+
+void check_ran(int *ran, int size) {
+    int i = 0;
+    while (i < size) {
+        assert(ran[i] == i);
+        i++;
+    }
+}
+
+void entrypoint(void *arg) {
+    int *ran = (int *)arg;
+    int mode;
+
+    for (mode = FORASYNC_MODE_FLAT; mode <= FORASYNC_MODE_RECURSIVE; mode++) {
+        hclib_loop_domain_t loop1 = {0, H1, 1, T1};
+        init_ran(ran, H1);
+        hclib_start_finish();
+        hclib_forasync_range((void *)range_fct1, (void *)ran, 1, &loop1, mode);
+        hclib_end_finish();
+        check_ran(ran, H1);
+
+        hclib_loop_domain_t loop2[2] = {{0, H1, 1, T1}, {0, H2, 1, T2}};
+        init_ran(ran, H1 * H2);
+        hclib_start_finish();
+        hclib_forasync_range((void *)range_fct2, (void *)ran, 2, loop2, mode);
+        hclib_end_finish();
+        check_ran(ran, H1 * H2);
+
+        hclib_loop_domain_t loop3[3] = {{0, H1, 1, T1}, {0, H2, 1, T2},
+            {0, H3, 1, T3}};
+        init_ran(ran, H1 * H2 * H3);
+        hclib_future_t *fut = hclib_forasync_range_future((void *)range_fct3,
+                (void *)ran, 3, loop3, mode);
+        hclib_future_wait(fut);
+        check_ran(ran, H1 * H2 * H3);
+    }
+
+    printf("Call Finalize\n");
+}
+
+int main (int argc, char ** argv) {
+    printf("Call Init\n");
+    int *ran = (int *)malloc(H1 * H2 * H3 * sizeof(int));
+    assert(ran);
+
+    char const *deps[] = { "system" };
+    hclib_launch(entrypoint, ran, deps, 1);
+    printf("Check results: ");
+    check_ran(ran, H1 * H2 * H3);
+    free(ran);
+    printf("OK\n");
+    return 0;
+}
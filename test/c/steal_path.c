@@ -0,0 +1,150 @@
+/* Copyright (c) 2013, Rice University
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+
+1.  Redistributions of source code must retain the above copyright
+     notice, this list of conditions and the following disclaimer.
+2.  Redistributions in binary form must reproduce the above
+     copyright notice, this list of conditions and the following
+     disclaimer in the documentation and/or other materials provided
+     with the distribution.
+3.  Neither the name of Rice University
+     nor the names of its contributors may be used to endorse or
+     promote products derived from this software without specific
+     prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+
+
+/**
+ * DESC: Online reordering of steal paths.
+ *
+ * Uses the edison.no_interconnect locality graph (unless HCLIB_LOCALITY_FILE is
+ * already set), in which worker 1 steals from L2_0_1, L3_0 and then sysmem.
+ * Only the master spawns tasks, so L2_0_1 never holds any. Tasks are first
+ * placed at sysmem and then at L3_0, and in each phase batches are run until
+ * worker 1 has stolen from the current batch and its learned steal path (as
+ * returned by hclib_get_steal_path) starts with the locale holding work and
+ * leaves out L2_0_1, which it should have skipped. Every worker's learned path is then checked for duplicates, and
+ * the statistics they were learned from are printed.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+#include "hclib.h"
+
+#define OBSERVED_WORKER 1
+#define TASKS_PER_BATCH 1000
+#define TASK_SPINS 1000
+#define MAX_BATCHES 10000
+#define MAX_PATH_LENGTH 64
+
+static volatile long observed_ntasks = 0;
+
+// Long enough that other workers get to steal while the master runs tasks
+void task(void *arg) {
+    for (volatile int i = 0; i < TASK_SPINS; i++) ;
+    if (hclib_get_current_worker() == OBSERVED_WORKER) {
+        __sync_fetch_and_add(&observed_ntasks, 1);
+    }
+}
+
+static hclib_locale_t *find_locale(const char *lbl) {
+    hclib_locale_t *locales = hclib_get_all_locales();
+    for (int i = 0; i < hclib_get_num_locales(); i++) {
+        if (strcmp(locales[i].lbl, lbl) == 0) return locales + i;
+    }
+    fprintf(stderr, "No locale named %s\n", lbl);
+    exit(1);
+}
+
+static void check_no_duplicates(const int wid) {
+    hclib_locale_t *learned[MAX_PATH_LENGTH];
+    const unsigned count = hclib_get_steal_path(wid, learned,
+            MAX_PATH_LENGTH);
+    assert(count > 0);
+
+    for (unsigned i = 0; i < count; i++) {
+        for (unsigned j = 0; j < i; j++) {
+            assert(learned[j] != learned[i]);
+        }
+    }
+}
+
+/*
+ * Whether the observed worker's learned path starts with busy and no longer
+ * holds empty.
+ */
+static int path_learned(hclib_locale_t *busy, hclib_locale_t *empty) {
+    hclib_locale_t *learned[MAX_PATH_LENGTH];
+    const unsigned count = hclib_get_steal_path(OBSERVED_WORKER, learned,
+            MAX_PATH_LENGTH);
+    if (count == 0 || learned[0] != busy) return 0;
+    for (unsigned i = 0; i < count; i++) {
+        if (learned[i] == empty) return 0;
+    }
+    return 1;
+}
+
+/*
+ * Run batches of tasks at busy until the observed worker has stolen from one
+ * and learned its path.
+ */
+static void run_phase(hclib_locale_t *busy, hclib_locale_t *empty) {
+    for (int batch = 0; batch < MAX_BATCHES; batch++) {
+        const long observed_before = observed_ntasks;
+        hclib_start_finish();
+        for (int i = 0; i < TASKS_PER_BATCH; i++) {
+            hclib_async(task, NULL, NO_FUTURE, 0, busy);
+        }
+        hclib_end_finish();
+
+        if (observed_ntasks > observed_before && path_learned(busy, empty)) {
+            printf("Worker %d learned to steal from %s first after %d "
+                    "batches\n", OBSERVED_WORKER, busy->lbl, batch + 1);
+            return;
+        }
+    }
+    fprintf(stderr, "Worker %d did not learn to steal from %s first\n",
+            OBSERVED_WORKER, busy->lbl);
+    hclib_print_steal_stats(stderr);
+    exit(1);
+}
+
+void entrypoint(void *arg) {
+    assert(hclib_get_num_workers() > OBSERVED_WORKER);
+    hclib_locale_t *empty = find_locale("L2_0_1");
+
+    run_phase(find_locale("sysmem"), empty);
+    run_phase(find_locale("L3_0"), empty);
+
+    for (int wid = 0; wid < hclib_get_num_workers(); wid++) {
+        check_no_duplicates(wid);
+    }
+    hclib_print_steal_stats(stdout);
+    printf("Passed\n");
+}
+
+int main(int argc, char ** argv) {
+    setenv("HCLIB_LOCALITY_FILE",
+            "../../locality_graphs/edison.no_interconnect.json", 0);
+    char const *deps[] = { "system" };
+    hclib_launch(entrypoint, NULL, deps, 1);
+    return 0;
+}
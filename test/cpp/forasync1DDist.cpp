@@ -0,0 +1,77 @@
+/* Copyright (c) 2013, Rice University
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+
+1.  Redistributions of source code must retain the above copyright
+     notice, this list of conditions and the following disclaimer.
+2.  Redistributions in binary form must reproduce the above
+     copyright notice, this list of conditions and the following
+     disclaimer in the documentation and/or other materials provided
+     with the distribution.
+3.  Neither the name of Rice University
+     nor the names of its contributors may be used to endorse or
+     promote products derived from this software without specific
+     prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+
+/**
+ * DESC: Flat forasync1D that replays chunk placement across timesteps
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <assert.h>
+
+#include "hclib_cpp.h"
+
+#define H1 1024
+#define T1 33
+#define NSTEPS 4
+
+int main (int argc, char ** argv) {
+    printf("Call Init\n");
+    int *ran = (int *)malloc(H1 * sizeof(int));
+    int *worker = (int *)malloc(H1 * sizeof(int));
+    int *prev_worker = (int *)malloc(H1 * sizeof(int));
+    const char *deps[] = { "system" };
+    hclib::launch(deps, 1, [=]() {
+        hclib::loop_domain_1d *loop = new hclib::loop_domain_1d(0, H1, T1);
+        for (int step = 0; step < NSTEPS; step++) {
+            for (int i = 0; i < H1; i++) ran[i] = -1;
+            hclib::finish([=]() {
+                hclib::forasync1D(loop, [=](int idx) {
+                    assert(ran[idx] == -1);
+                    ran[idx] = idx;
+                    worker[idx] = hclib::get_current_worker();
+                }, false, FORASYNC_MODE_FLAT, NULL, HCLIB_REPLAY_LOOP_DIST);
+            });
+
+            for (int i = 0; i < H1; i++) {
+                assert(ran[i] == i);
+                if (step > 0) assert(worker[i] == prev_worker[i]);
+                prev_worker[i] = worker[i];
+            }
+        }
+    });
+
+    printf("Check results: ");
+    free(ran);
+    free(worker);
+    free(prev_worker);
+    printf("OK\n");
+    return 0;
+}
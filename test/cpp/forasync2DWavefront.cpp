@@ -0,0 +1,124 @@
+/* Copyright (c) 2013, Rice University
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+
+1.  Redistributions of source code must retain the above copyright
+     notice, this list of conditions and the following disclaimer.
+2.  Redistributions in binary form must reproduce the above
+     copyright notice, this list of conditions and the following
+     disclaimer in the documentation and/or other materials provided
+     with the distribution.
+3.  Neither the name of Rice University
+     nor the names of its contributors may be used to endorse or
+     promote products derived from this software without specific
+     prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+
+/**
+ * DESC: Wavefront forasync2D over a dynamic-programming recurrence
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <assert.h>
+
+#include "hclib_cpp.h"
+#define H1 300
+#define H2 470
+#define T1 17
+#define T2 23
+#define MOD 1000003
+
+/*
+ * f[i][j] depends on its north, west, and northwest neighbours, so tiles can
+ * only be computed along anti-diagonals.
+ */
+static inline int recurrence(int *f, int i, int j) {
+    if (i == 0 || j == 0) return 1;
+    return (f[(i - 1) * H2 + j] + f[i * H2 + j - 1] +
+            f[(i - 1) * H2 + j - 1]) % MOD;
+}
+
+int main (int argc, char ** argv) {
+    printf("Call Init\n");
+    int *expected = (int *)malloc(H1 * H2 * sizeof(int));
+    int *f = (int *)malloc(H1 * H2 * sizeof(int));
+    int *g = (int *)malloc(H1 * H2 * sizeof(int));
+    for (int i = 0; i < H1; i++) {
+        for (int j = 0; j < H2; j++) {
+            expected[i * H2 + j] = recurrence(expected, i, j);
+            f[i * H2 + j] = -1;
+            g[i * H2 + j] = -1;
+        }
+    }
+
+    const char *deps[] = { "system" };
+    hclib::launch(deps, 1, [=]() {
+        hclib::finish([=]() {
+            hclib::loop_domain_2d *loop = new hclib::loop_domain_2d(0, H1, T1,
+                    0, H2, T2);
+            hclib::forasync2D_wavefront(loop, FORASYNC_WAVEFRONT_NORTH |
+                    FORASYNC_WAVEFRONT_WEST | FORASYNC_WAVEFRONT_NORTHWEST,
+                    [=](int low0, int high0, int low1, int high1) {
+                for (int i = low0; i < high0; i++) {
+                    for (int j = low1; j < high1; j++) {
+                        assert(f[i * H2 + j] == -1);
+                        f[i * H2 + j] = recurrence(f, i, j);
+                    }
+                }
+            });
+        });
+
+        /*
+         * Northeast dependencies: each cell reads the row above up to one
+         * column to its right. With one row per tile, that cell always lives
+         * in the north or northeast tile.
+         */
+        hclib::finish([=]() {
+            hclib::loop_domain_2d *loop = new hclib::loop_domain_2d(0, H1, 1,
+                    0, H2, T2);
+            hclib::forasync2D_wavefront(loop, FORASYNC_WAVEFRONT_WEST |
+                    FORASYNC_WAVEFRONT_NORTH | FORASYNC_WAVEFRONT_NORTHEAST,
+                    [=](int low0, int high0, int low1, int high1) {
+                for (int i = low0; i < high0; i++) {
+                    for (int j = low1; j < high1; j++) {
+                        assert(g[i * H2 + j] == -1);
+                        if (i == 0 || j == 0 || j == H2 - 1) {
+                            g[i * H2 + j] = 1;
+                        } else {
+                            assert(g[(i - 1) * H2 + j + 1] != -1);
+                            assert(g[i * H2 + j - 1] != -1);
+                            g[i * H2 + j] = (g[(i - 1) * H2 + j + 1] +
+                                    g[i * H2 + j - 1]) % MOD;
+                        }
+                    }
+                }
+            });
+        });
+    });
+
+    printf("Check results: ");
+    for (int i = 0; i < H1 * H2; i++) {
+        assert(f[i] == expected[i]);
+        assert(g[i] != -1);
+    }
+    free(expected);
+    free(f);
+    free(g);
+    printf("OK\n");
+    return 0;
+}
@@ -0,0 +1,133 @@
+/* Copyright (c) 2013, Rice University
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are
+met:
+
+1.  Redistributions of source code must retain the above copyright
+     notice, this list of conditions and the following disclaimer.
+2.  Redistributions in binary form must reproduce the above
+     copyright notice, this list of conditions and the following
+     disclaimer in the documentation and/or other materials provided
+     with the distribution.
+3.  Neither the name of Rice University
+     nor the names of its contributors may be used to endorse or
+     promote products derived from this software without specific
+     prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+"AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ */
+
+/**
+ * DESC: Range-body forasync over 1D, 2D, and 3D domains
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <assert.h>
+
+#include "hclib_cpp.h"
+
+#define H1 1024
+#define H2 64
+#define H3 32
+#define T1 33
+
+void init_ran(int *ran, int size) {
+    while (size > 0) {
+        ran[size-1] = -1;
+        size--;
+    }
+}
+
+void check_ran(int *ran, int size) {
+    int i = 0;
+    while (i < size) {
+        assert(ran[i] == i);
+        i++;
+    }
+}
+
+int main (int argc, char ** argv) {
+    printf("Call Init\n");
+    int *ran=(int *)malloc(H1*H2*H3*sizeof(int));
+    const char *deps[] = { "system" };
+    hclib::launch(deps, 1, [=]() {
+        for (int mode = FORASYNC_MODE_FLAT; mode <= FORASYNC_MODE_RECURSIVE;
+                mode++) {
+            init_ran(ran, H1);
+            hclib::finish([=]() {
+                hclib::loop_domain_1d *loop = new hclib::loop_domain_1d(0, H1,
+                        T1);
+                hclib::forasync1D_range(loop, [=](int low, int high) {
+                    for (int i = low; i < high; i++) {
+                        assert(ran[i] == -1);
+                        ran[i] = i;
+                    }
+                }, false, mode);
+            });
+            check_ran(ran, H1);
+
+            init_ran(ran, H1 * H2);
+            hclib::finish([=]() {
+                hclib::loop_domain_2d *loop = new hclib::loop_domain_2d(H1, H2);
+                hclib::forasync2D_range(loop, [=](int low0, int high0,
+                            int low1, int high1) {
+                    for (int i = low0; i < high0; i++) {
+                        for (int j = low1; j < high1; j++) {
+                            assert(ran[i * H2 + j] == -1);
+                            ran[i * H2 + j] = i * H2 + j;
+                        }
+                    }
+                }, false, mode);
+            });
+            check_ran(ran, H1 * H2);
+
+            init_ran(ran, H1 * H2 * H3);
+            hclib::finish([=]() {
+                hclib::loop_domain_3d *loop = new hclib::loop_domain_3d(H1, H2,
+                        H3);
+                hclib::forasync3D_range(loop, [=](int low0, int high0,
+                            int low1, int high1, int low2, int high2) {
+                    for (int i = low0; i < high0; i++) {
+                        for (int j = low1; j < high1; j++) {
+                            for (int k = low2; k < high2; k++) {
+                                const int idx = (i * H2 + j) * H3 + k;
+                                assert(ran[idx] == -1);
+                                ran[idx] = idx;
+                            }
+                        }
+                    }
+                }, false, mode);
+            });
+            check_ran(ran, H1 * H2 * H3);
+        }
+
+        init_ran(ran, H1);
+        hclib::loop_domain_1d *loop = new hclib::loop_domain_1d(0, H1, T1);
+        hclib::future_t<void> *fut = hclib::forasync1D_range_future(loop,
+                [=](int low, int high) {
+                    for (int i = low; i < high; i++) {
+                        assert(ran[i] == -1);
+                        ran[i] = i;
+                    }
+                });
+        fut->wait();
+    });
+
+    printf("Check results: ");
+    check_ran(ran, H1);
+    free(ran);
+    printf("OK\n");
+    return 0;
+}
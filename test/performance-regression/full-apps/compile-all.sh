@@ -111,6 +111,7 @@ compile_all tied ref
 # compile_all untied ref
 # compile_all flat
 # compile_all recursive
+# compile_all replay
 
 for TEST in "${!DATASETS[@]}"; do
     TEST_EXE=$(echo $TEST | awk -F ',' '{ print $1 }')
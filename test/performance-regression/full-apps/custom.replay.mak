@@ -0,0 +1,2 @@
+HCLIB_CFLAGS+=-DHCLIB_FORASYNC_MODE=FORASYNC_MODE_FLAT -DHCLIB_LOOP_DIST=HCLIB_REPLAY_LOOP_DIST
+HCLIB_CXXFLAGS+=-DHCLIB_FORASYNC_MODE=FORASYNC_MODE_FLAT -DHCLIB_LOOP_DIST=HCLIB_REPLAY_LOOP_DIST
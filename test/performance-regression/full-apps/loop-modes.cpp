@@ -0,0 +1,87 @@
+/*
+ * Compares the forasync chunking modes (flat, recursive, and adaptive lazy
+ * binary splitting) on a regular loop with uniform per-iteration cost and on
+ * two irregular loops: a triangular loop whose cost grows with the index, and
+ * a loop where a small random subset of iterations is much more expensive.
+ *
+ * Usage: ./loop-modes [N] [iterations]
+ */
+#include "hclib_cpp.h"
+#include <sys/time.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+static long get_usecs() {
+    struct timeval t;
+    gettimeofday(&t, NULL);
+    return t.tv_sec * 1000000 + t.tv_usec;
+}
+
+static double work(int n, double seed) {
+    double acc = seed;
+    for (int k = 0; k < n; k++) {
+        acc = sqrt(acc + k);
+    }
+    return acc;
+}
+
+static const char *mode_name(int mode) {
+    switch (mode) {
+        case FORASYNC_MODE_FLAT: return "flat";
+        case FORASYNC_MODE_RECURSIVE: return "recursive";
+        case FORASYNC_MODE_ADAPTIVE: return "adaptive";
+        default: return "unknown";
+    }
+}
+
+int main(int argc, char **argv) {
+    int N = 1 << 16;
+    int niters = 5;
+    if (argc > 1) N = atoi(argv[1]);
+    if (argc > 2) niters = atoi(argv[2]);
+
+    const char *deps[] = { "system" };
+    hclib::launch(deps, 1, [&]() {
+        double *out = (double *)malloc(N * sizeof(double));
+        int *cost = (int *)malloc(N * sizeof(int));
+        assert(out && cost);
+
+        const char *loop_names[] = { "regular", "triangular", "spiky" };
+        srand(42);
+        const int modes[] = { FORASYNC_MODE_FLAT, FORASYNC_MODE_RECURSIVE,
+            FORASYNC_MODE_ADAPTIVE };
+
+        for (int l = 0; l < 3; l++) {
+            for (int i = 0; i < N; i++) {
+                switch (l) {
+                    case 0: cost[i] = 64; break;
+                    case 1: cost[i] = (int)(128.0 * i / N); break;
+                    default: cost[i] = (rand() % 64 == 0) ? 4096 : 1;
+                }
+            }
+
+            for (int m = 0; m < 3; m++) {
+                const int mode = modes[m];
+                hclib::loop_domain_1d *loop = new hclib::loop_domain_1d(N);
+                const long start = get_usecs();
+                for (int iter = 0; iter < niters; iter++) {
+                    hclib::finish([&]() {
+                        hclib::forasync1D(loop, [=](int i) {
+                            out[i] = work(cost[i], (double)i);
+                        }, false, mode);
+                    });
+                }
+                const long elapsed = get_usecs() - start;
+                printf("%-10s %-9s %10.3f ms\n", loop_names[l],
+                        mode_name(mode), (double)elapsed / 1000.0 / niters);
+                delete loop;
+            }
+        }
+
+        free(out);
+        free(cost);
+    });
+
+    return 0;
+}
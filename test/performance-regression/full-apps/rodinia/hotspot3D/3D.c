@@ -14,6 +14,15 @@
 #include <sys/time.h>
 #include <string.h>
 
+/*
+ * Loop distribution used to place layers on workers each timestep, e.g.
+ * HCLIB_REPLAY_LOOP_DIST to keep a layer on the same worker across timesteps.
+ * Only honored in flat mode.
+ */
+#ifndef HCLIB_LOOP_DIST
+#define HCLIB_LOOP_DIST HCLIB_DEFAULT_LOOP_DIST
+#endif
+
 #define STR_SIZE (256)
 #define MAX_PD	(3.0e6)
 /* required precision in degrees	*/
@@ -221,7 +230,7 @@ domain[0].low = 0;
 domain[0].high = nz;
 domain[0].stride = 1;
 domain[0].tile = -1;
-hclib_future_t *fut = hclib_forasync_future((void *)pragma157_omp_parallel_hclib_async, new_ctx, 1, domain, HCLIB_FORASYNC_MODE);
+hclib_future_t *fut = hclib_forasync_future_dist((void *)pragma157_omp_parallel_hclib_async, new_ctx, 1, domain, HCLIB_FORASYNC_MODE, HCLIB_LOOP_DIST);
 hclib_future_wait(fut);
 free(new_ctx);
  } 
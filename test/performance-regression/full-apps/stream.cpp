@@ -0,0 +1,107 @@
+/*
+ * STREAM-style triad and daxpy kernels, used to compare the overhead of a
+ * per-index forasync body against a range body that is invoked once per tile.
+ *
+ * Usage: ./stream [N] [tile size] [iterations]
+ */
+#include "hclib_cpp.h"
+#include <sys/time.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+
+static long get_usecs() {
+    struct timeval t;
+    gettimeofday(&t, NULL);
+    return t.tv_sec * 1000000 + t.tv_usec;
+}
+
+static void report(const char *kernel, const char *body, int mode, long usecs,
+        int niters, size_t bytes_per_iter) {
+    const double secs = (double)usecs / 1000000.0;
+    printf("%-6s %-9s %-9s %10.3f ms  %8.2f GB/s\n", kernel, body,
+            mode == FORASYNC_MODE_RECURSIVE ? "recursive" : "flat",
+            (double)usecs / 1000.0 / niters,
+            (double)bytes_per_iter * niters / secs / 1e9);
+}
+
+int main(int argc, char **argv) {
+    int N = 1 << 24;
+    int tile = 4096;
+    int niters = 10;
+    if (argc > 1) N = atoi(argv[1]);
+    if (argc > 2) tile = atoi(argv[2]);
+    if (argc > 3) niters = atoi(argv[3]);
+
+    const char *deps[] = { "system" };
+    hclib::launch(deps, 1, [&]() {
+        double *a = (double *)malloc(N * sizeof(double));
+        double *b = (double *)malloc(N * sizeof(double));
+        double *c = (double *)malloc(N * sizeof(double));
+        const double scalar = 3.0;
+        assert(a && b && c);
+
+        hclib::loop_domain_1d *loop = new hclib::loop_domain_1d(0, N,
+                (N + tile - 1) / tile);
+        for (int i = 0; i < N; i++) {
+            a[i] = 1.0; b[i] = 2.0; c[i] = 0.0;
+        }
+
+        for (int mode = FORASYNC_MODE_FLAT; mode <= FORASYNC_MODE_RECURSIVE;
+                mode++) {
+            long start = get_usecs();
+            for (int iter = 0; iter < niters; iter++) {
+                hclib::finish([&]() {
+                    hclib::forasync1D(loop, [=](int i) {
+                        a[i] = b[i] + scalar * c[i];
+                    }, false, mode);
+                });
+            }
+            report("triad", "per-index", mode, get_usecs() - start, niters,
+                    3 * N * sizeof(double));
+
+            start = get_usecs();
+            for (int iter = 0; iter < niters; iter++) {
+                hclib::finish([&]() {
+                    hclib::forasync1D_range(loop, [=](int low, int high) {
+                        for (int i = low; i < high; i++) {
+                            a[i] = b[i] + scalar * c[i];
+                        }
+                    }, false, mode);
+                });
+            }
+            report("triad", "range", mode, get_usecs() - start, niters,
+                    3 * N * sizeof(double));
+
+            start = get_usecs();
+            for (int iter = 0; iter < niters; iter++) {
+                hclib::finish([&]() {
+                    hclib::forasync1D(loop, [=](int i) {
+                        b[i] += scalar * a[i];
+                    }, false, mode);
+                });
+            }
+            report("daxpy", "per-index", mode, get_usecs() - start, niters,
+                    3 * N * sizeof(double));
+
+            start = get_usecs();
+            for (int iter = 0; iter < niters; iter++) {
+                hclib::finish([&]() {
+                    hclib::forasync1D_range(loop, [=](int low, int high) {
+                        for (int i = low; i < high; i++) {
+                            b[i] += scalar * a[i];
+                        }
+                    }, false, mode);
+                });
+            }
+            report("daxpy", "range", mode, get_usecs() - start, niters,
+                    3 * N * sizeof(double));
+        }
+
+        free(a);
+        free(b);
+        free(c);
+    });
+
+    return 0;
+}
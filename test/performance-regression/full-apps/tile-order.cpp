@@ -0,0 +1,104 @@
+/*
+ * Compares the tile traversal orders of forasync2D on a blocked matrix
+ * transpose and a 5-point Jacobi stencil: row-major flat and recursive
+ * chunking versus Morton, Hilbert, and cache-oblivious (longest dimension
+ * first) orders.
+ *
+ * Usage: ./tile-order [N] [tile] [iterations]
+ */
+#include "hclib_cpp.h"
+#include <sys/time.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+
+static long get_usecs() {
+    struct timeval t;
+    gettimeofday(&t, NULL);
+    return t.tv_sec * 1000000 + t.tv_usec;
+}
+
+static const char *mode_name(int mode) {
+    switch (mode) {
+        case FORASYNC_MODE_FLAT: return "flat";
+        case FORASYNC_MODE_RECURSIVE: return "recursive";
+        case FORASYNC_MODE_MORTON: return "morton";
+        case FORASYNC_MODE_HILBERT: return "hilbert";
+        case FORASYNC_MODE_OBLIVIOUS: return "oblivious";
+        default: return "unknown";
+    }
+}
+
+int main(int argc, char **argv) {
+    int N = 4096;
+    int tile = 64;
+    int niters = 5;
+    if (argc > 1) N = atoi(argv[1]);
+    if (argc > 2) tile = atoi(argv[2]);
+    if (argc > 3) niters = atoi(argv[3]);
+
+    const char *deps[] = { "system" };
+    hclib::launch(deps, 1, [&]() {
+        double *a = (double *)malloc((size_t)N * N * sizeof(double));
+        double *b = (double *)malloc((size_t)N * N * sizeof(double));
+        assert(a && b);
+        for (size_t i = 0; i < (size_t)N * N; i++) {
+            a[i] = (double)(i % 1024);
+            b[i] = 0.0;
+        }
+
+        const int modes[] = { FORASYNC_MODE_FLAT, FORASYNC_MODE_RECURSIVE,
+            FORASYNC_MODE_MORTON, FORASYNC_MODE_HILBERT,
+            FORASYNC_MODE_OBLIVIOUS };
+
+        for (int m = 0; m < 5; m++) {
+            const int mode = modes[m];
+            hclib::loop_domain_2d *loop = new hclib::loop_domain_2d(0, N, tile,
+                    0, N, tile);
+
+            long start = get_usecs();
+            for (int iter = 0; iter < niters; iter++) {
+                hclib::finish([&]() {
+                    hclib::forasync2D_range(loop, [=](int low0, int high0,
+                                int low1, int high1) {
+                        for (int i = low0; i < high0; i++) {
+                            for (int j = low1; j < high1; j++) {
+                                b[(size_t)j * N + i] = a[(size_t)i * N + j];
+                            }
+                        }
+                    }, false, mode);
+                });
+            }
+            const long transpose = get_usecs() - start;
+
+            start = get_usecs();
+            for (int iter = 0; iter < niters; iter++) {
+                hclib::finish([&]() {
+                    hclib::forasync2D_range(loop, [=](int low0, int high0,
+                                int low1, int high1) {
+                        for (int i = low0; i < high0; i++) {
+                            if (i == 0 || i == N - 1) continue;
+                            for (int j = low1; j < high1; j++) {
+                                if (j == 0 || j == N - 1) continue;
+                                const size_t c = (size_t)i * N + j;
+                                b[c] = 0.2 * (a[c] + a[c - 1] + a[c + 1] +
+                                        a[c - N] + a[c + N]);
+                            }
+                        }
+                    }, false, mode);
+                });
+            }
+            const long stencil = get_usecs() - start;
+
+            printf("%-10s transpose %10.3f ms  stencil %10.3f ms\n",
+                    mode_name(mode), (double)transpose / 1000.0 / niters,
+                    (double)stencil / 1000.0 / niters);
+            delete loop;
+        }
+
+        free(a);
+        free(b);
+    });
+
+    return 0;
+}
@@ -1,11 +1,13 @@
-if [ $# -ne 2 ]; then
-	echo "USAGE: ./run.sh <NUM_WORKERS> <WORKLOAD>"
+if [ $# -lt 2 ]; then
+	echo "USAGE: ./run.sh <NUM_WORKERS> <WORKLOAD> [EXE]"
 	echo "WORKLOAD=tiny, medium, large, huge"
+	echo "EXE=smith_waterman (default), smith_waterman_wavefront"
 	exit
 fi
 
 export HCLIB_WORKERS=$1
 SIZE=$2
+EXE=${3:-smith_waterman}
 export HCLIB_STATS=1
 
 #SIZE=tiny
@@ -47,5 +49,5 @@ fi
 fi
 fi
 
-echo "./smith_waterman ${INPUT_FILE_1} ${INPUT_FILE_2} ${TILE_WIDTH} ${TILE_HEIGHT} ${INNER_TILE_WIDTH} ${INNER_TILE_HEIGHT}"
-./smith_waterman ${INPUT_FILE_1} ${INPUT_FILE_2} ${TILE_WIDTH} ${TILE_HEIGHT} ${INNER_TILE_WIDTH} ${INNER_TILE_HEIGHT}
+echo "./${EXE} ${INPUT_FILE_1} ${INPUT_FILE_2} ${TILE_WIDTH} ${TILE_HEIGHT} ${INNER_TILE_WIDTH} ${INNER_TILE_HEIGHT}"
+./${EXE} ${INPUT_FILE_1} ${INPUT_FILE_2} ${TILE_WIDTH} ${TILE_HEIGHT} ${INNER_TILE_WIDTH} ${INNER_TILE_HEIGHT}
@@ -74,14 +74,15 @@ signed char* read_file( FILE* file, size_t* n_chars ) {
 }
 
 typedef struct {
-    hclib::promise_t* bottom_row;
-    hclib::promise_t* right_column;
-    hclib::promise_t* bottom_right;
+    hclib::promise_t<int*>* bottom_row;
+    hclib::promise_t<int*>* right_column;
+    hclib::promise_t<int*>* bottom_right;
 } Tile_t;
 
 
 int main ( int argc, char* argv[] ) {
-    hclib::launch(&argc, argv, [&]() {
+    const char *deps[] = { "system" };
+    hclib::launch(deps, 1, [&]() {
         int i, j;
 
         int tile_width = (int) atoi (argv[3]);
@@ -128,9 +129,9 @@ int main ( int argc, char* argv[] ) {
         for ( i = 0; i < n_tiles_height+1; ++i ) {
             tile_matrix[i] = (Tile_t *) malloc(sizeof(Tile_t)*(n_tiles_width+1));
             for ( j = 0; j < n_tiles_width+1; ++j ) {
-                tile_matrix[i][j].bottom_row = new hclib::promise_t();
-                tile_matrix[i][j].right_column = new hclib::promise_t();
-                tile_matrix[i][j].bottom_right = new hclib::promise_t();
+                tile_matrix[i][j].bottom_row = new hclib::promise_t<int*>();
+                tile_matrix[i][j].right_column = new hclib::promise_t<int*>();
+                tile_matrix[i][j].bottom_right = new hclib::promise_t<int*>();
             }
         }
 
@@ -226,7 +227,7 @@ int main ( int argc, char* argv[] ) {
                         free(curr_tile_tmp);
                     }, tile_matrix[i][j-1].right_column->get_future(),
                     tile_matrix[i-1][j].bottom_row->get_future(),
-                    tile_matrix[i-1][j-1].bottom_right->get_future());
+                    tile_matrix[i-1][j-1].bottom_right->get_future(), NULL);
                 }
             }
         });
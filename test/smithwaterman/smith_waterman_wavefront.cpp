@@ -0,0 +1,232 @@
+#include <stdio.h>
+#include <sys/time.h>
+#include <time.h>
+#include <assert.h>
+#include "hclib_cpp.h"
+
+#define GAP_PENALTY -1
+#define TRANSITION_PENALTY -2
+#define TRANSVERSION_PENALTY -4
+#define MATCH 2
+
+enum Nucleotide {GAP=0, ADENINE, CYTOSINE, GUANINE, THYMINE};
+
+signed char char_mapping ( char c ) {
+    signed char to_be_returned = -1;
+    switch(c) {
+        case '_': to_be_returned = GAP; break;
+        case 'A': to_be_returned = ADENINE; break;
+        case 'C': to_be_returned = CYTOSINE; break;
+        case 'G': to_be_returned = GUANINE; break;
+        case 'T': to_be_returned = THYMINE; break;
+    }
+    return to_be_returned;
+}
+
+void print_matrix ( int** matrix, int n_rows, int n_columns ) {
+    int i, j;
+    for ( i = 0; i < n_rows; ++i ) {
+        for ( j = 0; j < n_columns; ++j ) {
+            fprintf(stdout, "%d ", matrix[i][j]);
+        }
+        fprintf(stdout, "\n");
+    }
+    fprintf(stdout,"--------------------------------\n");
+}
+
+static char alignment_score_matrix[5][5] =
+{
+    {GAP_PENALTY,GAP_PENALTY,GAP_PENALTY,GAP_PENALTY,GAP_PENALTY},
+    {GAP_PENALTY,MATCH,TRANSVERSION_PENALTY,TRANSITION_PENALTY,TRANSVERSION_PENALTY},
+    {GAP_PENALTY,TRANSVERSION_PENALTY, MATCH,TRANSVERSION_PENALTY,TRANSITION_PENALTY},
+    {GAP_PENALTY,TRANSITION_PENALTY,TRANSVERSION_PENALTY, MATCH,TRANSVERSION_PENALTY},
+    {GAP_PENALTY,TRANSVERSION_PENALTY,TRANSITION_PENALTY,TRANSVERSION_PENALTY, MATCH}
+};
+
+size_t clear_whitespaces_do_mapping ( signed char* buffer, long lsize ) {
+    size_t non_ws_index = 0, traverse_index = 0;
+
+    while ( traverse_index < lsize ) {
+        char curr_char = buffer[traverse_index];
+        switch ( curr_char ) {
+            case 'A': case 'C': case 'G': case 'T':
+                /*this used to be a copy not also does mapping*/
+                buffer[non_ws_index++] = char_mapping(curr_char);
+                break;
+        }
+        ++traverse_index;
+    }
+    return non_ws_index;
+}
+
+signed char* read_file( FILE* file, size_t* n_chars ) {
+    fseek (file, 0L, SEEK_END);
+    long file_size = ftell (file);
+    fseek (file, 0L, SEEK_SET);
+
+    signed char *file_buffer = (signed char *)malloc((1+file_size)*sizeof(signed char));
+
+    size_t n_read_from_file = fread(file_buffer, sizeof(signed char), file_size, file);
+    file_buffer[file_size] = '\n';
+
+    /* shams' sample inputs have newlines in them */
+    *n_chars = clear_whitespaces_do_mapping(file_buffer, file_size);
+    return file_buffer;
+}
+
+/*
+ * Same computation as smith_waterman.cpp, but using forasync2D_wavefront to
+ * order tiles instead of a promise per tile edge. Tile edges are kept in flat
+ * preallocated arrays, and each worker reuses a single scratch tile.
+ */
+int main ( int argc, char* argv[] ) {
+    const char *deps[] = { "system" };
+    hclib::launch(deps, 1, [&]() {
+        int i, j;
+
+        if ( argc < 5 ) {
+            fprintf(stderr, "Usage: %s fileName1 fileName2 tileWidth tileHeight\n", argv[0]);
+            exit(1);
+        }
+
+        const int tile_width = (int) atoi (argv[3]);
+        const int tile_height = (int) atoi (argv[4]);
+
+        signed char* string_1;
+        signed char* string_2;
+
+        char* file_name_1 = argv[1];
+        char* file_name_2 = argv[2];
+
+        FILE* file_1 = fopen(file_name_1, "r");
+        if (!file_1) { fprintf(stderr, "could not open file %s\n",file_name_1); exit(1); }
+        size_t n_char_in_file_1 = 0;
+        string_1 = read_file(file_1, &n_char_in_file_1);
+        fprintf(stdout, "Size of input string 1 is %lu\n", n_char_in_file_1 );
+
+        FILE* file_2 = fopen(file_name_2, "r");
+        if (!file_2) { fprintf(stderr, "could not open file %s\n",file_name_2); exit(1); }
+        size_t n_char_in_file_2 = 0;
+        string_2 = read_file(file_2, &n_char_in_file_2);
+        fprintf(stdout, "Size of input string 2 is %lu\n", n_char_in_file_2 );
+
+        fprintf(stdout, "Tile width is %d\n", tile_width);
+        fprintf(stdout, "Tile height is %d\n", tile_height);
+
+        const int n_tiles_width = n_char_in_file_1/tile_width;
+        const int n_tiles_height = n_char_in_file_2/tile_height;
+        const int row_len = n_tiles_width + 1;
+
+        fprintf(stdout, "Imported %d x %d tiles.\n", n_tiles_width, n_tiles_height);
+
+        // Edges of every tile, including the boundary row and column of tiles
+        int *bottom_rows = (int *)malloc(sizeof(int) * (n_tiles_height + 1) *
+                row_len * tile_width);
+        int *right_columns = (int *)malloc(sizeof(int) * (n_tiles_height + 1) *
+                row_len * tile_height);
+        int *bottom_rights = (int *)malloc(sizeof(int) * (n_tiles_height + 1) *
+                row_len);
+        assert(bottom_rows && right_columns && bottom_rights);
+
+        bottom_rights[0] = 0;
+        for ( j = 1; j < n_tiles_width + 1; ++j ) {
+            for( i = 0; i < tile_width ; ++i ) {
+                bottom_rows[j * tile_width + i] = GAP_PENALTY*((j-1)*tile_width+i+1);
+            }
+            bottom_rights[j] = GAP_PENALTY*(j*tile_width);
+        }
+        for ( i = 1; i < n_tiles_height + 1; ++i ) {
+            for ( j = 0; j < tile_height ; ++j ) {
+                right_columns[i * row_len * tile_height + j] = GAP_PENALTY*((i-1)*tile_height+j+1);
+            }
+            bottom_rights[i * row_len] = GAP_PENALTY*(i*tile_height);
+        }
+
+        const int nworkers = hclib::get_num_workers();
+        int *scratch = (int *)malloc(sizeof(int) * nworkers *
+                (1 + tile_width) * (1 + tile_height));
+        assert(scratch);
+
+        struct timeval begin,end;
+        gettimeofday(&begin,0);
+
+        const int this_tile_width = tile_width;
+        const int this_tile_height = tile_height;
+        const signed char *this_string_1 = string_1;
+        const signed char *this_string_2 = string_2;
+
+        hclib::finish([=]() {
+            hclib::loop_domain_2d *loop = new hclib::loop_domain_2d(
+                    1, n_tiles_height + 1, 1, 1, n_tiles_width + 1, 1);
+            hclib::forasync2D_wavefront(loop, FORASYNC_WAVEFRONT_NORTH |
+                    FORASYNC_WAVEFRONT_WEST | FORASYNC_WAVEFRONT_NORTHWEST,
+                    [=](int low0, int high0, int low1, int high1) {
+                /*
+                 * Copy captures into locals: stores through curr_tile could
+                 * otherwise alias the closure's int members and defeat
+                 * optimization of the inner loop.
+                 */
+                const int tile_width = this_tile_width;
+                const int tile_height = this_tile_height;
+                const signed char *string_1 = this_string_1;
+                const signed char *string_2 = this_string_2;
+                const int i = low0;
+                const int j = low1;
+                const int stride = 1 + tile_width;
+                int *curr_tile = scratch + hclib::get_current_worker() *
+                    (1 + tile_width) * (1 + tile_height);
+                const int *above_tile_bottom_row =
+                    bottom_rows + ((i - 1) * row_len + j) * tile_width;
+                const int *left_tile_right_column =
+                    right_columns + (i * row_len + j - 1) * tile_height;
+                int index, ii, jj;
+
+                curr_tile[0] = bottom_rights[(i - 1) * row_len + j - 1];
+                for ( index = 1; index < tile_height+1; ++index ) {
+                    curr_tile[index * stride] = left_tile_right_column[index-1];
+                }
+                for ( index = 1; index < tile_width+1; ++index ) {
+                    curr_tile[index] = above_tile_bottom_row[index-1];
+                }
+
+                for ( ii = 1; ii < tile_height+1; ++ii ) {
+                    for ( jj = 1; jj < tile_width+1; ++jj ) {
+                        signed char char_from_1 = string_1[(j-1)*tile_width+(jj-1)];
+                        signed char char_from_2 = string_2[(i-1)*tile_height+(ii-1)];
+
+                        int diag_score = curr_tile[(ii-1)*stride + jj-1] + alignment_score_matrix[char_from_2][char_from_1];
+                        int left_score = curr_tile[ii*stride + jj-1] + alignment_score_matrix[char_from_1][GAP];
+                        int  top_score = curr_tile[(ii-1)*stride + jj] + alignment_score_matrix[GAP][char_from_2];
+
+                        int bigger_of_left_top = (left_score > top_score) ? left_score : top_score;
+                        curr_tile[ii*stride + jj] = (bigger_of_left_top > diag_score) ? bigger_of_left_top : diag_score;
+                    }
+                }
+
+                bottom_rights[i * row_len + j] = curr_tile[tile_height*stride + tile_width];
+                int *curr_right_column = right_columns + (i * row_len + j) * tile_height;
+                for ( index = 0; index < tile_height; ++index ) {
+                    curr_right_column[index] = curr_tile[(index+1)*stride + tile_width];
+                }
+                int *curr_bottom_row = bottom_rows + (i * row_len + j) * tile_width;
+                for ( index = 0; index < tile_width; ++index ) {
+                    curr_bottom_row[index] = curr_tile[tile_height*stride + index+1];
+                }
+            });
+        });
+
+        gettimeofday(&end,0);
+        fprintf(stdout, "The computation took %f seconds\n",((end.tv_sec - begin.tv_sec)*1000000+(end.tv_usec - begin.tv_usec))*1.0/1000000);
+
+        int score = bottom_rows[(n_tiles_height * row_len + n_tiles_width) *
+            tile_width + tile_width - 1];
+        fprintf(stdout, "score: %d\n", score);
+
+        free(scratch);
+        free(bottom_rows);
+        free(right_columns);
+        free(bottom_rights);
+    });
+
+    return 0;
+}
@@ -0,0 +1,193 @@
+/*
+ *         ---- The Unbalanced Tree Search (UTS) Benchmark ----
+ *
+ *  Copyright (c) 2010 See AUTHORS file for copyright holders
+ *
+ *  This file is part of the unbalanced tree search benchmark.  This
+ *  project is licensed under the MIT Open Source license.  See the LICENSE
+ *  file for copyright and licensing information.
+ *
+ *  UTS is a collaborative project between researchers at the University of
+ *  Maryland, the University of North Carolina at Chapel Hill, and the Ohio
+ *  State University.  See AUTHORS file for more information.
+ *
+ */
+
+/*
+ * Distributed UTS over the hclib MPI module. Rank 0 spawns the root, and the
+ * tree is load balanced across workers and ranks by the module's distributed
+ * work stealing: each stealable task expands a chunk of nodes depth-first and
+ * releases chunks of surplus nodes as new stealable tasks, which idle ranks
+ * steal. Run as e.g. mpirun -np 4 ./UTS_mpi $T1 and compare the totals with
+ * sample_trees.sh.
+ */
+
+#include "hclib_cpp.h"
+#include "hclib_mpi.h"
+#include <assert.h>
+#include <string.h>
+
+#include "uts.h"
+
+/* per worker statistics, padded to avoid false sharing */
+struct workerStats_t {
+	counter_t nNodes, nLeaves;
+	counter_t maxTreeDepth;
+	char pad[64 - 3 * sizeof(counter_t)];
+};
+
+// parallel execution parameters
+int chunkSize = 20;    // number of nodes to move to/from shared area
+
+static int nworkers;
+static int nranks;
+static int expand_fn;
+static workerStats_t *workerStats;
+
+/*
+ * Expand nodes depth-first from a private stack, releasing the chunkSize
+ * oldest nodes (closest to the root) as a new stealable task whenever the
+ * stack holds at least twice that many.
+ */
+static void expand_chunk(void *payload, size_t nbytes) {
+	workerStats_t *ws = &workerStats[hclib::get_current_worker()];
+	int capacity = 4 * chunkSize + MAXNUMCHILDREN;
+	int size = nbytes / sizeof(Node);
+	Node *stack = (Node *)malloc(capacity * sizeof(Node));
+	assert(stack);
+	memcpy(stack, payload, nbytes);
+
+	while (size > 0) {
+		Node parent = stack[--size];
+		int numChildren = uts_numChildren(&parent);
+		int childType = uts_childType(&parent);
+
+		ws->nNodes++;
+		ws->maxTreeDepth = max(ws->maxTreeDepth, parent.height);
+		if (numChildren == 0) {
+			ws->nLeaves++;
+			continue;
+		}
+
+		if (size + numChildren > capacity) {
+			capacity = 2 * (size + numChildren);
+			stack = (Node *)realloc(stack, capacity * sizeof(Node));
+			assert(stack);
+		}
+		for (int i = 0; i < numChildren; i++) {
+			Node *child = &stack[size++];
+			child->type = childType;
+			child->height = parent.height + 1;
+			child->numChildren = -1;
+			for (int j = 0; j < computeGranularity; j++) {
+				rng_spawn(parent.state.state, child->state.state, i);
+			}
+		}
+
+		if (size >= 2 * chunkSize) {
+			hclib::MPI_Stealable_spawn(expand_fn, stack,
+					chunkSize * sizeof(Node));
+			size -= chunkSize;
+			memmove(stack, stack + chunkSize, size * sizeof(Node));
+		}
+	}
+	free(stack);
+}
+
+int main(int argc, char *argv[]) {
+	const char *deps[] = { "system" };
+	hclib::launch(deps, 1, [&]() {
+		int rank;
+		hclib::MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+		hclib::MPI_Comm_size(MPI_COMM_WORLD, &nranks);
+		nworkers = hclib::get_num_workers();
+
+		uts_parseParams(argc, argv);
+		if (rank == 0) uts_printParams();
+
+		workerStats = (workerStats_t *)calloc(nworkers,
+				sizeof(workerStats_t));
+		assert(workerStats);
+		expand_fn = hclib::MPI_Stealable_register(expand_chunk);
+
+		hclib::MPI_Barrier(MPI_COMM_WORLD);
+		double t1 = uts_wctime();
+
+		hclib::MPI_Distributed_finish([=] {
+			if (rank == 0) {
+				Node root;
+				uts_initRoot(&root, type);
+				hclib::MPI_Stealable_spawn(expand_fn, &root, sizeof(root));
+			}
+		});
+
+		double t2 = uts_wctime();
+
+		counter_t local[2] = { 0, 0 }, total[2];
+		counter_t localDepth = 0, maxDepth;
+		for (int i = 0; i < nworkers; i++) {
+			local[0] += workerStats[i].nNodes;
+			local[1] += workerStats[i].nLeaves;
+			localDepth = max(localDepth, workerStats[i].maxTreeDepth);
+		}
+		printf("Rank %d: %llu nodes\n", rank, local[0]);
+		hclib::MPI_Reduce(local, total, 2, MPI_UNSIGNED_LONG_LONG, MPI_SUM,
+				0, MPI_COMM_WORLD);
+		hclib::MPI_Reduce(&localDepth, &maxDepth, 1,
+				MPI_UNSIGNED_LONG_LONG, MPI_MAX, 0, MPI_COMM_WORLD);
+
+		if (rank == 0) {
+			uts_showStats(nranks * nworkers, chunkSize, t2 - t1, total[0],
+					total[1], maxDepth);
+		}
+		free(workerStats);
+	});
+
+	return 0;
+}
+
+/***********************************************************
+ *  UTS Implementation Hooks                               *
+ ***********************************************************/
+
+// Return a string describing this implementation
+char * impl_getName() {
+	return "HClib MPI distributed work-stealing UTS";
+}
+
+
+// construct string with all parameter settings
+int impl_paramsToStr(char *strBuf, int ind) {
+	ind += sprintf(strBuf+ind, "Execution strategy:  ");
+	ind += sprintf(strBuf+ind, "Parallel search using %d ranks of %d "
+			"threads\n", nranks, nworkers);
+	ind += sprintf(strBuf+ind, "   Load balance by distributed work stealing, "
+			"chunk size = %d nodes\n", chunkSize);
+
+	return ind;
+}
+
+// Parse command-line flags
+int impl_parseParam(char *param, char *value) {
+	int err = 0;  // Return 0 on a match, nonzero on an error
+
+	switch (param[1]) {
+	case 'c':
+		chunkSize = atoi(value); break;
+	default:
+		err = 1;
+		break;
+	}
+
+	return err;
+}
+
+// Add this to the generic help message
+void impl_helpMessage() {
+	printf("   -c  int   chunksize for work sharing and work stealing\n");
+}
+
+
+void impl_abort(int err) {
+	exit(1);
+}